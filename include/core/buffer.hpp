@@ -4,6 +4,12 @@
 #include <glad/glad.h>
 
 // std
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <map>
 #include <stdexcept>
 
 class Buffer {
@@ -44,8 +50,9 @@ private:
 class VertexArray {
 public:
 
-  // glGenVertexArrays(1, &id_)
-  VertexArray() { glGenVertexArrays(1, &id_); }
+  // glCreateVertexArrays(1, &id_), so the array exists before it is first bound and the
+  // glVertexArray* calls can set it up directly.
+  VertexArray() { glCreateVertexArrays(1, &id_); }
   ~VertexArray() { glDeleteVertexArrays(1, &id_); }
 
   VertexArray(const VertexArray&) = delete;
@@ -63,4 +70,303 @@ public:
 
 private:
   GLuint id_;
-};
\ No newline at end of file
+};
+
+
+
+/**
+ * @brief First-fit sub-allocator of a range of units. Freed ranges are merged with
+ * free neighbours, so the range does not fragment into slivers as meshes come and go.
+ * Knows nothing of GL; BufferArena pairs it with a buffer.
+ */
+class RangeAllocator {
+public:
+  static constexpr size_t kInvalid = SIZE_MAX;
+
+  explicit RangeAllocator(size_t capacity = 0) { Grow(capacity); }
+
+  /**
+   * @return The offset of size free units, or kInvalid if no free range is large enough.
+   */
+  size_t Allocate(size_t size) {
+    for (auto it = free_.begin(); it != free_.end(); ++it) {
+      if (it->second < size)
+        continue;
+      const size_t offset = it->first;
+      const size_t rest = it->second - size;
+      free_.erase(it);
+      if (rest > 0)
+        free_.emplace(offset + size, rest);
+      used_ += size;
+      return offset;
+    }
+    return kInvalid;
+  }
+
+  /**
+   * @brief Returns a range given by Allocate.
+   */
+  void Free(size_t offset, size_t size) {
+    used_ -= size;
+    Insert(offset, size);
+  }
+
+  /**
+   * @brief Extends the range to capacity units; allocations keep their offsets.
+   */
+  void Grow(size_t capacity) {
+    if (capacity <= capacity_)
+      return;
+    Insert(capacity_, capacity - capacity_);
+    capacity_ = capacity;
+  }
+
+  size_t GetCapacity() const { return capacity_; }
+  size_t GetUsed() const { return used_; }
+  size_t GetFreeRanges() const { return free_.size(); }
+
+private:
+  void Insert(size_t offset, size_t size) {
+    if (size == 0)
+      return;
+    auto next = free_.lower_bound(offset);
+    if (next != free_.end() && offset + size == next->first) {
+      size += next->second;
+      next = free_.erase(next);
+    }
+    if (next != free_.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == offset) {
+        prev->second += size;
+        return;
+      }
+    }
+    free_.emplace_hint(next, offset, size);
+  }
+
+  std::map<size_t, size_t> free_;  ///< Offset to size of every free range.
+  size_t capacity_ = 0;
+  size_t used_ = 0;
+};
+
+
+
+/**
+ * @brief One GL buffer holding many objects, sub-allocated in units of unit_size bytes
+ * (a vertex, an index). When full it moves to a buffer twice as large, up to
+ * max_capacity units, which changes GetID() but keeps every offset; users that bound the
+ * old buffer must bind it again.
+ */
+class BufferArena {
+public:
+  BufferArena(size_t unit_size, size_t capacity, size_t max_capacity = SIZE_MAX)
+      : unit_size_(unit_size), max_capacity_(std::max(max_capacity, size_t(1))), allocator_(std::min(capacity, max_capacity_)) {
+    glCreateBuffers(1, &id_);
+    glNamedBufferStorage(id_, static_cast<GLsizeiptr>(allocator_.GetCapacity() * unit_size_), nullptr, GL_DYNAMIC_STORAGE_BIT);
+  }
+  ~BufferArena() { glDeleteBuffers(1, &id_); }
+
+  BufferArena(const BufferArena&) = delete;
+  BufferArena& operator=(const BufferArena&) = delete;
+
+  /**
+   * @return The offset, in units, of size units, growing the buffer if needed, or
+   * RangeAllocator::kInvalid if no free range is large enough at max_capacity.
+   */
+  size_t Allocate(size_t size) {
+    size_t offset = allocator_.Allocate(size);
+    while (offset == RangeAllocator::kInvalid && allocator_.GetCapacity() < max_capacity_) {
+      Grow(std::min(allocator_.GetCapacity() * 2 + size, max_capacity_));
+      offset = allocator_.Allocate(size);
+    }
+    return offset;
+  }
+
+  void Free(size_t offset, size_t size) { allocator_.Free(offset, size); }
+
+  void Write(size_t offset, size_t size, const void* data) {
+    glNamedBufferSubData(id_, static_cast<GLintptr>(offset * unit_size_), static_cast<GLsizeiptr>(size * unit_size_), data);
+  }
+
+  /**
+   * @brief Copies size units from source_offset bytes into the buffer source, on the GPU.
+   */
+  void CopyFrom(GLuint source, size_t source_offset, size_t offset, size_t size) {
+    glCopyNamedBufferSubData(source, id_, static_cast<GLintptr>(source_offset),
+                             static_cast<GLintptr>(offset * unit_size_), static_cast<GLsizeiptr>(size * unit_size_));
+  }
+
+  GLuint GetID() const { return id_; }
+  size_t GetUnitSize() const { return unit_size_; }
+  const RangeAllocator& GetAllocator() const { return allocator_; }
+
+private:
+  void Grow(size_t capacity) {
+    GLuint grown = 0;
+    glCreateBuffers(1, &grown);
+    glNamedBufferStorage(grown, static_cast<GLsizeiptr>(capacity * unit_size_), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glCopyNamedBufferSubData(id_, grown, 0, 0, static_cast<GLsizeiptr>(allocator_.GetCapacity() * unit_size_));
+    glDeleteBuffers(1, &id_);
+    id_ = grown;
+    allocator_.Grow(capacity);
+  }
+
+  GLuint id_ = 0;
+  size_t unit_size_;
+  size_t max_capacity_;
+  RangeAllocator allocator_;
+};
+
+
+
+/**
+ * @brief A buffer mapped once, persistently and coherently, and written as a ring. Data
+ * is memcpy'd straight into the mapping and then copied or bound on the GPU, so uploads
+ * neither reallocate storage nor wait for the driver.
+ *
+ * Fence() marks the end of a frame's writes; their bytes are reused only once the GPU
+ * has passed the fence. Reserve waits for the oldest frame if the ring is full, so the
+ * capacity should cover a few frames of writes. It never waits on the bytes reserved
+ * since the last Fence(), which may not have been read yet: when only they are left in
+ * the way, it fails.
+ */
+class UploadRing {
+public:
+  static constexpr size_t kInvalid = SIZE_MAX;
+
+  explicit UploadRing(size_t capacity) : capacity_(capacity) {
+    constexpr GLbitfield kFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &id_);
+    glNamedBufferStorage(id_, static_cast<GLsizeiptr>(capacity_), nullptr, kFlags);
+    mapping_ = static_cast<uint8_t*>(glMapNamedBufferRange(id_, 0, static_cast<GLsizeiptr>(capacity_), kFlags));
+    if (!mapping_)
+      throw std::runtime_error("Failed to map the upload ring");
+  }
+  ~UploadRing() {
+    for (const Frame& frame : in_flight_)
+      glDeleteSync(frame.fence);
+    glUnmapNamedBuffer(id_);
+    glDeleteBuffers(1, &id_);
+  }
+
+  UploadRing(const UploadRing&) = delete;
+  UploadRing& operator=(const UploadRing&) = delete;
+
+  /**
+   * @return The offset of size writable bytes at GetMapping() + offset, aligned to
+   * alignment (a power of two), or kInvalid if they do not fit next to the bytes
+   * reserved since the last Fence().
+   */
+  size_t Reserve(size_t size, size_t alignment = 16) {
+    if (size > capacity_)
+      return kInvalid;
+    for (;;) {
+      if (used_ == 0)
+        head_ = 0;
+      size_t offset = (head_ + alignment - 1) & ~(alignment - 1);
+      if (offset + size > capacity_)
+        offset = 0;  // The tail of the ring is skipped.
+      const size_t skipped = (offset >= head_ ? offset - head_ : capacity_ - head_);
+      if (used_ + skipped + size <= capacity_) {
+        used_ += skipped + size;
+        frame_bytes_ += skipped + size;
+        head_ = offset + size;
+        bytes_written_ += size;
+        return offset;
+      }
+      // Full. The frame being built may still have its bytes to be read; only older
+      // frames are waited for.
+      if (in_flight_.empty())
+        return kInvalid;
+      WaitOldest();
+    }
+  }
+
+  /**
+   * @brief Fences the bytes reserved since the last call, once the commands that read
+   * them are issued.
+   */
+  void Fence() {
+    if (frame_bytes_ == 0)
+      return;
+    in_flight_.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), frame_bytes_ });
+    frame_bytes_ = 0;
+    // Reclaim what the GPU is already done with, without waiting.
+    while (in_flight_.size() > 1 && IsSignaled(in_flight_.front().fence))
+      Retire();
+  }
+
+  uint8_t* GetMapping() const { return mapping_; }
+  GLuint GetID() const { return id_; }
+  size_t GetCapacity() const { return capacity_; }
+  size_t GetBytesWritten() const { return bytes_written_; }  ///< Reserved bytes, over the ring's life.
+  size_t GetFenceWaits() const { return fence_waits_; }      ///< Reserves that had to wait for the GPU.
+
+private:
+  struct Frame {
+    GLsync fence;
+    size_t bytes;
+  };
+
+  static bool IsSignaled(GLsync fence) {
+    const GLenum result = glClientWaitSync(fence, 0, 0);
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+  }
+
+  void WaitOldest() {
+    const GLsync fence = in_flight_.front().fence;
+    if (!IsSignaled(fence)) {
+      ++fence_waits_;
+      GLenum result;
+      do
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+      while (result == GL_TIMEOUT_EXPIRED);
+      if (result == GL_WAIT_FAILED)
+        throw std::runtime_error("Failed to wait for an upload ring fence");
+    }
+    Retire();
+  }
+
+  void Retire() {
+    glDeleteSync(in_flight_.front().fence);
+    used_ -= in_flight_.front().bytes;
+    in_flight_.pop_front();
+  }
+
+  GLuint id_ = 0;
+  uint8_t* mapping_ = nullptr;
+  size_t capacity_;
+  size_t head_ = 0;         ///< Where the next reservation starts looking.
+  size_t used_ = 0;         ///< Bytes reserved and not yet retired, skipped ones included.
+  size_t frame_bytes_ = 0;  ///< Part of used_ not fenced yet.
+  std::deque<Frame> in_flight_;
+  size_t bytes_written_ = 0;
+  size_t fence_waits_ = 0;
+};
+
+
+
+/**
+ * @brief A uniform buffer of fixed size, rewritten whole by Update and bound for good to
+ * one binding point, where every program whose block is bound there reads it.
+ */
+class UniformBuffer {
+public:
+  UniformBuffer(size_t size, GLuint binding) : size_(size) {
+    glCreateBuffers(1, &id_);
+    glNamedBufferStorage(id_, static_cast<GLsizeiptr>(size_), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, id_);
+  }
+  ~UniformBuffer() { glDeleteBuffers(1, &id_); }
+
+  UniformBuffer(const UniformBuffer&) = delete;
+  UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+  void Update(const void* data) { glNamedBufferSubData(id_, 0, static_cast<GLsizeiptr>(size_), data); }
+
+  GLuint GetID() const { return id_; }
+
+private:
+  GLuint id_ = 0;
+  size_t size_;
+};
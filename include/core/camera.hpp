@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/frustum.hpp"
 #include "core/keys_n_mouse.hpp"
 
 // libs
@@ -41,43 +42,6 @@ class Camera {
   Camera(const Camera&) = delete;
   Camera& operator=(const Camera&) = delete;
 
-  /**
-   * @brief Updates the camera's position and orientation based on user input.
-   */
-  void HandleKeys() {
-    float camera_speed = 5.0f * data_.delta_time;
-    
-    if (Keyboard::IsKeyHeld(Keyboard::Key::kLeftControl))
-      camera_speed *= 4.0f;
-
-    glm::vec3 horizontal_movement = glm::normalize(glm::vec3(front_.x, 0.0f, front_.z));
-
-    if (Keyboard::IsKeyHeld(Keyboard::Key::kW)) {
-      pos_ += camera_speed * horizontal_movement;
-      view_needs_update_ = true;
-    }
-    if (Keyboard::IsKeyHeld(Keyboard::Key::kS)) {
-      pos_ -= camera_speed * horizontal_movement;
-      view_needs_update_ = true;
-    }
-    if (Keyboard::IsKeyHeld(Keyboard::Key::kA)) {
-      pos_ -= glm::normalize(glm::cross(front_, up_)) * camera_speed;
-      view_needs_update_ = true;
-    }
-    if (Keyboard::IsKeyHeld(Keyboard::Key::kD)) {
-      pos_ += glm::normalize(glm::cross(front_, up_)) * camera_speed;
-      view_needs_update_ = true;
-    }
-    if (Keyboard::IsKeyHeld(Keyboard::Key::kSpace)) {
-      pos_ += camera_speed * glm::vec3(0.0f, 1.0f, 0.0f);
-      view_needs_update_ = true;
-    }
-    if (Keyboard::IsKeyHeld(Keyboard::Key::kLeftShift)) {
-      pos_ -= camera_speed * glm::vec3(0.0f, 1.0f, 0.0f);
-      view_needs_update_ = true;
-    }
-  }
-
   void HandleMousePosition(double xpos, double ypos) {
     if (data_.show_cursor)
       return; // Don't handle mouse input if the cursor is visible.
@@ -94,29 +58,24 @@ class Camera {
     view_needs_update_ = true;
   }
 
+  /**
+   * @brief World-space direction of the ray through a screen position.
+   * Uses the inverse matrices cached by LookAt() and ProjectionMatrix().
+   * @return The normalized ray direction.
+   */
   glm::vec3 GetRay(double xpos, double ypos, int screen_width, int screen_height) {
-    float x = (2.0f * xpos) / screen_width - 1.0f;
-    float y = 1.0f - (2.0f * ypos) / screen_height;
-    float z = 1.0f;
-
-    glm::vec3 ray_nds = glm::vec3(x, y, z);
-    glm::vec4 ray_clip = glm::vec4(ray_nds, 1.0f);
-
-    glm::vec4 ray_eye = glm::inverse(data_.projection) * ray_clip;
-    ray_eye = glm::vec4(ray_eye.x, ray_eye.y, -1.0, 0.0);
+    LookAt();
+    ProjectionMatrix();
 
-    glm::vec3 ray_wor = glm::vec3(glm::inverse(data_.view) * ray_eye);
-    ray_wor = glm::normalize(ray_wor);
+    float x = (2.0f * static_cast<float>(xpos)) / screen_width - 1.0f;
+    float y = 1.0f - (2.0f * static_cast<float>(ypos)) / screen_height;
 
-    return ray_wor;
-  }
+    glm::vec4 ray_clip = glm::vec4(x, y, 1.0f, 1.0f);
 
-  bool RayIntersectsBlock(const glm::vec3 &ray, const glm::vec3 &camera_pos, const glm::vec3 &block_pos) {
-    glm::vec3 block_to_camera = camera_pos - block_pos;
-    float distance = glm::dot(block_to_camera, ray);
-    glm::vec3 point = block_pos + distance * ray;
+    glm::vec4 ray_eye = inverse_projection_ * ray_clip;
+    ray_eye = glm::vec4(ray_eye.x, ray_eye.y, -1.0f, 0.0f);
 
-    return glm::distance(point, camera_pos) < 5.0f;
+    return glm::normalize(glm::vec3(inverse_view_ * ray_eye));
   }
 
 
@@ -128,7 +87,9 @@ class Camera {
       return;
 
     data_.view = glm::lookAt(pos_, pos_ + front_, up_);
+    inverse_view_ = glm::inverse(data_.view);
     view_needs_update_ = false;
+    frustum_.Update(data_.projection * data_.view);
   }
 
   /**
@@ -139,9 +100,16 @@ class Camera {
       return;
 
     data_.projection = glm::perspective(glm::radians(data_.fov), data_.aspect_ratio, z_near_, z_far_);
+    inverse_projection_ = glm::inverse(data_.projection);
     projection_needs_update_ = false;
+    frustum_.Update(data_.projection * data_.view);
   }
 
+  /**
+   * @brief The view frustum of the matrices last computed by LookAt() and ProjectionMatrix().
+   */
+  const Frustum& GetFrustum() const { return frustum_; }
+
   float GetAspectRatio() const { return data_.aspect_ratio; }
 
   /**
@@ -168,6 +136,12 @@ class Camera {
     view_needs_update_ = true;
   }
 
+  /**
+   * @brief Gets the direction the camera is looking at.
+   * @return The normalized front vector of the camera.
+   */
+  const glm::vec3& GetFront() const { return front_; }
+
   /**
    * @brief Gets the field of view of the camera.
    * @return The field of view of the camera.
@@ -236,6 +210,9 @@ class Camera {
   float pitch_; ///< The pitch angle of the camera.
   float z_near_; ///< The near clipping plane of the camera.
   float z_far_; ///< The far clipping plane of the camera.
+  glm::mat4 inverse_view_{1.0f}; ///< Inverse of data_.view, refreshed with it.
+  glm::mat4 inverse_projection_{1.0f}; ///< Inverse of data_.projection, refreshed with it.
+  Frustum frustum_; ///< Planes of data_.projection * data_.view, refreshed with either.
   bool view_needs_update_ = true; ///< Flag to indicate if the view matrix needs updating.
   bool projection_needs_update_ = true; ///< Flag to indicate if the projection matrix needs updating.
 };
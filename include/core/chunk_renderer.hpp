@@ -0,0 +1,216 @@
+#pragma once
+
+#include "core/buffer.hpp"
+#include "core/frustum.hpp"
+#include "core/mesh_residency.hpp"
+#include "core/occlusion_culler.hpp"
+#include "core/visibility_graph.hpp"
+#include "world/chunk.hpp"
+#include "world/chunk_map.hpp"
+
+// libs
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace heh {
+
+/**
+ * @brief Counters of the last ChunkRenderer::Render call.
+ */
+struct ChunkDrawStats {
+  size_t meshes = 0;          ///< Meshes uploaded.
+  size_t drawn = 0;           ///< Meshes inside the frustum with at least one visible section.
+  size_t culled = 0;          ///< Meshes outside the frustum, skipped.
+  size_t occluded = 0;        ///< Meshes inside the frustum whose sections are all hidden.
+  size_t sections_drawn = 0;  ///< Sections with faces that are visible, one indirect command each.
+  size_t occluders = 0;       ///< Boxes drawn into the occlusion depth buffer.
+  size_t depth_culled = 0;    ///< Sections the graph reached that the depth buffer then hid.
+  double occlusion_seconds = 0.0;  ///< Rasterizing the occluders and testing the sections.
+  size_t draw_calls = 0;      ///< GL draw calls issued for all of them.
+  size_t vertex_bytes = 0;    ///< Size of the vertex arena.
+  size_t element_bytes = 0;   ///< Size of the element arena.
+  size_t upload_bytes = 0;    ///< Mesh bytes uploaded this frame.
+  size_t total_upload_bytes = 0; ///< Mesh bytes uploaded since the renderer was created.
+  size_t pending_uploads = 0; ///< Meshes left for later frames by the upload budget.
+  size_t fence_waits = 0;     ///< Times the upload ring waited for the GPU, in total.
+  double cull_seconds = 0.0;  ///< Time spent testing the bounds.
+};
+
+/**
+ * @brief Owns the GPU copies of chunk meshes.
+ *
+ * Meshes are built off the main thread from world data; this class only lives on the
+ * thread that owns the GL context. Uploading consumes the CPU copy.
+ *
+ * All meshes share one vertex and one element BufferArena behind a single VAO, and the
+ * visible sections, by the frustum, the VisibilityGraph and then the OcclusionCuller, are
+ * drawn with one glMultiDrawElementsIndirect call. Occluders are the closed sections of
+ * the chunks within kOccluderRadius of the camera. The shader finds the
+ * origin of the chunk being drawn at chunk_origins[gl_DrawIDARB] in the shader storage
+ * buffer at binding kDrawDataBinding.
+ *
+ * Uploads are queued and sent during Render, at most upload_budget bytes a frame, through
+ * a persistently mapped UploadRing: meshes are copied into the mapping, then into their
+ * arena ranges on the GPU. The draw commands and origins of each frame go through the
+ * ring too.
+ *
+ * The arenas never grow past memory_budget together, and a MeshResidency picks the
+ * meshes that stay within it: one that does not fit evicts farther or long unseen ones,
+ * or waits off the GPU itself. Evicted meshes come back from their compact copies, or,
+ * without keep_evicted, through PopRebuilds. Their chunks stay in the VisibilityGraph, so
+ * the search still goes through them.
+ */
+class ChunkRenderer {
+ public:
+  static constexpr GLuint kDrawDataBinding = 0;
+  static constexpr int32_t kOccluderRadius = 4;
+
+  /**
+   * @param upload_budget Mesh bytes uploaded per frame at most; a mesh larger than that
+   * is uploaded alone.
+   * @param memory_budget Bytes of the vertex and element arenas together, 0 for no limit.
+   * @param keep_evicted Whether to keep compact CPU copies of the meshes to upload them
+   * again after an eviction.
+   */
+  explicit ChunkRenderer(size_t upload_budget, size_t memory_budget = 0, bool keep_evicted = true);
+  ~ChunkRenderer() = default;
+
+  ChunkRenderer(const ChunkRenderer&) = delete;
+  ChunkRenderer& operator=(const ChunkRenderer&) = delete;
+
+  /**
+   * @brief Queues the mesh of chunk (x, z) for upload, replacing the one on the GPU or
+   * still queued, if any. The CPU data is freed once uploaded.
+   */
+  void Upload(int32_t x, int32_t z, std::unique_ptr<ChunkRenderData> data);
+
+  /**
+   * @brief Releases the GPU mesh of chunk (x, z) and drops its queued upload, if any.
+   */
+  void Remove(int32_t x, int32_t z);
+
+  /**
+   * @brief Sends queued uploads within the budget, then draws, with the shader currently
+   * in use, the sections that can be seen from eye inside frustum.
+   */
+  void Render(const Frustum& frustum, const glm::vec3& eye);
+
+  /**
+   * @brief How far, in chunks, the visibility search goes from the camera; should cover
+   * every chunk that can be loaded.
+   */
+  void SetVisibilityRadius(int32_t radius) { visibility_radius_ = radius; }
+
+  /**
+   * @brief Runs occlusion culling on jobs' threads; without it, on the calling thread.
+   */
+  void SetJobSystem(JobSystem* jobs) { jobs_ = jobs; }
+
+  size_t GetMeshCount() const { return meshes_.size(); }
+  size_t GetPendingUploads() const { return pending_.size(); }
+
+  /**
+   * @brief Takes the keys of evicted meshes that are wanted again but have no copy; their
+   * chunks must be meshed and uploaded again.
+   */
+  std::vector<world::ChunkKey> PopRebuilds();
+
+  const ResidencyStats& GetResidencyStats() const { return residency_.GetStats(); }
+  const VisibilityStats& GetVisibilityStats() const { return graph_.GetStats(); }
+  const ChunkDrawStats& GetStats() const { return stats_; }
+
+ private:
+  struct GpuMesh {
+    int32_t x = 0;  ///< Chunk coordinates.
+    int32_t z = 0;
+    size_t vertex_offset = 0;  ///< In vertices, into vertices_.
+    size_t vertex_count = 0;
+    size_t element_offset = 0; ///< In indices, into elements_.
+    size_t element_count = 0;
+    std::array<uint32_t, kSectionsPerChunk + 1> section_elements{};  ///< See ChunkRenderData.
+    uint16_t closed = 0;  ///< Bits of the sections that connect none of their faces.
+    glm::vec4 origin{ 0.0f };  ///< World position of the chunk's corner; w unused.
+    size_t slot = 0;  ///< Index of its bounds in bounds_ and of itself in slots_.
+  };
+
+  /**
+   * @brief Layout of GL_DRAW_INDIRECT_BUFFER entries for glMultiDrawElementsIndirect.
+   */
+  struct DrawCommand {
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t base_vertex;
+    uint32_t base_instance;
+  };
+
+  struct PendingUpload {
+    world::ChunkKey key;
+    std::unique_ptr<ChunkRenderData> data;
+    bool from_copy = false;  ///< Expanded from the residency copy of an evicted mesh.
+  };
+
+  void FlushUploads();
+
+  /**
+   * @brief Clears the bits in sections_ of the sections the depth buffer hides.
+   */
+  void CullOccluded(const Frustum& frustum, const glm::vec3& eye);
+
+  /**
+   * @brief Puts the mesh of chunk key in the arenas, staged through the ring, evicting
+   * others to make room; or leaves it off the GPU if they all rank better.
+   */
+  void Store(world::ChunkKey key, const ChunkRenderData& data, bool from_copy);
+
+  /**
+   * @brief Queues evicted meshes the residency wants back, while nothing else waits.
+   */
+  void ReturnEvicted();
+
+  /**
+   * @brief Frees the arena ranges and the draw slot of the mesh of key, if it has one.
+   */
+  void Release(world::ChunkKey key);
+
+  void FreeRanges(const GpuMesh& mesh);
+
+  /**
+   * @brief Points the VAO at the arenas again; they move when they grow.
+   */
+  void BindArenas();
+
+  BufferArena vertices_;
+  BufferArena elements_;
+  GLuint bound_vertices_ = 0;  ///< Arena buffers the VAO was last pointed at.
+  GLuint bound_elements_ = 0;
+  VertexArray vao_;
+  UploadRing ring_;
+  size_t upload_budget_;
+  size_t storage_alignment_ = 256;  ///< GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT.
+  std::deque<PendingUpload> pending_;
+  MeshResidency residency_;
+  std::vector<world::ChunkKey> rebuilds_;
+
+  std::unordered_map<world::ChunkKey, std::unique_ptr<GpuMesh>> meshes_;
+  AabbList bounds_;              ///< World-space bounds of the vertices of every mesh.
+  std::vector<GpuMesh*> slots_;  ///< Meshes in the order of bounds_.
+  std::vector<uint8_t> visible_;
+  std::vector<uint16_t> sections_;  ///< Per slot, bits of the sections drawn this frame.
+  VisibilityGraph graph_;
+  int32_t visibility_radius_ = 32;
+  OcclusionCuller occlusion_;
+  JobSystem* jobs_ = nullptr;
+  std::vector<uint32_t> candidates_;  ///< Slot << 4 | section, of the sections to test.
+  std::vector<uint8_t> candidate_visible_;
+  ChunkDrawStats stats_;
+};
+
+}  // namespace heh
@@ -0,0 +1,80 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace heh {
+
+/**
+ * @brief The six planes of a view frustum, for visibility tests of axis-aligned boxes.
+ */
+class Frustum {
+ public:
+  /**
+   * @brief Extracts the planes of projection * view, normalized and facing inwards.
+   */
+  void Update(const glm::mat4& projection_view);
+
+  /**
+   * @brief Whether a box may be inside the frustum. Conservative: boxes near a corner
+   * of the frustum can pass without being seen.
+   */
+  bool IsBoxVisible(const glm::vec3& min, const glm::vec3& max) const;
+
+  /**
+   * @brief Left, right, bottom, top, near, far, as (normal, distance): a point p is on
+   * the inner side when dot(normal, p) + distance >= 0.
+   */
+  const std::array<glm::vec4, 6>& GetPlanes() const { return planes_; }
+
+  /**
+   * @brief The matrix given to the last Update.
+   */
+  const glm::mat4& GetProjectionView() const { return projection_view_; }
+
+ private:
+  std::array<glm::vec4, 6> planes_{};
+  glm::mat4 projection_view_{ 1.0f };
+};
+
+/**
+ * @brief Axis-aligned boxes kept as one array per bound and axis, so Cull tests them
+ * with branch-free loops the compiler turns into SIMD.
+ */
+class AabbList {
+ public:
+  /**
+   * @return The index of the new box.
+   */
+  size_t Add(const glm::vec3& min, const glm::vec3& max);
+
+  void Set(size_t index, const glm::vec3& min, const glm::vec3& max);
+
+  /**
+   * @brief Moves the last box into index, keeping the arrays dense. The box that was
+   * last is at index afterwards.
+   */
+  void RemoveSwap(size_t index);
+
+  void Clear();
+  size_t Size() const { return min_x_.size(); }
+
+  /**
+   * @brief Sets visible[i] to 1 if box i may be inside the frustum and to 0 if it is
+   * certainly outside.
+   * @return The number of visible boxes.
+   */
+  size_t Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+
+ private:
+  std::vector<float> min_x_, min_y_, min_z_;
+  std::vector<float> max_x_, max_y_, max_z_;
+};
+
+}  // namespace heh
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "world/chunk.hpp"
+#include "world/chunk_map.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace heh {
+
+/**
+ * @brief A chunk mesh packed to stay on the CPU while it is off the GPU, at about a
+ * quarter of the size of its ChunkRenderData. Positions are kept to 1/64 of a block,
+ * which is exact for everything the meshers build, texture coordinates to 1/65535 and
+ * light to 1/255. Elements are dropped when they are the two triangles of each quad the
+ * meshers emit, and made again by Expand.
+ */
+class CompactMesh {
+ public:
+  explicit CompactMesh(const ChunkRenderData& data);
+
+  std::unique_ptr<ChunkRenderData> Expand() const;
+
+  size_t GetBytes() const { return vertices_.size() * sizeof(PackedVertex) + elements_.size() * sizeof(int32_t); }
+
+ private:
+  struct PackedVertex {
+    uint16_t position[3];  ///< (p + 1) * 64.
+    uint16_t tex_coords[2];
+    uint8_t light[2];
+    uint8_t normal;  ///< Index into the six axis directions.
+  };
+
+  std::vector<PackedVertex> vertices_;
+  std::vector<int32_t> elements_;  ///< Empty when they are quads.
+  uint32_t num_elements_ = 0;
+  uint32_t lod_ = 0;
+  std::array<uint32_t, kSectionsPerChunk + 1> section_elements_{};
+  std::array<uint16_t, kSectionsPerChunk> section_connectivity_{};
+};
+
+/**
+ * @brief Counters of a MeshResidency.
+ */
+struct ResidencyStats {
+  size_t budget = 0;          ///< Bytes of meshes allowed on the GPU, 0 for no limit.
+  size_t resident_bytes = 0;  ///< Vertices and elements of the meshes on the GPU.
+  size_t resident = 0;        ///< Meshes on the GPU.
+  size_t evicted = 0;         ///< Meshes of loaded chunks kept off the GPU.
+  size_t copy_bytes = 0;      ///< CompactMesh copies kept on the CPU.
+  uint64_t evictions = 0;     ///< Meshes taken off or kept off the GPU for room, in total.
+  uint64_t reuploads = 0;     ///< Evicted meshes sent back from their copies, in total.
+  uint64_t rebuilds = 0;      ///< Evicted meshes without a copy asked to be built again, in total.
+};
+
+/**
+ * @brief Decides which chunk meshes stay on the GPU within a byte budget, with no GL of
+ * its own: the renderer asks it for room, frees what it names and reports back.
+ *
+ * Meshes are ranked by their distance from the camera in chunks, plus a chunk for every
+ * second they have not been drawn, up to kMaxUnseenPenalty. A mesh that does not fit
+ * displaces the worst ranked ones, unless they all rank better than it, in which case it
+ * is kept off the GPU itself. Evicted meshes come back, nearest first, once they rank
+ * kReturnMargin chunks better than the worst mesh on the GPU or there is room for them.
+ *
+ * With keep_copies, a CompactMesh of every mesh is kept, so an evicted one is uploaded
+ * again from it; without, it has to be built again by whoever built it.
+ */
+class MeshResidency {
+ public:
+  static constexpr float kFramesPerChunk = 60.0f;
+  static constexpr float kMaxUnseenPenalty = 8.0f;
+  static constexpr float kReturnMargin = 2.0f;
+  static constexpr uint64_t kReturnTimeout = 300;  ///< Frames before a return that never arrived is offered again.
+
+  /**
+   * @param budget Bytes, 0 for no limit.
+   */
+  MeshResidency(size_t budget, bool keep_copies);
+
+  /**
+   * @brief Starts a frame seen from eye, for the ranking.
+   */
+  void BeginFrame(const glm::vec3& eye);
+
+  /**
+   * @brief Whether a mesh of bytes for key fits in the budget next to the others, in
+   * place of its own current mesh if it has one.
+   */
+  bool Fits(world::ChunkKey key, size_t bytes) const;
+
+  /**
+   * @brief The worst ranked mesh on the GPU other than key, if it ranks below the mesh of
+   * key about to be uploaded.
+   * @return false if there is none.
+   */
+  bool PickVictim(world::ChunkKey key, world::ChunkKey& victim) const;
+
+  /**
+   * @brief Records the mesh of key as uploaded.
+   * @param from_copy data was expanded from the copy handed out by TakeReturns.
+   */
+  void Insert(world::ChunkKey key, const ChunkRenderData& data, bool from_copy = false);
+
+  /**
+   * @brief Records the mesh of key as taken off the GPU.
+   */
+  void Evict(world::ChunkKey key);
+
+  /**
+   * @brief Records a mesh for key that was kept off the GPU for lack of room.
+   */
+  void Park(world::ChunkKey key, const ChunkRenderData& data, bool from_copy = false);
+
+  /**
+   * @brief Forgets key, whose chunk is gone.
+   */
+  void Erase(world::ChunkKey key);
+
+  void MarkDrawn(world::ChunkKey key);
+
+  /**
+   * @brief Evicted meshes to bring back, at most max_count, nearest first; each is
+   * reported once until it is inserted or parked again, or kReturnTimeout frames pass.
+   * @param uploads Meshes expanded from their copies, to upload.
+   * @param rebuilds Keys of the meshes without a copy, to build again.
+   */
+  void TakeReturns(size_t max_count, std::vector<std::pair<world::ChunkKey, std::unique_ptr<ChunkRenderData>>>& uploads,
+                   std::vector<world::ChunkKey>& rebuilds);
+
+  const ResidencyStats& GetStats() const { return stats_; }
+
+ private:
+  struct Entry {
+    size_t bytes = 0;
+    uint64_t last_drawn = 0;  ///< Frame.
+    bool resident = false;
+    uint64_t returned = 0;    ///< Frame TakeReturns last handed it out, 0 once it is back.
+    std::unique_ptr<CompactMesh> copy;
+  };
+
+  float Distance(world::ChunkKey key) const;
+  float Rank(world::ChunkKey key, const Entry& entry) const;
+  void KeepCopy(Entry& entry, const ChunkRenderData& data, bool from_copy);
+  void DropCopy(Entry& entry);
+
+  size_t budget_;
+  bool keep_copies_;
+  uint64_t frame_ = 0;
+  glm::vec2 eye_{ 0.0f };  ///< In chunks.
+  std::unordered_map<world::ChunkKey, Entry> entries_;
+  ResidencyStats stats_;
+};
+
+}  // namespace heh
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "world/chunk.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace heh {
+
+class JobSystem;
+
+/**
+ * @brief Occlusion culling on the CPU against a small software depth buffer, so it needs
+ * nothing from the GPU and gives the same answer headless.
+ *
+ * Occluders are the chunk sections that connect none of their faces (see
+ * Chunk::ComputeConnectivity): no line of sight goes through them, so each acts as a
+ * solid box. Their faces are clipped to the near plane and rasterized conservatively,
+ * covering only pixels they cover entirely, at the farthest depth of the face. A box is
+ * then hidden if every pixel its screen bounds touch holds something nearer than its
+ * nearest corner. Depth is clip-space w, the distance along the view direction.
+ *
+ * Rasterization splits the buffer into bands of rows that run as jobs; the tests only
+ * read the buffer and can run in parallel too.
+ */
+class OcclusionCuller {
+ public:
+  static constexpr int kWidth = 256;
+  static constexpr int kHeight = 128;
+
+  /**
+   * @brief Drops the occluders of the last frame and takes the matrix of this one.
+   */
+  void Begin(const glm::mat4& projection_view);
+
+  void AddOccluder(const glm::vec3& min, const glm::vec3& max);
+
+  /**
+   * @brief Adds the sections of chunk (x, z) whose bits are set in closed as occluders,
+   * merging vertical runs into one box.
+   */
+  void AddClosedSections(int32_t x, int32_t z, uint16_t closed);
+
+  /**
+   * @brief Clears the depth buffer and draws the occluders into it, in parallel on jobs
+   * if given.
+   */
+  void Rasterize(JobSystem* jobs);
+
+  bool IsVisible(const glm::vec3& min, const glm::vec3& max) const;
+  bool IsSectionVisible(int32_t x, int32_t section, int32_t z) const;
+
+  size_t GetOccluderCount() const { return occluders_; }
+  size_t GetTriangleCount() const { return triangles_.size(); }
+
+  /**
+   * @brief Row-major from the bottom of the screen, kWidth * kHeight.
+   */
+  const std::vector<float>& GetDepth() const { return depth_; }
+
+ private:
+  struct Triangle {
+    float x[3];
+    float y[3];
+    float depth;  ///< Farthest of the face it came from.
+  };
+
+  void AddFace(const glm::vec4* corners);
+  void RasterizeRows(int begin, int end);
+
+  glm::mat4 projection_view_{ 1.0f };
+  std::vector<Triangle> triangles_;
+  std::vector<float> depth_;
+  size_t occluders_ = 0;
+};
+
+}  // namespace heh
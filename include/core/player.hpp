@@ -0,0 +1,55 @@
+#pragma once
+
+#include "core/camera.hpp"
+#include "world/physics.hpp"
+#include "world/world.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+namespace heh {
+
+/**
+ * @brief The body the camera rides on, moved by the keyboard at a fixed tick rate.
+ *
+ * Input and collision run in fixed steps of kTickSeconds, so movement is the same at
+ * any frame rate. The camera is placed between the last two ticks by how far the frame
+ * is into the next one, which keeps it smooth at uneven frame times.
+ */
+class Player {
+ public:
+  static constexpr double kTickSeconds = 1.0 / 30.0;
+  static constexpr float kEyeHeight = 1.62f;  ///< Camera height above the feet.
+
+  /**
+   * @param feet Position of the centre of the feet.
+   */
+  explicit Player(const glm::vec3& feet);
+
+  Player(const Player&) = delete;
+  Player& operator=(const Player&) = delete;
+
+  /**
+   * @brief Runs the ticks that fell due during the last frame and moves the camera.
+   * @param frame_seconds Time since the previous call.
+   */
+  void Update(const world::World& world, Camera& camera, double frame_seconds);
+
+  /**
+   * @brief Switches between flying (no gravity) and walking.
+   */
+  void ToggleFlying();
+
+  bool IsFlying() const { return flying_; }
+  const world::Body& GetBody() const { return body_; }
+
+ private:
+  void Tick(world::BlockAccessor& blocks, const Camera& camera);
+
+  world::Body body_;
+  glm::vec3 previous_position_;  ///< Body position before the last tick, for interpolation.
+  double accumulator_ = 0.0;     ///< Time not yet simulated, less than one tick after Update.
+  bool flying_ = true;
+};
+
+}  // namespace heh
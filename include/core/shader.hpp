@@ -5,7 +5,10 @@
 #include <glm/glm.hpp>
 
 // std
+#include <array>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <stdexcept>
 #include <fstream>
 #include <sstream>
@@ -13,14 +16,48 @@
 
 namespace heh {
 
+/**
+ * @brief The per-frame data of the FrameData uniform block, in its std140 layout. One
+ * buffer of it is written once a frame and read by every program that declares the
+ * block. Vectors are vec4 on both sides, so the layouts match without padding.
+ */
+struct FrameUniforms {
+  glm::mat4 view{ 1.0f };
+  glm::mat4 projection{ 1.0f };
+  glm::vec4 view_pos{ 0.0f };
+  glm::vec4 light_pos{ 0.0f };
+  glm::vec4 light_color{ 0.0f };
+  glm::vec4 dir_light_direction{ 0.0f };
+  glm::vec4 dir_light_color{ 0.0f };
+};
+static_assert(sizeof(FrameUniforms) == 2 * 64 + 5 * 16, "FrameUniforms must match the std140 FrameData block");
+
 /**
  * @brief The Shader class represents a shader program in OpenGL.
  * 
  * This class provides functionality to load, compile, and link vertex and fragment shaders,
  * as well as set uniform values in the shader program.
+ *
+ * The active uniforms are looked up once, when the program is linked. Setters take a
+ * Uniform handle from GetUniform, so no name reaches the driver after that, and skip the
+ * call when the value is the one last set. The setters taking names are kept for code
+ * that runs once; they look the name up in the cache.
  */
 class Shader {
  public:
+  /**
+   * @brief Binding point of the FrameData uniform block in every program.
+   */
+  static constexpr GLuint kFrameDataBinding = 0;
+
+  /**
+   * @brief A uniform of one Shader. The default one, also returned for a name the
+   * program does not use, sets nothing.
+   */
+  struct Uniform {
+    int index = -1;
+  };
+
   /**
    * @brief Constructs a Shader object with the specified vertex and fragment shader file paths.
    * 
@@ -48,13 +85,26 @@ class Shader {
    */
   GLuint GetID() const;
 
+  /**
+   * @brief Finds a uniform by name; arrays by their name with or without "[0]".
+   */
+  Uniform GetUniform(const std::string& name) const;
+
+  void SetBool(Uniform uniform, bool value);
+  void SetInt(Uniform uniform, int value);
+  void SetFloat(Uniform uniform, float value);
+  void SetVec2(Uniform uniform, const glm::vec2& value);
+  void SetVec3(Uniform uniform, const glm::vec3& value);
+  void SetVec4(Uniform uniform, const glm::vec4& value);
+  void SetMat4(Uniform uniform, const glm::mat4& mat);
+
   /**
    * @brief Sets a boolean uniform value in the shader program.
    * 
    * @param name The name of the boolean uniform.
    * @param value The boolean value to set.
    */
-  void SetBool(const std::string& name, bool value) const;
+  void SetBool(const std::string& name, bool value);
 
   /**
    * @brief Sets an integer uniform value in the shader program.
@@ -62,7 +112,7 @@ class Shader {
    * @param name The name of the integer uniform.
    * @param value The integer value to set.
    */
-  void SetInt(const std::string& name, int value) const;
+  void SetInt(const std::string& name, int value);
 
   /**
    * @brief Sets a floating-point uniform value in the shader program.
@@ -70,7 +120,7 @@ class Shader {
    * @param name The name of the floating-point uniform.
    * @param value The floating-point value to set.
    */
-  void SetFloat(const std::string& name, float value) const;
+  void SetFloat(const std::string& name, float value);
 
   /**
    * @brief Sets a 2D vector uniform value in the shader program.
@@ -78,7 +128,7 @@ class Shader {
    * @param name The name of the 2D vector uniform.
    * @param value The 2D vector value to set.
    */
-  void SetVec2(const std::string& name, const glm::vec2& value) const;
+  void SetVec2(const std::string& name, const glm::vec2& value);
 
   /**
    * @brief Sets a 3D vector uniform value in the shader program.
@@ -86,7 +136,7 @@ class Shader {
    * @param name The name of the 3D vector uniform.
    * @param value The 3D vector value to set.
    */
-  void SetVec3(const std::string& name, const glm::vec3& value) const;
+  void SetVec3(const std::string& name, const glm::vec3& value);
 
   /**
    * @brief Sets a 4D vector uniform value in the shader program.
@@ -94,7 +144,7 @@ class Shader {
    * @param name The name of the 4D vector uniform.
    * @param value The 4D vector value to set.
    */
-  void SetVec4(const std::string& name, const glm::vec4& value) const;
+  void SetVec4(const std::string& name, const glm::vec4& value);
 
   /**
    * @brief Sets a 4x4 matrix uniform value in the shader program.
@@ -102,10 +152,25 @@ class Shader {
    * @param name The name of the matrix uniform.
    * @param mat The 4x4 matrix value to set.
    */
-  void SetMat4(const std::string& name, const glm::mat4& mat) const;
+  void SetMat4(const std::string& name, const glm::mat4& mat);
 
  private:
+  struct CachedUniform {
+    GLint location = -1;
+    bool set = false;                 ///< Whether value holds what was last set.
+    std::array<float, 16> value{};    ///< Bytes of the last value, up to a mat4.
+  };
+
+  /**
+   * @brief Records value as the last one set for uniform.
+   * @return The location to set it at, or -1 if there is nothing to do.
+   */
+  template <typename T>
+  GLint Update(Uniform uniform, const T& value);
+
   GLuint id_; /**< The ID of the shader program. */
+  std::vector<CachedUniform> uniforms_;
+  std::unordered_map<std::string, int> uniform_indices_;
 };  // class Shader
 
 } // namespace heh
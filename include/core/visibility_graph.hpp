@@ -0,0 +1,82 @@
+#pragma once
+
+#include "core/frustum.hpp"
+#include "world/chunk.hpp"
+#include "world/chunk_map.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace heh {
+
+/**
+ * @brief Counters of the last VisibilityGraph::Traverse.
+ */
+struct VisibilityStats {
+  size_t sections_visited = 0;  ///< Sections the search reached, all of them visible.
+  size_t frustum_rejected = 0;  ///< Steps into a section outside the frustum.
+  size_t closed_rejected = 0;   ///< Steps through a pair of faces with no open path between them.
+  bool fallback = false;        ///< The camera was outside the graph, so every section counts as visible.
+  double seconds = 0.0;
+};
+
+/**
+ * @brief Which chunk sections can be seen from the camera, through the connectivity
+ * masks of the sections (see Chunk::ComputeConnectivity) rather than by reading back
+ * anything from the GPU.
+ *
+ * Traverse searches breadth-first from the camera's section. A step leaves a section
+ * through a face only if that face is joined to the face it came in by, never goes
+ * opposite to a step already taken on the way, and only enters sections inside the
+ * frustum. Underground, rock between the camera and a cave stops the search; on the
+ * surface, the inside of hills does.
+ */
+class VisibilityGraph {
+ public:
+  using Connectivity = std::array<uint16_t, kSectionsPerChunk>;
+
+  void Set(int32_t x, int32_t z, const Connectivity& sections);
+  void Remove(int32_t x, int32_t z);
+  size_t Size() const { return chunks_.size(); }
+
+  /**
+   * @brief Finds the visible sections from eye, out to radius chunks in x and z.
+   */
+  void Traverse(const glm::vec3& eye, const Frustum& frustum, int32_t radius);
+
+  /**
+   * @brief Bits of the sections of chunk (x, z) found by the last Traverse, bit s for
+   * section s.
+   */
+  uint16_t GetVisibleSections(int32_t x, int32_t z) const;
+
+  const VisibilityStats& GetStats() const { return stats_; }
+
+ private:
+  struct Step {
+    int32_t column;  ///< Index into columns_ and visible_.
+    int32_t section;
+    uint8_t entry;       ///< Face it was entered through, kSectionFaceCount for the start.
+    uint8_t directions;  ///< Bits of the directions stepped in to get here.
+  };
+
+  std::unordered_map<world::ChunkKey, Connectivity> chunks_;
+
+  // Square of (2 * radius_ + 1) columns around center_, filled by Traverse.
+  int32_t center_x_ = 0;
+  int32_t center_z_ = 0;
+  int32_t radius_ = -1;
+  std::vector<const Connectivity*> columns_;  ///< Null where no chunk is known.
+  std::vector<uint16_t> visible_;
+  std::vector<Step> queue_;
+  bool all_visible_ = false;
+  VisibilityStats stats_;
+};
+
+}  // namespace heh
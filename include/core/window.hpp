@@ -2,7 +2,13 @@
 
 #include "core/camera.hpp"
 #include "core/shader.hpp"
+#include "core/chunk_renderer.hpp"
+#include "core/player.hpp"
+#include "utils/image_writer.hpp"
 #include "world/world.hpp"
+#include "world/block_ticks.hpp"
+#include "world/chunk_streamer.hpp"
+#include "world/raycast.hpp"
 
 // libs
 #include <glad/glad.h>
@@ -68,10 +74,15 @@ class Window {
   void HandleKeys();
   
   /**
-   * @brief Handles mouse input events.
+   * @brief Picks the block under the cursor (the screen centre while it is captured).
    */
   void HandleMouse(double xpos, double ypos);
 
+  /**
+   * @brief Breaks the picked block (left button) or places one against its face (right).
+   */
+  void EditPickedBlock(int button);
+
   void InitWindow();
   void Cleanup();
 
@@ -91,11 +102,18 @@ class Window {
   Camera camera_;     /**< The camera object for handling view and projection matrices. */
   Keyboard keyboard_; /**< The keyboard object for handling keyboard input.             */
   Mouse mouse_;       /**< The mouse object for handling mouse input.                   */
+  world::World world_; /**< Every loaded chunk.                                         */
+  world::TickScheduler* ticks_ = nullptr; /**< Owned by Run(), null outside of it.      */
+  Player* player_ = nullptr;          /**< Owned by Run(), null outside of it.           */
+  ChunkRenderer* chunk_renderer_ = nullptr; /**< Owned by Run(), null outside of it.    */
+  world::RaycastHit picked_;          /**< Block under the cursor, refreshed every frame. */
+  BlockId place_block_ = kAirBlock;   /**< Block placed with the right button.           */
 
   bool framebuffer_resized_ = false; /**< Flag indicating if the window was resized.    */
   bool wireframe_mode_ = false;      /**< Flag indicating if wireframe mode is enabled. */
   bool dark_background_mode_ = false; /**< Flag indicating if dark background mode is enabled. */
 
+  double block_tick_time_ = 0.0;  /**< Seconds not yet covered by block ticks. */
   double last_time_ = 0.0;
   double current_time_ = 0.0;
   int nb_frames_ = 0;
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "net/connection.hpp"
+#include "world/world.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace heh {
+
+  namespace net {
+
+    /**
+     * @brief Client counters, cumulative since the connection was made.
+     */
+    struct ClientStats {
+      uint64_t chunks = 0;          ///< kChunk messages applied.
+      uint64_t forgotten = 0;       ///< Chunks dropped on kForgetChunk.
+      uint64_t delta_sections = 0;  ///< Sections changed by kSectionDeltas.
+      uint64_t delta_blocks = 0;    ///< Blocks changed by kSectionDeltas.
+    };
+
+    /**
+     * @brief The client end of the protocol: keeps a World filled with the chunks the
+     * server sends for the view around the player.
+     *
+     * Received chunks hold blocks only and have status kFeatures; lighting and meshing
+     * them is up to the caller, like for chunks that were generated locally.
+     */
+    class Client {
+    public:
+      /**
+       * @brief Connects and asks for the chunks within view_radius.
+       * @throws std::runtime_error if the connection fails.
+       */
+      Client(const std::string& address, int view_radius);
+
+      Client(const Client&) = delete;
+      Client& operator=(const Client&) = delete;
+
+      /**
+       * @brief Sends what is queued and applies the messages that arrived.
+       * @return false once the connection is gone or the server sent malformed data.
+       */
+      bool Poll();
+
+      /**
+       * @brief Tells the server where the player is, which moves the view.
+       */
+      void SendPosition(const glm::vec3& pos);
+
+      /**
+       * @brief Takes the keys of the chunks whose meshes show blocks that arrived, changed
+       * or were forgotten since the last call, neighbours included, e.g. to rebuild them.
+       */
+      std::vector<world::ChunkKey> PopChangedChunks();
+
+      bool IsWelcomed() const { return welcomed_; }
+      int GetTickRate() const { return tick_rate_; }
+      int GetViewRadius() const { return view_radius_; }  ///< Granted by the server once welcomed.
+      const glm::vec3& GetSpawn() const { return spawn_; }
+      uint64_t GetServerTick() const { return server_tick_; }  ///< Of the last block changes.
+
+      world::World& GetWorld() { return world_; }
+      const Connection& GetConnection() const { return connection_; }
+      const ClientStats& GetStats() const { return stats_; }
+
+    private:
+      bool Handle(MessageType type, ByteReader& payload);
+      void AddChangedArea(int32_t x, int32_t z);
+
+      Connection connection_;
+      world::World world_;
+      bool welcomed_ = false;
+      int tick_rate_ = 0;
+      int view_radius_;
+      glm::vec3 spawn_{ 0.0f };
+      uint64_t server_tick_ = 0;
+      std::vector<world::ChunkKey> changed_;
+      ClientStats stats_;
+    };
+
+  }  // namespace net
+
+}  // namespace heh
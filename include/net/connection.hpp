@@ -0,0 +1,67 @@
+#pragma once
+
+#include "net/protocol.hpp"
+#include "net/socket.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace heh {
+
+  namespace net {
+
+    /**
+     * @brief Frames messages over a non-blocking socket: queues outgoing frames until the
+     * socket takes them and splits the incoming bytes back into messages.
+     */
+    class Connection {
+    public:
+      using Handler = std::function<bool(MessageType type, ByteReader& payload)>;
+
+      explicit Connection(Socket socket) : socket_(std::move(socket)) {}
+
+      /**
+       * @brief Buffer to append frames to, with BeginMessage and EndMessage. They are
+       * sent on the next Flush.
+       */
+      std::vector<uint8_t>& GetOutput() { return out_; }
+
+      /**
+       * @brief Sends as much of the queued frames as the socket takes.
+       * @return false if the connection is gone.
+       */
+      bool Flush();
+
+      /**
+       * @brief Reads what has arrived and calls handler for every complete message.
+       * @return false if the connection is gone, a frame is malformed or handler returned
+       * false.
+       */
+      bool Poll(const Handler& handler);
+
+      /**
+       * @brief Bytes queued and not yet taken by the socket.
+       */
+      size_t GetQueuedBytes() const { return out_.size() - out_offset_; }
+
+      uint64_t GetBytesSent() const { return bytes_sent_; }
+      uint64_t GetBytesReceived() const { return bytes_received_; }
+
+      bool IsOpen() const { return socket_.IsOpen(); }
+      void Close() { socket_.Close(); }
+
+    private:
+      Socket socket_;
+      std::vector<uint8_t> out_;
+      size_t out_offset_ = 0;    ///< Start of the bytes the socket has not taken yet.
+      std::vector<uint8_t> in_;
+      uint64_t bytes_sent_ = 0;
+      uint64_t bytes_received_ = 0;
+    };
+
+  }  // namespace net
+
+}  // namespace heh
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "world/block_ticks.hpp"
+#include "world/chunk.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace heh {
+
+  namespace net {
+
+    /*
+      The client/server protocol. A stream of frames, each a little-endian uint32 size,
+      then a message type byte and the payload (the size counts both). Integers are
+      little-endian, floats are IEEE 754 in the byte order of a uint32.
+
+      client -> server
+        kHello          u16 version, u8 view radius in chunks
+        kPosition       f32 x, y, z of the player, in blocks
+
+      server -> client
+        kWelcome        u16 version, u16 tick rate, u8 granted view radius, f32 x, y, z spawn
+        kChunk          i32 x, i32 z, kSectionsPerChunk sections (see EncodeChunk)
+        kForgetChunk    i32 x, i32 z: the chunk left the view and gets no more updates
+        kSectionDeltas  u64 tick, u16 section count, then per section
+                        i32 x, i32 z, u8 section, u16 count, count x (u16 index, u16 id)
+                        with index the position in the section's 4096 blocks
+
+      A section of a chunk is its palette, the distinct ids in it (u16 size, then u16 ids),
+      and an index into the palette per block, packed LSB first with the fewest bits that
+      fit the palette size: none for a section of a single id, such as air.
+    */
+
+    constexpr uint16_t kProtocolVersion = 1;
+    constexpr uint32_t kMaxFrameSize = 1u << 20;
+
+    enum class MessageType : uint8_t {
+      kHello = 1,
+      kPosition = 2,
+
+      kWelcome = 16,
+      kChunk = 17,
+      kForgetChunk = 18,
+      kSectionDeltas = 19,
+    };
+
+    /**
+     * @brief Appends little-endian values to a byte buffer.
+     */
+    class ByteWriter {
+    public:
+      explicit ByteWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+      void PutU8(uint8_t v) { out_.push_back(v); }
+      void PutU16(uint16_t v);
+      void PutU32(uint32_t v);
+      void PutU64(uint64_t v);
+      void PutI32(int32_t v) { PutU32(static_cast<uint32_t>(v)); }
+      void PutF32(float v);
+
+      std::vector<uint8_t>& GetBuffer() { return out_; }
+
+    private:
+      std::vector<uint8_t>& out_;
+    };
+
+    /**
+     * @brief Reads little-endian values from a byte range. Reading past the end yields
+     * zeros and marks the reader failed, so a message is checked once at the end.
+     */
+    class ByteReader {
+    public:
+      ByteReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+      uint8_t GetU8();
+      uint16_t GetU16();
+      uint32_t GetU32();
+      uint64_t GetU64();
+      int32_t GetI32() { return static_cast<int32_t>(GetU32()); }
+      float GetF32();
+
+      /**
+       * @brief Skips size bytes and returns where they start, nullptr if there are not
+       * that many left.
+       */
+      const uint8_t* GetBytes(size_t size);
+
+      bool Failed() const { return failed_; }
+      size_t GetRemaining() const { return size_ - offset_; }
+
+    private:
+      const uint8_t* data_;
+      size_t size_;
+      size_t offset_ = 0;
+      bool failed_ = false;
+    };
+
+    /**
+     * @brief Starts a frame of type in out; finish it with EndMessage.
+     * @return Offset of the frame in out.
+     */
+    size_t BeginMessage(std::vector<uint8_t>& out, MessageType type);
+
+    /**
+     * @brief Writes the size of the frame that BeginMessage started at offset.
+     */
+    void EndMessage(std::vector<uint8_t>& out, size_t offset);
+
+    /**
+     * @brief Appends the palette-compressed blocks of chunk.
+     */
+    void EncodeChunk(const Chunk& chunk, ByteWriter& out);
+
+    /**
+     * @brief Reads blocks written by EncodeChunk into chunk.blocks_data.
+     * @return false if the data is malformed; chunk may be partly written.
+     */
+    bool DecodeChunk(ByteReader& in, Chunk& chunk);
+
+    /**
+     * @brief The changes of one tick, last value per block, grouped by section.
+     */
+    struct SectionDelta {
+      int32_t x;
+      int32_t z;
+      uint8_t section;
+      std::vector<std::pair<uint16_t, BlockId>> blocks;  ///< (index in section, id), ascending index.
+    };
+
+    /**
+     * @brief Groups changes by section, keeping only the last id of each block. Sections
+     * come out in ascending (chunk key, section) order.
+     */
+    std::vector<SectionDelta> CoalesceChanges(const std::vector<world::BlockChange>& changes);
+
+    /**
+     * @brief Appends the sections for a kSectionDeltas payload.
+     */
+    void EncodeSectionDeltas(uint64_t tick, const std::vector<const SectionDelta*>& sections, ByteWriter& out);
+
+  }  // namespace net
+
+}  // namespace heh
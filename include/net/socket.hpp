@@ -0,0 +1,97 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace heh {
+
+  namespace net {
+
+    /*
+      Addresses are "host:port" for TCP ("127.0.0.1:25565", "localhost:25565", ":25565"
+      to listen on every interface) or "unix:path" for a Unix domain socket.
+
+      Sockets use the POSIX API; the Windows build uses the same calls through
+      Winsock and has no Unix domain sockets.
+    */
+
+    /**
+     * @brief A connected, non-blocking stream socket.
+     */
+    class Socket {
+    public:
+      Socket() = default;
+      ~Socket();
+
+      Socket(Socket&& other) noexcept;
+      Socket& operator=(Socket&& other) noexcept;
+      Socket(const Socket&) = delete;
+      Socket& operator=(const Socket&) = delete;
+
+      /**
+       * @brief Connects to address, blocking until connected.
+       * @throws std::runtime_error if the connection fails.
+       */
+      static Socket Connect(const std::string& address);
+
+      bool IsOpen() const { return handle_ != kInvalid; }
+      void Close();
+
+      /**
+       * @brief Sends what the socket takes without blocking.
+       * @return Bytes sent, 0 if the socket buffer is full, -1 if the connection is gone.
+       */
+      long Send(const uint8_t* data, size_t size);
+
+      /**
+       * @brief Receives what has arrived, without blocking.
+       * @return Bytes received, 0 if nothing is there, -1 if the connection is closed.
+       */
+      long Receive(uint8_t* data, size_t size);
+
+    private:
+      friend class Listener;
+
+      using Handle = intptr_t;
+      static constexpr Handle kInvalid = -1;
+
+      explicit Socket(Handle handle);
+
+      Handle handle_ = kInvalid;
+    };
+
+    /**
+     * @brief A listening socket that accepts connections without blocking.
+     */
+    class Listener {
+    public:
+      /**
+       * @throws std::runtime_error if the address cannot be bound.
+       */
+      explicit Listener(const std::string& address);
+      ~Listener();
+
+      Listener(const Listener&) = delete;
+      Listener& operator=(const Listener&) = delete;
+
+      /**
+       * @brief Takes a pending connection, or returns a closed Socket if there is none.
+       */
+      Socket Accept();
+
+      /**
+       * @brief The bound address; for TCP with port 0, the port the system picked.
+       */
+      const std::string& GetAddress() const { return address_; }
+
+    private:
+      Socket::Handle handle_ = Socket::kInvalid;
+      std::string address_;
+      std::string unix_path_;  ///< Removed again in the destructor.
+    };
+
+  }  // namespace net
+
+}  // namespace heh
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "net/connection.hpp"
+#include "net/socket.hpp"
+#include "world/block_ticks.hpp"
+#include "world/chunk_storage.hpp"
+#include "world/chunk_streamer.hpp"
+#include "world/terrain_generator.hpp"
+#include "world/world.hpp"
+#include "utils/job_system.hpp"
+#include "utils/toml_extended.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace heh {
+
+  namespace server {
+
+    /**
+     * @brief Distribution of tick durations, in log-spaced buckets about 4.4% wide from
+     * 1 microsecond to about 16 seconds, so percentiles cost no per-tick allocation
+     * however long the server runs.
+     */
+    class TickTimes {
+    public:
+      void Add(double seconds);
+      void Clear();
+
+      /**
+       * @brief Duration below which a fraction p (0 to 1) of the ticks fall, to the
+       * bucket's precision; 0 without ticks.
+       */
+      double Percentile(double p) const;
+
+      uint64_t GetCount() const { return count_; }
+      double GetMeanSeconds() const { return count_ ? total_seconds_ / static_cast<double>(count_) : 0.0; }
+      double GetMaxSeconds() const { return max_seconds_; }
+
+    private:
+      static constexpr int kBucketsPerOctave = 16;
+      static constexpr size_t kBucketCount = 24 * kBucketsPerOctave;
+
+      std::array<uint64_t, kBucketCount> buckets_{};
+      uint64_t count_ = 0;
+      double total_seconds_ = 0.0;
+      double max_seconds_ = 0.0;
+    };
+
+    /**
+     * @brief Server loop counters, cumulative since the server started.
+     */
+    struct ServerStats {
+      uint64_t ticks = 0;
+      uint64_t overruns = 0;       ///< Ticks that took longer than the tick period.
+      uint64_t skipped_ticks = 0;  ///< Ticks dropped to catch up after falling too far behind.
+      uint64_t saves = 0;          ///< Periodic saves of the changed chunks.
+      uint64_t clients_joined = 0;
+      uint64_t clients_left = 0;   ///< Disconnected, or dropped for malformed messages.
+      uint64_t chunks_sent = 0;
+      uint64_t delta_sections_sent = 0;
+      uint64_t bytes_sent = 0;     ///< Queued for clients, frames included.
+    };
+
+    /**
+     * @brief The world without a window: streams chunks around an anchor, ticks blocks
+     * and saves chunks to storage, at a fixed tick rate.
+     *
+     * Chunks are loaded from the storage when it has them and generated otherwise. They
+     * are lit but never meshed. Changed chunks are saved when they unload, every
+     * save_interval seconds, and when Run() returns. Nothing here links against GL or
+     * GLFW.
+     *
+     * Once listening, every tick accepts clients and, for each one, streams the chunks
+     * around its reported position in (see net/protocol.hpp):
+     *  - chunks farther than its view radius + 1 are forgotten,
+     *  - the block changes of the tick in chunks it has go out as one batch of section
+     *    deltas, coalesced to the last value of each block,
+     *  - chunks within the view radius that it lacks follow, nearest first, as long as
+     *    the connection's budget lasts. The budget refills at client_bandwidth and holds
+     *    at most a second's worth, which caps the bytes per second of every connection.
+     * Chunks rewritten by a bulk edit are sent again whole. The area around each client
+     * is streamed like the one around the anchor.
+     */
+    class Server {
+    public:
+      /**
+       * @param worker_count Job threads besides the server thread, -1 for one per core.
+       * @throws std::runtime_error if the world directory cannot be created.
+       */
+      explicit Server(const config::Config& config, int worker_count = -1);
+
+      Server(const Server&) = delete;
+      Server& operator=(const Server&) = delete;
+
+      /**
+       * @brief Moves the point the chunks are streamed around, in blocks.
+       */
+      void SetAnchor(const glm::vec3& pos) { anchor_ = pos; }
+      const glm::vec3& GetAnchor() const { return anchor_; }
+
+      /**
+       * @brief Moves the anchor by velocity (blocks per second) every tick, to exercise
+       * streaming and saving without clients.
+       */
+      void SetAnchorVelocity(const glm::vec3& velocity) { anchor_velocity_ = velocity; }
+
+      /**
+       * @brief Accepts clients on address (see net/socket.hpp) from the next tick on.
+       * @throws std::runtime_error if the address cannot be bound.
+       */
+      void Listen(const std::string& address);
+
+      /**
+       * @brief The address clients connect to, with the port the system picked for port 0.
+       */
+      std::string GetListenAddress() const { return listener_ ? listener_->GetAddress() : std::string(); }
+
+      size_t GetClientCount() const { return sessions_.size(); }
+
+      /**
+       * @brief Runs one tick: clients' messages, anchor movement, streaming, block ticks,
+       * updates to clients and the periodic save.
+       */
+      void Tick();
+
+      /**
+       * @brief Runs Tick() at the tick rate until stop is set or max_ticks ticks ran
+       * (0 for no limit), then saves. Every report_interval seconds (0 for never) it
+       * prints the tick times of the interval.
+       *
+       * Ticks are due at fixed times from the start, so a slow tick is made up by the
+       * following ones. A server more than kMaxCatchUpTicks behind drops the ticks it
+       * missed instead of running them back to back.
+       */
+      void Run(const std::atomic<bool>& stop, uint64_t max_ticks = 0, double report_interval = 10.0);
+
+      /**
+       * @brief Saves every changed chunk and waits for the writes.
+       * @throws std::runtime_error if a save failed.
+       */
+      void Save();
+
+      /**
+       * @brief Prints the counters and the tick time percentiles of times.
+       */
+      void PrintReport(const char* label, const TickTimes& times, double seconds) const;
+
+      int GetTickRate() const { return tick_rate_; }
+      uint64_t GetTick() const { return tick_; }
+      const ServerStats& GetStats() const { return stats_; }
+      const TickTimes& GetTickTimes() const { return total_times_; }
+
+      world::ChunkStreamer& GetStreamer() { return streamer_; }
+      world::TickScheduler& GetTicks() { return ticks_; }
+      world::World& GetWorld() { return world_; }
+      JobSystem& GetJobs() { return jobs_; }
+
+      static constexpr uint64_t kMaxCatchUpTicks = 10;
+      static constexpr size_t kMaxQueuedBytes = 1u << 20;    ///< No chunks are queued for a client beyond this.
+      static constexpr size_t kDeltaSectionsPerMessage = 32; ///< Keeps delta frames under net::kMaxFrameSize.
+
+    private:
+      struct Session {
+        explicit Session(net::Socket socket) : connection(std::move(socket)) {}
+
+        net::Connection connection;
+        bool welcomed = false;
+        int view_radius = 0;
+        glm::vec3 pos{ 0.0f };
+        double budget = 0.0;                        ///< Bytes that may be queued this tick.
+        std::unordered_set<world::ChunkKey> sent;   ///< Chunks the client has.
+      };
+
+      void AcceptClients();
+      bool Receive(Session& session);
+      void SendUpdates(Session& session, const std::vector<net::SectionDelta>& deltas);
+
+      int tick_rate_;
+      double save_interval_;
+      uint64_t tick_ = 0;
+      double last_save_time_ = 0.0;
+      glm::vec3 anchor_{ 0.0f };
+      glm::vec3 anchor_velocity_{ 0.0f };
+
+      // Declared in dependency order: the streamer and the scheduler use the others.
+      JobSystem jobs_;
+      world::World world_;
+      world::TerrainGenerator generator_;
+      world::ChunkStorage storage_;
+      world::ChunkStreamer streamer_;
+      world::TickScheduler ticks_;
+
+      double client_bandwidth_;  ///< Bytes per second and connection.
+      std::unique_ptr<net::Listener> listener_;
+      std::vector<std::unique_ptr<Session>> sessions_;
+      std::vector<world::BlockChange> changes_;
+      std::vector<world::ChunkKey> rewritten_;
+
+      ServerStats stats_;
+      TickTimes total_times_;
+    };
+
+  }  // namespace server
+
+}  // namespace heh
@@ -0,0 +1,180 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace heh {
+
+  class JobCounter;
+  class JobSystem;
+
+  namespace job_detail {
+
+    struct Job {
+      std::function<void()> function;
+      JobCounter* signal;  ///< Decremented once function returns, may be nullptr.
+    };
+
+    /**
+     * @brief Chase-Lev work-stealing deque of jobs.
+     *
+     * The owning thread pushes and pops at the bottom (newest first, cache-warm); any
+     * other thread steals from the top (oldest first). Push and Pop are owner-only.
+     * The ring grows when full; old rings stay alive until the deque is destroyed,
+     * since a concurrent thief may still read from them.
+     */
+    class WorkStealingDeque {
+    public:
+      WorkStealingDeque();
+      ~WorkStealingDeque();
+
+      WorkStealingDeque(const WorkStealingDeque&) = delete;
+      WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+      void Push(Job* job);
+      Job* Pop();
+      Job* Steal();
+
+      size_t SizeApprox() const;
+
+    private:
+      struct Ring {
+        explicit Ring(int64_t capacity) : mask(capacity - 1), slots(new std::atomic<Job*>[static_cast<size_t>(capacity)]) {}
+
+        Job* Get(int64_t i) const { return slots[static_cast<size_t>(i & mask)].load(std::memory_order_relaxed); }
+        void Put(int64_t i, Job* job) { slots[static_cast<size_t>(i & mask)].store(job, std::memory_order_relaxed); }
+
+        int64_t mask;
+        std::unique_ptr<std::atomic<Job*>[]> slots;
+      };
+
+      std::atomic<int64_t> top_{ 0 };
+      std::atomic<int64_t> bottom_{ 0 };
+      std::atomic<Ring*> ring_;
+      std::vector<std::unique_ptr<Ring>> rings_;  ///< Current and retired rings, owner only.
+    };
+
+  }  // namespace job_detail
+
+  /**
+   * @brief Number of unfinished jobs signalling it. Jobs submitted with it as wait_for
+   * run once it reaches zero.
+   *
+   * The counter must outlive every job that signals or waits for it; wait on it with
+   * JobSystem::Wait before destroying it.
+   */
+  class JobCounter {
+  public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    int GetValue() const { return value_.load(std::memory_order_acquire); }
+    bool IsDone() const { return GetValue() == 0; }
+
+  private:
+    friend class JobSystem;
+
+    std::atomic<int> value_{ 0 };
+    mutable std::mutex mutex_;
+    std::vector<job_detail::Job*> continuations_;  ///< Jobs waiting for zero.
+  };
+
+  /**
+   * @brief Work-stealing job system shared by all background engine work.
+   *
+   * Each worker thread owns a deque: jobs a worker submits go to its own deque and it
+   * runs them newest first, while idle workers steal the oldest jobs from the others.
+   * The thread that creates the system also gets a deque, so jobs it submits are
+   * stolen by the workers and it can help run them while waiting (Wait). Submissions
+   * from any other thread go through a shared queue.
+   *
+   * Jobs must not throw.
+   */
+  class JobSystem {
+  public:
+    /**
+     * @param worker_count Background threads. Negative picks one per core besides the
+     * caller's; with 0, jobs only run when the creating thread calls Wait or TryRunOne.
+     */
+    explicit JobSystem(int worker_count = -1);
+
+    /**
+     * @brief Stops the workers. Jobs that have not started are discarded, so owners wait
+     * for their counters first.
+     */
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /**
+     * @param signal Incremented now and decremented when the job finishes, may be nullptr.
+     * @param wait_for The job is held back until this counter reaches zero, may be nullptr.
+     */
+    void Submit(std::function<void()> function, JobCounter* signal = nullptr, JobCounter* wait_for = nullptr);
+
+    /**
+     * @brief Runs queued jobs on the calling thread until counter reaches zero.
+     * Safe to call from inside a job.
+     */
+    void Wait(const JobCounter& counter);
+
+    /**
+     * @brief Runs one queued job on the calling thread, if there is one.
+     * @return false if no job was found.
+     */
+    bool TryRunOne();
+
+    /**
+     * @brief Calls body(begin, end) over [0, count) in batches of batch_size, in parallel,
+     * and waits for all of them.
+     */
+    void ParallelFor(size_t count, size_t batch_size, const std::function<void(size_t begin, size_t end)>& body);
+
+    unsigned GetWorkerCount() const { return static_cast<unsigned>(workers_.size()); }
+
+    /**
+     * @brief Threads that run jobs: the workers and the creating thread.
+     */
+    unsigned GetThreadCount() const { return GetWorkerCount() + 1; }
+
+    uint64_t GetStealCount() const { return steals_.load(std::memory_order_relaxed); }
+
+  private:
+    void Enqueue(job_detail::Job* job);
+    void Run(job_detail::Job* job);
+    void Finish(JobCounter* counter);
+    job_detail::Job* FindJob(int index);
+    void WorkerLoop(int index);
+
+    /**
+     * @brief Deque index of the calling thread in this system, -1 for other threads.
+     */
+    int ThreadIndex() const;
+
+    std::vector<std::unique_ptr<job_detail::WorkStealingDeque>> deques_;  ///< [0] belongs to the creating thread.
+    std::thread::id owner_thread_;
+    std::vector<std::thread> workers_;
+
+    std::mutex injected_mutex_;
+    std::deque<job_detail::Job*> injected_;  ///< Jobs from threads without a deque.
+
+    std::atomic<int64_t> pending_{ 0 };  ///< Queued jobs not taken yet; workers sleep at zero.
+    std::atomic<uint64_t> steals_{ 0 };
+    std::atomic<int> sleepers_{ 0 };
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    bool stopping_ = false;
+  };
+
+}  // namespace heh
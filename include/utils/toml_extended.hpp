@@ -21,6 +21,27 @@ namespace heh {
       int height{ 600 };            ///< The height of the window.
       std::string window_name;      ///< The name of the window.
       bool fullscreen{ false };     ///< Whether the window is fullscreen or not.
+      int upload_budget{ 4096 };    ///< KiB of chunk meshes sent to the GPU per frame at most.
+      int mesh_memory{ 1024 };      ///< MiB of GPU memory for chunk meshes; the farthest are evicted past it. 0 for no limit.
+      bool keep_evicted_meshes{ true }; ///< Keep compact copies of evicted meshes to upload them again instead of rebuilding them.
+    };
+
+    struct WorldConfig {
+      int seed{ 1337 };             ///< Seed of the terrain generator.
+      int render_distance{ 8 };     ///< Radius, in chunks, that is kept generated and meshed around the camera.
+      int unload_margin{ 2 };       ///< Extra chunks beyond render_distance before a chunk is unloaded.
+      int lod_distance{ 8 };        ///< Chunks from the camera where meshes start losing detail, halving it at each doubling of the distance; 0 disables it.
+      float prefetch_lookahead{ 2.0f }; ///< Seconds of predicted camera movement covered by prefetching, 0 disables it.
+      int prefetch_queue{ 64 };     ///< Maximum number of chunks prefetched ahead of the load radius.
+      int random_tick_speed{ 3 };   ///< Random block ticks per section and tick, 0 disables them.
+    };
+
+    struct ServerConfig {
+      int tick_rate{ 20 };          ///< Ticks per second of the server loop.
+      float save_interval{ 30.0f }; ///< Seconds between saves of the changed chunks, 0 saves only on unload and exit.
+      std::string world_directory{ "world" }; ///< Directory of the region files.
+      std::string address{ ":25565" };        ///< Where clients connect, "host:port" or "unix:path".
+      int client_bandwidth{ 4096 };           ///< KiB per second sent to each client at most.
     };
 
     struct BlockConfig {
@@ -28,6 +49,9 @@ namespace heh {
       std::string side;
       std::string top;
       std::string bottom;
+      bool opaque{ true };          ///< Whether the block stops light.
+      bool solid{ true };           ///< Whether bodies collide with the block.
+      uint32_t emission{ 0 };       ///< Block light it gives off, 0 to 15.
     };
 
     struct TextureConfig {
@@ -38,6 +62,8 @@ namespace heh {
     struct Config {
       CameraConfig camera;
       WindowConfig window;
+      WorldConfig world;
+      ServerConfig server;
       std::unordered_map<std::string, BlockConfig> blocks;
       std::unordered_map<std::string, TextureConfig> textures;
     };
@@ -4,9 +4,10 @@
 #include <toml11/toml.hpp>
 #include <glm/glm.hpp>
 
-#include "utils/image_writer.hpp"
+#include "utils/toml_extended.hpp"
 
 // std
+#include <cstdint>
 #include <unordered_map>
 #include <string>
 #include <vector>
@@ -24,13 +25,58 @@ namespace heh {
     glm::vec2 uvs[4];
   };
 
+  struct BlockFaceUvs {
+    glm::vec2 top[4];
+    glm::vec2 side[4];
+    glm::vec2 bottom[4];
+  };
+
+  struct BlockProperties {
+    bool opaque = false;    ///< Stops light.
+    bool solid = false;     ///< Stops moving bodies.
+    uint8_t emission = 0;   ///< Block light level it emits, 0 to 15.
+  };
+
   namespace block_map {
     extern std::unordered_map<int, std::string> id_to_name;
-    extern std::vector<BlockFormat> block_formats;
+    extern std::vector<BlockFormat> block_formats;   ///< Indexed by block id - 1.
     extern std::unordered_map<std::string, TextureFormat> texture_formats;
+    extern std::vector<BlockFaceUvs> face_uvs;       ///< Indexed by block id, read by the mesher without string lookups.
+    extern std::vector<BlockProperties> properties;  ///< Indexed by block id; [0] is air.
 
+    /**
+     * @brief (Re)builds the block tables from config::file.
+     * Call again after the texture atlas changes the texture uvs.
+     */
     void LoadBlocks();
 
+    /**
+     * @brief Looks up a block id by its name in blocks.toml.
+     * @return The id, or fallback if no block has that name.
+     */
+    int FindBlockId(const std::string& name, int fallback);
+
+    /**
+     * @brief Whether a block stops light. Ids missing from blocks.toml do.
+     */
+    inline bool IsOpaque(int id)
+    {
+      return static_cast<size_t>(id) < properties.size() ? properties[id].opaque : true;
+    }
+
+    /**
+     * @brief Whether bodies collide with a block. Ids missing from blocks.toml do.
+     */
+    inline bool IsSolid(int id)
+    {
+      return static_cast<size_t>(id) < properties.size() ? properties[id].solid : true;
+    }
+
+    inline uint8_t GetEmission(int id)
+    {
+      return static_cast<size_t>(id) < properties.size() ? properties[id].emission : 0;
+    }
+
   } // namespace block_map  
 
 } // namespace heh
\ No newline at end of file
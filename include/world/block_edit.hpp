@@ -0,0 +1,101 @@
+#pragma once
+
+#include "world/world.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <vector>
+
+namespace heh {
+
+  class JobSystem;
+
+  namespace world {
+
+    /**
+     * @brief A box of block positions, min and max included.
+     */
+    struct BlockBox {
+      glm::ivec3 min{ 0 };
+      glm::ivec3 max{ -1 };
+
+      /**
+       * @brief The box between two opposite corners given in any order.
+       */
+      static BlockBox FromCorners(const glm::ivec3& a, const glm::ivec3& b)
+      {
+        return { glm::min(a, b), glm::max(a, b) };
+      }
+
+      bool IsEmpty() const { return max.x < min.x || max.y < min.y || max.z < min.z; }
+      glm::ivec3 GetSize() const { return max - min + 1; }
+    };
+
+    /**
+     * @brief What a bulk edit did.
+     */
+    struct EditStats {
+      size_t blocks = 0;            ///< Blocks inside loaded chunks that were visited.
+      size_t changed = 0;           ///< Blocks whose id changed; fills count what they wrote over.
+      size_t full_sections = 0;     ///< Sections the box covered whole, handled as one run.
+      size_t partial_sections = 0;
+      std::vector<ChunkKey> chunks; ///< Chunks whose blocks were visited, in ascending key order.
+    };
+
+    /**
+     * @brief Blocks copied out of a box, to be pasted elsewhere.
+     */
+    struct BlockClipboard {
+      glm::ivec3 size{ 0 };
+      std::vector<BlockId> blocks;  ///< x-major, then z, then y, so columns are contiguous like in a chunk.
+
+      size_t Index(int32_t x, int32_t y, int32_t z) const
+      {
+        return (static_cast<size_t>(x) * static_cast<size_t>(size.z) + static_cast<size_t>(z)) * static_cast<size_t>(size.y) +
+               static_cast<size_t>(y);
+      }
+    };
+
+    /*
+      Bulk edits over boxes. Each one walks the chunks the box overlaps, section by section:
+      a section the box covers whole is a single contiguous run of ids, and in a section
+      it covers in part, a column is a run along y, and columns next to each other merge
+      into longer runs when the box spans the full section height. The runs are plain
+      loops over packed ids that the compiler vectorizes. Chunks are processed in
+      parallel with a job system.
+
+      The edits write blocks only: no light, no meshes. They skip the parts of the box
+      in chunks that are not loaded, and clip it to the world height. Nothing may read
+      the chunks meanwhile; through a ChunkStreamer, use ChunkStreamer::EditBlocks, which
+      relights and remeshes every touched chunk once afterwards.
+    */
+
+    /**
+     * @brief Sets every block in box to id.
+     */
+    EditStats FillBox(World& world, const BlockBox& box, BlockId id, JobSystem* jobs = nullptr);
+
+    /**
+     * @brief Sets the blocks in box that are from to to.
+     */
+    EditStats ReplaceInBox(World& world, const BlockBox& box, BlockId from, BlockId to, JobSystem* jobs = nullptr);
+
+    /**
+     * @brief Copies the blocks in box. Blocks in chunks that are not loaded, or above or
+     * below the world, copy as air.
+     */
+    BlockClipboard CopyBox(const World& world, const BlockBox& box, JobSystem* jobs = nullptr);
+
+    /**
+     * @brief Writes clipboard with its min corner at origin.
+     * @param skip_air Leaves the world's blocks where the clipboard holds air.
+     */
+    EditStats PasteBox(World& world, const BlockClipboard& clipboard, const glm::ivec3& origin, bool skip_air,
+                       JobSystem* jobs = nullptr);
+
+  }  // namespace world
+
+}  // namespace heh
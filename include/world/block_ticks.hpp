@@ -0,0 +1,303 @@
+#pragma once
+
+#include "world/block_edit.hpp"
+#include "world/chunk_pipeline.hpp"
+#include "world/world.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace heh {
+
+  class JobSystem;
+
+  namespace world {
+
+    class ChunkStreamer;
+    class TickContext;
+    class TickScheduler;
+
+    using TickFunction = void (*)(TickContext& context, const glm::ivec3& pos, BlockId id);
+
+    /**
+     * @brief What a block does when it is ticked. Either function may be null.
+     */
+    struct BlockBehaviour {
+      TickFunction random_tick = nullptr;     ///< Called when a random tick lands on the block.
+      TickFunction scheduled_tick = nullptr;  ///< Called for ticks scheduled at the block, e.g. after a neighbour changed.
+    };
+
+    /**
+     * @brief A block that was set to id.
+     */
+    struct BlockChange {
+      glm::ivec3 pos;
+      BlockId id;
+    };
+
+    /**
+     * @brief Block tick counters. The per-tick fields describe the last tick.
+     */
+    struct TickStats {
+      uint64_t ticks = 0;            ///< Ticks run since construction.
+      size_t chunks = 0;             ///< Chunks that could be ticked.
+      size_t active_sections = 0;    ///< Sections that got random ticks.
+      size_t random_ticks = 0;       ///< Random ticks that landed on a block with a behaviour.
+      size_t scheduled_ticks = 0;    ///< Scheduled ticks that ran.
+      size_t pending_ticks = 0;      ///< Scheduled ticks waiting in the queues.
+      size_t edits = 0;              ///< Blocks changed by behaviours.
+      size_t regions = 0;            ///< Regions the ticked chunks were split into.
+      size_t deferred_edits = 0;     ///< Edits that crossed a region border and waited for the end of the phase.
+      StageTiming timing;            ///< Wall-clock time of whole ticks.
+    };
+
+    /**
+     * @brief The view of the world a behaviour gets while its chunk is ticked.
+     *
+     * Reads may reach one block into the neighbouring chunks. Blocks of the ticked chunk's
+     * region are changed at once, with their light; blocks of other regions, and ticks
+     * scheduled anywhere, are applied at the end of the region's phase (see TickScheduler).
+     */
+    class TickContext {
+    public:
+      BlockId GetBlock(const glm::ivec3& pos);
+
+      /**
+       * @brief Packed light at pos, sky in the high nibble; full sky light outside the world.
+       */
+      uint8_t GetLight(const glm::ivec3& pos);
+
+      void SetBlock(const glm::ivec3& pos, BlockId id);
+
+      /**
+       * @brief Runs the scheduled tick of the block at pos delay ticks from now (at least one).
+       */
+      void Schedule(const glm::ivec3& pos, uint32_t delay);
+
+      /**
+       * @brief Next value of the chunk's random sequence, the same for the same seed,
+       * tick and chunk.
+       */
+      uint32_t Random();
+
+      uint64_t GetTick() const { return tick_; }
+
+      const TickScheduler& GetScheduler() const { return scheduler_; }
+
+    private:
+      friend class TickScheduler;
+
+      struct RegionChunk {
+        Chunk* chunk;
+        uint16_t* tickable;  ///< The chunk's tickable block counts.
+      };
+
+      struct Output {
+        std::vector<std::pair<glm::ivec3, uint32_t>> schedules;  ///< (block, delay)
+        std::vector<std::pair<glm::ivec3, BlockId>> edits;       ///< Edits outside the ticked region.
+        std::vector<ChunkKey> remesh;
+        std::vector<BlockChange> changes;  ///< Edits applied in the ticked region, when recording.
+        size_t active_sections = 0;
+        size_t random_ticks = 0;
+        size_t scheduled_ticks = 0;
+        size_t popped_ticks = 0;
+        size_t edits_applied = 0;
+      };
+
+      TickContext(TickScheduler& scheduler, World& world, const RegionChunk& ticked, const RegionChunk* region,
+                  size_t region_size, uint64_t seed, Output& output);
+
+      TickScheduler& scheduler_;
+      World& world_;
+      BlockAccessor blocks_;
+      Chunk& chunk_;
+      uint16_t* tickable_;           ///< The chunk's tickable block counts.
+      const RegionChunk* region_;    ///< Chunks of the region being ticked, this one included.
+      size_t region_size_;
+      uint64_t tick_;
+      uint64_t random_state_;
+      Output& output_;
+    };
+
+    /**
+     * @brief Runs block ticks: scheduled ticks from a per-chunk queue, and random ticks.
+     *
+     * Each Tick(), every section that holds a block with a random tick behaviour gets
+     * random_ticks_per_section ticks at random positions; sections without such blocks
+     * (empty or inert) are skipped on a per-section count, so their cost is nothing.
+     * Scheduled ticks wait in a priority queue per chunk, ordered by due tick and then by
+     * scheduling order, and only due ones are looked at. The cost of a tick follows the
+     * number of active sections and due ticks, not the size of the world.
+     *
+     * Only chunks whose 3x3 neighbourhood the streamer allows editing are ticked. They are
+     * grouped into square regions of region_size chunks, and the regions into 4 colours
+     * by the parity of their coordinates, checkerboard-style. Regions of a colour are a
+     * region apart, at least two chunks, so what their chunks read and write (themselves,
+     * and the light of their neighbours) never overlaps: a colour runs as one phase of
+     * parallel jobs, one per region, and the colours run one after the other. Edits that
+     * cross into another region are buffered and applied, in a fixed order, when the
+     * phase ends. Results do not depend on the thread count.
+     *
+     * Tick() and SetBlock() must be called from the thread that updates the streamer.
+     */
+    class TickScheduler {
+    public:
+      /**
+       * @param streamer Decides which chunks can be edited and rebuilds meshes; must
+       * outlive the scheduler.
+       * @param jobs Runs the chunks of a colour in parallel; must outlive the scheduler.
+       */
+      TickScheduler(World& world, ChunkStreamer& streamer, JobSystem& jobs, uint32_t seed, int random_ticks_per_section = 3);
+
+      TickScheduler(const TickScheduler&) = delete;
+      TickScheduler& operator=(const TickScheduler&) = delete;
+
+      /**
+       * @brief Sets the behaviour of a block id, replacing the built-in one (see
+       * RegisterDefaultBehaviours).
+       */
+      void Register(BlockId id, const BlockBehaviour& behaviour);
+
+      /**
+       * @brief Runs the scheduled tick of the block at pos delay ticks from now (at least
+       * one). Dropped if its chunk is not loaded.
+       */
+      void Schedule(const glm::ivec3& pos, uint32_t delay);
+
+      /**
+       * @brief Changes a block through the streamer and schedules ticks for its
+       * neighbours that react to changes. Use it for edits that do not come from ticks.
+       * @return false if the streamer refused the edit.
+       */
+      bool SetBlock(const glm::ivec3& pos, BlockId id);
+
+      /**
+       * @brief Runs a bulk edit through ChunkStreamer::EditBlocks and recounts the
+       * tickable blocks of the chunks in box before their next tick.
+       * @return false if the streamer refused the edit.
+       */
+      bool EditBlocks(const BlockBox& box, const std::function<void()>& edit);
+
+      /**
+       * @brief Recounts the tickable blocks of a chunk whose blocks changed without
+       * SetBlock, before its next tick.
+       */
+      void InvalidateChunk(int32_t x, int32_t z);
+
+      /**
+       * @brief Advances the world by one tick.
+       */
+      void Tick();
+
+      /**
+       * @brief Whether block changes are recorded for PopChanges, e.g. to send them to
+       * the clients of a server. Off by default.
+       */
+      void SetRecordChanges(bool record);
+
+      /**
+       * @brief Takes the changes recorded since the last call, in the order they were
+       * applied. Bulk edits are not listed block by block; their chunks are added to
+       * rewritten instead.
+       */
+      void PopChanges(std::vector<BlockChange>& changes, std::vector<ChunkKey>& rewritten);
+
+      /**
+       * @brief Side of a region in chunks, at least kMinRegionSize. Larger regions defer
+       * fewer edits; smaller ones give more jobs per phase.
+       */
+      void SetRegionSize(int chunks) { region_size_ = chunks < kMinRegionSize ? kMinRegionSize : chunks; }
+      int GetRegionSize() const { return region_size_; }
+
+      void SetRandomTicksPerSection(int count) { random_ticks_per_section_ = count < 0 ? 0 : count; }
+      int GetRandomTicksPerSection() const { return random_ticks_per_section_; }
+
+      uint64_t GetTick() const { return tick_; }
+      const TickStats& GetStats() const { return stats_; }
+
+      /**
+       * @brief Ids the built-in behaviours turn blocks into; kAirBlock if blocks.toml has
+       * no such block.
+       */
+      BlockId GetGrassBlock() const { return grass_block_; }
+      BlockId GetDirtBlock() const { return dirt_block_; }
+
+      static constexpr int kMinRegionSize = 2;  ///< Keeps regions of a colour two chunks apart.
+
+    private:
+      friend class TickContext;
+
+      struct ScheduledTick {
+        uint64_t due;
+        uint64_t order;  ///< Keeps ticks due at the same tick in scheduling order.
+        uint32_t index;  ///< Chunk::Index of the block.
+
+        bool operator>(const ScheduledTick& other) const
+        {
+          return due != other.due ? due > other.due : order > other.order;
+        }
+      };
+
+      struct ChunkTicks {
+        const Chunk* chunk = nullptr;  ///< Detects a chunk that was unloaded and loaded again.
+        bool counted = false;
+        std::array<uint16_t, kSectionsPerChunk> tickable{};  ///< Blocks with a random tick, per section.
+        std::priority_queue<ScheduledTick, std::vector<ScheduledTick>, std::greater<ScheduledTick>> queue;
+      };
+
+      struct TickedChunk {
+        uint32_t colour;  ///< Of the region.
+        ChunkKey region;
+        ChunkKey key;
+        ChunkTicks* ticks;
+      };
+
+      void RegisterDefaultBehaviours();
+      ChunkTicks* GetTicks(Chunk* chunk);
+      void CountTickable(ChunkTicks& ticks, const Chunk& chunk) const;
+      void TickRegion(const TickedChunk* ticked, const TickContext::RegionChunk* chunks, size_t count,
+                      TickContext::Output& output);
+      void TickChunk(const TickContext::RegionChunk& chunk, ChunkTicks& ticks, const TickContext::RegionChunk* region,
+                     size_t region_size, TickContext::Output& output);
+      void MergeOutput(TickContext::Output& output, std::vector<ChunkKey>& remesh);
+      void CountChange(uint16_t* tickable, int32_t y, BlockId old_id, BlockId new_id) const;
+      void ScheduleNeighbours(BlockAccessor& blocks, const glm::ivec3& pos,
+                              std::vector<std::pair<glm::ivec3, uint32_t>>& out) const;
+      void DropUnloaded();
+
+      const BlockBehaviour& GetBehaviour(BlockId id) const
+      {
+        static const BlockBehaviour kNone;
+        return static_cast<size_t>(id) < behaviours_.size() ? behaviours_[id] : kNone;
+      }
+
+      World& world_;
+      ChunkStreamer& streamer_;
+      JobSystem& jobs_;
+      uint64_t seed_;
+      int random_ticks_per_section_;
+      int region_size_ = kMinRegionSize;
+
+      uint64_t tick_ = 0;
+      uint64_t order_ = 0;
+      bool record_changes_ = false;
+      std::vector<BlockChange> changes_;
+      std::vector<ChunkKey> rewritten_;
+      std::vector<BlockBehaviour> behaviours_;  ///< Indexed by block id.
+      BlockId grass_block_ = kAirBlock;
+      BlockId dirt_block_ = kAirBlock;
+      std::unordered_map<ChunkKey, ChunkTicks> chunks_;
+      TickStats stats_;
+    };
+
+  }  // namespace world
+
+}  // namespace heh
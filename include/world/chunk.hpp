@@ -1,13 +1,12 @@
 #pragma once
 
-#include "core/buffer.hpp"
 #include "block.hpp"
 
 // libs
-#include <glad/glad.h>
 #include <glm/glm.hpp>
 
 // std
+#include <array>
 #include <cstdint>
 #include <vector>
 #include <memory>
@@ -22,14 +21,67 @@ namespace heh {
   static constexpr uint32_t kChunkWidth = 16;
   static constexpr uint32_t kChunkDepth = 16;
   static constexpr uint32_t kChunkHeight = 256;
+  static constexpr uint32_t kSectionHeight = 16;
+  static constexpr uint32_t kSectionsPerChunk = kChunkHeight / kSectionHeight;
+  static constexpr uint32_t kSectionVolume = kChunkWidth * kSectionHeight * kChunkDepth;
+  static constexpr uint32_t kChunkVolume = kChunkWidth * kChunkHeight * kChunkDepth;
+
+  using BlockId = int16_t;
+  static constexpr BlockId kAirBlock = 0;
+
+  /**
+   * Coarsest level of detail of a chunk mesh: faces of 2^kMaxLod blocks (see Chunk::BuildLodMesh).
+   */
+  static constexpr uint32_t kMaxLod = 3;
+
+  static constexpr uint8_t kMaxLight = 15;
+  /**
+   * Light of a block open to the sky with nothing emitting nearby, packed as in Chunk::light_data.
+   */
+  static constexpr uint8_t kSkyLight = kMaxLight << 4;
 
   struct Vertex
   {
     glm::vec3 position;
     glm::vec2 tex_coords;
     glm::vec3 normal;
+    glm::vec2 light;  ///< Sky and block light in [0, 1], averaged over the blocks around the corner.
+  };
+
+  /**
+   * Faces of a section, in the order of the bits of a connectivity mask. Opposite faces
+   * differ in the lowest bit.
+   */
+  enum SectionFace : uint8_t {
+    kFaceDown,   ///< -y
+    kFaceUp,     ///< +y
+    kFaceNorth,  ///< -z
+    kFaceSouth,  ///< +z
+    kFaceWest,   ///< -x
+    kFaceEast,   ///< +x
   };
 
+  static constexpr int kSectionFaceCount = 6;
+
+  /**
+   * All 15 pairs of different faces connected.
+   */
+  static constexpr uint16_t kAllFacesConnected = 0x7fff;
+
+  /**
+   * @brief Bit of the pair of different faces a and b in a connectivity mask.
+   */
+  constexpr uint16_t SectionFacePairBit(int a, int b)
+  {
+    if (a > b)
+    {
+      const int t = a;
+      a = b;
+      b = t;
+    }
+    return static_cast<uint16_t>(1u << (a * (11 - a) / 2 + b - a - 1));
+  }
+
   struct ChunkRenderData
   {
     std::vector<Vertex> vertices;
@@ -38,22 +90,147 @@ namespace heh {
     size_t vertex_size_bytes;
     size_t element_size_bytes;
     uint32_t num_elements;
+
+    /**
+     * Faces are grouped by section, bottom up: section s owns elements
+     * [section_elements[s], section_elements[s + 1]).
+     */
+    std::array<uint32_t, kSectionsPerChunk + 1> section_elements{};
+
+    /**
+     * Per section, the pairs of faces (see SectionFacePairBit) joined by a path through
+     * blocks that are not opaque, inside the section.
+     */
+    std::array<uint16_t, kSectionsPerChunk> section_connectivity{};
+
+    uint32_t lod = 0;  ///< Level of detail it was built at, 0 for full blocks.
   };
 
+  /**
+   * @brief How far a chunk has come through the generation pipeline (see world/chunk_pipeline.hpp).
+   * Each status implies all the previous ones.
+   */
+  enum class ChunkStatus : uint8_t {
+    kEmpty,     ///< Allocated, no blocks yet.
+    kTerrain,   ///< Heightmap and caves.
+    kFeatures,  ///< Trees and flowers, including the parts of neighbours' trees that reach in.
+    kLight,     ///< Light computed.
+    kMeshed,    ///< Mesh built from the final blocks and light.
+    kUploaded,  ///< Mesh handed to the renderer.
+  };
+
+  static constexpr size_t kChunkStatusCount = static_cast<size_t>(ChunkStatus::kUploaded) + 1;
+
+  struct ChunkNeighbourhood;
+
   struct Chunk
   {
+    int32_t x = 0;  ///< Chunk column coordinate, world x / kChunkWidth.
+    int32_t z = 0;  ///< Chunk column coordinate, world z / kChunkDepth.
+
     std::unique_ptr<ChunkRenderData> data;
-    std::vector<int16_t> blocks_data;
 
-    void Generate();
-    void UploadToGpu();
-    void ClearCpuData();
-    void Render();
+    /**
+     * Written only by the thread that schedules the pipeline, between stages.
+     */
+    ChunkStatus status = ChunkStatus::kEmpty;
+
+    /**
+     * Block ids, section-major: each 16x16x16 section is contiguous and, inside it,
+     * columns are contiguous along y (see Index).
+     */
+    std::vector<BlockId> blocks_data;
+
+    /**
+     * @brief Index of a local block position into blocks_data.
+     */
+    static constexpr uint32_t Index(uint32_t x, uint32_t y, uint32_t z)
+    {
+      return ((y >> 4) << 12) | (x << 8) | (z << 4) | (y & 15);
+    }
+
+    /**
+     * Sky light in the high nibble and block light in the low one, laid out like
+     * blocks_data. Empty until the light stage has run.
+     */
+    std::vector<uint8_t> light_data;
+
+    inline BlockId GetBlock(uint32_t x, uint32_t y, uint32_t z) const { return blocks_data[Index(x, y, z)]; }
+    inline void SetBlock(uint32_t x, uint32_t y, uint32_t z, BlockId id) { blocks_data[Index(x, y, z)] = id; }
+
+    /**
+     * @brief Packed light at a local position; full sky light if the chunk has no light yet.
+     */
+    inline uint8_t GetLight(uint32_t x, uint32_t y, uint32_t z) const
+    {
+      return light_data.empty() ? kSkyLight : light_data[Index(x, y, z)];
+    }
+
+    /**
+     * @brief Builds the faces of this chunk that touch air, with smooth light at each
+     * corner. Vertex positions are local to the chunk.
+     * @param area This chunk at its center and the chunks around it. A missing
+     * neighbour is treated as air under the open sky.
+     */
+    std::unique_ptr<ChunkRenderData> BuildMesh(const ChunkNeighbourhood& area) const;
+
+    /**
+     * @brief Builds a coarser mesh for distant chunks straight from the blocks, out of
+     * cells of 2^lod blocks a side. A cell is solid if at least half its blocks are, and
+     * shows the block most of its columns have on top. Each face is lit by the brightest
+     * block in front of it. Border cells are compared with the neighbours' cells of the
+     * same size; the border faces of the top cells of each column are kept as skirts even
+     * when hidden, so no gap opens against a neighbour built at another level.
+     * @param lod 1 to kMaxLod; 0 builds the full mesh with BuildMesh.
+     */
+    std::unique_ptr<ChunkRenderData> BuildLodMesh(const ChunkNeighbourhood& area, uint32_t lod) const;
+
+    /**
+     * @brief Which faces of a section can see each other through it, by flood-filling
+     * its blocks that are not opaque. A mask of SectionFacePairBit.
+     */
+    uint16_t ComputeConnectivity(uint32_t section) const;
+  };
+
+  /**
+   * Chunk column offsets of the four horizontal neighbours.
+   */
+  static constexpr int32_t kNeighbourOffsets[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+  /**
+   * @brief A chunk and the eight chunks around it, for stages that read across borders.
+   */
+  struct ChunkNeighbourhood
+  {
+    std::array<const Chunk*, 9> chunks{};  ///< Row-major over dz, dx in [-1, 1]; the center is chunks[4].
+
+    const Chunk* Get(int dx, int dz) const { return chunks[(dz + 1) * 3 + (dx + 1)]; }
+
+    /**
+     * @brief Block at a position local to the center chunk; x and z may reach one chunk
+     * outside it. Missing chunks read as air, positions above and below the world as air.
+     */
+    BlockId GetBlock(int x, int y, int z) const
+    {
+      if (y < 0 || y >= static_cast<int>(kChunkHeight))
+        return kAirBlock;
+      const Chunk* chunk = Get(x >> 4, z >> 4);
+      return chunk ? chunk->GetBlock(static_cast<uint32_t>(x) & 15u, static_cast<uint32_t>(y), static_cast<uint32_t>(z) & 15u) : kAirBlock;
+    }
 
-  private:
-    Buffer vbo_{ GL_ARRAY_BUFFER };
-    Buffer ebo_{ GL_ELEMENT_ARRAY_BUFFER };
-    VertexArray vao_{};
+    /**
+     * @brief Packed light, like GetBlock. Above the world and in missing chunks it is full
+     * sky light, below the world it is dark.
+     */
+    uint8_t GetLight(int x, int y, int z) const
+    {
+      if (y < 0)
+        return 0;
+      if (y >= static_cast<int>(kChunkHeight))
+        return kSkyLight;
+      const Chunk* chunk = Get(x >> 4, z >> 4);
+      return chunk ? chunk->GetLight(static_cast<uint32_t>(x) & 15u, static_cast<uint32_t>(y), static_cast<uint32_t>(z) & 15u) : kSkyLight;
+    }
   };
 
 }  // namespace heh
\ No newline at end of file
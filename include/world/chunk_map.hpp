@@ -0,0 +1,153 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace heh {
+
+  struct Chunk;
+
+  namespace world {
+
+    /**
+     * @brief Chunk column coordinates packed into a single 64-bit key.
+     * High 32 bits hold x, low 32 bits hold z (both as two's complement).
+     */
+    using ChunkKey = uint64_t;
+
+    constexpr ChunkKey PackChunkKey(int32_t x, int32_t z)
+    {
+      return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z);
+    }
+
+    constexpr int32_t ChunkKeyX(ChunkKey key) { return static_cast<int32_t>(static_cast<uint32_t>(key >> 32)); }
+    constexpr int32_t ChunkKeyZ(ChunkKey key) { return static_cast<int32_t>(static_cast<uint32_t>(key)); }
+
+    // Chunk coordinates are world coordinates >> 4, so x == INT32_MIN can never be reached
+    // and its keys are free to act as slot markers.
+    constexpr ChunkKey kEmptyChunkKey = PackChunkKey(INT32_MIN, 0);
+    constexpr ChunkKey kTombstoneChunkKey = PackChunkKey(INT32_MIN, 1);
+
+    /**
+     * @brief Open-addressing hash map from ChunkKey to Chunk*.
+     *
+     * Slots hold the key and the value side by side (16 bytes, four per cache line) and are
+     * probed linearly, so a lookup usually touches a single cache line.
+     *
+     * Readers (Find, ForEach) never lock: they only perform acquire loads, and may run on any
+     * thread concurrently with a writer. Writers (Insert, Erase) are serialized by an internal
+     * mutex. Growing the table publishes a new slot array; the old one is kept alive until
+     * ReclaimRetired() is called at a point where no reader can still be probing it.
+     */
+    class ChunkMap {
+    public:
+      explicit ChunkMap(size_t initial_capacity = 1024);
+      ~ChunkMap();
+
+      ChunkMap(const ChunkMap&) = delete;
+      ChunkMap& operator=(const ChunkMap&) = delete;
+
+      /**
+       * @brief Looks up a chunk. Lock-free, safe to call from any thread.
+       * @return The chunk, or nullptr if the key is not present.
+       */
+      inline Chunk* Find(ChunkKey key) const
+      {
+        for (;;)
+        {
+          const Table* table = table_.load(std::memory_order_acquire);
+          size_t i = Hash(key) & table->mask;
+          for (;;)
+          {
+            const Slot& slot = table->slots[i];
+            const ChunkKey k = slot.key.load(std::memory_order_acquire);
+            if (k == key)
+            {
+              Chunk* chunk = slot.value.load(std::memory_order_acquire);
+              // The key may have been erased and its slot reused by another key between
+              // the two loads, leaving that key's chunk in the value; probe again then.
+              if (slot.key.load(std::memory_order_acquire) == key)
+                return chunk;
+              break;
+            }
+            if (k == kEmptyChunkKey)
+              return nullptr;
+            i = (i + 1) & table->mask;
+          }
+        }
+      }
+
+      /**
+       * @brief Inserts a chunk. Does nothing and returns false if the key is already present.
+       */
+      bool Insert(ChunkKey key, Chunk* chunk);
+
+      /**
+       * @brief Removes a key.
+       * @return The chunk that was stored under the key, or nullptr.
+       */
+      Chunk* Erase(ChunkKey key);
+
+      /**
+       * @brief Calls f(key, chunk) for every stored chunk. Lock-free like Find.
+       */
+      template <typename F>
+      void ForEach(F&& f) const
+      {
+        const Table* table = table_.load(std::memory_order_acquire);
+        for (size_t i = 0; i <= table->mask; ++i)
+        {
+          const ChunkKey k = table->slots[i].key.load(std::memory_order_acquire);
+          if (k == kEmptyChunkKey || k == kTombstoneChunkKey)
+            continue;
+          Chunk* chunk = table->slots[i].value.load(std::memory_order_acquire);
+          if (chunk)
+            f(k, chunk);
+        }
+      }
+
+      size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+      /**
+       * @brief Frees slot arrays replaced by growth. The caller guarantees no reader is
+       * still inside Find/ForEach on an old table.
+       */
+      void ReclaimRetired();
+
+      static inline size_t Hash(ChunkKey key)
+      {
+        // Fibonacci hashing; the xor-shift folds x into the low bits used by the mask.
+        key ^= key >> 29;
+        key *= 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(key ^ (key >> 32));
+      }
+
+    private:
+      struct Slot {
+        std::atomic<ChunkKey> key{ kEmptyChunkKey };
+        std::atomic<Chunk*> value{ nullptr };
+      };
+
+      struct Table {
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+        explicit Table(size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+      };
+
+      void Grow(size_t new_capacity);
+
+      std::atomic<Table*> table_;
+      std::atomic<size_t> size_{ 0 };
+      size_t used_slots_ = 0;  ///< Live entries plus tombstones, guarded by write_mutex_.
+      std::mutex write_mutex_;
+      std::vector<std::unique_ptr<Table>> retired_tables_;
+    };
+
+  }  // namespace world
+
+}  // namespace heh
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "world/chunk.hpp"
+
+// std
+#include <algorithm>
+#include <cstdint>
+
+namespace heh {
+
+  namespace world {
+
+    /**
+     * @brief What a pipeline stage reads besides the chunk it runs on.
+     *
+     * A stage only ever writes the chunk it runs on. Before it runs, every chunk within
+     * neighbour_radius (Chebyshev, in chunks) must have reached neighbour_status, so the
+     * data it reads from them is final. Exclusive stages additionally read neighbour data
+     * that the same stage writes (features read the neighbours' surface while placing the
+     * parts of their trees that reach in), so no two chunks within neighbour_radius run
+     * such a stage at the same time.
+     */
+    struct StageSpec {
+      ChunkStatus stage;
+      const char* name;
+      int neighbour_radius;
+      ChunkStatus neighbour_status;
+      bool exclusive;
+    };
+
+    constexpr StageSpec kStageSpecs[kChunkStatusCount] = {
+      { ChunkStatus::kEmpty,    "empty",    0, ChunkStatus::kEmpty,    false },
+      { ChunkStatus::kTerrain,  "terrain",  0, ChunkStatus::kEmpty,    false },
+      { ChunkStatus::kFeatures, "features", 1, ChunkStatus::kTerrain,  true },
+      { ChunkStatus::kLight,    "light",    1, ChunkStatus::kFeatures, false },
+      { ChunkStatus::kMeshed,   "meshed",   1, ChunkStatus::kLight,    false },
+      { ChunkStatus::kUploaded, "uploaded", 0, ChunkStatus::kEmpty,    false },
+    };
+
+    constexpr const StageSpec& GetStageSpec(ChunkStatus stage) { return kStageSpecs[static_cast<size_t>(stage)]; }
+
+    constexpr ChunkStatus NextStatus(ChunkStatus status)
+    {
+      return status == ChunkStatus::kUploaded ? status : static_cast<ChunkStatus>(static_cast<uint8_t>(status) + 1);
+    }
+
+    /**
+     * @brief How far beyond the mesh radius (in chunks) chunks must reach status so that
+     * every chunk inside the mesh radius can be meshed. A neighbour one chunk away
+     * diagonally is at most sqrt(2) chunks farther from the camera.
+     */
+    constexpr float StageMargin(ChunkStatus status)
+    {
+      float margin = 0.0f;
+      for (size_t stage = static_cast<size_t>(status) + 1; stage <= static_cast<size_t>(ChunkStatus::kMeshed); ++stage)
+        margin += static_cast<float>(kStageSpecs[stage].neighbour_radius) * 1.4143f;
+      return margin;
+    }
+
+    /**
+     * @brief Wall-clock time spent in one stage, summed over all chunks.
+     */
+    struct StageTiming {
+      uint64_t count = 0;
+      double total_seconds = 0.0;
+      double max_seconds = 0.0;
+
+      void Add(double seconds)
+      {
+        ++count;
+        total_seconds += seconds;
+        max_seconds = std::max(max_seconds, seconds);
+      }
+
+      double AverageSeconds() const { return count ? total_seconds / static_cast<double>(count) : 0.0; }
+    };
+
+  }  // namespace world
+
+}  // namespace heh
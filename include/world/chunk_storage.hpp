@@ -0,0 +1,132 @@
+#pragma once
+
+#include "world/chunk.hpp"
+#include "world/chunk_map.hpp"
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace heh {
+
+  namespace world {
+
+    /**
+     * @brief The highest block of every column of a chunk, seen from above.
+     */
+    struct ChunkSurface {
+      int32_t x = 0;
+      int32_t z = 0;
+      std::array<BlockId, kChunkWidth * kChunkDepth> top{};     ///< Indexed by local x * kChunkDepth + z; kAirBlock for an empty column.
+      std::array<uint8_t, kChunkWidth * kChunkDepth> height{};  ///< y of top.
+    };
+
+    static_assert(kChunkHeight <= 256, "ChunkSurface heights are bytes");
+
+    /**
+     * @brief Saves chunk blocks to region files in a directory and loads them back.
+     *
+     * A region file holds kRegionWidth x kRegionWidth chunk columns: a header with the
+     * offset and size of every column's record side by side, then the records. A record
+     * stores the chunk status and its blocks run-length encoded along blocks_data, where
+     * terrain leaves long runs of air and stone. Saving a chunk again appends a new record and
+     * repoints the header. The old bytes stay behind until they outweigh the live ones
+     * (and kMinCompactBytes); the region is then rewritten with only the live records
+     * into a new file that replaces it. Records are written before the header entry
+     * that points to them, and files are replaced whole, so a run that is killed half
+     * way leaves every saved chunk readable: a column's offset and size change together,
+     * in one write. Files of the older layout, with all the offsets before all the
+     * sizes, are read as they are and rewritten in this one on their first save.
+     *
+     * Light and meshes are not stored; a loaded chunk goes back through those stages.
+     * All functions may be called from any thread. Encoding runs in the calling thread,
+     * file access is serialized.
+     */
+    class ChunkStorage {
+    public:
+      static constexpr int32_t kRegionWidth = 32;
+      static constexpr uint32_t kMinCompactBytes = 1 << 20;  ///< Dead bytes a region may keep whatever its size.
+
+      /**
+       * @param directory Created if missing.
+       * @throws std::runtime_error if the directory cannot be created.
+       */
+      explicit ChunkStorage(const std::string& directory);
+
+      ChunkStorage(const ChunkStorage&) = delete;
+      ChunkStorage& operator=(const ChunkStorage&) = delete;
+
+      /**
+       * @brief Whether the chunk at (x, z) has been saved.
+       */
+      bool Contains(int32_t x, int32_t z);
+
+      /**
+       * @brief Fills chunk.blocks_data and chunk.status for the chunk at (chunk.x, chunk.z).
+       * @return false if it was never saved or its record is damaged; chunk is unchanged.
+       */
+      bool Load(Chunk& chunk);
+
+      /**
+       * @brief Saves the blocks and status of chunk, replacing an earlier record.
+       * @throws std::runtime_error if the region file cannot be written.
+       */
+      void Save(const Chunk& chunk);
+
+      /**
+       * @brief Coordinates of the regions with a file in the directory, packed with
+       * PackChunkKey, in key order.
+       */
+      std::vector<ChunkKey> ListRegions() const;
+
+      /**
+       * @brief A hash of the region's header, which changes whenever one of its chunks is
+       * saved. 0 if none of them was.
+       */
+      uint64_t GetRegionVersion(int32_t region_x, int32_t region_z);
+
+      /**
+       * @brief Reads the surface of every saved chunk of a region, with one read of its
+       * file and without expanding the blocks. Damaged records are skipped.
+       */
+      std::vector<ChunkSurface> LoadRegionSurfaces(int32_t region_x, int32_t region_z);
+
+      const std::string& GetDirectory() const { return directory_; }
+
+      /**
+       * @brief Bytes written by Save since construction, headers excluded.
+       */
+      uint64_t GetBytesWritten() const { return bytes_written_.load(std::memory_order_relaxed); }
+
+    private:
+      struct Region {
+        std::array<uint32_t, kRegionWidth * kRegionWidth> offsets{};  ///< 0 if the column was never saved.
+        std::array<uint32_t, kRegionWidth * kRegionWidth> sizes{};
+        uint32_t end = 0;                                              ///< File size, where the next record goes.
+        uint32_t dead = 0;                                             ///< Bytes of replaced records.
+        uint64_t generation = 0;                                       ///< Times the file was replaced.
+        bool legacy = false;                                           ///< Offsets before sizes in the header.
+      };
+
+      Region& GetRegion(int32_t region_x, int32_t region_z);
+      /**
+       * @return false if the file could not be replaced; it is then left as it was.
+       */
+      bool Compact(int32_t region_x, int32_t region_z, Region& region);
+      std::string RegionPath(int32_t region_x, int32_t region_z) const;
+
+      std::string directory_;
+      std::mutex mutex_;
+      std::unordered_map<ChunkKey, std::unique_ptr<Region>> regions_;  ///< Headers of the regions opened so far.
+      std::atomic<uint64_t> bytes_written_{ 0 };
+    };
+
+  }  // namespace world
+
+}  // namespace heh
@@ -0,0 +1,348 @@
+#pragma once
+
+#include "world/block_edit.hpp"
+#include "world/chunk_pipeline.hpp"
+#include "world/chunk_storage.hpp"
+#include "world/terrain_generator.hpp"
+#include "world/world.hpp"
+#include "utils/job_system.hpp"
+#include "utils/toml_extended.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace heh {
+
+  namespace world {
+
+    /**
+     * @brief Estimates the horizontal camera velocity from its recent positions.
+     */
+    class VelocityEstimator {
+    public:
+      /**
+       * @param window Seconds of history averaged into the estimate.
+       */
+      explicit VelocityEstimator(double window = 0.5) : window_(window) {}
+
+      void AddSample(double time, const glm::vec3& pos);
+
+      /**
+       * @brief Velocity in blocks per second over the sample window, zero until two samples
+       * far enough apart in time exist.
+       */
+      glm::vec3 GetVelocity() const;
+
+      void Reset() { samples_.clear(); }
+
+    private:
+      struct Sample {
+        double time;
+        glm::vec3 pos;
+      };
+
+      double window_;
+      std::deque<Sample> samples_;
+    };
+
+    /**
+     * @brief Level of detail of a chunk mesh distance chunks from the camera: full within
+     * lod_distance, then one level coarser at each doubling of it, up to kMaxLod. Each
+     * ring then holds about as many faces as the one inside it, so the total grows with
+     * the number of rings rather than the area. 0 if lod_distance is not positive.
+     */
+    uint32_t LodForDistance(float distance, int lod_distance);
+
+    /**
+     * @brief Streaming counters, cumulative since construction.
+     */
+    struct StreamerStats {
+      uint64_t entered_view = 0;        ///< Chunks that came within render_distance after the first Update.
+      uint64_t ready_on_entry = 0;      ///< ... of which were already generated at that moment.
+      uint64_t prefetch_requested = 0;  ///< Chunks queued by the predictor.
+      uint64_t prefetch_used = 0;       ///< Prefetched chunks that later entered the load radius.
+      uint64_t prefetch_cancelled = 0;  ///< Prefetched chunks dropped because the path changed.
+      uint64_t loaded = 0;              ///< Chunks read from the storage instead of generated.
+      uint64_t saved = 0;               ///< Chunks queued for saving.
+      uint64_t lod_changed = 0;         ///< Meshes rebuilt because their chunk moved to another level of detail.
+    };
+
+    /**
+     * @brief Keeps the chunks around the camera generated, meshed and loaded.
+     *
+     * Chunks go through the stages of ChunkStatus one at a time. A chunk is advanced to
+     * the next stage once the chunks around it have reached the status the stage needs
+     * (see kStageSpecs), so each stage runs exactly once per chunk and independent chunks
+     * run in parallel. Every Update() the streamer:
+     *  - applies the stages finished by the workers,
+     *  - queues terrain for missing chunks within the terrain radius, nearest and
+     *    in-front-of-the-camera first,
+     *  - advances loaded chunks whose neighbours are ready, up to the status their distance
+     *    calls for: meshed within render_distance, and the earlier stages in rings around
+     *    it wide enough for the border chunks' neighbours (StageMargin),
+     *  - unloads chunks farther than the terrain radius + unload_margin,
+     *  - when the camera changes chunk, sends the meshes whose level of detail no longer
+     *    matches their distance (see LodForDistance) back to meshing,
+     *  - prefetches terrain the camera will reach within prefetch_lookahead seconds at its
+     *    current velocity, and cancels those that fall off the predicted path.
+     *
+     * The margin is the hysteresis: a chunk that was just unloaded is not requested again
+     * until the camera moves unload_margin chunks back towards it.
+     *
+     * With a ChunkStorage, the terrain job loads a chunk that was saved before instead of
+     * generating it; it comes back with its features and goes on from there. Chunks that
+     * were generated or changed are saved when they are unloaded and on SaveChanged().
+     *
+     * Stages run as jobs on the shared JobSystem. Everything else, including the World
+     * writes and the status changes, happens on the thread that calls Update().
+     */
+    class ChunkStreamer {
+    public:
+      struct MeshUpload {
+        int32_t x;
+        int32_t z;
+        std::unique_ptr<ChunkRenderData> data;
+      };
+
+      /**
+       * @param generator Fills new chunks; must outlive the streamer.
+       * @param jobs Runs the stages; must outlive the streamer.
+       */
+      ChunkStreamer(World& world, const TerrainGenerator& generator, JobSystem& jobs, const config::WorldConfig& settings);
+      ~ChunkStreamer();
+
+      ChunkStreamer(const ChunkStreamer&) = delete;
+      ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+      /**
+       * @brief Loads and saves chunks through storage from now on; nullptr, the default,
+       * turns persistence off. Set it before the first Update(). Must outlive the streamer.
+       */
+      void SetStorage(ChunkStorage* storage) { storage_ = storage; }
+
+      /**
+       * @brief Points, in blocks, whose surroundings are kept loaded like the camera's,
+       * such as the players of a server. Prefetching and the entry counters follow the
+       * camera alone.
+       */
+      void SetAnchors(const std::vector<glm::vec3>& positions);
+
+      /**
+       * @brief Whether chunks are meshed. Without meshes, as on a server, chunks within
+       * render_distance stop once they have their light, which is what ticks and edits need.
+       */
+      void SetMeshing(bool enabled);
+
+      /**
+       * @brief Advances streaming around the camera. Call once per frame.
+       * @param time Current time in seconds, used to estimate the camera velocity.
+       * @throws std::runtime_error if a save queued earlier failed.
+       */
+      void Update(const glm::vec3& camera_pos, const glm::vec3& camera_front, double time);
+
+      /**
+       * @brief Takes up to max_count finished meshes, nearest first. Bounding the count
+       * bounds the upload cost of a frame.
+       */
+      std::vector<MeshUpload> PopReadyMeshes(size_t max_count);
+
+      /**
+       * @brief Takes the keys of the chunks unloaded since the last call, so the renderer
+       * can free their meshes. Call before PopReadyMeshes.
+       */
+      std::vector<ChunkKey> PopUnloaded();
+
+      /**
+       * @brief Changes a block, updates the light around it and queues the meshes that
+       * show either for rebuilding.
+       * @return false if its chunk is not loaded, has no features yet, or a stage job is
+       * using it right now (the caller may retry next frame).
+       */
+      bool SetBlock(const glm::ivec3& pos, BlockId id);
+
+      /**
+       * @brief Runs edit, which may write any block inside box (e.g. with FillBox), then
+       * sends the lit chunks within one chunk of box back through the light stage, and
+       * the meshes one chunk further out, whose border faces show that light, to
+       * meshing. Each chunk is relit and remeshed once, however many blocks changed.
+       * @return false, without calling edit, if a stage job is using one of those chunks.
+       */
+      bool EditBlocks(const BlockBox& box, const std::function<void()>& edit);
+
+      /**
+       * @brief Chunks that may be edited in place right now: they and their 8 neighbours
+       * have their light and no stage job is using any of them. Valid until the next
+       * Update().
+       */
+      std::vector<ChunkKey> GetEditableChunks() const;
+
+      /**
+       * @brief Queues the meshes of chunks whose blocks or light were changed outside the
+       * streamer for rebuilding. Keys of chunks without a mesh are ignored.
+       */
+      void RebuildMeshes(const std::vector<ChunkKey>& keys);
+
+      /**
+       * @brief Queues the meshes of chunks to be built again although nothing changed,
+       * such as ones the renderer dropped. Keys of chunks without a mesh are ignored.
+       */
+      void RemeshChunks(const std::vector<ChunkKey>& keys);
+
+      /**
+       * @brief Queues saves of the chunks that changed since they were loaded or last
+       * saved, skipping those a stage job is using. Their blocks are copied right away;
+       * the writes run as jobs.
+       * @return Number of chunks queued.
+       */
+      size_t SaveChanged();
+
+      /**
+       * @brief Blocks until every queued save is written.
+       * @throws std::runtime_error if one of them failed.
+       */
+      void WaitForSaves();
+
+      /**
+       * @brief Number of queued saves that have not been written yet.
+       */
+      size_t GetSavesInFlight() const { return saves_in_flight_.load(std::memory_order_relaxed); }
+
+      void SetRenderDistance(int render_distance);
+      int GetRenderDistance() const { return render_distance_; }
+
+      /**
+       * @brief Number of stage jobs that have not completed yet.
+       */
+      size_t GetJobsInFlight() const { return generating_ + running_; }
+
+      size_t GetLoadedCount() const { return world_.GetChunkCount(); }
+
+      const StreamerStats& GetStats() const { return stats_; }
+      const std::array<StageTiming, kChunkStatusCount>& GetStageTimings() const { return stage_timings_; }
+
+      /**
+       * @brief Number of tracked chunks at each status.
+       */
+      std::array<size_t, kChunkStatusCount> CountByStatus() const;
+      glm::vec3 GetVelocity() const { return velocity_.GetVelocity(); }
+
+    private:
+      struct Entry {
+        Chunk* chunk = nullptr;                     ///< In the World once its terrain is done.
+        ChunkStatus running = ChunkStatus::kEmpty;  ///< Stage queued or running on it, kEmpty if none.
+        int pins = 0;           ///< Stage jobs reading this chunk; a pinned chunk is never unloaded.
+        bool prefetch = false;  ///< Requested by the predictor, outside the load radius so far.
+        bool changed = false;   ///< Blocks differ from the stored copy, or there is none.
+        uint8_t lod = 0;        ///< Level of detail of the mesh built or being built.
+        std::shared_ptr<std::atomic<bool>> cancel;  ///< Set to skip a queued prefetch job.
+
+        ChunkStatus Status() const { return chunk ? chunk->status : ChunkStatus::kEmpty; }
+      };
+
+      struct StageResult {
+        int32_t x;
+        int32_t z;
+        ChunkStatus stage;
+        std::unique_ptr<Chunk> chunk;           ///< Terrain: the new chunk, nullptr if the job was cancelled.
+        std::unique_ptr<ChunkRenderData> mesh;  ///< Meshing: the new mesh.
+        bool prefetch = false;
+        bool loaded = false;                    ///< Terrain: read from the storage.
+        double seconds = 0.0;
+      };
+
+      void DrainCompletedJobs();
+      void UnloadFarChunks();
+      void UpdateLods();
+      void QueueGeneration();
+      void AdvanceStages();
+      void UpdatePrefetchTargets();
+      void QueuePrefetch();
+      void CountEnteringChunks(int32_t old_x, int32_t old_z);
+      float Priority(int32_t x, int32_t z) const;
+      bool InAnyRadius(int32_t x, int32_t z, float radius) const;
+      float TerrainRadius() const { return static_cast<float>(render_distance_) + StageMargin(ChunkStatus::kTerrain); }
+      float NearestDistance(int32_t x, int32_t z) const;
+      ChunkStatus TargetStatus(int32_t x, int32_t z) const;
+      bool NeighboursReady(int32_t x, int32_t z, const StageSpec& spec) const;
+      bool NeighbourRunning(int32_t x, int32_t z, const StageSpec& spec) const;
+      void PinArea(int32_t x, int32_t z, int radius, int delta);
+      bool SaveChunk(Entry& entry);
+      void WritePendingSaves(ChunkKey key);
+      bool LoadPendingSave(Chunk& chunk);
+      void ThrowSaveError();
+      void SubmitGeneration(ChunkKey key, std::shared_ptr<std::atomic<bool>> cancel);
+      void SubmitStage(ChunkKey key, ChunkStatus stage);
+
+      template <typename Function>
+      void Submit(Function&& job);
+
+      World& world_;
+      const TerrainGenerator& generator_;
+      ChunkStorage* storage_ = nullptr;
+      bool meshing_ = true;
+      int render_distance_;
+      int unload_margin_;
+      int lod_distance_;
+      float prefetch_lookahead_;
+      size_t prefetch_queue_;
+
+      glm::vec2 camera_chunk_pos_{ 0.0f };  ///< Camera position in chunk units.
+      glm::vec2 camera_dir_{ 0.0f, -1.0f }; ///< Horizontal camera direction.
+      int32_t center_x_ = 0;
+      int32_t center_z_ = 0;
+      std::vector<glm::vec2> anchors_;      ///< Extra anchors in chunk units, see SetAnchors.
+      bool first_update_ = true;
+      bool scan_needed_ = true;             ///< False once nothing is missing around the current center.
+      bool advance_needed_ = true;          ///< False once no chunk can advance until something changes.
+
+      VelocityEstimator velocity_;
+      double last_prefetch_time_ = -1.0;
+      std::vector<std::pair<float, ChunkKey>> prefetch_targets_;  ///< (seconds until needed, chunk), soonest first.
+      size_t prefetching_ = 0;              ///< Prefetch generation jobs in flight.
+
+      std::unordered_map<ChunkKey, Entry> entries_;  ///< Main thread only.
+      size_t generating_ = 0;               ///< Terrain jobs in flight.
+      size_t running_ = 0;                  ///< Other stage jobs in flight.
+      size_t max_jobs_in_flight_;
+      size_t max_prefetch_in_flight_;
+
+      std::vector<MeshUpload> ready_meshes_;
+      std::vector<ChunkKey> unloaded_;
+      StreamerStats stats_;
+      std::array<StageTiming, kChunkStatusCount> stage_timings_;
+
+      // Results handed back by the workers.
+      std::mutex results_mutex_;
+      std::vector<StageResult> results_;
+
+      // Saves run apart from the stages: they must finish even while the streamer stops.
+      struct PendingSave {
+        std::shared_ptr<const Chunk> latest;   ///< Not yet written; a newer save replaces it.
+        std::shared_ptr<const Chunk> writing;  ///< Being written by the key's save job.
+      };
+      std::mutex pending_saves_mutex_;
+      std::unordered_map<ChunkKey, PendingSave> pending_saves_;  ///< Keys with a save job, one each.
+      JobCounter saves_counter_;
+      std::atomic<size_t> saves_in_flight_{ 0 };
+      std::string save_error_;               ///< First failed save, guarded by results_mutex_.
+
+      JobSystem& jobs_;
+      JobCounter jobs_counter_;              ///< Every job this streamer submitted and that has not finished.
+      std::atomic<bool> stopping_{ false };  ///< Set by the destructor so queued jobs return without working.
+    };
+
+  }  // namespace world
+
+}  // namespace heh
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "world/world.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <vector>
+
+namespace heh {
+
+  namespace world {
+
+    /**
+     * @brief Fills the light_data of the center chunk of area with sky and block light.
+     *
+     * Sky light is 15 above the highest opaque block of each column and keeps that level
+     * going straight down through transparent blocks; every other step, and every step
+     * of block light away from an emitting block, costs one level. Both are flooded
+     * breadth-first over the 3x3 chunks of area. Light travels at most 15 blocks, so the
+     * result for the center chunk is the same as a flood over the whole world, and each
+     * chunk only writes its own light. Missing neighbours count as open air.
+     */
+    void ComputeLight(Chunk& chunk, const ChunkNeighbourhood& area);
+
+    /**
+     * @brief Updates the light around a block that changed from old_id to the block the
+     * world holds at pos now, without recomputing whole chunks.
+     *
+     * Light that came through the old block is removed breadth-first, then refilled from
+     * the light left around it and from the new block. Only the chunks within one chunk
+     * of pos are written; they must all have their light and nothing may read them
+     * meanwhile. Chunks without light stop the update like opaque blocks.
+     *
+     * @param dirty Receives the chunks whose meshes show a light value that changed.
+     */
+    void UpdateLight(World& world, const glm::ivec3& pos, BlockId old_id, std::vector<ChunkKey>& dirty);
+
+  }  // namespace world
+
+}  // namespace heh
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "world/chunk_storage.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace heh {
+
+  class JobSystem;
+
+  namespace world {
+
+    /**
+     * @brief Counters of one MapRenderer::Render call.
+     */
+    struct MapStats {
+      size_t regions = 0;   ///< Regions in the storage.
+      size_t rendered = 0;  ///< Tiles written.
+      size_t chunks = 0;    ///< Chunks drawn into the written tiles.
+      double seconds = 0.0;
+    };
+
+    /**
+     * @brief Renders a top-down map of a saved world as PNG tiles, one per storage region
+     * (ChunkStorage::kRegionWidth chunks square, a pixel per block column), named like the
+     * region files: r.<x>.<z>.png.
+     *
+     * A pixel takes the average colour of the top texture of the column's highest block,
+     * lighter where the column is higher than the one north of it and darker where it is
+     * lower, so slopes read as relief. Columns with no saved chunk stay transparent.
+     *
+     * Tiles render in parallel as jobs. The region versions of the last run are kept in
+     * tiles.txt in the output directory, and only tiles whose region changed since then
+     * are rendered again.
+     */
+    class MapRenderer {
+    public:
+      static constexpr int32_t kTileSize = ChunkStorage::kRegionWidth * static_cast<int32_t>(kChunkWidth);
+
+      /**
+       * @param storage The world to draw; must outlive the renderer.
+       * @param jobs Runs the tiles in parallel; must outlive the renderer.
+       */
+      MapRenderer(ChunkStorage& storage, JobSystem& jobs);
+
+      MapRenderer(const MapRenderer&) = delete;
+      MapRenderer& operator=(const MapRenderer&) = delete;
+
+      /**
+       * @brief Takes block colours from the average of their top textures in
+       * texture_directory (see config::BlockConfig::top). Blocks whose texture is missing
+       * are grey.
+       */
+      void LoadColours(const std::string& texture_directory);
+
+      /**
+       * @brief Writes the tiles of the regions that changed since the last run into
+       * output_directory, or of every region with force. Without LoadColours every
+       * block is grey.
+       * @throws std::runtime_error if the directory or a tile cannot be written.
+       */
+      MapStats Render(const std::string& output_directory, bool force = false);
+
+    private:
+      struct Colour {
+        uint8_t r, g, b;
+      };
+
+      /**
+       * @return Chunks drawn, or -1 if the tile could not be written.
+       */
+      long RenderTile(int32_t region_x, int32_t region_z, const std::string& path) const;
+
+      ChunkStorage& storage_;
+      JobSystem& jobs_;
+      std::vector<Colour> colours_;  ///< Indexed by block id.
+    };
+
+  }  // namespace world
+
+}  // namespace heh
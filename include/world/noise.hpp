@@ -0,0 +1,194 @@
+#pragma once
+
+// std
+#include <cstdint>
+
+namespace heh {
+
+  namespace world {
+
+    /**
+     * Number of points evaluated per batched noise call. The batch loops are written
+     * branch-free over this many lanes so the compiler turns them into 8- or 16-wide SIMD.
+     */
+    constexpr int kNoiseLanes = 16;
+
+    namespace noise_detail {
+
+      inline int32_t FastFloor(float v)
+      {
+        const int32_t i = static_cast<int32_t>(v);
+        return i - (v < static_cast<float>(i) ? 1 : 0);
+      }
+
+      inline uint32_t Hash(int32_t i, int32_t j, uint32_t seed)
+      {
+        uint32_t h = seed ^ (static_cast<uint32_t>(i) * 0x27d4eb2du);
+        h ^= static_cast<uint32_t>(j) * 0x165667b1u;
+        h = (h ^ (h >> 15)) * 0x85ebca6bu;
+        return h ^ (h >> 13);
+      }
+
+      inline uint32_t Hash(int32_t i, int32_t j, int32_t k, uint32_t seed)
+      {
+        return Hash(i, j, seed ^ (static_cast<uint32_t>(k) * 0x9e3779b1u));
+      }
+
+      inline float Grad(uint32_t h, float x, float y)
+      {
+        // Eight directions, as in Gustavson's simplexnoise1234.
+        const float u = (h & 4u) ? y : x;
+        const float v = (h & 4u) ? x : y;
+        return ((h & 1u) ? -u : u) + ((h & 2u) ? -2.0f * v : 2.0f * v);
+      }
+
+      inline float Grad(uint32_t h, float x, float y, float z)
+      {
+        // The 12 cube edge directions (and 4 repeats), as in Perlin's improved noise.
+        h &= 15u;
+        const float u = h < 8u ? x : y;
+        const float v = h < 4u ? y : (h == 12u || h == 14u) ? x : z;
+        return ((h & 1u) ? -u : u) + ((h & 2u) ? -v : v);
+      }
+
+    }  // namespace noise_detail
+
+    /**
+     * @brief 2D simplex noise in roughly [-1, 1]. A pure function of its arguments, so the
+     * same point gives the same bits on any thread and in the batched variants.
+     */
+    inline float Simplex2(float x, float y, uint32_t seed)
+    {
+      using namespace noise_detail;
+      constexpr float kF2 = 0.366025403f;  // (sqrt(3) - 1) / 2
+      constexpr float kG2 = 0.211324865f;  // (3 - sqrt(3)) / 6
+
+      const float s = (x + y) * kF2;
+      const int32_t i = FastFloor(x + s);
+      const int32_t j = FastFloor(y + s);
+
+      const float t = static_cast<float>(i + j) * kG2;
+      const float x0 = x - (static_cast<float>(i) - t);
+      const float y0 = y - (static_cast<float>(j) - t);
+
+      // Lower or upper triangle of the skewed cell.
+      const int32_t i1 = x0 > y0 ? 1 : 0;
+      const int32_t j1 = 1 - i1;
+
+      const float x1 = x0 - static_cast<float>(i1) + kG2;
+      const float y1 = y0 - static_cast<float>(j1) + kG2;
+      const float x2 = x0 - 1.0f + 2.0f * kG2;
+      const float y2 = y0 - 1.0f + 2.0f * kG2;
+
+      float t0 = 0.5f - x0 * x0 - y0 * y0;
+      float t1 = 0.5f - x1 * x1 - y1 * y1;
+      float t2 = 0.5f - x2 * x2 - y2 * y2;
+      t0 = t0 < 0.0f ? 0.0f : t0;
+      t1 = t1 < 0.0f ? 0.0f : t1;
+      t2 = t2 < 0.0f ? 0.0f : t2;
+      t0 *= t0;
+      t1 *= t1;
+      t2 *= t2;
+
+      const float n0 = t0 * t0 * Grad(Hash(i, j, seed), x0, y0);
+      const float n1 = t1 * t1 * Grad(Hash(i + i1, j + j1, seed), x1, y1);
+      const float n2 = t2 * t2 * Grad(Hash(i + 1, j + 1, seed), x2, y2);
+      return 40.0f * (n0 + n1 + n2);
+    }
+
+    /**
+     * @brief 3D simplex noise in roughly [-1, 1]. The simplex corner order is picked with
+     * comparisons instead of branches, so batched loops over it still vectorize.
+     */
+    inline float Simplex3(float x, float y, float z, uint32_t seed)
+    {
+      using namespace noise_detail;
+      constexpr float kF3 = 1.0f / 3.0f;
+      constexpr float kG3 = 1.0f / 6.0f;
+
+      const float s = (x + y + z) * kF3;
+      const int32_t i = FastFloor(x + s);
+      const int32_t j = FastFloor(y + s);
+      const int32_t k = FastFloor(z + s);
+
+      const float t = static_cast<float>(i + j + k) * kG3;
+      const float x0 = x - (static_cast<float>(i) - t);
+      const float y0 = y - (static_cast<float>(j) - t);
+      const float z0 = z - (static_cast<float>(k) - t);
+
+      // Second corner steps along the largest offset, third along the two largest.
+      const int32_t x_ge_y = x0 >= y0 ? 1 : 0;
+      const int32_t y_ge_z = y0 >= z0 ? 1 : 0;
+      const int32_t x_ge_z = x0 >= z0 ? 1 : 0;
+      const int32_t i1 = x_ge_y & x_ge_z;
+      const int32_t j1 = (1 - x_ge_y) & y_ge_z;
+      const int32_t k1 = (1 - x_ge_z) & (1 - y_ge_z);
+      const int32_t i2 = x_ge_y | x_ge_z;
+      const int32_t j2 = (1 - x_ge_y) | y_ge_z;
+      const int32_t k2 = (1 - x_ge_z) | (1 - y_ge_z);
+
+      const float x1 = x0 - static_cast<float>(i1) + kG3;
+      const float y1 = y0 - static_cast<float>(j1) + kG3;
+      const float z1 = z0 - static_cast<float>(k1) + kG3;
+      const float x2 = x0 - static_cast<float>(i2) + 2.0f * kG3;
+      const float y2 = y0 - static_cast<float>(j2) + 2.0f * kG3;
+      const float z2 = z0 - static_cast<float>(k2) + 2.0f * kG3;
+      const float x3 = x0 - 1.0f + 3.0f * kG3;
+      const float y3 = y0 - 1.0f + 3.0f * kG3;
+      const float z3 = z0 - 1.0f + 3.0f * kG3;
+
+      float t0 = 0.6f - x0 * x0 - y0 * y0 - z0 * z0;
+      float t1 = 0.6f - x1 * x1 - y1 * y1 - z1 * z1;
+      float t2 = 0.6f - x2 * x2 - y2 * y2 - z2 * z2;
+      float t3 = 0.6f - x3 * x3 - y3 * y3 - z3 * z3;
+      t0 = t0 < 0.0f ? 0.0f : t0;
+      t1 = t1 < 0.0f ? 0.0f : t1;
+      t2 = t2 < 0.0f ? 0.0f : t2;
+      t3 = t3 < 0.0f ? 0.0f : t3;
+      t0 *= t0;
+      t1 *= t1;
+      t2 *= t2;
+      t3 *= t3;
+
+      const float n0 = t0 * t0 * Grad(Hash(i, j, k, seed), x0, y0, z0);
+      const float n1 = t1 * t1 * Grad(Hash(i + i1, j + j1, k + k1, seed), x1, y1, z1);
+      const float n2 = t2 * t2 * Grad(Hash(i + i2, j + j2, k + k2, seed), x2, y2, z2);
+      const float n3 = t3 * t3 * Grad(Hash(i + 1, j + 1, k + 1, seed), x3, y3, z3);
+      return 32.0f * (n0 + n1 + n2 + n3);
+    }
+
+    /**
+     * @brief Fractal (fBm) settings shared by the noise stages of the generator.
+     */
+    struct FractalSettings {
+      int octaves = 5;
+      float frequency = 1.0f / 256.0f;  ///< Frequency of the first octave, in 1 / blocks.
+      float lacunarity = 2.0f;          ///< Frequency multiplier per octave.
+      float gain = 0.5f;                ///< Amplitude multiplier per octave.
+    };
+
+    /**
+     * @brief Fractal 2D simplex noise for kNoiseLanes points.
+     * Each octave uses its own seed so features do not line up across octaves.
+     * @return Values in roughly [-1, 1] (normalized by the summed amplitudes).
+     */
+    void Fractal2(const float* x, const float* y, uint32_t seed, const FractalSettings& settings, float* out);
+
+    /**
+     * @brief Scalar Fractal2, bit-identical to the batched one.
+     */
+    float Fractal2(float x, float y, uint32_t seed, const FractalSettings& settings);
+
+    /**
+     * @brief Fractal 3D simplex noise for kNoiseLanes points, see Fractal2.
+     */
+    void Fractal3(const float* x, const float* y, const float* z, uint32_t seed, const FractalSettings& settings, float* out);
+
+    /**
+     * @brief Scalar Fractal3, bit-identical to the batched one.
+     */
+    float Fractal3(float x, float y, float z, uint32_t seed, const FractalSettings& settings);
+
+  }  // namespace world
+
+}  // namespace heh
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "world/world.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+
+namespace heh {
+
+  class JobSystem;
+
+  namespace world {
+
+    constexpr float kGravity = 32.0f;            ///< Blocks per second squared.
+    constexpr float kTerminalVelocity = 78.4f;   ///< Blocks per second.
+
+    struct Aabb {
+      glm::vec3 min;
+      glm::vec3 max;
+    };
+
+    /**
+     * @brief An axis-aligned box that moves through the world and stops at solid blocks.
+     */
+    struct Body {
+      glm::vec3 position{ 0.0f };                    ///< Centre of the bottom face.
+      glm::vec3 velocity{ 0.0f };                    ///< Blocks per second.
+      glm::vec3 half_extents{ 0.3f, 0.9f, 0.3f };
+      bool gravity = true;
+      bool on_ground = false;                        ///< Stood on a block after the last step.
+
+      Aabb GetBounds() const
+      {
+        return { position - glm::vec3(half_extents.x, 0.0f, half_extents.z),
+                 position + glm::vec3(half_extents.x, 2.0f * half_extents.y, half_extents.z) };
+      }
+    };
+
+    /**
+     * @brief Moves box by motion until it touches a solid block, one axis at a time (y,
+     * then x, then z), so it slides along walls and floors.
+     *
+     * Only the blocks inside the volume swept by the box are tested, gathered once per
+     * call. Blocks of chunks that are not loaded, or whose features are still being
+     * placed, count as solid. Blocks the box already overlaps do not stop it, so a box
+     * stuck inside terrain can still move out.
+     *
+     * @return The motion actually applied; a component smaller than requested was blocked.
+     */
+    glm::vec3 SweepAabb(BlockAccessor& blocks, const Aabb& box, const glm::vec3& motion);
+
+    /**
+     * @brief Advances a body by dt seconds: gravity, then a sweep of velocity * dt.
+     * Blocked velocity components are zeroed. A body whose own chunk is not loaded waits.
+     */
+    void StepBody(BlockAccessor& blocks, Body& body, float dt);
+
+    /**
+     * @brief Steps count bodies, split into batches that run in parallel with a job
+     * system. Bodies do not collide with each other. Call it while no chunk is being
+     * written, e.g. between streamer updates.
+     */
+    void StepBodies(const World& world, Body* bodies, size_t count, float dt, JobSystem* jobs = nullptr);
+
+  }  // namespace world
+
+}  // namespace heh
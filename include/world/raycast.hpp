@@ -0,0 +1,53 @@
+#pragma once
+
+#include "world/world.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+
+namespace heh {
+
+  class JobSystem;
+
+  namespace world {
+
+    struct Ray {
+      glm::vec3 origin;
+      glm::vec3 direction;  ///< Need not be normalized; distances are in units of its length.
+    };
+
+    struct RaycastHit {
+      bool hit = false;
+      BlockId id = kAirBlock;
+      glm::ivec3 block{ 0 };   ///< World position of the hit block.
+      glm::ivec3 normal{ 0 };  ///< Outward normal of the face the ray entered through, zero if it started inside.
+      float distance = 0.0f;   ///< Along the ray, to the entry point.
+    };
+
+    /**
+     * @brief Walks the blocks along a ray (Amanatides & Woo) and stops at the first
+     * non-air block.
+     *
+     * Blocks span [p - 0.5, p + 0.5] around their integer position, as in the mesher.
+     * Each step costs a few compares and a block load, so a full reach of a couple of
+     * hundred blocks stays in the microseconds. Chunks that are not loaded, or whose
+     * features are still being placed, read as air.
+     *
+     * @return true on a hit within max_distance.
+     */
+    bool Raycast(const World& world, const Ray& ray, float max_distance, RaycastHit& hit);
+
+    /**
+     * @brief Casts count rays, hits[i] for rays[i]. With a job system the rays are split
+     * into batches that run in parallel; call it while no chunk is being written, e.g.
+     * between streamer updates.
+     */
+    void RaycastBatch(const World& world, const Ray* rays, size_t count, float max_distance, RaycastHit* hits,
+                      JobSystem* jobs = nullptr);
+
+  }  // namespace world
+
+}  // namespace heh
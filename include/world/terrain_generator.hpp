@@ -0,0 +1,92 @@
+#pragma once
+
+#include "world/chunk.hpp"
+#include "world/noise.hpp"
+
+// std
+#include <cstdint>
+
+namespace heh {
+
+  namespace world {
+
+    /**
+     * @brief Seeded heightmap terrain.
+     *
+     * Column heights come from fractal simplex noise evaluated kNoiseLanes columns at a
+     * time. Columns are grass on top of stone, over a one to three block cobblestone floor.
+     *
+     * Caves are then carved where a 3D density field is positive. The field is sampled on a
+     * coarse lattice of kCaveCellWidth x kCaveCellHeight x kCaveCellWidth cells, one batch per
+     * lattice column along Y, and trilinearly interpolated in between. Cells whose eight
+     * corners agree are entirely solid or entirely carved and skip the per-block work.
+     *
+     * Trees and flowers are placed by a separate stage (PlaceFeatures) once the neighbours'
+     * terrain exists, since trees reach across chunk borders.
+     *
+     * Generation is a pure function of the seed and the chunk position: the generator holds
+     * no mutable state, so any number of threads may call Generate concurrently and the
+     * blocks are bit-identical regardless of which thread produced them.
+     */
+    class TerrainGenerator {
+    public:
+      static constexpr uint32_t kCaveCellWidth = 4;
+      static constexpr uint32_t kCaveCellHeight = 8;
+      static constexpr int32_t kCaveMinY = 4;  ///< Caves never cut through the cobblestone floor.
+
+      struct Settings {
+        uint32_t seed = 1337;
+        int base_height = 64;       ///< Height of a column where the noise is zero.
+        int height_range = 40;      ///< Height change at noise = +-1.
+        FractalSettings height_noise;
+        FractalSettings cave_noise{ 3, 1.0f / 64.0f, 2.0f, 0.5f };
+        float cave_threshold = 0.3f;  ///< Blocks are carved where the cave noise exceeds this; 1 disables caves.
+      };
+
+      explicit TerrainGenerator(uint32_t seed);
+      explicit TerrainGenerator(const Settings& settings);
+
+      /**
+       * @brief Fills chunk.blocks_data for the chunk at (chunk.x, chunk.z).
+       */
+      void Generate(Chunk& chunk) const;
+
+      /**
+       * @brief Places trees and flowers into chunk, which must already have its terrain.
+       *
+       * Writes only to chunk. Trees rooted in a neighbour but reaching into chunk are placed
+       * here too (the neighbour places its own part), so area must hold the neighbours'
+       * terrain. Roots are found from GetHeight and the terrain block there, which no
+       * feature ever overwrites, so the result does not depend on the order chunks run in.
+       */
+      void PlaceFeatures(Chunk& chunk, const ChunkNeighbourhood& area) const;
+
+      /**
+       * @brief Surface heights of a chunk's columns, heights[z * kChunkWidth + x].
+       */
+      void GenerateHeightmap(int32_t chunk_x, int32_t chunk_z, int32_t* heights) const;
+
+      /**
+       * @brief Surface height (y of the top block) of a single world column.
+       */
+      int32_t GetHeight(int32_t x, int32_t z) const;
+
+      const Settings& GetSettings() const { return settings_; }
+
+    private:
+      int32_t NoiseToHeight(float n) const;
+      void FillColumns(Chunk& chunk, const int32_t* heights) const;
+      void CarveCaves(Chunk& chunk, const int32_t* heights) const;
+
+      Settings settings_;
+      BlockId grass_;
+      BlockId stone_;
+      BlockId cobblestone_;
+      BlockId log_;
+      BlockId leaves_;
+      BlockId flowers_[2];
+    };
+
+  }  // namespace world
+
+}  // namespace heh
@@ -1,14 +1,207 @@
 #pragma once
 
 #include "world/chunk.hpp"
+#include "world/chunk_map.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace heh {
 
   namespace world {
 
+    /**
+     * @brief Converts a world block coordinate to the coordinate of the chunk containing it.
+     * Arithmetic shift floors towards negative infinity, so -1 maps to chunk -1.
+     */
+    constexpr int32_t BlockToChunk(int32_t v) { return v >> 4; }
+
+    /**
+     * @brief Converts a world block coordinate to the local coordinate inside its chunk.
+     */
+    constexpr uint32_t BlockToLocal(int32_t v) { return static_cast<uint32_t>(v) & 15u; }
+
+    /**
+     * @brief Appends the chunks whose meshes show the block at world column (x, z): its own
+     * and, on a border, the ones across it. Meshes read one block into every neighbour,
+     * diagonals included, for hidden faces and smooth light.
+     */
+    inline void AppendMeshingChunks(int32_t x, int32_t z, std::vector<ChunkKey>& out)
+    {
+      const int32_t chunk_x = BlockToChunk(x);
+      const int32_t chunk_z = BlockToChunk(z);
+      const uint32_t local_x = BlockToLocal(x);
+      const uint32_t local_z = BlockToLocal(z);
+      const int32_t min_dx = local_x == 0 ? -1 : 0;
+      const int32_t max_dx = local_x == kChunkWidth - 1 ? 1 : 0;
+      const int32_t min_dz = local_z == 0 ? -1 : 0;
+      const int32_t max_dz = local_z == kChunkDepth - 1 ? 1 : 0;
+      for (int32_t dz = min_dz; dz <= max_dz; ++dz)
+      {
+        for (int32_t dx = min_dx; dx <= max_dx; ++dx)
+          out.push_back(PackChunkKey(chunk_x + dx, chunk_z + dz));
+      }
+    }
+
+    /**
+     * @brief Owns every loaded chunk and answers block queries in world coordinates.
+     *
+     * Chunks live in a ChunkMap keyed by packed column coordinates. All read functions
+     * (GetChunk, GetBlock, GetBlocks, BlockAccessor) are lock-free and may be called from
+     * any thread while another thread loads or unloads chunks. Unloaded chunks are retired
+     * rather than freed; ReclaimRetired() frees them once the owner knows no reader still
+     * holds a pointer obtained before the unload (e.g. once per frame, after background
+     * work has been joined).
+     */
+    class World {
+    public:
+      World();
+      ~World();
+
+      World(const World&) = delete;
+      World& operator=(const World&) = delete;
+
+      /**
+       * @brief Returns the chunk at chunk coordinates (x, z), or nullptr if it is not loaded.
+       */
+      inline Chunk* GetChunk(int32_t x, int32_t z) const { return chunks_.Find(PackChunkKey(x, z)); }
+
+      /**
+       * @brief Creates an empty (all air) chunk at chunk coordinates (x, z).
+       * @return The new chunk, or the existing one if it is already loaded.
+       */
+      Chunk* CreateChunk(int32_t x, int32_t z);
+
+      /**
+       * @brief Takes ownership of a filled chunk and makes it visible to readers.
+       * @return The stored chunk. If a chunk already exists at that position the argument
+       * is dropped and the existing chunk is returned.
+       */
+      Chunk* InsertChunk(std::unique_ptr<Chunk> chunk);
+
+      /**
+       * @brief Removes a chunk from the world. The memory is released by ReclaimRetired().
+       * @return true if the chunk was loaded.
+       */
+      bool UnloadChunk(int32_t x, int32_t z);
+
+      /**
+       * @brief Frees unloaded chunks and old hash table storage.
+       * Must not run concurrently with readers that obtained chunk pointers earlier.
+       */
+      void ReclaimRetired();
+
+      /**
+       * @brief Returns the block at a world position, or kAirBlock if it is outside
+       * the vertical range or its chunk is not loaded.
+       */
+      inline BlockId GetBlock(int32_t x, int32_t y, int32_t z) const
+      {
+        if (static_cast<uint32_t>(y) >= kChunkHeight)
+          return kAirBlock;
+        const Chunk* chunk = GetChunk(BlockToChunk(x), BlockToChunk(z));
+        if (!chunk)
+          return kAirBlock;
+        return chunk->GetBlock(BlockToLocal(x), static_cast<uint32_t>(y), BlockToLocal(z));
+      }
+
+      inline BlockId GetBlock(const glm::ivec3& pos) const { return GetBlock(pos.x, pos.y, pos.z); }
 
+      /**
+       * @brief Sets the block at a world position.
+       * @return false if the position is outside the vertical range or its chunk is not loaded.
+       */
+      bool SetBlock(int32_t x, int32_t y, int32_t z, BlockId id);
+
+      inline bool SetBlock(const glm::ivec3& pos, BlockId id) { return SetBlock(pos.x, pos.y, pos.z, id); }
+
+      /**
+       * @brief Batched lookup: out[i] = GetBlock(positions[i]).
+       * Consecutive positions in the same chunk skip the hash lookup.
+       */
+      void GetBlocks(const glm::ivec3* positions, size_t count, BlockId* out) const;
+
+      /**
+       * @brief Number of loaded chunks.
+       */
+      size_t GetChunkCount() const { return chunks_.Size(); }
+
+      /**
+       * @brief Calls f(Chunk*) for every loaded chunk. Lock-free.
+       */
+      template <typename F>
+      void ForEachChunk(F&& f) const
+      {
+        chunks_.ForEach([&f](ChunkKey, Chunk* chunk) { f(chunk); });
+      }
+
+    private:
+      ChunkMap chunks_;
+      std::mutex retired_mutex_;
+      std::vector<std::unique_ptr<Chunk>> retired_chunks_;
+    };
+
+    /**
+     * @brief Read cursor that remembers the last chunk it touched.
+     *
+     * Raycasts, collision sweeps and light propagation query long runs of neighbouring
+     * blocks; consecutive hits in the same chunk cost a compare and an array load instead
+     * of a hash probe. An accessor is cheap to create and must not outlive a
+     * World::ReclaimRetired() call.
+     */
+    class BlockAccessor {
+    public:
+      explicit BlockAccessor(const World& world) : world_(world) {}
+
+      inline BlockId GetBlock(int32_t x, int32_t y, int32_t z)
+      {
+        if (static_cast<uint32_t>(y) >= kChunkHeight)
+          return kAirBlock;
+        const Chunk* chunk = GetChunk(BlockToChunk(x), BlockToChunk(z));
+        if (!chunk)
+          return kAirBlock;
+        return chunk->GetBlock(BlockToLocal(x), static_cast<uint32_t>(y), BlockToLocal(z));
+      }
+
+      inline BlockId GetBlock(const glm::ivec3& pos) { return GetBlock(pos.x, pos.y, pos.z); }
+
+      /**
+       * @brief Returns the chunk at chunk coordinates (x, z), hitting the cache when possible.
+       */
+      inline Chunk* GetChunk(int32_t x, int32_t z)
+      {
+        const ChunkKey key = PackChunkKey(x, z);
+        if (key != last_key_)
+        {
+          last_key_ = key;
+          last_chunk_ = world_.GetChunk(x, z);
+        }
+        return last_chunk_;
+      }
+
+      /**
+       * @brief Forgets the cached chunk, e.g. after chunks were loaded or unloaded.
+       */
+      void Reset()
+      {
+        last_key_ = kEmptyChunkKey;
+        last_chunk_ = nullptr;
+      }
+
+    private:
+      const World& world_;
+      ChunkKey last_key_ = kEmptyChunkKey;
+      Chunk* last_chunk_ = nullptr;
+    };
 
   }  // namespace world
-  
 
-}  // namespace heh
\ No newline at end of file
+
+}  // namespace heh
@@ -5,15 +5,25 @@ out vec4 FragColor;
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+in vec2 Light; // sky and block light, 0..1
 
 uniform sampler2D texture_diffuse1;
 
-uniform vec3 lightColor;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+// Written once a frame and shared by every program; see heh::FrameUniforms.
+layout (std140) uniform FrameData {
+  mat4 view;
+  mat4 projection;
+  vec4 viewPos;
+  vec4 lightPos;
+  vec4 lightColor;
+  vec4 dirLightDirection;
+  vec4 dirLightColor;
+};
 
-uniform vec3 dirLightDirection;
-uniform vec3 dirLightColor;
+// Each light level is 80% as bright as the one above it.
+float LightCurve(float level) {
+  return pow(0.8, 15.0 * (1.0 - level));
+}
 
 void main() {
   // Diffuse color
@@ -37,22 +47,25 @@ void main() {
       ao = 0.3;
   }
 
-  // Ambient lighting
-  vec3 ambient = 0.3 * color * ao;
+  float skyLight = LightCurve(Light.x);
+  float blockLight = Light.y > 0.0 ? LightCurve(Light.y) : 0.0;
+
+  // Ambient lighting, dimmed where the sky does not reach; blocks that emit light add a warm tint.
+  vec3 ambient = (0.05 + 0.25 * skyLight) * color * ao + 0.8 * blockLight * vec3(1.0, 0.85, 0.6) * color;
 
   // Diffuse lighting
   vec3 norm = normalize(Normal);
-  vec3 lightDir = normalize(dirLightDirection); // simulating sunlight
+  vec3 lightDir = normalize(dirLightDirection.xyz); // simulating sunlight
   float diff = max(dot(norm, lightDir), 0.0);
-  vec3 diffuse = diff * dirLightColor * color; // used dirLightColor instead of lightColor
+  vec3 diffuse = skyLight * diff * dirLightColor.rgb * color; // used dirLightColor instead of lightColor
 
   // Specular lighting
-  vec3 viewDir = normalize(viewPos - FragPos);
+  vec3 viewDir = normalize(viewPos.xyz - FragPos);
   vec3 reflectDir = reflect(-lightDir, norm);
   float spec = pow(max(dot(viewDir, reflectDir), 0.0), 256);
   
   float specularStrength = 0.15; // Specular strength can be adjusted
-  vec3 specular = spec * dirLightColor * specularStrength; // used dirLightColor instead of lightColor
+  vec3 specular = skyLight * spec * dirLightColor.rgb * specularStrength; // used dirLightColor instead of lightColor
 
   vec3 result = ambient + diffuse + specular;
   FragColor = vec4(result, texColor.a);
@@ -1,19 +1,37 @@
 #version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 layout (location = 2) in vec3 aNormal;
+layout (location = 3) in vec2 aLight;
 
 out vec2 TexCoords;
 out vec3 FragPos;
 out vec3 Normal;
+out vec2 Light;
+
+// Corner of each chunk drawn by the current glMultiDrawElementsIndirect, by draw index.
+layout (std430, binding = 0) readonly buffer ChunkDraws {
+  vec4 chunk_origins[];
+};
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Written once a frame and shared by every program; see heh::FrameUniforms.
+layout (std140) uniform FrameData {
+  mat4 view;
+  mat4 projection;
+  vec4 viewPos;
+  vec4 lightPos;
+  vec4 lightColor;
+  vec4 dirLightDirection;
+  vec4 dirLightColor;
+};
 
 void main() {
   TexCoords = aTexCoords;
-  Normal = mat3(transpose(inverse(model))) * aNormal;
-  FragPos = vec3(model * vec4(aPos, 1.0));
+  Light = aLight;
+  // Chunks are only translated, so normals stay as they are.
+  Normal = aNormal;
+  FragPos = aPos + chunk_origins[gl_DrawIDARB].xyz;
   gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,379 @@
+#include "core/chunk_renderer.hpp"
+
+#include "utils/job_system.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace heh {
+
+// Starting sizes of the arenas: about 40 MiB of vertices and the indices of their quads.
+// They double when full.
+static constexpr size_t kInitialVertices = size_t(1) << 20;
+static constexpr size_t kInitialElements = kInitialVertices / 4 * 6;
+// The upload ring holds this many frames of uploads and draw data before it waits.
+static constexpr size_t kFramesInFlight = 3;
+// Room for the draw commands and origins of a frame, about 58000 sections.
+static constexpr size_t kDrawDataBytes = size_t(2) << 20;
+// Evicted meshes queued to come back per frame at most.
+static constexpr size_t kMaxReturnsPerFrame = 4;
+
+// The memory budget is split between the arenas as quads use them: four vertices and
+// six indices each.
+static constexpr size_t kQuadBytes = 4 * sizeof(Vertex) + 6 * sizeof(uint32_t);
+
+static size_t ArenaLimit(size_t memory_budget, size_t units_per_quad) {
+  return memory_budget == 0 ? SIZE_MAX : memory_budget / kQuadBytes * units_per_quad;
+}
+
+ChunkRenderer::ChunkRenderer(size_t upload_budget, size_t memory_budget, bool keep_evicted)
+    : vertices_(sizeof(Vertex), kInitialVertices, ArenaLimit(memory_budget, 4)),
+      elements_(sizeof(uint32_t), kInitialElements, ArenaLimit(memory_budget, 6)),
+      ring_(kFramesInFlight * (upload_budget + kDrawDataBytes)),
+      upload_budget_(upload_budget),
+      residency_(memory_budget, keep_evicted) {
+  GLint alignment = 0;
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  storage_alignment_ = std::max<size_t>(static_cast<size_t>(alignment), 16);
+
+  const GLuint vao = vao_.GetID();
+
+  // position
+  glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+  // texture coords
+  glVertexArrayAttribFormat(vao, 1, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, tex_coords));
+  // normals
+  glVertexArrayAttribFormat(vao, 2, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+  // sky and block light
+  glVertexArrayAttribFormat(vao, 3, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, light));
+  for (GLuint attribute = 0; attribute < 4; ++attribute) {
+    glVertexArrayAttribBinding(vao, attribute, 0);
+    glEnableVertexArrayAttrib(vao, attribute);
+  }
+  BindArenas();
+}
+
+void ChunkRenderer::BindArenas() {
+  if (bound_vertices_ != vertices_.GetID()) {
+    glVertexArrayVertexBuffer(vao_.GetID(), 0, vertices_.GetID(), 0, sizeof(Vertex));
+    bound_vertices_ = vertices_.GetID();
+  }
+  if (bound_elements_ != elements_.GetID()) {
+    glVertexArrayElementBuffer(vao_.GetID(), elements_.GetID());
+    bound_elements_ = elements_.GetID();
+  }
+}
+
+void ChunkRenderer::FreeRanges(const GpuMesh& mesh) {
+  vertices_.Free(mesh.vertex_offset, mesh.vertex_count);
+  elements_.Free(mesh.element_offset, mesh.element_count);
+}
+
+void ChunkRenderer::Upload(int32_t x, int32_t z, std::unique_ptr<ChunkRenderData> data) {
+  if (!data || data->num_elements == 0) {
+    Remove(x, z);
+    return;
+  }
+
+  const world::ChunkKey key = world::PackChunkKey(x, z);
+  auto it = std::find_if(pending_.begin(), pending_.end(), [key](const PendingUpload& p) { return p.key == key; });
+  if (it != pending_.end()) {
+    it->data = std::move(data);
+    it->from_copy = false;
+  } else {
+    pending_.push_back({ key, std::move(data) });
+  }
+}
+
+void ChunkRenderer::FlushUploads() {
+  stats_.upload_bytes = 0;
+  while (!pending_.empty()) {
+    const ChunkRenderData& data = *pending_.front().data;
+    const size_t bytes = data.vertices.size() * sizeof(Vertex) + data.num_elements * sizeof(uint32_t);
+    if (stats_.upload_bytes > 0 && stats_.upload_bytes + bytes > upload_budget_)
+      break;
+    Store(pending_.front().key, data, pending_.front().from_copy);
+    stats_.upload_bytes += bytes;
+    pending_.pop_front();
+  }
+  stats_.total_upload_bytes += stats_.upload_bytes;
+  stats_.pending_uploads = pending_.size();
+}
+
+void ChunkRenderer::ReturnEvicted() {
+  if (!pending_.empty())
+    return;
+  std::vector<std::pair<world::ChunkKey, std::unique_ptr<ChunkRenderData>>> uploads;
+  residency_.TakeReturns(kMaxReturnsPerFrame, uploads, rebuilds_);
+  for (auto& [key, data] : uploads)
+    pending_.push_back({ key, std::move(data), true });
+}
+
+std::vector<world::ChunkKey> ChunkRenderer::PopRebuilds() {
+  std::vector<world::ChunkKey> out;
+  out.swap(rebuilds_);
+  return out;
+}
+
+void ChunkRenderer::Store(world::ChunkKey key, const ChunkRenderData& data, bool from_copy) {
+  const int32_t x = world::ChunkKeyX(key);
+  const int32_t z = world::ChunkKeyZ(key);
+  graph_.Set(x, z, data.section_connectivity);
+
+  // The old ranges of this chunk count as free from here on.
+  auto old = meshes_.find(key);
+  if (old != meshes_.end()) {
+    FreeRanges(*old->second);
+    old->second->vertex_count = 0;
+    old->second->element_count = 0;
+  }
+
+  const size_t vertex_count = data.vertices.size();
+  const size_t element_count = data.num_elements;
+  const size_t bytes = vertex_count * sizeof(Vertex) + element_count * sizeof(uint32_t);
+  size_t vertex_offset = RangeAllocator::kInvalid;
+  size_t element_offset = RangeAllocator::kInvalid;
+  for (;;) {
+    // Within the budget the arenas may still be too fragmented; evicting more helps both.
+    if (residency_.Fits(key, bytes)) {
+      vertex_offset = vertices_.Allocate(vertex_count);
+      if (vertex_offset != RangeAllocator::kInvalid) {
+        element_offset = elements_.Allocate(element_count);
+        if (element_offset != RangeAllocator::kInvalid)
+          break;
+        vertices_.Free(vertex_offset, vertex_count);
+      }
+    }
+    world::ChunkKey victim = 0;
+    if (!residency_.PickVictim(key, victim)) {
+      Release(key);
+      residency_.Park(key, data, from_copy);
+      return;
+    }
+    Release(victim);
+    residency_.Evict(victim);
+  }
+
+  auto& mesh = meshes_[key];
+  if (!mesh) {
+    mesh = std::make_unique<GpuMesh>();
+    mesh->x = x;
+    mesh->z = z;
+    mesh->slot = bounds_.Add(glm::vec3(0.0f), glm::vec3(0.0f));
+    slots_.push_back(mesh.get());
+  }
+
+  const glm::vec3 origin(static_cast<float>(x * static_cast<int32_t>(kChunkWidth)), 0.0f,
+                         static_cast<float>(z * static_cast<int32_t>(kChunkDepth)));
+  mesh->origin = glm::vec4(origin, 0.0f);
+
+  // Bounds of what was meshed rather than of the whole column, so chunks are culled
+  // by their surface when looking up or down.
+  glm::vec3 min(data.vertices.front().position);
+  glm::vec3 max(min);
+  for (const Vertex& vertex : data.vertices) {
+    min = glm::min(min, vertex.position);
+    max = glm::max(max, vertex.position);
+  }
+  bounds_.Set(mesh->slot, origin + min, origin + max);
+
+  // Indices stay local to the mesh; the draw command's base vertex offsets them.
+  mesh->vertex_count = vertex_count;
+  mesh->element_count = element_count;
+  mesh->section_elements = data.section_elements;
+  mesh->closed = 0;
+  for (uint32_t section = 0; section < kSectionsPerChunk; ++section) {
+    if (data.section_connectivity[section] == 0)
+      mesh->closed |= static_cast<uint16_t>(1u << section);
+  }
+  mesh->vertex_offset = vertex_offset;
+  mesh->element_offset = element_offset;
+  residency_.Insert(key, data, from_copy);
+  BindArenas();
+
+  const size_t vertex_bytes = mesh->vertex_count * sizeof(Vertex);
+  const size_t element_bytes = mesh->element_count * sizeof(uint32_t);
+  const size_t staging = ring_.Reserve(vertex_bytes + element_bytes);
+  if (staging == UploadRing::kInvalid) {
+    // No room next to this frame's other uploads: let the driver stage it.
+    vertices_.Write(mesh->vertex_offset, mesh->vertex_count, data.vertices.data());
+    elements_.Write(mesh->element_offset, mesh->element_count, data.elements.data());
+    return;
+  }
+  std::memcpy(ring_.GetMapping() + staging, data.vertices.data(), vertex_bytes);
+  std::memcpy(ring_.GetMapping() + staging + vertex_bytes, data.elements.data(), element_bytes);
+  vertices_.CopyFrom(ring_.GetID(), staging, mesh->vertex_offset, mesh->vertex_count);
+  elements_.CopyFrom(ring_.GetID(), staging + vertex_bytes, mesh->element_offset, mesh->element_count);
+}
+
+void ChunkRenderer::Remove(int32_t x, int32_t z) {
+  const world::ChunkKey key = world::PackChunkKey(x, z);
+  pending_.erase(std::remove_if(pending_.begin(), pending_.end(), [key](const PendingUpload& p) { return p.key == key; }),
+                 pending_.end());
+
+  residency_.Erase(key);
+  graph_.Remove(x, z);
+  Release(key);
+}
+
+void ChunkRenderer::Release(world::ChunkKey key) {
+  auto it = meshes_.find(key);
+  if (it == meshes_.end())
+    return;
+
+  FreeRanges(*it->second);
+  const size_t slot = it->second->slot;
+  bounds_.RemoveSwap(slot);
+  slots_[slot] = slots_.back();
+  slots_[slot]->slot = slot;
+  slots_.pop_back();
+  meshes_.erase(it);
+}
+
+void ChunkRenderer::CullOccluded(const Frustum& frustum, const glm::vec3& eye) {
+  const auto start = std::chrono::steady_clock::now();
+  const int32_t eye_x = static_cast<int32_t>(std::floor((eye.x + 0.5f) / static_cast<float>(kChunkWidth)));
+  const int32_t eye_z = static_cast<int32_t>(std::floor((eye.z + 0.5f) / static_cast<float>(kChunkDepth)));
+
+  occlusion_.Begin(frustum.GetProjectionView());
+  for (const GpuMesh* mesh : slots_) {
+    if (mesh->closed && std::abs(mesh->x - eye_x) <= kOccluderRadius && std::abs(mesh->z - eye_z) <= kOccluderRadius)
+      occlusion_.AddClosedSections(mesh->x, mesh->z, mesh->closed);
+  }
+  occlusion_.Rasterize(jobs_);
+
+  candidates_.clear();
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    for (uint32_t section = 0; section < kSectionsPerChunk; ++section) {
+      if (sections_[i] >> section & 1)
+        candidates_.push_back(static_cast<uint32_t>(i) << 4 | section);
+    }
+  }
+  candidate_visible_.assign(candidates_.size(), 1);
+  const auto test = [this](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const GpuMesh& mesh = *slots_[candidates_[i] >> 4];
+      candidate_visible_[i] = occlusion_.IsSectionVisible(mesh.x, static_cast<int32_t>(candidates_[i] & 15), mesh.z);
+    }
+  };
+  if (jobs_)
+    jobs_->ParallelFor(candidates_.size(), 64, test);
+  else
+    test(0, candidates_.size());
+
+  stats_.depth_culled = 0;
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    if (!candidate_visible_[i]) {
+      sections_[candidates_[i] >> 4] &= static_cast<uint16_t>(~(1u << (candidates_[i] & 15)));
+      ++stats_.depth_culled;
+    }
+  }
+  stats_.occluders = occlusion_.GetOccluderCount();
+  stats_.occlusion_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ChunkRenderer::Render(const Frustum& frustum, const glm::vec3& eye) {
+  residency_.BeginFrame(eye);
+  ReturnEvicted();
+  FlushUploads();
+
+  const auto start = std::chrono::steady_clock::now();
+  bounds_.Cull(frustum, visible_);
+  stats_.cull_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  graph_.Traverse(eye, frustum, visibility_radius_);
+
+  // The sections each mesh draws: inside the frustum, reached by the graph, not empty.
+  stats_.meshes = slots_.size();
+  stats_.culled = 0;
+  sections_.assign(slots_.size(), 0);
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    if (!visible_[i]) {
+      ++stats_.culled;
+      continue;
+    }
+    const GpuMesh& mesh = *slots_[i];
+    const uint16_t reached = graph_.GetVisibleSections(mesh.x, mesh.z);
+    for (uint32_t section = 0; section < kSectionsPerChunk; ++section) {
+      if ((reached >> section & 1) && mesh.section_elements[section + 1] > mesh.section_elements[section])
+        sections_[i] |= static_cast<uint16_t>(1u << section);
+    }
+  }
+  CullOccluded(frustum, eye);
+
+  stats_.drawn = 0;
+  stats_.occluded = 0;
+  stats_.sections_drawn = 0;
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    if (!visible_[i])
+      continue;
+    if (sections_[i]) {
+      ++stats_.drawn;
+      residency_.MarkDrawn(world::PackChunkKey(slots_[i]->x, slots_[i]->z));
+    } else {
+      ++stats_.occluded;
+    }
+    for (uint32_t section = 0; section < kSectionsPerChunk; ++section)
+      stats_.sections_drawn += sections_[i] >> section & 1;
+  }
+  stats_.vertex_bytes = vertices_.GetAllocator().GetCapacity() * vertices_.GetUnitSize();
+  stats_.element_bytes = elements_.GetAllocator().GetCapacity() * elements_.GetUnitSize();
+  stats_.draw_calls = 0;
+
+  const size_t count = stats_.sections_drawn;
+  if (count > 0) {
+    // Commands and origins are written straight into the ring and read from there, in
+    // one reservation so the second cannot wait on the first.
+    const size_t alignment = storage_alignment_;
+    const size_t origins_start = (count * sizeof(DrawCommand) + alignment - 1) & ~(alignment - 1);
+    const size_t draw_bytes = origins_start + count * sizeof(glm::vec4);
+    size_t commands_offset = ring_.Reserve(draw_bytes, alignment);
+    if (commands_offset == UploadRing::kInvalid) {
+      // The uploads of this frame are in the way; their copies are issued, so they can be
+      // fenced and waited for.
+      ring_.Fence();
+      commands_offset = ring_.Reserve(draw_bytes, alignment);
+    }
+    if (commands_offset == UploadRing::kInvalid)
+      throw std::runtime_error("Too many chunk draws for the upload ring");
+    const size_t origins_offset = commands_offset + origins_start;
+    auto* commands = reinterpret_cast<DrawCommand*>(ring_.GetMapping() + commands_offset);
+    auto* origins = reinterpret_cast<glm::vec4*>(ring_.GetMapping() + origins_offset);
+    size_t command = 0;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      if (!sections_[i])
+        continue;
+      const GpuMesh& mesh = *slots_[i];
+      for (uint32_t section = 0; section < kSectionsPerChunk; ++section) {
+        if (!(sections_[i] >> section & 1))
+          continue;
+        const uint32_t first = mesh.section_elements[section];
+        commands[command] = { mesh.section_elements[section + 1] - first, 1,
+                              static_cast<uint32_t>(mesh.element_offset) + first, static_cast<int32_t>(mesh.vertex_offset),
+                              0 };
+        origins[command] = mesh.origin;
+        ++command;
+      }
+    }
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kDrawDataBinding, ring_.GetID(),
+                      static_cast<GLintptr>(origins_offset), static_cast<GLsizeiptr>(count * sizeof(glm::vec4)));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ring_.GetID());
+    vao_.Bind();
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(commands_offset),
+                                static_cast<GLsizei>(count), 0);
+    vao_.Unbind();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    stats_.draw_calls = 1;
+  }
+
+  // Covers this frame's uploads and draw data.
+  ring_.Fence();
+  stats_.fence_waits = ring_.GetFenceWaits();
+}
+
+}  // namespace heh
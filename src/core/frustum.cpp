@@ -0,0 +1,107 @@
+#include "core/frustum.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+
+namespace heh {
+
+// Boxes tested against all six planes before moving on, so a block stays in L1.
+static constexpr size_t kCullBlock = 1024;
+
+void Frustum::Update(const glm::mat4& projection_view) {
+  // Gribb-Hartmann: each plane is the last row of the matrix plus or minus another row.
+  // glm is column-major, so row i is m[0][i], m[1][i], m[2][i], m[3][i].
+  projection_view_ = projection_view;
+  const glm::mat4& m = projection_view;
+  const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+  const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+  const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+  const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+  planes_ = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2 };
+  for (glm::vec4& plane : planes_) {
+    const float length = glm::length(glm::vec3(plane));
+    if (length > 0.0f)
+      plane /= length;
+  }
+}
+
+bool Frustum::IsBoxVisible(const glm::vec3& min, const glm::vec3& max) const {
+  for (const glm::vec4& plane : planes_) {
+    // The corner furthest along the normal; if it is outside, the whole box is.
+    const glm::vec3 corner(plane.x >= 0.0f ? max.x : min.x,
+                           plane.y >= 0.0f ? max.y : min.y,
+                           plane.z >= 0.0f ? max.z : min.z);
+    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+      return false;
+  }
+  return true;
+}
+
+size_t AabbList::Add(const glm::vec3& min, const glm::vec3& max) {
+  min_x_.push_back(min.x);
+  min_y_.push_back(min.y);
+  min_z_.push_back(min.z);
+  max_x_.push_back(max.x);
+  max_y_.push_back(max.y);
+  max_z_.push_back(max.z);
+  return Size() - 1;
+}
+
+void AabbList::Set(size_t index, const glm::vec3& min, const glm::vec3& max) {
+  min_x_[index] = min.x;
+  min_y_[index] = min.y;
+  min_z_[index] = min.z;
+  max_x_[index] = max.x;
+  max_y_[index] = max.y;
+  max_z_[index] = max.z;
+}
+
+void AabbList::RemoveSwap(size_t index) {
+  for (std::vector<float>* values : { &min_x_, &min_y_, &min_z_, &max_x_, &max_y_, &max_z_ }) {
+    (*values)[index] = values->back();
+    values->pop_back();
+  }
+}
+
+void AabbList::Clear() {
+  for (std::vector<float>* values : { &min_x_, &min_y_, &min_z_, &max_x_, &max_y_, &max_z_ })
+    values->clear();
+}
+
+size_t AabbList::Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const {
+  const size_t count = Size();
+  visible.resize(count);
+  uint8_t* out = visible.data();
+
+  // Results of a block are gathered as int32 rather than written to visible directly:
+  // bytes may alias the float bounds, which keeps the compiler from vectorizing.
+  std::array<int32_t, kCullBlock> inside;
+  for (size_t begin = 0; begin < count; begin += kCullBlock) {
+    const size_t length = std::min(kCullBlock, count - begin);
+    inside.fill(1);
+    for (const glm::vec4& plane : frustum.GetPlanes()) {
+      // Picking the corner per plane instead of per box keeps the inner loop free of
+      // branches: the same bound array is read for every box.
+      const float* x = (plane.x >= 0.0f ? max_x_.data() : min_x_.data()) + begin;
+      const float* y = (plane.y >= 0.0f ? max_y_.data() : min_y_.data()) + begin;
+      const float* z = (plane.z >= 0.0f ? max_z_.data() : min_z_.data()) + begin;
+      const float nx = plane.x;
+      const float ny = plane.y;
+      const float nz = plane.z;
+      const float d = plane.w;
+      for (size_t i = 0; i < length; ++i)
+        inside[i] &= static_cast<int32_t>(nx * x[i] + ny * y[i] + nz * z[i] + d >= 0.0f);
+    }
+    for (size_t i = 0; i < length; ++i)
+      out[begin + i] = static_cast<uint8_t>(inside[i]);
+  }
+
+  size_t visible_count = 0;
+  for (size_t i = 0; i < count; ++i)
+    visible_count += out[i];
+  return visible_count;
+}
+
+}  // namespace heh
@@ -0,0 +1,265 @@
+#include "core/mesh_residency.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace heh {
+
+static constexpr float kPositionScale = 64.0f;
+
+static constexpr float kNormals[6][3] = {
+  { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+  { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f },
+};
+
+template <typename T>
+static T Quantize(float value, float scale) {
+  const float scaled = std::round(value * scale);
+  return static_cast<T>(std::clamp(scaled, 0.0f, static_cast<float>(std::numeric_limits<T>::max())));
+}
+
+static bool IsQuads(const ChunkRenderData& data) {
+  if (data.vertices.size() % 4 != 0 || data.elements.size() != data.vertices.size() / 4 * 6)
+    return false;
+  static constexpr int32_t kQuad[6] = { 0, 1, 2, 0, 2, 3 };
+  for (size_t i = 0; i < data.elements.size(); ++i) {
+    if (data.elements[i] != static_cast<int32_t>(i / 6 * 4) + kQuad[i % 6])
+      return false;
+  }
+  return true;
+}
+
+CompactMesh::CompactMesh(const ChunkRenderData& data)
+    : num_elements_(data.num_elements),
+      lod_(data.lod),
+      section_elements_(data.section_elements),
+      section_connectivity_(data.section_connectivity) {
+  vertices_.resize(data.vertices.size());
+  for (size_t i = 0; i < data.vertices.size(); ++i) {
+    const Vertex& vertex = data.vertices[i];
+    PackedVertex& packed = vertices_[i];
+    for (int axis = 0; axis < 3; ++axis)
+      packed.position[axis] = Quantize<uint16_t>(vertex.position[axis] + 1.0f, kPositionScale);
+    packed.tex_coords[0] = Quantize<uint16_t>(vertex.tex_coords.x, 65535.0f);
+    packed.tex_coords[1] = Quantize<uint16_t>(vertex.tex_coords.y, 65535.0f);
+    packed.light[0] = Quantize<uint8_t>(vertex.light.x, 255.0f);
+    packed.light[1] = Quantize<uint8_t>(vertex.light.y, 255.0f);
+    packed.normal = 0;
+    for (uint8_t n = 0; n < 6; ++n) {
+      if (glm::vec3(kNormals[n][0], kNormals[n][1], kNormals[n][2]) == vertex.normal)
+        packed.normal = n;
+    }
+  }
+  if (!IsQuads(data))
+    elements_ = data.elements;
+}
+
+std::unique_ptr<ChunkRenderData> CompactMesh::Expand() const {
+  auto data = std::make_unique<ChunkRenderData>();
+  data->vertices.resize(vertices_.size());
+  for (size_t i = 0; i < vertices_.size(); ++i) {
+    const PackedVertex& packed = vertices_[i];
+    Vertex& vertex = data->vertices[i];
+    vertex.position = glm::vec3(packed.position[0], packed.position[1], packed.position[2]) / kPositionScale - 1.0f;
+    vertex.tex_coords = glm::vec2(packed.tex_coords[0], packed.tex_coords[1]) / 65535.0f;
+    vertex.light = glm::vec2(packed.light[0], packed.light[1]) / 255.0f;
+    const float* normal = kNormals[packed.normal];
+    vertex.normal = glm::vec3(normal[0], normal[1], normal[2]);
+  }
+  if (!elements_.empty()) {
+    data->elements = elements_;
+  } else {
+    data->elements.resize(vertices_.size() / 4 * 6);
+    for (size_t quad = 0; quad < vertices_.size() / 4; ++quad) {
+      const int32_t first = static_cast<int32_t>(quad * 4);
+      int32_t* out = data->elements.data() + quad * 6;
+      out[0] = first;
+      out[1] = first + 1;
+      out[2] = first + 2;
+      out[3] = first;
+      out[4] = first + 2;
+      out[5] = first + 3;
+    }
+  }
+  data->vertex_size_bytes = data->vertices.size() * sizeof(Vertex);
+  data->element_size_bytes = data->elements.size() * sizeof(int32_t);
+  data->num_elements = num_elements_;
+  data->section_elements = section_elements_;
+  data->section_connectivity = section_connectivity_;
+  data->lod = lod_;
+  return data;
+}
+
+MeshResidency::MeshResidency(size_t budget, bool keep_copies) : budget_(budget), keep_copies_(keep_copies) {
+  stats_.budget = budget;
+}
+
+void MeshResidency::BeginFrame(const glm::vec3& eye) {
+  ++frame_;
+  // Blocks span [p - 0.5, p + 0.5], as in the mesher.
+  eye_ = glm::vec2(eye.x + 0.5f, eye.z + 0.5f) / glm::vec2(kChunkWidth, kChunkDepth);
+}
+
+float MeshResidency::Distance(world::ChunkKey key) const {
+  const glm::vec2 centre(static_cast<float>(world::ChunkKeyX(key)) + 0.5f, static_cast<float>(world::ChunkKeyZ(key)) + 0.5f);
+  return glm::length(centre - eye_);
+}
+
+float MeshResidency::Rank(world::ChunkKey key, const Entry& entry) const {
+  const float unseen = static_cast<float>(frame_ - std::min(entry.last_drawn, frame_)) / kFramesPerChunk;
+  return Distance(key) + std::min(unseen, kMaxUnseenPenalty);
+}
+
+bool MeshResidency::Fits(world::ChunkKey key, size_t bytes) const {
+  if (budget_ == 0)
+    return true;
+  size_t current = 0;
+  auto it = entries_.find(key);
+  if (it != entries_.end() && it->second.resident)
+    current = it->second.bytes;
+  return stats_.resident_bytes - current + bytes <= budget_;
+}
+
+bool MeshResidency::PickVictim(world::ChunkKey key, world::ChunkKey& victim) const {
+  // The mesh about to be uploaded counts as just seen.
+  float worst = Distance(key);
+  bool found = false;
+  for (const auto& [other, entry] : entries_) {
+    if (other == key || !entry.resident)
+      continue;
+    const float rank = Rank(other, entry);
+    if (rank > worst) {
+      worst = rank;
+      victim = other;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void MeshResidency::KeepCopy(Entry& entry, const ChunkRenderData& data, bool from_copy) {
+  // A mesh expanded from the copy still matches it.
+  if (!keep_copies_ || (from_copy && entry.copy))
+    return;
+  DropCopy(entry);
+  entry.copy = std::make_unique<CompactMesh>(data);
+  stats_.copy_bytes += entry.copy->GetBytes();
+}
+
+void MeshResidency::DropCopy(Entry& entry) {
+  if (!entry.copy)
+    return;
+  stats_.copy_bytes -= entry.copy->GetBytes();
+  entry.copy.reset();
+}
+
+void MeshResidency::Insert(world::ChunkKey key, const ChunkRenderData& data, bool from_copy) {
+  auto [it, added] = entries_.try_emplace(key);
+  Entry& entry = it->second;
+  if (entry.resident) {
+    stats_.resident_bytes -= entry.bytes;
+  } else {
+    ++stats_.resident;
+    if (!added)
+      --stats_.evicted;
+  }
+  entry.bytes = data.vertices.size() * sizeof(Vertex) + data.num_elements * sizeof(uint32_t);
+  entry.resident = true;
+  entry.last_drawn = frame_;
+  KeepCopy(entry, data, from_copy);
+  entry.returned = 0;
+  stats_.resident_bytes += entry.bytes;
+}
+
+void MeshResidency::Evict(world::ChunkKey key) {
+  auto it = entries_.find(key);
+  if (it == entries_.end() || !it->second.resident)
+    return;
+  it->second.resident = false;
+  stats_.resident_bytes -= it->second.bytes;
+  --stats_.resident;
+  ++stats_.evicted;
+  ++stats_.evictions;
+}
+
+void MeshResidency::Park(world::ChunkKey key, const ChunkRenderData& data, bool from_copy) {
+  auto [it, added] = entries_.try_emplace(key);
+  Entry& entry = it->second;
+  if (entry.resident) {
+    Evict(key);
+  } else {
+    if (added)
+      ++stats_.evicted;
+    ++stats_.evictions;
+  }
+  entry.bytes = data.vertices.size() * sizeof(Vertex) + data.num_elements * sizeof(uint32_t);
+  KeepCopy(entry, data, from_copy);
+  entry.returned = 0;
+}
+
+void MeshResidency::Erase(world::ChunkKey key) {
+  auto it = entries_.find(key);
+  if (it == entries_.end())
+    return;
+  if (it->second.resident) {
+    stats_.resident_bytes -= it->second.bytes;
+    --stats_.resident;
+  } else {
+    --stats_.evicted;
+  }
+  DropCopy(it->second);
+  entries_.erase(it);
+}
+
+void MeshResidency::MarkDrawn(world::ChunkKey key) {
+  auto it = entries_.find(key);
+  if (it != entries_.end())
+    it->second.last_drawn = frame_;
+}
+
+void MeshResidency::TakeReturns(size_t max_count,
+                                std::vector<std::pair<world::ChunkKey, std::unique_ptr<ChunkRenderData>>>& uploads,
+                                std::vector<world::ChunkKey>& rebuilds) {
+  if (stats_.evicted == 0 || max_count == 0)
+    return;
+
+  float worst = 0.0f;
+  for (const auto& [key, entry] : entries_) {
+    if (entry.resident)
+      worst = std::max(worst, Rank(key, entry));
+  }
+
+  std::vector<std::pair<float, world::ChunkKey>> candidates;
+  for (const auto& [key, entry] : entries_) {
+    if (entry.resident || (entry.returned != 0 && frame_ - entry.returned < kReturnTimeout))
+      continue;
+    const float distance = Distance(key);
+    if (distance + kReturnMargin < worst || Fits(key, entry.bytes))
+      candidates.emplace_back(distance, key);
+  }
+  const size_t count = std::min(max_count, candidates.size());
+  std::partial_sort(candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(count), candidates.end());
+
+  size_t room = budget_ > stats_.resident_bytes ? budget_ - stats_.resident_bytes : 0;
+  for (size_t i = 0; i < count; ++i) {
+    Entry& entry = entries_[candidates[i].second];
+    // Those coming back into free room must fit next to each other too.
+    if (budget_ != 0 && candidates[i].first + kReturnMargin >= worst) {
+      if (entry.bytes > room)
+        continue;
+      room -= entry.bytes;
+    }
+    entry.returned = frame_;
+    if (entry.copy) {
+      uploads.emplace_back(candidates[i].second, entry.copy->Expand());
+      ++stats_.reuploads;
+    } else {
+      rebuilds.push_back(candidates[i].second);
+      ++stats_.rebuilds;
+    }
+  }
+}
+
+}  // namespace heh
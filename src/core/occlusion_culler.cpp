@@ -0,0 +1,200 @@
+#include "core/occlusion_culler.hpp"
+
+#include "utils/job_system.hpp"
+
+// std
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace heh {
+
+// Rows per rasterization job.
+static constexpr int kBandRows = 16;
+
+// Corners of a box as bits: x in bit 0, y in bit 1, z in bit 2. Each face lists its
+// four corners in order around it.
+static constexpr int kBoxFaces[6][4] = {
+  { 0, 1, 3, 2 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 3, 7, 5 },
+};
+
+void OcclusionCuller::Begin(const glm::mat4& projection_view) {
+  projection_view_ = projection_view;
+  triangles_.clear();
+  occluders_ = 0;
+}
+
+void OcclusionCuller::AddOccluder(const glm::vec3& min, const glm::vec3& max) {
+  glm::vec4 corners[8];
+  for (int i = 0; i < 8; ++i) {
+    const glm::vec3 corner(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+    corners[i] = projection_view_ * glm::vec4(corner, 1.0f);
+  }
+  // Back faces too: they lie behind the front ones, so they only fill the cracks that
+  // conservative rasterization leaves along the edges between front faces.
+  for (const auto& face : kBoxFaces) {
+    const glm::vec4 quad[4] = { corners[face[0]], corners[face[1]], corners[face[2]], corners[face[3]] };
+    AddFace(quad);
+  }
+  ++occluders_;
+}
+
+void OcclusionCuller::AddClosedSections(int32_t x, int32_t z, uint16_t closed) {
+  const glm::vec3 origin(static_cast<float>(x * static_cast<int32_t>(kChunkWidth)) - 0.5f, -0.5f,
+                         static_cast<float>(z * static_cast<int32_t>(kChunkDepth)) - 0.5f);
+  uint32_t section = 0;
+  while (section < kSectionsPerChunk) {
+    if (!(closed >> section & 1)) {
+      ++section;
+      continue;
+    }
+    const uint32_t first = section;
+    while (section < kSectionsPerChunk && (closed >> section & 1))
+      ++section;
+    AddOccluder(origin + glm::vec3(0.0f, static_cast<float>(first * kSectionHeight), 0.0f),
+                origin + glm::vec3(kChunkWidth, static_cast<float>(section * kSectionHeight), kChunkDepth));
+  }
+}
+
+void OcclusionCuller::AddFace(const glm::vec4* corners) {
+  // Clip against the near plane, z + w >= 0.
+  glm::vec4 polygon[5];
+  int count = 0;
+  for (int i = 0; i < 4; ++i) {
+    const glm::vec4& a = corners[i];
+    const glm::vec4& b = corners[(i + 1) & 3];
+    const float da = a.z + a.w;
+    const float db = b.z + b.w;
+    if (da >= 0.0f)
+      polygon[count++] = a;
+    if ((da >= 0.0f) != (db >= 0.0f))
+      polygon[count++] = a + (b - a) * (da / (da - db));
+  }
+  if (count < 3)
+    return;
+
+  float depth = 0.0f;
+  float x[5];
+  float y[5];
+  for (int i = 0; i < count; ++i) {
+    depth = std::max(depth, polygon[i].w);
+    x[i] = (polygon[i].x / polygon[i].w * 0.5f + 0.5f) * static_cast<float>(kWidth);
+    y[i] = (polygon[i].y / polygon[i].w * 0.5f + 0.5f) * static_cast<float>(kHeight);
+  }
+  for (int i = 1; i + 1 < count; ++i)
+    triangles_.push_back({ { x[0], x[i], x[i + 1] }, { y[0], y[i], y[i + 1] }, depth });
+}
+
+void OcclusionCuller::Rasterize(JobSystem* jobs) {
+  depth_.assign(static_cast<size_t>(kWidth * kHeight), FLT_MAX);
+  constexpr int kBands = (kHeight + kBandRows - 1) / kBandRows;
+  if (!jobs) {
+    RasterizeRows(0, kHeight);
+    return;
+  }
+  jobs->ParallelFor(kBands, 1, [this](size_t begin, size_t end) {
+    RasterizeRows(static_cast<int>(begin) * kBandRows, std::min(static_cast<int>(end) * kBandRows, kHeight));
+  });
+}
+
+void OcclusionCuller::RasterizeRows(int begin, int end) {
+  for (const Triangle& triangle : triangles_) {
+    const float min_y = std::min({ triangle.y[0], triangle.y[1], triangle.y[2] });
+    const float max_y = std::max({ triangle.y[0], triangle.y[1], triangle.y[2] });
+    const float min_x = std::min({ triangle.x[0], triangle.x[1], triangle.x[2] });
+    const float max_x = std::max({ triangle.x[0], triangle.x[1], triangle.x[2] });
+    // Pixels whose centres are inside the bounds; only those can be covered.
+    const int y0 = std::max(begin, static_cast<int>(std::ceil(min_y - 0.5f)));
+    const int y1 = std::min(end - 1, static_cast<int>(std::floor(max_y - 0.5f)));
+    const int x0 = std::max(0, static_cast<int>(std::ceil(min_x - 0.5f)));
+    const int x1 = std::min(kWidth - 1, static_cast<int>(std::floor(max_x - 0.5f)));
+    if (y0 > y1 || x0 > x1)
+      continue;
+
+    // Edge functions a * x + b * y + c, positive inside whatever the winding. A pixel
+    // is covered only if its whole square is inside: its centre is at least half a
+    // pixel in, along each edge's axes.
+    const float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+                       (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+    if (std::fabs(area) < 1e-6f)
+      continue;
+    const float sign = area > 0.0f ? 1.0f : -1.0f;
+    float a[3];
+    float b[3];
+    float c[3];
+    float threshold[3];
+    for (int i = 0; i < 3; ++i) {
+      const int j = (i + 1) % 3;
+      a[i] = -(triangle.y[j] - triangle.y[i]) * sign;
+      b[i] = (triangle.x[j] - triangle.x[i]) * sign;
+      c[i] = -(a[i] * triangle.x[i] + b[i] * triangle.y[i]);
+      threshold[i] = 0.5f * (std::fabs(a[i]) + std::fabs(b[i]));
+    }
+
+    const float depth = triangle.depth;
+    for (int y = y0; y <= y1; ++y) {
+      const float py = static_cast<float>(y) + 0.5f;
+      const float row0 = b[0] * py + c[0];
+      const float row1 = b[1] * py + c[1];
+      const float row2 = b[2] * py + c[2];
+      float* row = depth_.data() + static_cast<size_t>(y) * kWidth;
+      // Branch-free so the compiler vectorizes it across the row.
+      for (int x = x0; x <= x1; ++x) {
+        const float px = static_cast<float>(x) + 0.5f;
+        const bool inside = a[0] * px + row0 >= threshold[0] && a[1] * px + row1 >= threshold[1] &&
+                            a[2] * px + row2 >= threshold[2];
+        row[x] = inside && depth < row[x] ? depth : row[x];
+      }
+    }
+  }
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3& min, const glm::vec3& max) const {
+  float min_x = FLT_MAX;
+  float max_x = -FLT_MAX;
+  float min_y = FLT_MAX;
+  float max_y = -FLT_MAX;
+  float nearest = FLT_MAX;
+  for (int i = 0; i < 8; ++i) {
+    const glm::vec3 corner(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+    const glm::vec4 clip = projection_view_ * glm::vec4(corner, 1.0f);
+    // Reaching behind the near plane: its screen bounds are unbounded.
+    if (clip.z + clip.w < 0.0f)
+      return true;
+    const float x = (clip.x / clip.w * 0.5f + 0.5f) * static_cast<float>(kWidth);
+    const float y = (clip.y / clip.w * 0.5f + 0.5f) * static_cast<float>(kHeight);
+    min_x = std::min(min_x, x);
+    max_x = std::max(max_x, x);
+    min_y = std::min(min_y, y);
+    max_y = std::max(max_y, y);
+    nearest = std::min(nearest, clip.w);
+  }
+
+  // Every pixel the bounds touch.
+  const int x0 = std::max(0, static_cast<int>(std::floor(min_x)));
+  const int x1 = std::min(kWidth - 1, static_cast<int>(std::ceil(max_x)) - 1);
+  const int y0 = std::max(0, static_cast<int>(std::floor(min_y)));
+  const int y1 = std::min(kHeight - 1, static_cast<int>(std::ceil(max_y)) - 1);
+  if (x0 > x1 || y0 > y1)
+    return false;
+
+  for (int y = y0; y <= y1; ++y) {
+    const float* row = depth_.data() + static_cast<size_t>(y) * kWidth;
+    int open = 0;
+    for (int x = x0; x <= x1; ++x)
+      open += row[x] >= nearest ? 1 : 0;
+    if (open > 0)
+      return true;
+  }
+  return false;
+}
+
+bool OcclusionCuller::IsSectionVisible(int32_t x, int32_t section, int32_t z) const {
+  const glm::vec3 min = glm::vec3(static_cast<float>(x * static_cast<int32_t>(kChunkWidth)),
+                                  static_cast<float>(section * static_cast<int32_t>(kSectionHeight)),
+                                  static_cast<float>(z * static_cast<int32_t>(kChunkDepth))) -
+                        glm::vec3(0.5f);
+  return IsVisible(min, min + glm::vec3(kChunkWidth, kSectionHeight, kChunkDepth));
+}
+
+}  // namespace heh
@@ -0,0 +1,83 @@
+#include "core/player.hpp"
+
+#include "core/keys_n_mouse.hpp"
+
+// std
+#include <algorithm>
+
+namespace heh {
+
+// Walking speed in blocks per second; flying with [Left Ctrl] is kSprintFactor times faster.
+static constexpr float kWalkSpeed = 5.0f;
+static constexpr float kSprintFactor = 4.0f;
+// Lifts the feet a little over one block.
+static constexpr float kJumpSpeed = 8.5f;
+// Ticks simulated in one frame at most, so a long stall does not snowball into longer frames.
+static constexpr int kMaxTicksPerFrame = 5;
+
+Player::Player(const glm::vec3& feet) : previous_position_(feet) {
+  body_.position = feet;
+  body_.gravity = !flying_;
+}
+
+void Player::ToggleFlying() {
+  flying_ = !flying_;
+  body_.gravity = !flying_;
+  body_.velocity = glm::vec3(0.0f);
+}
+
+void Player::Update(const world::World& world, Camera& camera, double frame_seconds) {
+  accumulator_ += frame_seconds;
+
+  world::BlockAccessor blocks(world);
+  int ticks = 0;
+  while (accumulator_ >= kTickSeconds) {
+    if (ticks++ == kMaxTicksPerFrame) {
+      accumulator_ = 0.0;
+      break;
+    }
+    previous_position_ = body_.position;
+    Tick(blocks, camera);
+    accumulator_ -= kTickSeconds;
+  }
+
+  const float alpha = static_cast<float>(accumulator_ / kTickSeconds);
+  const glm::vec3 feet = glm::mix(previous_position_, body_.position, alpha);
+  camera.SetPos(feet + glm::vec3(0.0f, kEyeHeight, 0.0f));
+}
+
+void Player::Tick(world::BlockAccessor& blocks, const Camera& camera) {
+  const glm::vec3& front = camera.GetFront();
+  glm::vec3 forward(front.x, 0.0f, front.z);
+  forward = glm::dot(forward, forward) > 1e-6f ? glm::normalize(forward) : glm::vec3(0.0f);
+  const glm::vec3 right = glm::normalize(glm::cross(front, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+  glm::vec3 wish(0.0f);
+  if (Keyboard::IsKeyHeld(Keyboard::Key::kW)) wish += forward;
+  if (Keyboard::IsKeyHeld(Keyboard::Key::kS)) wish -= forward;
+  if (Keyboard::IsKeyHeld(Keyboard::Key::kD)) wish += right;
+  if (Keyboard::IsKeyHeld(Keyboard::Key::kA)) wish -= right;
+  if (glm::dot(wish, wish) > 1e-6f)
+    wish = glm::normalize(wish);
+
+  float speed = kWalkSpeed;
+  if (flying_ && Keyboard::IsKeyHeld(Keyboard::Key::kLeftControl))
+    speed *= kSprintFactor;
+
+  body_.velocity.x = wish.x * speed;
+  body_.velocity.z = wish.z * speed;
+
+  if (flying_) {
+    body_.velocity.y = 0.0f;
+    if (Keyboard::IsKeyHeld(Keyboard::Key::kSpace))
+      body_.velocity.y += speed;
+    if (Keyboard::IsKeyHeld(Keyboard::Key::kLeftShift))
+      body_.velocity.y -= speed;
+  } else if (body_.on_ground && Keyboard::IsKeyHeld(Keyboard::Key::kSpace)) {
+    body_.velocity.y = kJumpSpeed;
+  }
+
+  world::StepBody(blocks, body_, static_cast<float>(kTickSeconds));
+}
+
+}  // namespace heh
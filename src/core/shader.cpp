@@ -1,5 +1,9 @@
 #include "core/shader.hpp"
 
+// std
+#include <algorithm>
+#include <cstring>
+
 namespace heh {
 
 Shader::Shader(const std::string& vertex_path, const std::string& fragment_path) {
@@ -86,39 +90,106 @@ Shader::Shader(const std::string& vertex_path, const std::string& fragment_path)
   glDeleteShader(vertex);
   glDeleteShader(fragment);
 
+  // 3. Reflect the uniforms once. Members of uniform blocks have no location and are
+  // left out.
+  GLint count = 0;
+  GLint max_length = 0;
+  glGetProgramiv(id_, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+  std::vector<GLchar> name_buffer(static_cast<size_t>(std::max(max_length, 1)));
+  for (GLint i = 0; i < count; ++i) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(id_, static_cast<GLuint>(i), static_cast<GLsizei>(name_buffer.size()), &length, &size, &type,
+                       name_buffer.data());
+    std::string name(name_buffer.data(), static_cast<size_t>(length));
+    const GLint location = glGetUniformLocation(id_, name.c_str());
+    if (location < 0)
+      continue;
+    const int index = static_cast<int>(uniforms_.size());
+    uniforms_.push_back({ location });
+    uniform_indices_[name] = index;
+    if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+      uniform_indices_[name.substr(0, name.size() - 3)] = index;
+  }
+
+  const GLuint frame_block = glGetUniformBlockIndex(id_, "FrameData");
+  if (frame_block != GL_INVALID_INDEX)
+    glUniformBlockBinding(id_, frame_block, kFrameDataBinding);
+
 } // Shader::Shader
 
 Shader::~Shader() { glDeleteProgram(id_); }
 void Shader::Use() const { glUseProgram(id_); }
 GLuint Shader::GetID() const { return id_; }
 
-// Utility uniform functions
-void Shader::SetBool(const std::string &name, bool value) const {
-  glUniform1i(glGetUniformLocation(id_, name.c_str()), (int)value);
+Shader::Uniform Shader::GetUniform(const std::string& name) const {
+  auto it = uniform_indices_.find(name);
+  return it == uniform_indices_.end() ? Uniform{} : Uniform{ it->second };
 }
 
-void Shader::SetInt(const std::string &name, int value) const {
-  glUniform1i(glGetUniformLocation(id_, name.c_str()), value);
+template <typename T>
+GLint Shader::Update(Uniform uniform, const T& value) {
+  static_assert(sizeof(T) <= sizeof(CachedUniform::value), "Uniform too large to cache");
+  if (uniform.index < 0 || static_cast<size_t>(uniform.index) >= uniforms_.size())
+    return -1;
+  CachedUniform& cached = uniforms_[static_cast<size_t>(uniform.index)];
+  if (cached.set && std::memcmp(cached.value.data(), &value, sizeof(T)) == 0)
+    return -1;
+  std::memcpy(cached.value.data(), &value, sizeof(T));
+  cached.set = true;
+  return cached.location;
 }
 
-void Shader::SetFloat(const std::string &name, float value) const {
-  glUniform1f(glGetUniformLocation(id_, name.c_str()), value);
+// Utility uniform functions. The program need not be in use: they go through
+// glProgramUniform.
+void Shader::SetBool(Uniform uniform, bool value) {
+  SetInt(uniform, static_cast<int>(value));
 }
 
-void Shader::SetVec2(const std::string &name, const glm::vec2 &value) const {
-  glUniform2fv(glGetUniformLocation(id_, name.c_str()), 1, &value[0]);
+void Shader::SetInt(Uniform uniform, int value) {
+  const GLint location = Update(uniform, value);
+  if (location >= 0)
+    glProgramUniform1i(id_, location, value);
 }
 
-void Shader::SetVec3(const std::string &name, const glm::vec3 &value) const {
-  glUniform3fv(glGetUniformLocation(id_, name.c_str()), 1, &value[0]);
+void Shader::SetFloat(Uniform uniform, float value) {
+  const GLint location = Update(uniform, value);
+  if (location >= 0)
+    glProgramUniform1f(id_, location, value);
 }
 
-void Shader::SetVec4(const std::string &name, const glm::vec4 &value) const {
-  glUniform4fv(glGetUniformLocation(id_, name.c_str()), 1, &value[0]);
+void Shader::SetVec2(Uniform uniform, const glm::vec2 &value) {
+  const GLint location = Update(uniform, value);
+  if (location >= 0)
+    glProgramUniform2fv(id_, location, 1, &value[0]);
 }
 
-void Shader::SetMat4(const std::string &name, const glm::mat4 &mat) const {
-  glUniformMatrix4fv(glGetUniformLocation(id_, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void Shader::SetVec3(Uniform uniform, const glm::vec3 &value) {
+  const GLint location = Update(uniform, value);
+  if (location >= 0)
+    glProgramUniform3fv(id_, location, 1, &value[0]);
 }
 
-}  // namespace heh
\ No newline at end of file
+void Shader::SetVec4(Uniform uniform, const glm::vec4 &value) {
+  const GLint location = Update(uniform, value);
+  if (location >= 0)
+    glProgramUniform4fv(id_, location, 1, &value[0]);
+}
+
+void Shader::SetMat4(Uniform uniform, const glm::mat4 &mat) {
+  const GLint location = Update(uniform, mat);
+  if (location >= 0)
+    glProgramUniformMatrix4fv(id_, location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::SetBool(const std::string &name, bool value) { SetBool(GetUniform(name), value); }
+void Shader::SetInt(const std::string &name, int value) { SetInt(GetUniform(name), value); }
+void Shader::SetFloat(const std::string &name, float value) { SetFloat(GetUniform(name), value); }
+void Shader::SetVec2(const std::string &name, const glm::vec2 &value) { SetVec2(GetUniform(name), value); }
+void Shader::SetVec3(const std::string &name, const glm::vec3 &value) { SetVec3(GetUniform(name), value); }
+void Shader::SetVec4(const std::string &name, const glm::vec4 &value) { SetVec4(GetUniform(name), value); }
+void Shader::SetMat4(const std::string &name, const glm::mat4 &mat) { SetMat4(GetUniform(name), mat); }
+
+}  // namespace heh
@@ -0,0 +1,113 @@
+#include "core/visibility_graph.hpp"
+
+// std
+#include <chrono>
+#include <cmath>
+
+namespace heh {
+
+// Unit steps of each SectionFace: chunk x, section y, chunk z.
+static constexpr int32_t kFaceSteps[kSectionFaceCount][3] = {
+  { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }, { -1, 0, 0 }, { 1, 0, 0 },
+};
+
+void VisibilityGraph::Set(int32_t x, int32_t z, const Connectivity& sections) {
+  chunks_[world::PackChunkKey(x, z)] = sections;
+}
+
+void VisibilityGraph::Remove(int32_t x, int32_t z) {
+  chunks_.erase(world::PackChunkKey(x, z));
+}
+
+void VisibilityGraph::Traverse(const glm::vec3& eye, const Frustum& frustum, int32_t radius) {
+  const auto start = std::chrono::steady_clock::now();
+  stats_ = VisibilityStats{};
+
+  // Blocks span [p - 0.5, p + 0.5] around their integer position, as in the mesher.
+  const glm::vec3 block = eye + glm::vec3(0.5f);
+  center_x_ = static_cast<int32_t>(std::floor(block.x / static_cast<float>(kChunkWidth)));
+  center_z_ = static_cast<int32_t>(std::floor(block.z / static_cast<float>(kChunkDepth)));
+  radius_ = radius;
+  const int32_t side = 2 * radius_ + 1;
+
+  // Columns are looked up once per frame, not once per step.
+  columns_.assign(static_cast<size_t>(side * side), nullptr);
+  for (int32_t dz = -radius_; dz <= radius_; ++dz) {
+    for (int32_t dx = -radius_; dx <= radius_; ++dx) {
+      auto it = chunks_.find(world::PackChunkKey(center_x_ + dx, center_z_ + dz));
+      if (it != chunks_.end())
+        columns_[static_cast<size_t>((dz + radius_) * side + dx + radius_)] = &it->second;
+    }
+  }
+  visible_.assign(columns_.size(), 0);
+
+  // From above or below the world, or an unknown chunk, there is nothing to start from.
+  const int32_t start_section = static_cast<int32_t>(std::floor(block.y / static_cast<float>(kSectionHeight)));
+  const int32_t start_column = radius_ * side + radius_;
+  all_visible_ = start_section < 0 || start_section >= static_cast<int32_t>(kSectionsPerChunk) ||
+                 !columns_[static_cast<size_t>(start_column)];
+  if (all_visible_) {
+    stats_.fallback = true;
+    stats_.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return;
+  }
+
+  queue_.clear();
+  queue_.push_back({ start_column, start_section, static_cast<uint8_t>(kSectionFaceCount), 0 });
+  visible_[static_cast<size_t>(start_column)] |= static_cast<uint16_t>(1u << start_section);
+
+  for (size_t head = 0; head < queue_.size(); ++head) {
+    const Step step = queue_[head];
+    const uint16_t connectivity = (*columns_[static_cast<size_t>(step.column)])[static_cast<size_t>(step.section)];
+    const int32_t column_x = step.column % side;
+    const int32_t column_z = step.column / side;
+
+    for (int face = 0; face < kSectionFaceCount; ++face) {
+      // Opposite faces differ in the lowest bit.
+      if (step.directions & (1u << (face ^ 1)))
+        continue;
+      if (step.entry != kSectionFaceCount && !(connectivity & SectionFacePairBit(step.entry, face))) {
+        ++stats_.closed_rejected;
+        continue;
+      }
+
+      const int32_t x = column_x + kFaceSteps[face][0];
+      const int32_t section = step.section + kFaceSteps[face][1];
+      const int32_t z = column_z + kFaceSteps[face][2];
+      if (x < 0 || x >= side || z < 0 || z >= side || section < 0 || section >= static_cast<int32_t>(kSectionsPerChunk))
+        continue;
+      const int32_t column = z * side + x;
+      if (!columns_[static_cast<size_t>(column)] || (visible_[static_cast<size_t>(column)] >> section & 1))
+        continue;
+
+      const glm::vec3 min =
+          glm::vec3(static_cast<float>((center_x_ + x - radius_) * static_cast<int32_t>(kChunkWidth)),
+                    static_cast<float>(section * static_cast<int32_t>(kSectionHeight)),
+                    static_cast<float>((center_z_ + z - radius_) * static_cast<int32_t>(kChunkDepth))) -
+          glm::vec3(0.5f);
+      if (!frustum.IsBoxVisible(min, min + glm::vec3(kChunkWidth, kSectionHeight, kChunkDepth))) {
+        ++stats_.frustum_rejected;
+        continue;
+      }
+
+      visible_[static_cast<size_t>(column)] |= static_cast<uint16_t>(1u << section);
+      queue_.push_back({ column, section, static_cast<uint8_t>(face ^ 1),
+                         static_cast<uint8_t>(step.directions | (1u << face)) });
+    }
+  }
+
+  stats_.sections_visited = queue_.size();
+  stats_.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint16_t VisibilityGraph::GetVisibleSections(int32_t x, int32_t z) const {
+  if (all_visible_)
+    return 0xffff;
+  const int32_t dx = x - center_x_;
+  const int32_t dz = z - center_z_;
+  if (radius_ < 0 || dx < -radius_ || dx > radius_ || dz < -radius_ || dz > radius_)
+    return 0;
+  return visible_[static_cast<size_t>((dz + radius_) * (2 * radius_ + 1) + dx + radius_)];
+}
+
+}  // namespace heh
@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 
 // std
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 #include <filesystem>
@@ -14,6 +15,17 @@ using namespace glm;
 
 namespace heh {
 
+// Meshes taken from the streamer while the renderer still has fewer than this queued;
+// the renderer's byte budget decides how many go to the GPU each frame.
+static constexpr size_t kMaxPendingUploads = 8;
+// Smallest per-frame upload budget, in KiB, whatever the config says.
+static constexpr int kMinUploadBudget = 64;
+// How far away blocks can be picked, in blocks.
+static constexpr float kPickReach = 8.0f;
+// Block ticks per second, and the most run in one frame to catch up after a stall.
+static constexpr double kBlockTickRate = 20.0;
+static constexpr int kMaxBlockTicksPerFrame = 4;
+
 static void PrintOpenGLInfo() {
   const GLubyte* renderer = glGetString(GL_RENDERER);
   const GLubyte* vendor = glGetString(GL_VENDOR);
@@ -54,7 +66,7 @@ Window::Window(int width, int height, const std::string &window_name)
     window_{nullptr}, 
     camera_(
         camera_data_, 
-        glm::vec3(0.0f, 0.0f, 3.0f), 
+        glm::vec3(0.0f, static_cast<float>(kChunkHeight) + 2.0f, 3.0f), 
         -90.0f,   // yaw
         0.0f,     // pitch
         0.1f,       // z_near
@@ -123,23 +135,56 @@ void Window::Run() {
   image_writer.CreateAtlas("textures", "atlas.png");
   assert(image_writer.GetAtlasSize() == kAtlasSize && "kAtlasSize must be updated");
 
-  Chunk chunk;
-  chunk.Generate();
-  chunk.UploadToGpu();
-  chunk.ClearCpuData();
+  // The atlas rewrote the texture uvs, refresh the tables the mesher reads.
+  block_map::LoadBlocks();
+
+  world::TerrainGenerator generator(static_cast<uint32_t>(config::file.world.seed));
+  Player player(glm::vec3(0.0f, static_cast<float>(generator.GetHeight(0, 0)) + 1.0f, 3.0f));
+  player_ = &player;
+
+  JobSystem jobs;
+  world::ChunkStreamer streamer(world_, generator, jobs, config::file.world);
+  world::TickScheduler ticks(world_, streamer, jobs, static_cast<uint32_t>(config::file.world.seed),
+                             config::file.world.random_tick_speed);
+  ticks_ = &ticks;
+  place_block_ = static_cast<BlockId>(block_map::FindBlockId("cobblestone", 1));
+  ChunkRenderer chunk_renderer(static_cast<size_t>(std::max(config::file.window.upload_budget, kMinUploadBudget)) * 1024,
+                               static_cast<size_t>(std::max(config::file.window.mesh_memory, 0)) << 20,
+                               config::file.window.keep_evicted_meshes);
+  chunk_renderer_ = &chunk_renderer;
+  chunk_renderer.SetVisibilityRadius(config::file.world.render_distance + config::file.world.unload_margin);
+  chunk_renderer.SetJobSystem(&jobs);
 
   Shader shader("shaders/specular.vert", "shaders/specular.frag");
-  
-  shader.Use();
-  shader.SetInt("texture1", 0);
+  shader.SetInt(shader.GetUniform("texture_diffuse1"), 0);
+
+  // The lights do not change; only the camera is written each frame.
+  FrameUniforms frame;
+  frame.light_color = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+  frame.light_pos = glm::vec4(4.2f, 300.0f, 2.0f, 1.0f);
+  frame.dir_light_direction = glm::vec4(-0.2f, 0.7f, 0.6f, 0.0f);
+  frame.dir_light_color = glm::vec4(1.0f, 0.95f, 0.85f, 0.0f);
+  UniformBuffer frame_uniforms(sizeof(FrameUniforms), Shader::kFrameDataBinding);
 
   while (!glfwWindowShouldClose(window_)) {
     CalculateDeltaTime();
     CalculateFPS();
 
+    player.Update(world_, camera_, camera_data_.delta_time);
     camera_.LookAt();
     camera_.ProjectionMatrix();
-    camera_.HandleKeys();
+
+    streamer.Update(camera_.GetPos(), camera_.GetFront(), current_time_);
+    block_tick_time_ = std::min(block_tick_time_ + camera_data_.delta_time, kMaxBlockTicksPerFrame / kBlockTickRate);
+    for (; block_tick_time_ >= 1.0 / kBlockTickRate; block_tick_time_ -= 1.0 / kBlockTickRate)
+      ticks.Tick();
+    HandleMouse(Mouse::GetX(), Mouse::GetY());
+    for (world::ChunkKey key : streamer.PopUnloaded())
+      chunk_renderer.Remove(world::ChunkKeyX(key), world::ChunkKeyZ(key));
+    streamer.RemeshChunks(chunk_renderer.PopRebuilds());
+    const size_t pending = chunk_renderer.GetPendingUploads();
+    for (auto& mesh : streamer.PopReadyMeshes(pending < kMaxPendingUploads ? kMaxPendingUploads - pending : 0))
+      chunk_renderer.Upload(mesh.x, mesh.z, std::move(mesh.data));
 
     if (dark_background_mode_)
       glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
@@ -147,30 +192,24 @@ void Window::Run() {
       glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    frame.view = camera_data_.view;
+    frame.projection = camera_data_.projection;
+    frame.view_pos = glm::vec4(camera_.GetPos(), 1.0f);
+    frame_uniforms.Update(&frame);
     shader.Use();
-    shader.SetMat4("view", camera_data_.view);
-    shader.SetMat4("projection", camera_data_.projection);
-    shader.SetVec3("lightColor", glm::vec3(1.0f, 1.0f, 1.0f));
-    shader.SetVec3("lightPos", glm::vec3(4.2f, 300.0f, 2.0f));
-    shader.SetVec3("viewPos", camera_.GetPos());
-
-    shader.SetVec3("dirLightDirection", glm::vec3(-0.2f, 0.7f, 0.6f));
-    shader.SetVec3("dirLightColor", glm::vec3(1.0f, 0.95f, 0.85f));
-
-    glm::mat4 model = glm::mat4(1.0f);
-    shader.SetMat4("model", model);
 
     image_writer.BindAtlas();
 
-    chunk.Render();
-    //vao.Bind();
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+    chunk_renderer.Render(camera_.GetFrustum(), camera_.GetPos());
 
     glBindTexture(GL_TEXTURE_2D, 0);
 
     glfwSwapBuffers(window_);
     glfwPollEvents();
   }
+  chunk_renderer_ = nullptr;
+  ticks_ = nullptr;
+  player_ = nullptr;
 }
 
 void Window::HandleKeys() {  
@@ -190,6 +229,10 @@ void Window::HandleKeys() {
   if (keyboard_.IsKeyPressed(Keyboard::Key::kF2))
     dark_background_mode_ = !dark_background_mode_;
 
+  // [F3] Toggle between flying and walking
+  if (keyboard_.IsKeyPressed(Keyboard::Key::kF3) && player_)
+    player_->ToggleFlying();
+
   // [F11] Toggle fullscreen mode
   if (keyboard_.IsKeyPressed(Keyboard::Key::kF11)) {
     config::file.window.fullscreen = !config::file.window.fullscreen;
@@ -226,12 +269,33 @@ void Window::HandleKeys() {
 }
 
 void Window::HandleMouse(double xpos, double ypos) {
-  glm::vec3 ray_direction = camera_.GetRay(xpos, ypos, width_, height_);
-  glm::vec3 ray_origin = camera_.GetPos();
-
-  glm::vec3 hit_pos, hit_normal;
+  // With the cursor captured, pick what is under the screen centre.
+  if (!camera_data_.show_cursor) {
+    xpos = width_ * 0.5;
+    ypos = height_ * 0.5;
+  }
+  const world::Ray ray{ camera_.GetPos(), camera_.GetRay(xpos, ypos, width_, height_) };
+  world::Raycast(world_, ray, kPickReach, picked_);
+}
 
+void Window::EditPickedBlock(int button) {
+  if (!ticks_ || !picked_.hit)
+    return;
 
+  if (button == GLFW_MOUSE_BUTTON_LEFT) {
+    ticks_->SetBlock(picked_.block, kAirBlock);
+  } else if (button == GLFW_MOUSE_BUTTON_RIGHT && picked_.normal != glm::ivec3(0)) {
+    const glm::ivec3 target = picked_.block + picked_.normal;
+    const glm::vec3 centre(target);
+    // Don't place a block into the player.
+    const world::Aabb body = player_ ? player_->GetBody().GetBounds() : world::Aabb{ camera_.GetPos(), camera_.GetPos() };
+    bool overlaps = true;
+    for (int axis = 0; axis < 3; ++axis)
+      overlaps = overlaps && body.min[axis] < centre[axis] + 0.5f && body.max[axis] > centre[axis] - 0.5f;
+    if (!overlaps)
+      ticks_->SetBlock(target, place_block_);
+  }
+  picked_.hit = false;  // Picked again next frame, against the edited world.
 }
 
 void Window::FramebufferResizeCallback(GLFWwindow* glfw_window, int width, int height) {
@@ -264,6 +328,9 @@ void Window::KeyCallback(GLFWwindow* window, int key, int scancode, int action,
 void Window::MouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
   auto window_ptr = reinterpret_cast<Window*>(glfwGetWindowUserPointer(window));
   window_ptr->mouse_.HandleMouseButton(button, action, mods);
+
+  if (action == GLFW_PRESS)
+    window_ptr->EditPickedBlock(button);
 }
 
 void Window::CursorPositionCallback(GLFWwindow* window, double xpos, double ypos) {
@@ -272,7 +339,6 @@ void Window::CursorPositionCallback(GLFWwindow* window, double xpos, double ypos
 
   // Handle mouse input for the camera and the window
   window_ptr->camera_.HandleMousePosition(xpos, ypos);
-  window_ptr->HandleMouse(xpos, ypos);
 }
 
 void Window::ScrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
@@ -294,6 +360,15 @@ void Window::CalculateFPS() {
   if (current_time_ - last_fps_update_time_ >= 1.0) {
     double fps = nb_frames_ / (current_time_ - last_fps_update_time_);
     std::string new_title = config::file.window.window_name + " - FPS: " + std::to_string(static_cast<int>(fps));
+    if (chunk_renderer_) {
+      const ChunkDrawStats& draws = chunk_renderer_->GetStats();
+      new_title += " - chunks drawn: " + std::to_string(draws.drawn) + "/" + std::to_string(draws.meshes) +
+                   " (" + std::to_string(draws.occluded) + " occluded), sections: " +
+                   std::to_string(draws.sections_drawn) + " in " + std::to_string(draws.draw_calls) + " draws";
+      const ResidencyStats& residency = chunk_renderer_->GetResidencyStats();
+      new_title += ", meshes: " + std::to_string(residency.resident_bytes >> 20) + " MiB (" +
+                   std::to_string(residency.evicted) + " evicted)";
+    }
     glfwSetWindowTitle(window_, new_title.c_str());
     last_fps_update_time_ = current_time_;
     nb_frames_ = 0;
@@ -0,0 +1,155 @@
+#include "net/client.hpp"
+
+// std
+#include <algorithm>
+#include <memory>
+
+namespace heh {
+
+  namespace net {
+
+    Client::Client(const std::string& address, int view_radius)
+      : connection_(Socket::Connect(address)),
+        view_radius_(std::clamp(view_radius, 1, 255))
+    {
+      std::vector<uint8_t>& out = connection_.GetOutput();
+      const size_t message = BeginMessage(out, MessageType::kHello);
+      ByteWriter writer(out);
+      writer.PutU16(kProtocolVersion);
+      writer.PutU8(static_cast<uint8_t>(view_radius_));
+      EndMessage(out, message);
+      connection_.Flush();
+    }
+
+    void Client::SendPosition(const glm::vec3& pos)
+    {
+      std::vector<uint8_t>& out = connection_.GetOutput();
+      const size_t message = BeginMessage(out, MessageType::kPosition);
+      ByteWriter writer(out);
+      writer.PutF32(pos.x);
+      writer.PutF32(pos.y);
+      writer.PutF32(pos.z);
+      EndMessage(out, message);
+    }
+
+    bool Client::Poll()
+    {
+      const bool ok = connection_.Flush() &&
+                      connection_.Poll([this](MessageType type, ByteReader& payload) { return Handle(type, payload); });
+      // Nothing else holds chunk pointers between polls.
+      world_.ReclaimRetired();
+      return ok;
+    }
+
+    std::vector<world::ChunkKey> Client::PopChangedChunks()
+    {
+      std::sort(changed_.begin(), changed_.end());
+      changed_.erase(std::unique(changed_.begin(), changed_.end()), changed_.end());
+      std::vector<world::ChunkKey> out;
+      out.swap(changed_);
+      return out;
+    }
+
+    void Client::AddChangedArea(int32_t x, int32_t z)
+    {
+      // The border faces of the neighbours' meshes depend on this chunk too.
+      for (int32_t dz = -1; dz <= 1; ++dz)
+      {
+        for (int32_t dx = -1; dx <= 1; ++dx)
+          changed_.push_back(world::PackChunkKey(x + dx, z + dz));
+      }
+    }
+
+    bool Client::Handle(MessageType type, ByteReader& payload)
+    {
+      switch (type)
+      {
+      case MessageType::kWelcome:
+      {
+        if (payload.GetU16() != kProtocolVersion)
+          return false;
+        tick_rate_ = payload.GetU16();
+        view_radius_ = payload.GetU8();
+        spawn_.x = payload.GetF32();
+        spawn_.y = payload.GetF32();
+        spawn_.z = payload.GetF32();
+        welcomed_ = true;
+        return true;
+      }
+      case MessageType::kChunk:
+      {
+        const int32_t x = payload.GetI32();
+        const int32_t z = payload.GetI32();
+        // A chunk sent again, after a bulk edit, replaces the blocks in place.
+        Chunk* existing = world_.GetChunk(x, z);
+        if (existing)
+        {
+          if (!DecodeChunk(payload, *existing))
+            return false;
+        }
+        else
+        {
+          auto chunk = std::make_unique<Chunk>();
+          chunk->x = x;
+          chunk->z = z;
+          if (!DecodeChunk(payload, *chunk))
+            return false;
+          chunk->status = ChunkStatus::kFeatures;
+          world_.InsertChunk(std::move(chunk));
+        }
+        AddChangedArea(x, z);
+        ++stats_.chunks;
+        return true;
+      }
+      case MessageType::kForgetChunk:
+      {
+        const int32_t x = payload.GetI32();
+        const int32_t z = payload.GetI32();
+        if (world_.UnloadChunk(x, z))
+        {
+          AddChangedArea(x, z);
+          ++stats_.forgotten;
+        }
+        return true;
+      }
+      case MessageType::kSectionDeltas:
+      {
+        server_tick_ = payload.GetU64();
+        const uint16_t sections = payload.GetU16();
+        for (uint16_t i = 0; i < sections && !payload.Failed(); ++i)
+        {
+          const int32_t x = payload.GetI32();
+          const int32_t z = payload.GetI32();
+          const uint8_t section = payload.GetU8();
+          const uint16_t count = payload.GetU16();
+          Chunk* chunk = world_.GetChunk(x, z);
+          if (section >= kSectionsPerChunk)
+            return false;
+          for (uint16_t j = 0; j < count; ++j)
+          {
+            const uint16_t index = payload.GetU16();
+            const BlockId id = static_cast<BlockId>(payload.GetU16());
+            if (!chunk || index >= kSectionVolume)
+              continue;
+            chunk->blocks_data[section * kSectionVolume + index] = id;
+            // Index is (x << 8) | (z << 4) | y inside the section.
+            world::AppendMeshingChunks(x * static_cast<int32_t>(kChunkWidth) + (index >> 8),
+                                       z * static_cast<int32_t>(kChunkDepth) + ((index >> 4) & 15), changed_);
+          }
+          if (chunk)
+          {
+            ++stats_.delta_sections;
+            stats_.delta_blocks += count;
+          }
+        }
+        return true;
+      }
+      default:
+        // Unknown messages are skipped.
+        return true;
+      }
+    }
+
+  }  // namespace net
+
+}  // namespace heh
@@ -0,0 +1,81 @@
+#include "net/connection.hpp"
+
+namespace heh {
+
+  namespace net {
+
+    bool Connection::Flush()
+    {
+      while (out_offset_ < out_.size())
+      {
+        const long sent = socket_.Send(out_.data() + out_offset_, out_.size() - out_offset_);
+        if (sent < 0)
+        {
+          socket_.Close();
+          return false;
+        }
+        if (sent == 0)
+          break;
+        out_offset_ += static_cast<size_t>(sent);
+        bytes_sent_ += static_cast<uint64_t>(sent);
+      }
+
+      // Drop what was sent once it is the larger part of the buffer, so the copy stays
+      // cheap against the bytes that were sent.
+      if (out_offset_ == out_.size())
+      {
+        out_.clear();
+        out_offset_ = 0;
+      }
+      else if (out_offset_ > out_.size() / 2)
+      {
+        out_.erase(out_.begin(), out_.begin() + static_cast<std::ptrdiff_t>(out_offset_));
+        out_offset_ = 0;
+      }
+      return true;
+    }
+
+    bool Connection::Poll(const Handler& handler)
+    {
+      uint8_t buffer[64 * 1024];
+      bool closed = false;
+      for (;;)
+      {
+        const long received = socket_.Receive(buffer, sizeof(buffer));
+        // Messages that arrived before the close are still handled.
+        closed = received < 0;
+        if (received <= 0)
+          break;
+        in_.insert(in_.end(), buffer, buffer + received);
+        bytes_received_ += static_cast<uint64_t>(received);
+      }
+
+      size_t offset = 0;
+      bool ok = true;
+      while (ok && in_.size() - offset >= 4)
+      {
+        ByteReader header(in_.data() + offset, 4);
+        const uint32_t size = header.GetU32();
+        if (size == 0 || size > kMaxFrameSize)
+        {
+          ok = false;
+          break;
+        }
+        if (in_.size() - offset - 4 < size)
+          break;
+
+        const uint8_t* frame = in_.data() + offset + 4;
+        ByteReader payload(frame + 1, size - 1);
+        ok = handler(static_cast<MessageType>(frame[0]), payload) && !payload.Failed();
+        offset += 4 + size;
+      }
+      in_.erase(in_.begin(), in_.begin() + static_cast<std::ptrdiff_t>(offset));
+
+      if (!ok || closed)
+        socket_.Close();
+      return ok && !closed;
+    }
+
+  }  // namespace net
+
+}  // namespace heh
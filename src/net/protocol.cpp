@@ -0,0 +1,253 @@
+#include "net/protocol.hpp"
+
+#include "world/world.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+namespace heh {
+
+  namespace net {
+
+    void ByteWriter::PutU16(uint16_t v)
+    {
+      out_.push_back(static_cast<uint8_t>(v));
+      out_.push_back(static_cast<uint8_t>(v >> 8));
+    }
+
+    void ByteWriter::PutU32(uint32_t v)
+    {
+      for (int i = 0; i < 4; ++i)
+        out_.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    void ByteWriter::PutU64(uint64_t v)
+    {
+      for (int i = 0; i < 8; ++i)
+        out_.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    void ByteWriter::PutF32(float v)
+    {
+      uint32_t bits;
+      std::memcpy(&bits, &v, sizeof(bits));
+      PutU32(bits);
+    }
+
+    const uint8_t* ByteReader::GetBytes(size_t size)
+    {
+      if (size > size_ - offset_)
+      {
+        failed_ = true;
+        offset_ = size_;
+        return nullptr;
+      }
+      const uint8_t* bytes = data_ + offset_;
+      offset_ += size;
+      return bytes;
+    }
+
+    uint8_t ByteReader::GetU8()
+    {
+      const uint8_t* in = GetBytes(1);
+      return in ? in[0] : 0;
+    }
+
+    uint16_t ByteReader::GetU16()
+    {
+      const uint8_t* in = GetBytes(2);
+      return in ? static_cast<uint16_t>(in[0] | (in[1] << 8)) : 0;
+    }
+
+    uint32_t ByteReader::GetU32()
+    {
+      const uint8_t* in = GetBytes(4);
+      if (!in)
+        return 0;
+      return static_cast<uint32_t>(in[0]) | (static_cast<uint32_t>(in[1]) << 8) | (static_cast<uint32_t>(in[2]) << 16) |
+             (static_cast<uint32_t>(in[3]) << 24);
+    }
+
+    uint64_t ByteReader::GetU64()
+    {
+      const uint64_t low = GetU32();
+      return low | (static_cast<uint64_t>(GetU32()) << 32);
+    }
+
+    float ByteReader::GetF32()
+    {
+      const uint32_t bits = GetU32();
+      float v;
+      std::memcpy(&v, &bits, sizeof(v));
+      return v;
+    }
+
+    size_t BeginMessage(std::vector<uint8_t>& out, MessageType type)
+    {
+      const size_t offset = out.size();
+      out.resize(offset + 4);
+      out.push_back(static_cast<uint8_t>(type));
+      return offset;
+    }
+
+    void EndMessage(std::vector<uint8_t>& out, size_t offset)
+    {
+      const uint32_t size = static_cast<uint32_t>(out.size() - offset - 4);
+      for (int i = 0; i < 4; ++i)
+        out[offset + static_cast<size_t>(i)] = static_cast<uint8_t>(size >> (8 * i));
+    }
+
+    namespace {
+
+      uint32_t BitsFor(size_t palette_size)
+      {
+        uint32_t bits = 0;
+        while ((size_t{ 1 } << bits) < palette_size)
+          ++bits;
+        return bits;
+      }
+
+    }  // namespace
+
+    void EncodeChunk(const Chunk& chunk, ByteWriter& out)
+    {
+      std::vector<BlockId> palette;
+      std::vector<uint16_t> indices(kSectionVolume);
+      std::vector<uint8_t>& buffer = out.GetBuffer();
+
+      for (uint32_t section = 0; section < kSectionsPerChunk; ++section)
+      {
+        const BlockId* blocks = chunk.blocks_data.data() + section * kSectionVolume;
+
+        // Terrain sections hold a handful of ids in long runs, so the last hit is
+        // usually the right one and the linear search rarely runs.
+        palette.clear();
+        uint16_t last = 0;
+        for (uint32_t i = 0; i < kSectionVolume; ++i)
+        {
+          if (palette.empty() || palette[last] != blocks[i])
+          {
+            auto it = std::find(palette.begin(), palette.end(), blocks[i]);
+            if (it == palette.end())
+              it = palette.insert(palette.end(), blocks[i]);
+            last = static_cast<uint16_t>(it - palette.begin());
+          }
+          indices[i] = last;
+        }
+
+        out.PutU16(static_cast<uint16_t>(palette.size()));
+        for (BlockId id : palette)
+          out.PutU16(static_cast<uint16_t>(id));
+
+        const uint32_t bits = BitsFor(palette.size());
+        if (bits == 0)
+          continue;
+        const size_t start = buffer.size();
+        buffer.resize(start + kSectionVolume * bits / 8, 0);
+        uint8_t* packed = buffer.data() + start;
+        size_t bit = 0;
+        for (uint32_t i = 0; i < kSectionVolume; ++i, bit += bits)
+        {
+          // An index spans at most three bytes (bits <= 12).
+          const uint32_t v = static_cast<uint32_t>(indices[i]) << (bit & 7);
+          packed[bit >> 3] |= static_cast<uint8_t>(v);
+          if (v >> 8)
+            packed[(bit >> 3) + 1] |= static_cast<uint8_t>(v >> 8);
+          if (v >> 16)
+            packed[(bit >> 3) + 2] |= static_cast<uint8_t>(v >> 16);
+        }
+      }
+    }
+
+    bool DecodeChunk(ByteReader& in, Chunk& chunk)
+    {
+      chunk.blocks_data.resize(kChunkVolume);
+      std::vector<BlockId> palette;
+      for (uint32_t section = 0; section < kSectionsPerChunk; ++section)
+      {
+        BlockId* blocks = chunk.blocks_data.data() + section * kSectionVolume;
+        const uint16_t palette_size = in.GetU16();
+        if (palette_size == 0 || palette_size > kSectionVolume)
+          return false;
+        palette.resize(palette_size);
+        for (BlockId& id : palette)
+          id = static_cast<BlockId>(in.GetU16());
+
+        const uint32_t bits = BitsFor(palette_size);
+        if (bits == 0)
+        {
+          std::fill_n(blocks, kSectionVolume, palette[0]);
+          continue;
+        }
+        const uint8_t* packed = in.GetBytes(kSectionVolume * bits / 8);
+        if (!packed)
+          return false;
+        const uint32_t mask = (1u << bits) - 1;
+        size_t bit = 0;
+        for (uint32_t i = 0; i < kSectionVolume; ++i, bit += bits)
+        {
+          const size_t byte = bit >> 3;
+          uint32_t v = packed[byte];
+          // Only read the bytes the index reaches into; the last one may end the data.
+          if ((bit & 7) + bits > 8)
+            v |= static_cast<uint32_t>(packed[byte + 1]) << 8;
+          if ((bit & 7) + bits > 16)
+            v |= static_cast<uint32_t>(packed[byte + 2]) << 16;
+          const uint32_t index = (v >> (bit & 7)) & mask;
+          if (index >= palette_size)
+            return false;
+          blocks[i] = palette[index];
+        }
+      }
+      return !in.Failed();
+    }
+
+    std::vector<SectionDelta> CoalesceChanges(const std::vector<world::BlockChange>& changes)
+    {
+      // (chunk key, section) -> index -> id; later changes overwrite earlier ones.
+      std::map<std::pair<world::ChunkKey, uint8_t>, std::map<uint16_t, BlockId>> sections;
+      for (const world::BlockChange& change : changes)
+      {
+        if (static_cast<uint32_t>(change.pos.y) >= kChunkHeight)
+          continue;
+        const uint32_t y = static_cast<uint32_t>(change.pos.y);
+        const uint16_t index = static_cast<uint16_t>(
+          Chunk::Index(world::BlockToLocal(change.pos.x), y, world::BlockToLocal(change.pos.z)) & (kSectionVolume - 1));
+        const auto key = std::make_pair(world::PackChunkKey(world::BlockToChunk(change.pos.x), world::BlockToChunk(change.pos.z)),
+                                        static_cast<uint8_t>(y / kSectionHeight));
+        sections[key][index] = change.id;
+      }
+
+      std::vector<SectionDelta> out;
+      out.reserve(sections.size());
+      for (const auto& [key, blocks] : sections)
+      {
+        out.push_back({ world::ChunkKeyX(key.first), world::ChunkKeyZ(key.first), key.second, {} });
+        out.back().blocks.assign(blocks.begin(), blocks.end());
+      }
+      return out;
+    }
+
+    void EncodeSectionDeltas(uint64_t tick, const std::vector<const SectionDelta*>& sections, ByteWriter& out)
+    {
+      out.PutU64(tick);
+      out.PutU16(static_cast<uint16_t>(sections.size()));
+      for (const SectionDelta* section : sections)
+      {
+        out.PutI32(section->x);
+        out.PutI32(section->z);
+        out.PutU8(section->section);
+        out.PutU16(static_cast<uint16_t>(section->blocks.size()));
+        for (const auto& [index, id] : section->blocks)
+        {
+          out.PutU16(index);
+          out.PutU16(static_cast<uint16_t>(id));
+        }
+      }
+    }
+
+  }  // namespace net
+
+}  // namespace heh
@@ -0,0 +1,280 @@
+#include "net/socket.hpp"
+
+// std
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace heh {
+
+  namespace net {
+
+    namespace {
+
+#ifdef _WIN32
+      using NativeHandle = SOCKET;
+      constexpr NativeHandle kNoSocket = INVALID_SOCKET;
+
+      void EnsureStarted()
+      {
+        static const bool started = [] {
+          WSADATA data;
+          return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+        if (!started)
+          throw std::runtime_error("Failed to start Winsock");
+      }
+
+      void CloseNative(NativeHandle handle) { closesocket(handle); }
+      bool WouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+
+      void SetNonBlocking(NativeHandle handle)
+      {
+        u_long enabled = 1;
+        ioctlsocket(handle, FIONBIO, &enabled);
+      }
+#else
+      using NativeHandle = int;
+      constexpr NativeHandle kNoSocket = -1;
+
+      void EnsureStarted() {}
+      void CloseNative(NativeHandle handle) { close(handle); }
+      bool WouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+
+      void SetNonBlocking(NativeHandle handle)
+      {
+        fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+      }
+#endif
+
+      NativeHandle Native(intptr_t handle) { return static_cast<NativeHandle>(handle); }
+
+      bool IsUnixAddress(const std::string& address) { return address.rfind("unix:", 0) == 0; }
+
+      // Chunk data goes out in bursts of small frames; do not hold them back.
+      void SetNoDelay(NativeHandle handle)
+      {
+        int enabled = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+      }
+
+      /**
+       * @brief Resolves "host:port" to its first TCP address.
+       */
+      addrinfo* Resolve(const std::string& address, bool passive)
+      {
+        const size_t colon = address.rfind(':');
+        if (colon == std::string::npos)
+          throw std::runtime_error("Address needs a port: " + address);
+        const std::string host = address.substr(0, colon);
+        const std::string port = address.substr(colon + 1);
+
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0 || !result)
+          throw std::runtime_error("Failed to resolve address: " + address);
+        return result;
+      }
+
+#ifndef _WIN32
+      sockaddr_un UnixAddress(const std::string& path)
+      {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+          throw std::runtime_error("Unix socket path too long: " + path);
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return addr;
+      }
+#endif
+
+    }  // namespace
+
+    Socket::Socket(Handle handle)
+      : handle_(handle)
+    {
+    }
+
+    Socket::~Socket()
+    {
+      Close();
+    }
+
+    Socket::Socket(Socket&& other) noexcept
+      : handle_(std::exchange(other.handle_, kInvalid))
+    {
+    }
+
+    Socket& Socket::operator=(Socket&& other) noexcept
+    {
+      if (this != &other)
+      {
+        Close();
+        handle_ = std::exchange(other.handle_, kInvalid);
+      }
+      return *this;
+    }
+
+    void Socket::Close()
+    {
+      if (handle_ != kInvalid)
+        CloseNative(Native(handle_));
+      handle_ = kInvalid;
+    }
+
+    Socket Socket::Connect(const std::string& address)
+    {
+      EnsureStarted();
+      NativeHandle handle;
+      if (IsUnixAddress(address))
+      {
+#ifdef _WIN32
+        throw std::runtime_error("Unix sockets are not supported on this platform: " + address);
+#else
+        const sockaddr_un addr = UnixAddress(address.substr(5));
+        handle = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (handle == kNoSocket || connect(handle, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+        {
+          if (handle != kNoSocket)
+            CloseNative(handle);
+          throw std::runtime_error("Failed to connect to " + address);
+        }
+#endif
+      }
+      else
+      {
+        addrinfo* info = Resolve(address, false);
+        handle = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        const bool connected = handle != kNoSocket &&
+                               connect(handle, info->ai_addr, static_cast<int>(info->ai_addrlen)) == 0;
+        freeaddrinfo(info);
+        if (!connected)
+        {
+          if (handle != kNoSocket)
+            CloseNative(handle);
+          throw std::runtime_error("Failed to connect to " + address);
+        }
+        SetNoDelay(handle);
+      }
+      SetNonBlocking(handle);
+      return Socket(static_cast<Handle>(handle));
+    }
+
+    long Socket::Send(const uint8_t* data, size_t size)
+    {
+      if (handle_ == kInvalid)
+        return -1;
+#if defined(MSG_NOSIGNAL)
+      const int flags = MSG_NOSIGNAL;  // A closed peer is an error, not a SIGPIPE.
+#else
+      const int flags = 0;
+#endif
+      const auto sent = send(Native(handle_), reinterpret_cast<const char*>(data), static_cast<int>(size), flags);
+      if (sent >= 0)
+        return static_cast<long>(sent);
+      return WouldBlock() ? 0 : -1;
+    }
+
+    long Socket::Receive(uint8_t* data, size_t size)
+    {
+      if (handle_ == kInvalid)
+        return -1;
+      const auto received = recv(Native(handle_), reinterpret_cast<char*>(data), static_cast<int>(size), 0);
+      if (received > 0)
+        return static_cast<long>(received);
+      if (received == 0)
+        return -1;
+      return WouldBlock() ? 0 : -1;
+    }
+
+    Listener::Listener(const std::string& address)
+      : address_(address)
+    {
+      EnsureStarted();
+      NativeHandle handle;
+      if (IsUnixAddress(address))
+      {
+#ifdef _WIN32
+        throw std::runtime_error("Unix sockets are not supported on this platform: " + address);
+#else
+        unix_path_ = address.substr(5);
+        const sockaddr_un addr = UnixAddress(unix_path_);
+        unlink(unix_path_.c_str());  // Left behind by a server that did not shut down.
+        handle = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (handle == kNoSocket || bind(handle, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(handle, SOMAXCONN) != 0)
+        {
+          if (handle != kNoSocket)
+            CloseNative(handle);
+          throw std::runtime_error("Failed to listen on " + address);
+        }
+#endif
+      }
+      else
+      {
+        addrinfo* info = Resolve(address, true);
+        handle = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        int reuse = 1;
+        if (handle != kNoSocket)
+          setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+        const bool bound = handle != kNoSocket && bind(handle, info->ai_addr, static_cast<int>(info->ai_addrlen)) == 0 &&
+                           listen(handle, SOMAXCONN) == 0;
+        freeaddrinfo(info);
+        if (!bound)
+        {
+          if (handle != kNoSocket)
+            CloseNative(handle);
+          throw std::runtime_error("Failed to listen on " + address);
+        }
+
+        // Report the port the system picked for port 0.
+        sockaddr_in bound_addr{};
+        socklen_t length = sizeof(bound_addr);
+        if (getsockname(handle, reinterpret_cast<sockaddr*>(&bound_addr), &length) == 0)
+          address_ = address.substr(0, address.rfind(':') + 1) + std::to_string(ntohs(bound_addr.sin_port));
+      }
+      SetNonBlocking(handle);
+      handle_ = static_cast<Socket::Handle>(handle);
+    }
+
+    Listener::~Listener()
+    {
+      if (handle_ != Socket::kInvalid)
+        CloseNative(Native(handle_));
+#ifndef _WIN32
+      if (!unix_path_.empty())
+        unlink(unix_path_.c_str());
+#endif
+    }
+
+    Socket Listener::Accept()
+    {
+      const NativeHandle handle = accept(Native(handle_), nullptr, nullptr);
+      if (handle == kNoSocket)
+        return Socket();
+      if (unix_path_.empty())
+        SetNoDelay(handle);
+      SetNonBlocking(handle);
+      return Socket(static_cast<Socket::Handle>(handle));
+    }
+
+  }  // namespace net
+
+}  // namespace heh
@@ -0,0 +1,120 @@
+#include "server/server.hpp"
+#include "world/block.hpp"
+#include "utils/toml_extended.hpp"
+
+// std
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/*
+  Runs the world headless: streaming, block ticks and saving, at the configured tick rate
+  (config.toml [server]). Stops and saves on SIGINT or SIGTERM.
+
+  usage: hehcraft_server [--spawn x z] [--walk blocks_per_second] [--ticks count]
+                         [--threads count] [--report seconds] [--listen address]
+
+  Clients connect on --listen, or config.toml [server] address, given as host:port or
+  unix:path; an empty address runs without clients.
+
+  --walk moves the streaming anchor along +x, which keeps generation, unloading and
+  saving busy; with --ticks the run ends by itself, for load tests in CI.
+*/
+
+namespace {
+
+  std::atomic<bool> stop_requested{ false };
+
+  void HandleSignal(int)
+  {
+    stop_requested.store(true, std::memory_order_relaxed);
+  }
+
+  struct Options {
+    bool has_spawn = false;
+    float spawn_x = 0.0f;
+    float spawn_z = 0.0f;
+    float walk_speed = 0.0f;
+    uint64_t ticks = 0;       ///< 0: until stopped.
+    int threads = 0;          ///< 0: one per core.
+    double report = 10.0;
+    bool has_listen = false;
+    std::string listen;
+  };
+
+  bool ParseOptions(int argc, char** argv, Options& options)
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      const bool has_value = i + 1 < argc;
+      if (std::strcmp(argv[i], "--spawn") == 0 && i + 2 < argc)
+      {
+        options.has_spawn = true;
+        options.spawn_x = static_cast<float>(std::atof(argv[++i]));
+        options.spawn_z = static_cast<float>(std::atof(argv[++i]));
+      }
+      else if (std::strcmp(argv[i], "--walk") == 0 && has_value)
+        options.walk_speed = static_cast<float>(std::atof(argv[++i]));
+      else if (std::strcmp(argv[i], "--ticks") == 0 && has_value)
+        options.ticks = std::strtoull(argv[++i], nullptr, 10);
+      else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+        options.threads = std::atoi(argv[++i]);
+      else if (std::strcmp(argv[i], "--report") == 0 && has_value)
+        options.report = std::atof(argv[++i]);
+      else if (std::strcmp(argv[i], "--listen") == 0 && has_value)
+      {
+        options.has_listen = true;
+        options.listen = argv[++i];
+      }
+      else
+        return false;
+    }
+    return true;
+  }
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  try {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+      std::cerr << "usage: hehcraft_server [--spawn x z] [--walk blocks_per_second] [--ticks count] "
+                   "[--threads count] [--report seconds] [--listen address]"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    heh::config::InitConfigFile("config.toml", "blocks.toml", "textures.toml");
+    heh::block_map::LoadBlocks();
+
+    std::signal(SIGINT, HandleSignal);
+    std::signal(SIGTERM, HandleSignal);
+
+    heh::server::Server server(heh::config::file, options.threads > 0 ? options.threads - 1 : -1);
+    if (options.has_spawn)
+      server.SetAnchor(glm::vec3(options.spawn_x, server.GetAnchor().y, options.spawn_z));
+    server.SetAnchorVelocity(glm::vec3(options.walk_speed, 0.0f, 0.0f));
+
+    std::printf("server: %d ticks/s, render distance %d, world in %s, %u threads, seed %d\n",
+      server.GetTickRate(), heh::config::file.world.render_distance,
+      heh::config::file.server.world_directory.c_str(), server.GetJobs().GetThreadCount(), heh::config::file.world.seed);
+    const std::string& address = options.has_listen ? options.listen : heh::config::file.server.address;
+    if (!address.empty())
+    {
+      server.Listen(address);
+      std::printf("server: listening on %s\n", server.GetListenAddress().c_str());
+    }
+    std::fflush(stdout);
+
+    server.Run(stop_requested, options.ticks, options.report);
+    return EXIT_SUCCESS;
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,343 @@
+#include "server/server.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+namespace heh {
+
+  namespace server {
+
+    void TickTimes::Add(double seconds)
+    {
+      const double micros = std::max(seconds * 1e6, 1.0);
+      const size_t bucket = static_cast<size_t>(std::log2(micros) * kBucketsPerOctave);
+      ++buckets_[std::min(bucket, kBucketCount - 1)];
+      ++count_;
+      total_seconds_ += seconds;
+      max_seconds_ = std::max(max_seconds_, seconds);
+    }
+
+    void TickTimes::Clear()
+    {
+      *this = TickTimes();
+    }
+
+    double TickTimes::Percentile(double p) const
+    {
+      if (count_ == 0)
+        return 0.0;
+      const uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(p * static_cast<double>(count_))), 1);
+      uint64_t seen = 0;
+      for (size_t bucket = 0; bucket < kBucketCount; ++bucket)
+      {
+        seen += buckets_[bucket];
+        if (seen >= rank)
+        {
+          // The bucket's upper edge, but never beyond the slowest tick seen.
+          const double edge = std::exp2(static_cast<double>(bucket + 1) / kBucketsPerOctave) * 1e-6;
+          return std::min(edge, max_seconds_);
+        }
+      }
+      return max_seconds_;
+    }
+
+    Server::Server(const config::Config& config, int worker_count)
+      : tick_rate_(std::max(config.server.tick_rate, 1)),
+        save_interval_(std::max(static_cast<double>(config.server.save_interval), 0.0)),
+        jobs_(worker_count),
+        generator_(static_cast<uint32_t>(config.world.seed)),
+        storage_(config.server.world_directory),
+        streamer_(world_, generator_, jobs_, config.world),
+        ticks_(world_, streamer_, jobs_, static_cast<uint32_t>(config.world.seed), config.world.random_tick_speed),
+        client_bandwidth_(std::max(config.server.client_bandwidth, 1) * 1024.0)
+    {
+      streamer_.SetStorage(&storage_);
+      streamer_.SetMeshing(false);
+      anchor_ = glm::vec3(0.5f, static_cast<float>(generator_.GetHeight(0, 0)) + 1.0f, 0.5f);
+    }
+
+    void Server::Listen(const std::string& address)
+    {
+      listener_ = std::make_unique<net::Listener>(address);
+      ticks_.SetRecordChanges(true);
+    }
+
+    void Server::AcceptClients()
+    {
+      for (net::Socket socket = listener_->Accept(); socket.IsOpen(); socket = listener_->Accept())
+      {
+        sessions_.push_back(std::make_unique<Session>(std::move(socket)));
+        ++stats_.clients_joined;
+      }
+    }
+
+    bool Server::Receive(Session& session)
+    {
+      return session.connection.Poll([this, &session](net::MessageType type, net::ByteReader& payload) {
+        switch (type)
+        {
+        case net::MessageType::kHello:
+        {
+          if (session.welcomed || payload.GetU16() != net::kProtocolVersion)
+            return false;
+          session.view_radius = std::clamp<int>(payload.GetU8(), 1, streamer_.GetRenderDistance());
+          session.pos = anchor_;
+          session.welcomed = true;
+
+          std::vector<uint8_t>& out = session.connection.GetOutput();
+          const size_t message = net::BeginMessage(out, net::MessageType::kWelcome);
+          net::ByteWriter writer(out);
+          writer.PutU16(net::kProtocolVersion);
+          writer.PutU16(static_cast<uint16_t>(tick_rate_));
+          writer.PutU8(static_cast<uint8_t>(session.view_radius));
+          writer.PutF32(anchor_.x);
+          writer.PutF32(anchor_.y);
+          writer.PutF32(anchor_.z);
+          net::EndMessage(out, message);
+          return true;
+        }
+        case net::MessageType::kPosition:
+          session.pos.x = payload.GetF32();
+          session.pos.y = payload.GetF32();
+          session.pos.z = payload.GetF32();
+          return session.welcomed && std::isfinite(session.pos.x) && std::isfinite(session.pos.z);
+        default:
+          return false;
+        }
+      });
+    }
+
+    void Server::SendUpdates(Session& session, const std::vector<net::SectionDelta>& deltas)
+    {
+      std::vector<uint8_t>& out = session.connection.GetOutput();
+      const size_t queued_before = out.size();
+      session.budget = std::min(session.budget + client_bandwidth_ / tick_rate_, client_bandwidth_);
+
+      const int32_t center_x = world::BlockToChunk(static_cast<int32_t>(std::floor(session.pos.x)));
+      const int32_t center_z = world::BlockToChunk(static_cast<int32_t>(std::floor(session.pos.z)));
+      auto distance2 = [center_x, center_z](int32_t x, int32_t z) {
+        const int64_t dx = x - center_x;
+        const int64_t dz = z - center_z;
+        return dx * dx + dz * dz;
+      };
+
+      // Out of view, with a chunk of hysteresis.
+      const int64_t forget_radius = session.view_radius + 1;
+      for (auto it = session.sent.begin(); it != session.sent.end();)
+      {
+        const int32_t x = world::ChunkKeyX(*it);
+        const int32_t z = world::ChunkKeyZ(*it);
+        if (distance2(x, z) <= forget_radius * forget_radius)
+        {
+          ++it;
+          continue;
+        }
+        const size_t message = net::BeginMessage(out, net::MessageType::kForgetChunk);
+        net::ByteWriter writer(out);
+        writer.PutI32(x);
+        writer.PutI32(z);
+        net::EndMessage(out, message);
+        it = session.sent.erase(it);
+      }
+
+      // Rewritten chunks are sent again whole, in distance order with the missing ones.
+      for (world::ChunkKey key : rewritten_)
+        session.sent.erase(key);
+
+      // Deltas go out whatever the budget: the chunks the client has must stay current.
+      std::vector<const net::SectionDelta*> sections;
+      for (const net::SectionDelta& delta : deltas)
+      {
+        if (session.sent.count(world::PackChunkKey(delta.x, delta.z)))
+          sections.push_back(&delta);
+      }
+      for (size_t begin = 0; begin < sections.size(); begin += kDeltaSectionsPerMessage)
+      {
+        const size_t end = std::min(begin + kDeltaSectionsPerMessage, sections.size());
+        const std::vector<const net::SectionDelta*> batch(sections.begin() + static_cast<std::ptrdiff_t>(begin),
+                                                          sections.begin() + static_cast<std::ptrdiff_t>(end));
+        const size_t message = net::BeginMessage(out, net::MessageType::kSectionDeltas);
+        net::ByteWriter writer(out);
+        net::EncodeSectionDeltas(tick_, batch, writer);
+        net::EndMessage(out, message);
+      }
+      stats_.delta_sections_sent += sections.size();
+      session.budget -= static_cast<double>(out.size() - queued_before);
+
+      // Missing chunks, nearest first, while the budget and the socket keep up.
+      if (session.budget > 0.0 && session.connection.GetQueuedBytes() < kMaxQueuedBytes)
+      {
+        const int32_t radius = session.view_radius;
+        std::vector<std::pair<int64_t, world::ChunkKey>> missing;
+        for (int32_t dz = -radius; dz <= radius; ++dz)
+        {
+          for (int32_t dx = -radius; dx <= radius; ++dx)
+          {
+            const int32_t x = center_x + dx;
+            const int32_t z = center_z + dz;
+            const world::ChunkKey key = world::PackChunkKey(x, z);
+            if (distance2(x, z) > static_cast<int64_t>(radius) * radius || session.sent.count(key))
+              continue;
+            // Blocks are final once the features are in; light is the client's business.
+            const Chunk* chunk = world_.GetChunk(x, z);
+            if (chunk && chunk->status >= ChunkStatus::kFeatures)
+              missing.emplace_back(distance2(x, z), key);
+          }
+        }
+        std::sort(missing.begin(), missing.end());
+
+        for (const auto& [distance, key] : missing)
+        {
+          if (session.budget <= 0.0 || session.connection.GetQueuedBytes() >= kMaxQueuedBytes)
+            break;
+          const size_t start = out.size();
+          const size_t message = net::BeginMessage(out, net::MessageType::kChunk);
+          net::ByteWriter writer(out);
+          writer.PutI32(world::ChunkKeyX(key));
+          writer.PutI32(world::ChunkKeyZ(key));
+          net::EncodeChunk(*world_.GetChunk(world::ChunkKeyX(key), world::ChunkKeyZ(key)), writer);
+          net::EndMessage(out, message);
+          session.budget -= static_cast<double>(out.size() - start);
+          session.sent.insert(key);
+          ++stats_.chunks_sent;
+        }
+      }
+
+      stats_.bytes_sent += out.size() - queued_before;
+      session.connection.Flush();
+    }
+
+    void Server::Tick()
+    {
+      if (listener_)
+      {
+        AcceptClients();
+        // Clients that left or sent something malformed are dropped.
+        sessions_.erase(std::remove_if(sessions_.begin(), sessions_.end(), [this](const std::unique_ptr<Session>& session) {
+          if (Receive(*session))
+            return false;
+          ++stats_.clients_left;
+          return true;
+        }), sessions_.end());
+
+        std::vector<glm::vec3> positions;
+        for (const auto& session : sessions_)
+        {
+          if (session->welcomed)
+            positions.push_back(session->pos);
+        }
+        streamer_.SetAnchors(positions);
+      }
+
+      const double time = static_cast<double>(tick_) / tick_rate_;
+      anchor_ += anchor_velocity_ / static_cast<float>(tick_rate_);
+      const bool moving = glm::dot(anchor_velocity_, anchor_velocity_) > 0.0f;
+      const glm::vec3 front = moving ? anchor_velocity_ : glm::vec3(0.0f, 0.0f, -1.0f);
+      streamer_.Update(anchor_, front, time);
+      // Nothing renders here; the unloaded keys only matter to a renderer.
+      streamer_.PopUnloaded();
+      ticks_.Tick();
+
+      if (listener_)
+      {
+        ticks_.PopChanges(changes_, rewritten_);
+        const std::vector<net::SectionDelta> deltas = net::CoalesceChanges(changes_);
+        for (const auto& session : sessions_)
+        {
+          if (session->welcomed)
+            SendUpdates(*session, deltas);
+        }
+      }
+
+      if (save_interval_ > 0.0 && time - last_save_time_ >= save_interval_)
+      {
+        last_save_time_ = time;
+        streamer_.SaveChanged();
+        ++stats_.saves;
+      }
+      ++tick_;
+      ++stats_.ticks;
+    }
+
+    void Server::Save()
+    {
+      streamer_.SaveChanged();
+      streamer_.WaitForSaves();
+    }
+
+    void Server::Run(const std::atomic<bool>& stop, uint64_t max_ticks, double report_interval)
+    {
+      using Clock = std::chrono::steady_clock;
+      const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / tick_rate_));
+      const Clock::time_point start = Clock::now();
+      Clock::time_point due = start;
+      Clock::time_point last_report = start;
+      TickTimes interval_times;
+
+      while (!stop.load(std::memory_order_relaxed) && (max_ticks == 0 || stats_.ticks < max_ticks))
+      {
+        const Clock::time_point tick_start = Clock::now();
+        Tick();
+        const Clock::time_point tick_end = Clock::now();
+        const double seconds = std::chrono::duration<double>(tick_end - tick_start).count();
+        interval_times.Add(seconds);
+        total_times_.Add(seconds);
+        if (tick_end - tick_start > period)
+          ++stats_.overruns;
+
+        due += period;
+        if (tick_end - due > period * static_cast<Clock::rep>(kMaxCatchUpTicks))
+        {
+          const uint64_t behind = static_cast<uint64_t>((tick_end - due) / period);
+          stats_.skipped_ticks += behind;
+          due += period * static_cast<Clock::rep>(behind);
+        }
+        std::this_thread::sleep_until(due);
+
+        const double since_report = std::chrono::duration<double>(Clock::now() - last_report).count();
+        if (report_interval > 0.0 && since_report >= report_interval)
+        {
+          PrintReport("interval", interval_times, since_report);
+          interval_times.Clear();
+          last_report = Clock::now();
+        }
+      }
+
+      Save();
+      PrintReport("total", total_times_, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    void Server::PrintReport(const char* label, const TickTimes& times, double seconds) const
+    {
+      const auto counts = streamer_.CountByStatus();
+      const world::StreamerStats& streamer = streamer_.GetStats();
+      const world::TickStats& ticks = ticks_.GetStats();
+      std::printf("[%s] tick %llu  %.2f ticks/s (target %d)  mean %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms\n",
+        label, static_cast<unsigned long long>(tick_), seconds > 0.0 ? static_cast<double>(times.GetCount()) / seconds : 0.0,
+        tick_rate_, times.GetMeanSeconds() * 1e3, times.Percentile(0.5) * 1e3, times.Percentile(0.9) * 1e3,
+        times.Percentile(0.99) * 1e3, times.GetMaxSeconds() * 1e3);
+      std::printf("  overruns %llu  skipped %llu  chunks %zu (lit %zu)  jobs %zu  loaded %llu  saved %llu (%.1f MiB)"
+                  "  ticked chunks %zu  active sections %zu  pending ticks %zu\n",
+        static_cast<unsigned long long>(stats_.overruns), static_cast<unsigned long long>(stats_.skipped_ticks),
+        streamer_.GetLoadedCount(), counts[static_cast<size_t>(ChunkStatus::kLight)], streamer_.GetJobsInFlight(),
+        static_cast<unsigned long long>(streamer.loaded), static_cast<unsigned long long>(streamer.saved),
+        static_cast<double>(storage_.GetBytesWritten()) / (1024.0 * 1024.0), ticks.chunks, ticks.active_sections,
+        ticks.pending_ticks);
+      if (listener_)
+      {
+        std::printf("  clients %zu (joined %llu, left %llu)  sent %llu chunks, %llu delta sections, %.1f MiB\n",
+          sessions_.size(), static_cast<unsigned long long>(stats_.clients_joined),
+          static_cast<unsigned long long>(stats_.clients_left), static_cast<unsigned long long>(stats_.chunks_sent),
+          static_cast<unsigned long long>(stats_.delta_sections_sent),
+          static_cast<double>(stats_.bytes_sent) / (1024.0 * 1024.0));
+      }
+      std::fflush(stdout);
+    }
+
+  }  // namespace server
+
+}  // namespace heh
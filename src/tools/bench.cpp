@@ -0,0 +1,1482 @@
+#include "core/frustum.hpp"
+#include "core/mesh_residency.hpp"
+#include "core/occlusion_culler.hpp"
+#include "core/visibility_graph.hpp"
+#include "net/client.hpp"
+#include "server/server.hpp"
+#include "world/world.hpp"
+#include "world/block_edit.hpp"
+#include "world/block_ticks.hpp"
+#include "world/chunk_streamer.hpp"
+#include "world/physics.hpp"
+#include "world/raycast.hpp"
+#include "world/terrain_generator.hpp"
+#include "utils/job_system.hpp"
+#include "utils/toml_extended.hpp"
+
+// libs
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+  Headless benchmarks for the world code. No window or GL context is created.
+
+  usage: hehcraft_bench <benchmark> [args...]
+*/
+
+namespace {
+
+  using Clock = std::chrono::steady_clock;
+
+  double SecondsSince(Clock::time_point start)
+  {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  int ArgInt(int argc, char** argv, int index, int fallback)
+  {
+    return index < argc ? std::atoi(argv[index]) : fallback;
+  }
+
+  void PrintStageTimings(const heh::world::ChunkStreamer& streamer)
+  {
+    const auto& timings = streamer.GetStageTimings();
+    for (size_t stage = 0; stage < timings.size(); ++stage)
+    {
+      if (timings[stage].count == 0)
+        continue;
+      std::printf("  %-10s %7llu chunks  avg %7.3f ms  max %7.3f ms  total %8.1f ms\n",
+        heh::world::kStageSpecs[stage].name,
+        static_cast<unsigned long long>(timings[stage].count),
+        timings[stage].AverageSeconds() * 1000.0,
+        timings[stage].max_seconds * 1000.0,
+        timings[stage].total_seconds * 1000.0);
+    }
+  }
+
+  /**
+   * Scripted fly-through at sprint speed (5 * 4 blocks per second, see Camera::HandleKeys),
+   * paced in real time at 60 frames per second. The path goes straight, turns 90 degrees,
+   * then flies diagonally, so both the prediction and the cancellation are exercised.
+   * Reports the share of chunks already generated when they enter the render distance.
+   */
+  void RunFlythrough(const heh::config::WorldConfig& settings, double seconds, const char* label)
+  {
+    heh::world::World world;
+    heh::world::TerrainGenerator generator(static_cast<uint32_t>(settings.seed));
+    heh::JobSystem jobs;
+    heh::world::ChunkStreamer streamer(world, generator, jobs, settings);
+
+    const float speed = 20.0f;
+    const double frame_time = 1.0 / 60.0;
+    glm::vec3 pos(0.0f, static_cast<float>(heh::kChunkHeight) + 2.0f, 0.0f);
+
+    // Let the initial radius fill before the flight starts.
+    const Clock::time_point warmup_start = Clock::now();
+    double time = 0.0;
+    while (SecondsSince(warmup_start) < 10.0)
+    {
+      streamer.Update(pos, glm::vec3(1.0f, 0.0f, 0.0f), time);
+      streamer.PopUnloaded();
+      streamer.PopReadyMeshes(SIZE_MAX);
+      if (streamer.GetJobsInFlight() == 0 && streamer.GetLoadedCount() > 0 && time > 1.0)
+        break;
+      std::this_thread::sleep_for(std::chrono::duration<double>(frame_time));
+      time += frame_time;
+    }
+    const heh::world::StreamerStats before = streamer.GetStats();
+
+    const Clock::time_point start = Clock::now();
+    double worst_frame = 0.0;
+    uint64_t frames = 0;
+    while (SecondsSince(start) < seconds)
+    {
+      const Clock::time_point frame_start = Clock::now();
+      const double t = SecondsSince(start);
+
+      glm::vec3 dir(1.0f, 0.0f, 0.0f);
+      if (t > seconds / 3.0)
+        dir = glm::vec3(0.0f, 0.0f, 1.0f);
+      if (t > seconds * 2.0 / 3.0)
+        dir = glm::normalize(glm::vec3(-1.0f, 0.0f, 1.0f));
+
+      pos += dir * speed * static_cast<float>(frame_time);
+      time += frame_time;
+
+      streamer.Update(pos, dir, time);
+      streamer.PopUnloaded();
+      streamer.PopReadyMeshes(8);
+
+      worst_frame = std::max(worst_frame, SecondsSince(frame_start));
+      ++frames;
+      const double left = frame_time - SecondsSince(frame_start);
+      if (left > 0.0)
+        std::this_thread::sleep_for(std::chrono::duration<double>(left));
+    }
+
+    const heh::world::StreamerStats& stats = streamer.GetStats();
+    const uint64_t entered = stats.entered_view - before.entered_view;
+    const uint64_t ready = stats.ready_on_entry - before.ready_on_entry;
+    std::printf("%-12s entered %6llu  ready %6llu  (%5.1f%%)  prefetched %5llu used %5llu cancelled %5llu  worst streamer frame %.2f ms\n",
+      label,
+      static_cast<unsigned long long>(entered),
+      static_cast<unsigned long long>(ready),
+      entered ? 100.0 * ready / entered : 100.0,
+      static_cast<unsigned long long>(stats.prefetch_requested),
+      static_cast<unsigned long long>(stats.prefetch_used),
+      static_cast<unsigned long long>(stats.prefetch_cancelled),
+      worst_frame * 1000.0);
+    PrintStageTimings(streamer);
+  }
+
+  int BenchFlythrough(int argc, char** argv)
+  {
+    const double seconds = ArgInt(argc, argv, 2, 30);
+    heh::config::WorldConfig settings = heh::config::file.world;
+    settings.render_distance = ArgInt(argc, argv, 3, settings.render_distance);
+
+    heh::config::WorldConfig no_prefetch = settings;
+    no_prefetch.prefetch_lookahead = 0.0f;
+
+    RunFlythrough(no_prefetch, seconds, "no prefetch");
+    RunFlythrough(settings, seconds, "prefetch");
+    return EXIT_SUCCESS;
+  }
+
+  /**
+   * FNV-1a over the blocks of all chunks, in chunk order.
+   */
+  uint64_t HashChunks(const std::vector<heh::Chunk>& chunks)
+  {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const heh::Chunk& chunk : chunks)
+    {
+      for (heh::BlockId id : chunk.blocks_data)
+      {
+        hash ^= static_cast<uint16_t>(id);
+        hash *= 0x100000001b3ull;
+      }
+    }
+    return hash;
+  }
+
+  /**
+   * Generates the same square of chunks with 1, 2, 4, ... up to max_threads threads.
+   * Reports the throughput and checks that every thread count produced identical blocks.
+   */
+  int BenchGenerate(int argc, char** argv)
+  {
+    const int count = std::max(ArgInt(argc, argv, 2, 1024), 1);
+    const unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+    const unsigned max_threads = static_cast<unsigned>(std::max(ArgInt(argc, argv, 3, static_cast<int>(cores)), 1));
+
+    const heh::world::TerrainGenerator generator(static_cast<uint32_t>(heh::config::file.world.seed));
+    const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+
+    uint64_t reference = 0;
+    for (unsigned threads = 1; ; threads = std::min(threads * 2, max_threads))
+    {
+      std::vector<heh::Chunk> chunks(static_cast<size_t>(count));
+      for (int i = 0; i < count; ++i)
+      {
+        chunks[i].x = i % side - side / 2;
+        chunks[i].z = i / side - side / 2;
+      }
+
+      heh::JobSystem jobs(static_cast<int>(threads) - 1);
+      const Clock::time_point start = Clock::now();
+      jobs.ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+          generator.Generate(chunks[i]);
+      });
+      const double seconds = SecondsSince(start);
+
+      const uint64_t hash = HashChunks(chunks);
+      if (threads == 1)
+        reference = hash;
+
+      std::printf("threads %3u  %8.0f chunks/s  %7.3f ms/chunk/thread  hash %016llx%s\n",
+        threads,
+        count / seconds,
+        seconds * 1000.0 * threads / count,
+        static_cast<unsigned long long>(hash),
+        hash == reference ? "" : "  MISMATCH");
+
+      if (hash != reference)
+        return EXIT_FAILURE;
+      if (threads == max_threads)
+        break;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  /**
+   * Terrain for a square of chunks plus a border ring, then meshes for the inner square,
+   * each mesh job waiting on the terrain counter. Run with 1, 2, 4, ... up to max_threads
+   * threads (the calling thread helps) to show how the job system scales.
+   */
+  int BenchScaling(int argc, char** argv)
+  {
+    const int side = std::max(ArgInt(argc, argv, 2, 24), 1);
+    const unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+    const unsigned max_threads = static_cast<unsigned>(std::max(ArgInt(argc, argv, 3, static_cast<int>(cores)), 1));
+
+    const heh::world::TerrainGenerator generator(static_cast<uint32_t>(heh::config::file.world.seed));
+    const int outer = side + 2;
+
+    double single_thread_seconds = 0.0;
+    for (unsigned threads = 1; ; threads = std::min(threads * 2, max_threads))
+    {
+      std::vector<heh::Chunk> chunks(static_cast<size_t>(outer * outer));
+      std::vector<std::unique_ptr<heh::ChunkRenderData>> meshes(static_cast<size_t>(side * side));
+      auto chunk_at = [&](int x, int z) -> heh::Chunk& { return chunks[static_cast<size_t>(z * outer + x)]; };
+
+      heh::JobSystem jobs(static_cast<int>(threads) - 1);
+      const Clock::time_point start = Clock::now();
+
+      heh::JobCounter terrain;
+      for (int z = 0; z < outer; ++z)
+      {
+        for (int x = 0; x < outer; ++x)
+        {
+          jobs.Submit([&, x, z]() {
+            heh::Chunk& chunk = chunk_at(x, z);
+            chunk.x = x;
+            chunk.z = z;
+            generator.Generate(chunk);
+          }, &terrain);
+        }
+      }
+
+      heh::JobCounter meshed;
+      for (int z = 1; z <= side; ++z)
+      {
+        for (int x = 1; x <= side; ++x)
+        {
+          jobs.Submit([&, x, z]() {
+            heh::ChunkNeighbourhood area;
+            for (int dz = -1; dz <= 1; ++dz)
+            {
+              for (int dx = -1; dx <= 1; ++dx)
+                area.chunks[static_cast<size_t>((dz + 1) * 3 + (dx + 1))] = &chunk_at(x + dx, z + dz);
+            }
+            meshes[static_cast<size_t>((z - 1) * side + (x - 1))] = chunk_at(x, z).BuildMesh(area);
+          }, &meshed, &terrain);
+        }
+      }
+
+      jobs.Wait(meshed);
+      const double seconds = SecondsSince(start);
+      if (threads == 1)
+        single_thread_seconds = seconds;
+
+      uint64_t vertices = 0;
+      for (const auto& mesh : meshes)
+        vertices += mesh ? mesh->vertices.size() : 0;
+
+      std::printf("threads %3u  %7.1f ms  %8.0f chunks/s  speedup %5.2fx  steals %7llu  vertices %llu\n",
+        threads,
+        seconds * 1000.0,
+        (outer * outer) / seconds,
+        single_thread_seconds / seconds,
+        static_cast<unsigned long long>(jobs.GetStealCount()),
+        static_cast<unsigned long long>(vertices));
+
+      if (threads == max_threads)
+        break;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  /**
+   * Meshes every chunk within render_distance of the origin both at full detail and at the
+   * level of detail its distance calls for, then prints the vertices drawn within growing
+   * radii either way, and the cost of building each level. Terrain is generated three
+   * rows of chunks at a time so large distances fit in memory.
+   */
+  int BenchLod(int argc, char** argv)
+  {
+    const int radius = std::max(ArgInt(argc, argv, 2, 48), 1);
+    const int lod_distance = std::max(ArgInt(argc, argv, 3, heh::config::file.world.lod_distance), 1);
+    const heh::world::TerrainGenerator generator(static_cast<uint32_t>(heh::config::file.world.seed));
+
+    struct Column {
+      float distance;
+      size_t full_vertices;
+      size_t lod_vertices;
+    };
+    std::vector<Column> columns;
+    std::array<double, heh::kMaxLod + 1> build_seconds{};
+    std::array<size_t, heh::kMaxLod + 1> build_count{};
+
+    // Rows z - 1, z and z + 1, from x = -radius - 1 to radius + 1.
+    const int width = 2 * radius + 3;
+    std::array<std::vector<heh::Chunk>, 3> rows;
+    const auto generate_row = [&](std::vector<heh::Chunk>& row, int z) {
+      row.clear();
+      row.resize(static_cast<size_t>(width));
+      for (int i = 0; i < width; ++i)
+      {
+        row[static_cast<size_t>(i)].x = i - radius - 1;
+        row[static_cast<size_t>(i)].z = z;
+        generator.Generate(row[static_cast<size_t>(i)]);
+      }
+    };
+    generate_row(rows[0], -radius - 1);
+    generate_row(rows[1], -radius);
+    for (int z = -radius; z <= radius; ++z)
+    {
+      generate_row(rows[static_cast<size_t>(z + radius + 2) % 3], z + 1);
+      for (int x = -radius; x <= radius; ++x)
+      {
+        const float distance = std::sqrt(static_cast<float>(x * x + z * z));
+        if (distance > static_cast<float>(radius))
+          continue;
+        heh::ChunkNeighbourhood area;
+        for (int dz = -1; dz <= 1; ++dz)
+        {
+          for (int dx = -1; dx <= 1; ++dx)
+            area.chunks[static_cast<size_t>((dz + 1) * 3 + (dx + 1))] =
+              &rows[static_cast<size_t>(z + dz + radius + 1) % 3][static_cast<size_t>(x + dx + radius + 1)];
+        }
+        const heh::Chunk& chunk = *area.Get(0, 0);
+
+        Clock::time_point start = Clock::now();
+        const size_t full_vertices = chunk.BuildMesh(area)->vertices.size();
+        build_seconds[0] += SecondsSince(start);
+        ++build_count[0];
+
+        const uint32_t lod = heh::world::LodForDistance(distance, lod_distance);
+        size_t lod_vertices = full_vertices;
+        if (lod > 0)
+        {
+          start = Clock::now();
+          lod_vertices = chunk.BuildLodMesh(area, lod)->vertices.size();
+          build_seconds[lod] += SecondsSince(start);
+          ++build_count[lod];
+        }
+        columns.push_back({ distance, full_vertices, lod_vertices });
+      }
+    }
+
+    std::sort(columns.begin(), columns.end(), [](const Column& a, const Column& b) { return a.distance < b.distance; });
+    std::printf("lod distance %d\n", lod_distance);
+    std::printf("  radius  chunks  full vertices   lod vertices  ratio\n");
+    size_t chunks = 0;
+    uint64_t full = 0;
+    uint64_t lod = 0;
+    for (int step = 1; ; ++step)
+    {
+      const float edge = std::min(static_cast<float>(step * 8), static_cast<float>(radius));
+      while (chunks < columns.size() && columns[chunks].distance <= edge)
+      {
+        full += columns[chunks].full_vertices;
+        lod += columns[chunks].lod_vertices;
+        ++chunks;
+      }
+      std::printf("  %6.0f  %6zu  %13llu  %13llu  %5.1f%%\n", edge, chunks, static_cast<unsigned long long>(full),
+                  static_cast<unsigned long long>(lod), full ? 100.0 * static_cast<double>(lod) / static_cast<double>(full) : 0.0);
+      if (edge >= static_cast<float>(radius))
+        break;
+    }
+    for (uint32_t level = 0; level <= heh::kMaxLod; ++level)
+    {
+      if (build_count[level])
+        std::printf("  level %u  %6zu meshes  %7.3f ms/mesh\n", level, build_count[level],
+                    build_seconds[level] * 1000.0 / static_cast<double>(build_count[level]));
+    }
+    return EXIT_SUCCESS;
+  }
+
+  /**
+   * Flies over streamed terrain with the meshes kept in a MeshResidency of budget MiB, as
+   * the renderer does but counting bytes instead of filling arenas, and meshes ahead of
+   * the camera counting as drawn. Checks every frame that the resident bytes stay within
+   * the budget, and that the compact copies expand to the same geometry.
+   */
+  int BenchResidency(int argc, char** argv)
+  {
+    heh::config::WorldConfig settings = heh::config::file.world;
+    settings.render_distance = std::max(ArgInt(argc, argv, 2, 16), 1);
+    settings.prefetch_lookahead = 0.0f;
+    const size_t budget = static_cast<size_t>(std::max(ArgInt(argc, argv, 3, 64), 1)) << 20;
+    const int frames = std::max(ArgInt(argc, argv, 4, 3600), 1);
+
+    heh::world::World world;
+    heh::world::TerrainGenerator generator(static_cast<uint32_t>(settings.seed));
+    heh::JobSystem jobs;
+    heh::world::ChunkStreamer streamer(world, generator, jobs, settings);
+    heh::MeshResidency residency(budget, true);
+
+    size_t over_budget = 0;
+    size_t peak = 0;
+    size_t mismatches = 0;
+    size_t raw_bytes = 0;
+    size_t packed_bytes = 0;
+    const auto store = [&](heh::world::ChunkKey key, const heh::ChunkRenderData& data, bool from_copy) {
+      const size_t bytes = data.vertices.size() * sizeof(heh::Vertex) + data.num_elements * sizeof(uint32_t);
+      while (!residency.Fits(key, bytes))
+      {
+        heh::world::ChunkKey victim = 0;
+        if (!residency.PickVictim(key, victim))
+        {
+          residency.Park(key, data, from_copy);
+          return;
+        }
+        residency.Evict(victim);
+      }
+      residency.Insert(key, data, from_copy);
+    };
+
+    const glm::vec3 direction(1.0f, 0.0f, 0.0f);
+    const float surface = static_cast<float>(generator.GetHeight(0, 0)) + 2.0f;
+    const Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+      // A warm-up second in place, then 20 blocks per second.
+      const glm::vec3 eye = glm::vec3(0.0f, surface, 0.0f) + direction * (20.0f / 60.0f * static_cast<float>(std::max(frame - 60, 0)));
+      streamer.Update(eye, direction, frame / 60.0);
+      // Every frame sees its jobs through, so the run does not depend on the machine.
+      while (streamer.GetJobsInFlight() > 0)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        streamer.Update(eye, direction, frame / 60.0);
+      }
+      residency.BeginFrame(eye);
+
+      for (heh::world::ChunkKey key : streamer.PopUnloaded())
+        residency.Erase(key);
+      std::vector<std::pair<heh::world::ChunkKey, std::unique_ptr<heh::ChunkRenderData>>> returns;
+      std::vector<heh::world::ChunkKey> rebuilds;
+      residency.TakeReturns(4, returns, rebuilds);
+      streamer.RemeshChunks(rebuilds);
+      for (auto& [key, data] : returns)
+        store(key, *data, true);
+
+      for (auto& mesh : streamer.PopReadyMeshes(8))
+      {
+        if (mesh.data->num_elements == 0)
+          continue;
+        const heh::world::ChunkKey key = heh::world::PackChunkKey(mesh.x, mesh.z);
+        const heh::CompactMesh packed(*mesh.data);
+        const auto expanded = packed.Expand();
+        raw_bytes += mesh.data->vertices.size() * sizeof(heh::Vertex) + mesh.data->num_elements * sizeof(uint32_t);
+        packed_bytes += packed.GetBytes();
+        bool same = expanded->elements == mesh.data->elements && expanded->vertices.size() == mesh.data->vertices.size();
+        for (size_t i = 0; same && i < expanded->vertices.size(); ++i)
+        {
+          const heh::Vertex& a = expanded->vertices[i];
+          const heh::Vertex& b = mesh.data->vertices[i];
+          const glm::vec2 tex_error = glm::abs(a.tex_coords - b.tex_coords);
+          const glm::vec2 light_error = glm::abs(a.light - b.light);
+          same = a.position == b.position && a.normal == b.normal && std::max(tex_error.x, tex_error.y) <= 1.0f / 65535.0f &&
+                 std::max(light_error.x, light_error.y) <= 1.0f / 255.0f;
+        }
+        mismatches += same ? 0 : 1;
+        store(key, *mesh.data, false);
+      }
+
+      // Meshes in front of the camera are the ones drawn.
+      for (heh::world::ChunkKey key : streamer.GetEditableChunks())
+      {
+        const glm::vec2 to_chunk(static_cast<float>(heh::world::ChunkKeyX(key)) * 16.0f - eye.x,
+                                 static_cast<float>(heh::world::ChunkKeyZ(key)) * 16.0f - eye.z);
+        if (glm::dot(to_chunk, glm::vec2(direction.x, direction.z)) > -16.0f)
+          residency.MarkDrawn(key);
+      }
+
+      const heh::ResidencyStats& stats = residency.GetStats();
+      peak = std::max(peak, stats.resident_bytes);
+      over_budget += stats.resident_bytes > budget ? 1 : 0;
+    }
+
+    const heh::ResidencyStats& stats = residency.GetStats();
+    std::printf("render distance %d  budget %zu MiB  %d frames in %.1f s\n", settings.render_distance, budget >> 20,
+                frames, SecondsSince(start));
+    std::printf("  resident %zu meshes %zu MiB (peak %zu MiB)  evicted %zu  frames over budget %zu\n", stats.resident,
+                stats.resident_bytes >> 20, peak >> 20, stats.evicted, over_budget);
+    std::printf("  evictions %llu  reuploads %llu  rebuilds %llu  copies %zu MiB\n",
+                static_cast<unsigned long long>(stats.evictions), static_cast<unsigned long long>(stats.reuploads),
+                static_cast<unsigned long long>(stats.rebuilds), stats.copy_bytes >> 20);
+    std::printf("  compact copies %.1f%% of the mesh bytes, %zu mismatched\n",
+                raw_bytes ? 100.0 * static_cast<double>(packed_bytes) / static_cast<double>(raw_bytes) : 0.0, mismatches);
+    return over_budget == 0 && mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  /**
+   * Casts rays from just above the surface at the centre of a generated square of chunks,
+   * in random directions, and times a single Raycast per ray and RaycastBatch over the
+   * job system. Long reaches mostly end at the edge of the square or in the sky.
+   */
+  int BenchFrustum(int argc, char** argv)
+  {
+    // Section-sized boxes of a square of chunks around the camera.
+    const int render_distance = std::max(ArgInt(argc, argv, 2, 32), 1);
+    const int iterations = std::max(ArgInt(argc, argv, 3, 1000), 1);
+
+    heh::AabbList boxes;
+    for (int z = -render_distance; z <= render_distance; ++z)
+    {
+      for (int x = -render_distance; x <= render_distance; ++x)
+      {
+        for (int section = 0; section < static_cast<int>(heh::kSectionsPerChunk); ++section)
+        {
+          const glm::vec3 min(static_cast<float>(x * 16), static_cast<float>(section * 16), static_cast<float>(z * 16));
+          boxes.Add(min, min + glm::vec3(16.0f));
+        }
+      }
+    }
+
+    const glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f,
+                                                  static_cast<float>(render_distance * 16) * 1.5f);
+    std::vector<heh::Frustum> frustums;
+    for (int i = 0; i < 16; ++i)
+    {
+      // Turning around while looking slightly down, as from the surface.
+      const float yaw = glm::radians(static_cast<float>(i) * 22.5f);
+      const glm::vec3 eye(0.0f, 80.0f, 0.0f);
+      const glm::vec3 front(std::cos(yaw), -0.3f, std::sin(yaw));
+      frustums.emplace_back();
+      frustums.back().Update(projection * glm::lookAt(eye, eye + front, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
+    std::vector<uint8_t> visible;
+    size_t visible_count = 0;
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; ++i)
+      visible_count += boxes.Cull(frustums[static_cast<size_t>(i) % frustums.size()], visible);
+    const double seconds = SecondsSince(start);
+
+    // The SoA loop must agree with the per-box test.
+    size_t mismatches = 0;
+    for (const heh::Frustum& frustum : frustums)
+    {
+      boxes.Cull(frustum, visible);
+      size_t index = 0;
+      for (int z = -render_distance; z <= render_distance; ++z)
+      {
+        for (int x = -render_distance; x <= render_distance; ++x)
+        {
+          for (int section = 0; section < static_cast<int>(heh::kSectionsPerChunk); ++section, ++index)
+          {
+            const glm::vec3 min(static_cast<float>(x * 16), static_cast<float>(section * 16), static_cast<float>(z * 16));
+            mismatches += (visible[index] != 0) != frustum.IsBoxVisible(min, min + glm::vec3(16.0f)) ? 1 : 0;
+          }
+        }
+      }
+    }
+
+    const double tests = static_cast<double>(boxes.Size()) * iterations;
+    std::printf("render distance %d  boxes %zu  iterations %d\n", render_distance, boxes.Size(), iterations);
+    std::printf("  cull      %7.3f ns/box  %7.1f us/frame\n", seconds * 1e9 / tests, seconds * 1e6 / iterations);
+    std::printf("  visible   %6.1f%%\n", 100.0 * static_cast<double>(visible_count) / tests);
+    std::printf("  mismatches %zu\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+  }
+
+  /**
+   * Streams and meshes the chunks around the origin, then counts the sections with faces
+   * that the frustum alone would draw against those the visibility graph reaches, and
+   * those left after the occlusion depth buffer, from the surface and from a cave,
+   * looking around. Rays cast through each view check that every section they hit first
+   * was kept, and the depth buffer tests must give the same set with and without jobs.
+   */
+  int BenchVisibility(int argc, char** argv)
+  {
+    heh::config::WorldConfig settings = heh::config::file.world;
+    settings.render_distance = std::max(ArgInt(argc, argv, 2, 8), 1);
+    settings.prefetch_lookahead = 0.0f;
+    const int ray_count = std::max(ArgInt(argc, argv, 3, 20000), 1);
+
+    heh::world::World world;
+    heh::world::TerrainGenerator generator(static_cast<uint32_t>(settings.seed));
+    heh::JobSystem jobs;
+    heh::world::ChunkStreamer streamer(world, generator, jobs, settings);
+
+    const float surface = static_cast<float>(generator.GetHeight(0, 0));
+    heh::VisibilityGraph graph;
+    std::map<heh::world::ChunkKey, std::array<uint32_t, heh::kSectionsPerChunk + 1>> meshes;
+    std::map<heh::world::ChunkKey, uint16_t> closed;
+    double time = 0.0;
+    for (;;)
+    {
+      streamer.Update(glm::vec3(0.0f, surface, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), time);
+      streamer.PopUnloaded();
+      for (auto& mesh : streamer.PopReadyMeshes(SIZE_MAX))
+      {
+        graph.Set(mesh.x, mesh.z, mesh.data->section_connectivity);
+        meshes[heh::world::PackChunkKey(mesh.x, mesh.z)] = mesh.data->section_elements;
+        uint16_t& bits = closed[heh::world::PackChunkKey(mesh.x, mesh.z)];
+        bits = 0;
+        for (uint32_t s = 0; s < heh::kSectionsPerChunk; ++s)
+          bits |= mesh.data->section_connectivity[s] == 0 ? static_cast<uint16_t>(1u << s) : 0;
+      }
+      if (streamer.GetJobsInFlight() == 0 && !meshes.empty() && time > 1.0)
+        break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      time += 0.01;
+    }
+
+    // A cave: the deepest air block under a column near the origin.
+    glm::vec3 cave(0.0f, -1.0f, 0.0f);
+    for (int x = 0; x < 64 && cave.y < 0.0f; ++x)
+    {
+      for (int y = 8; y < generator.GetHeight(x, 0) - 24; ++y)
+      {
+        if (world.GetBlock(x, y, 0) == heh::kAirBlock && world.GetBlock(x, y + 1, 0) == heh::kAirBlock)
+        {
+          cave = glm::vec3(static_cast<float>(x), static_cast<float>(y) + 0.6f, 0.0f);
+          break;
+        }
+      }
+    }
+
+    struct View {
+      const char* label;
+      glm::vec3 eye;
+    };
+    std::vector<View> views = { { "surface", glm::vec3(0.0f, surface + 1.7f, 0.0f) } };
+    if (cave.y >= 0.0f)
+      views.push_back({ "cave", cave });
+
+    const float reach = static_cast<float>(settings.render_distance * static_cast<int>(heh::kChunkWidth));
+    const glm::mat4 projection = glm::perspective(glm::radians(80.0f), 16.0f / 9.0f, 0.1f, reach * 1.5f);
+    std::mt19937 rng(99);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    size_t missed_total = 0;
+    size_t mismatches = 0;
+    heh::OcclusionCuller occlusion;
+    std::printf("render distance %d  chunks %zu\n", settings.render_distance, meshes.size());
+    for (const View& view : views)
+    {
+      size_t frustum_sections = 0;
+      size_t graph_sections = 0;
+      size_t depth_sections = 0;
+      size_t missed = 0;
+      size_t depth_missed = 0;
+      double seconds = 0.0;
+      double occlusion_seconds = 0.0;
+      size_t occluders = 0;
+      for (int i = 0; i < 8; ++i)
+      {
+        const float yaw = glm::radians(static_cast<float>(i) * 45.0f);
+        const glm::vec3 front = glm::normalize(glm::vec3(std::cos(yaw), -0.2f, std::sin(yaw)));
+        const glm::mat4 projection_view = projection * glm::lookAt(view.eye, view.eye + front, glm::vec3(0.0f, 1.0f, 0.0f));
+        heh::Frustum frustum;
+        frustum.Update(projection_view);
+        graph.Traverse(view.eye, frustum, settings.render_distance + settings.unload_margin);
+        seconds += graph.GetStats().seconds;
+
+        // Occluders as the renderer picks them: closed sections of the chunks near the eye.
+        const Clock::time_point occlusion_start = Clock::now();
+        const int32_t eye_x = static_cast<int32_t>(std::floor((view.eye.x + 0.5f) / 16.0f));
+        const int32_t eye_z = static_cast<int32_t>(std::floor((view.eye.z + 0.5f) / 16.0f));
+        occlusion.Begin(projection_view);
+        for (const auto& [key, bits] : closed)
+        {
+          const int32_t x = heh::world::ChunkKeyX(key);
+          const int32_t z = heh::world::ChunkKeyZ(key);
+          if (bits && std::abs(x - eye_x) <= 4 && std::abs(z - eye_z) <= 4)
+            occlusion.AddClosedSections(x, z, bits);
+        }
+        occlusion.Rasterize(&jobs);
+        occlusion_seconds += SecondsSince(occlusion_start);
+        occluders += occlusion.GetOccluderCount();
+        const std::vector<float> parallel_depth = occlusion.GetDepth();
+        occlusion.Rasterize(nullptr);
+        mismatches += parallel_depth == occlusion.GetDepth() ? 0 : 1;
+
+        std::map<heh::world::ChunkKey, uint16_t> kept;
+        for (const auto& [key, sections] : meshes)
+        {
+          const uint16_t reached = graph.GetVisibleSections(heh::world::ChunkKeyX(key), heh::world::ChunkKeyZ(key));
+          for (uint32_t s = 0; s < heh::kSectionsPerChunk; ++s)
+          {
+            if (sections[s + 1] == sections[s])
+              continue;
+            const glm::vec3 min = glm::vec3(static_cast<float>(heh::world::ChunkKeyX(key) * 16), static_cast<float>(s * 16),
+                                            static_cast<float>(heh::world::ChunkKeyZ(key) * 16)) - glm::vec3(0.5f);
+            if (!frustum.IsBoxVisible(min, min + glm::vec3(16.0f)))
+              continue;
+            ++frustum_sections;
+            if (!((reached >> s) & 1))
+              continue;
+            ++graph_sections;
+            if (occlusion.IsSectionVisible(heh::world::ChunkKeyX(key), static_cast<int32_t>(s), heh::world::ChunkKeyZ(key)))
+            {
+              ++depth_sections;
+              kept[key] |= static_cast<uint16_t>(1u << s);
+            }
+          }
+        }
+
+        // Every first hit of a ray through the view must be in a section the graph kept.
+        const glm::mat4 inverse = glm::inverse(projection_view);
+        for (int r = 0; r < ray_count / 8; ++r)
+        {
+          const glm::vec4 far = inverse * glm::vec4(unit(rng), unit(rng), 1.0f, 1.0f);
+          const heh::world::Ray ray{ view.eye, glm::normalize(glm::vec3(far) / far.w - view.eye) };
+          heh::world::RaycastHit hit;
+          if (!heh::world::Raycast(world, ray, reach, hit))
+            continue;
+          const int32_t cx = hit.block.x >> 4;
+          const int32_t cz = hit.block.z >> 4;
+          const heh::world::ChunkKey key = heh::world::PackChunkKey(cx, cz);
+          if (!meshes.count(key))
+            continue;
+          if (!((graph.GetVisibleSections(cx, cz) >> (hit.block.y >> 4)) & 1))
+            ++missed;
+          else if (!((kept[key] >> (hit.block.y >> 4)) & 1))
+            ++depth_missed;
+        }
+      }
+      missed_total += missed + depth_missed;
+      std::printf("  %-8s sections drawn: frustum %6zu  graph %6zu (%5.1f%%)  depth %6zu (%5.1f%%)  missed hits %zu / %zu\n",
+                  view.label, frustum_sections / 8, graph_sections / 8,
+                  frustum_sections ? 100.0 * graph_sections / frustum_sections : 0.0, depth_sections / 8,
+                  frustum_sections ? 100.0 * depth_sections / frustum_sections : 0.0, missed, depth_missed);
+      std::printf("           %7.3f ms/traverse  %7.3f ms/occlusion raster (%zu occluders)\n", seconds * 1000.0 / 8,
+                  occlusion_seconds * 1000.0 / 8, occluders / 8);
+    }
+    std::printf("parallel raster mismatches %zu\n", mismatches);
+    return missed_total == 0 && mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  int BenchRaycast(int argc, char** argv)
+  {
+    const int ray_count = std::max(ArgInt(argc, argv, 2, 100000), 1);
+    const float reach = static_cast<float>(std::max(ArgInt(argc, argv, 3, 64), 1));
+    const int radius = static_cast<int>(reach) / static_cast<int>(heh::kChunkWidth) + 1;
+
+    const heh::world::TerrainGenerator generator(static_cast<uint32_t>(heh::config::file.world.seed));
+    heh::JobSystem jobs;
+    heh::world::World world;
+
+    std::vector<std::unique_ptr<heh::Chunk>> chunks;
+    for (int z = -radius; z <= radius; ++z)
+    {
+      for (int x = -radius; x <= radius; ++x)
+      {
+        auto chunk = std::make_unique<heh::Chunk>();
+        chunk->x = x;
+        chunk->z = z;
+        chunks.push_back(std::move(chunk));
+      }
+    }
+    jobs.ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+      {
+        generator.Generate(*chunks[i]);
+        chunks[i]->status = heh::ChunkStatus::kFeatures;
+      }
+    });
+    for (auto& chunk : chunks)
+      world.InsertChunk(std::move(chunk));
+
+    const glm::vec3 origin(0.0f, static_cast<float>(generator.GetHeight(0, 0)) + 1.6f, 0.0f);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<heh::world::Ray> rays(static_cast<size_t>(ray_count));
+    for (heh::world::Ray& ray : rays)
+    {
+      glm::vec3 dir;
+      do
+        dir = glm::vec3(unit(rng), unit(rng), unit(rng));
+      while (glm::dot(dir, dir) > 1.0f || glm::dot(dir, dir) < 1e-4f);
+      ray = { origin, glm::normalize(dir) };
+    }
+
+    std::vector<heh::world::RaycastHit> hits(rays.size());
+    Clock::time_point start = Clock::now();
+    size_t hit_count = 0;
+    for (size_t i = 0; i < rays.size(); ++i)
+      hit_count += heh::world::Raycast(world, rays[i], reach, hits[i]) ? 1 : 0;
+    const double single_seconds = SecondsSince(start);
+
+    start = Clock::now();
+    heh::world::RaycastBatch(world, rays.data(), rays.size(), reach, hits.data(), &jobs);
+    const double batch_seconds = SecondsSince(start);
+
+    size_t batch_hit_count = 0;
+    for (const heh::world::RaycastHit& hit : hits)
+      batch_hit_count += hit.hit ? 1 : 0;
+
+    std::printf("reach %.0f  rays %d  hits %zu\n", reach, ray_count, hit_count);
+    std::printf("  single  %7.3f us/ray\n", single_seconds * 1e6 / ray_count);
+    std::printf("  batch   %7.3f us/ray  %u threads%s\n",
+      batch_seconds * 1e6 / ray_count,
+      jobs.GetThreadCount(),
+      batch_hit_count == hit_count ? "" : "  MISMATCH");
+    return batch_hit_count == hit_count ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  /**
+   * Many bodies wandering over a generated square of chunks at 30 ticks per second:
+   * each walks in a random direction, jumps when blocked and turns now and then.
+   * Times StepBodies single threaded and on the job system, and checks that no body
+   * ends up inside a solid block.
+   */
+  int BenchPhysics(int argc, char** argv)
+  {
+    const int body_count = std::max(ArgInt(argc, argv, 2, 1000), 1);
+    const int ticks = std::max(ArgInt(argc, argv, 3, 300), 1);
+    const int radius = 3;
+    const float dt = 1.0f / 30.0f;
+
+    const heh::world::TerrainGenerator generator(static_cast<uint32_t>(heh::config::file.world.seed));
+    heh::JobSystem jobs;
+    heh::world::World world;
+    for (int z = -radius; z <= radius; ++z)
+    {
+      for (int x = -radius; x <= radius; ++x)
+      {
+        auto chunk = std::make_unique<heh::Chunk>();
+        chunk->x = x;
+        chunk->z = z;
+        generator.Generate(*chunk);
+        chunk->status = heh::ChunkStatus::kFeatures;
+        world.InsertChunk(std::move(chunk));
+      }
+    }
+
+    const float extent = static_cast<float>(radius * static_cast<int>(heh::kChunkWidth));
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    auto wander = [&](heh::world::Body& body) {
+      const float angle = unit(rng) * 3.14159265f;
+      body.velocity.x = std::cos(angle) * 4.0f;
+      body.velocity.z = std::sin(angle) * 4.0f;
+    };
+
+    auto spawn = [&](std::vector<heh::world::Body>& bodies) {
+      rng.seed(1234);
+      bodies.assign(static_cast<size_t>(body_count), heh::world::Body{});
+      for (heh::world::Body& body : bodies)
+      {
+        const float x = unit(rng) * extent * 0.8f;
+        const float z = unit(rng) * extent * 0.8f;
+        const int32_t height = generator.GetHeight(static_cast<int32_t>(std::floor(x + 0.5f)), static_cast<int32_t>(std::floor(z + 0.5f)));
+        body.position = glm::vec3(x, static_cast<float>(height) + 4.0f, z);
+        wander(body);
+      }
+    };
+
+    auto run = [&](heh::JobSystem* job_system, std::vector<heh::world::Body>& bodies) {
+      double worst = 0.0;
+      const Clock::time_point start = Clock::now();
+      for (int tick = 0; tick < ticks; ++tick)
+      {
+        const Clock::time_point tick_start = Clock::now();
+        heh::world::StepBodies(world, bodies.data(), bodies.size(), dt, job_system);
+        worst = std::max(worst, SecondsSince(tick_start));
+
+        // Steering, as a game would do between ticks.
+        for (heh::world::Body& body : bodies)
+        {
+          const bool blocked = body.velocity.x == 0.0f || body.velocity.z == 0.0f;
+          if (body.on_ground && blocked)
+            body.velocity.y = 8.5f;
+          if (blocked || (rng() & 63) == 0 || std::abs(body.position.x) > extent || std::abs(body.position.z) > extent)
+            wander(body);
+        }
+      }
+      return std::make_pair(SecondsSince(start), worst);
+    };
+
+    std::vector<heh::world::Body> single;
+    spawn(single);
+    const auto [single_seconds, single_worst] = run(nullptr, single);
+
+    std::vector<heh::world::Body> parallel;
+    spawn(parallel);
+    const auto [parallel_seconds, parallel_worst] = run(&jobs, parallel);
+
+    // Bodies rest on or beside blocks, never in them.
+    size_t embedded = 0;
+    for (const heh::world::Body& body : parallel)
+    {
+      const heh::world::Aabb box = body.GetBounds();
+      bool inside = false;
+      for (int32_t x = static_cast<int32_t>(std::floor(box.min.x + 0.5f + 1e-3f)); x <= static_cast<int32_t>(std::floor(box.max.x + 0.5f - 1e-3f)); ++x)
+        for (int32_t y = static_cast<int32_t>(std::floor(box.min.y + 0.5f + 1e-3f)); y <= static_cast<int32_t>(std::floor(box.max.y + 0.5f - 1e-3f)); ++y)
+          for (int32_t z = static_cast<int32_t>(std::floor(box.min.z + 0.5f + 1e-3f)); z <= static_cast<int32_t>(std::floor(box.max.z + 0.5f - 1e-3f)); ++z)
+            inside = inside || heh::block_map::IsSolid(world.GetBlock(x, y, z));
+      embedded += inside ? 1 : 0;
+    }
+
+    const double per_tick = 1000.0 / ticks;
+    std::printf("bodies %d  ticks %d\n", body_count, ticks);
+    std::printf("  single  %7.3f ms/tick  worst %7.3f ms  %6.3f us/body\n",
+      single_seconds * per_tick, single_worst * 1000.0, single_seconds * 1e6 / ticks / body_count);
+    std::printf("  jobs    %7.3f ms/tick  worst %7.3f ms  %6.3f us/body  %u threads\n",
+      parallel_seconds * per_tick, parallel_worst * 1000.0, parallel_seconds * 1e6 / ticks / body_count, jobs.GetThreadCount());
+    std::printf("  bodies inside solid blocks: %zu\n", embedded);
+    return embedded == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  /**
+   * Bulk edits over a size^3 box (clipped to the world height) against the same fill done
+   * one World::SetBlock at a time, then random boxes checked block by block against a
+   * naive reference.
+   */
+  int BenchEdit(int argc, char** argv)
+  {
+    const int size = std::max(ArgInt(argc, argv, 2, 256), 1);
+    const int chunks = (size + static_cast<int>(heh::kChunkWidth) - 1) / static_cast<int>(heh::kChunkWidth);
+
+    const heh::world::TerrainGenerator generator(static_cast<uint32_t>(heh::config::file.world.seed));
+    heh::JobSystem jobs;
+    heh::world::World world;
+    for (int z = -1; z <= chunks; ++z)
+    {
+      for (int x = -1; x <= chunks; ++x)
+      {
+        auto chunk = std::make_unique<heh::Chunk>();
+        chunk->x = x;
+        chunk->z = z;
+        generator.Generate(*chunk);
+        chunk->status = heh::ChunkStatus::kFeatures;
+        world.InsertChunk(std::move(chunk));
+      }
+    }
+
+    const heh::BlockId stone = static_cast<heh::BlockId>(heh::block_map::FindBlockId("stone", 1));
+    const heh::BlockId glass = static_cast<heh::BlockId>(heh::block_map::FindBlockId("glass", 1));
+    const heh::world::BlockBox box{ glm::ivec3(0), glm::ivec3(size - 1) };
+
+    auto report = [](const char* name, double seconds, const heh::world::EditStats& stats) {
+      std::printf("  %-8s %8.3f ms  %10zu blocks  %10zu changed  %5zu full / %5zu partial sections  %4zu chunks\n",
+        name, seconds * 1000.0, stats.blocks, stats.changed, stats.full_sections, stats.partial_sections,
+        stats.chunks.size());
+    };
+
+    std::printf("box %d^3, %u threads\n", size, jobs.GetThreadCount());
+    Clock::time_point start = Clock::now();
+    for (int x = 0; x < size; ++x)
+      for (int z = 0; z < size; ++z)
+        for (int y = 0; y < std::min(size, static_cast<int>(heh::kChunkHeight)); ++y)
+          world.SetBlock(x, y, z, glass);
+    std::printf("  %-8s %8.3f ms\n", "setblock", SecondsSince(start) * 1000.0);
+
+    start = Clock::now();
+    heh::world::EditStats stats = heh::world::FillBox(world, box, stone, &jobs);
+    report("fill", SecondsSince(start), stats);
+    start = Clock::now();
+    stats = heh::world::ReplaceInBox(world, box, stone, glass, &jobs);
+    report("replace", SecondsSince(start), stats);
+    start = Clock::now();
+    const heh::world::BlockClipboard clipboard = heh::world::CopyBox(world, box, &jobs);
+    std::printf("  %-8s %8.3f ms\n", "copy", SecondsSince(start) * 1000.0);
+    start = Clock::now();
+    stats = heh::world::PasteBox(world, clipboard, glm::ivec3(-5, 3, -7), true, &jobs);
+    report("paste", SecondsSince(start), stats);
+
+    // Random boxes against a naive copy of the world.
+    std::mt19937 rng(99);
+    auto random_box = [&]() {
+      auto coord = [&](int limit) { return static_cast<int32_t>(rng() % static_cast<uint32_t>(limit + 40)) - 20; };
+      return heh::world::BlockBox::FromCorners(glm::ivec3(coord(size), coord(300), coord(size)),
+                                               glm::ivec3(coord(size), coord(300), coord(size)));
+    };
+    auto in_box = [](const heh::world::BlockBox& b, int32_t x, int32_t y, int32_t z) {
+      return x >= b.min.x && x <= b.max.x && y >= b.min.y && y <= b.max.y && z >= b.min.z && z <= b.max.z;
+    };
+    const int32_t extent = chunks * static_cast<int32_t>(heh::kChunkWidth) + 16;
+    size_t mismatches = 0;
+    for (int round = 0; round < 20; ++round)
+    {
+      const heh::world::BlockBox edit_box = random_box();
+      const heh::world::BlockBox copy_box = random_box();
+      const glm::ivec3 origin = random_box().min;
+      const heh::BlockId id = static_cast<heh::BlockId>(1 + rng() % 4);
+      const int op = round % 3;
+
+      std::vector<heh::BlockId> expected;
+      for (int32_t x = -16; x < extent; ++x)
+        for (int32_t z = -16; z < extent; ++z)
+          for (int32_t y = 0; y < static_cast<int32_t>(heh::kChunkHeight); ++y)
+            expected.push_back(world.GetBlock(x, y, z));
+      auto at = [&](int32_t x, int32_t y, int32_t z) -> heh::BlockId& {
+        return expected[(static_cast<size_t>(x + 16) * (extent + 16) + static_cast<size_t>(z + 16)) * heh::kChunkHeight + y];
+      };
+      const std::vector<heh::BlockId> before = expected;
+      auto before_at = [&](int32_t x, int32_t y, int32_t z) {
+        const bool loaded = x >= -16 && x < extent && z >= -16 && z < extent && y >= 0 && y < static_cast<int32_t>(heh::kChunkHeight);
+        return loaded ? before[(static_cast<size_t>(x + 16) * (extent + 16) + static_cast<size_t>(z + 16)) * heh::kChunkHeight + y]
+                      : heh::kAirBlock;
+      };
+
+      heh::world::BlockClipboard copied;
+      if (op == 2)
+        copied = heh::world::CopyBox(world, copy_box, &jobs);
+      for (int32_t x = -16; x < extent; ++x)
+      {
+        for (int32_t z = -16; z < extent; ++z)
+        {
+          for (int32_t y = 0; y < static_cast<int32_t>(heh::kChunkHeight); ++y)
+          {
+            heh::BlockId& block = at(x, y, z);
+            if (op == 0 && in_box(edit_box, x, y, z))
+              block = id;
+            else if (op == 1 && in_box(edit_box, x, y, z) && block == heh::kAirBlock)
+              block = id;
+            else if (op == 2)
+            {
+              const glm::ivec3 source = glm::ivec3(x, y, z) - origin + copy_box.min;
+              if (in_box(copy_box, source.x, source.y, source.z) && before_at(source.x, source.y, source.z) != heh::kAirBlock)
+                block = before_at(source.x, source.y, source.z);
+            }
+          }
+        }
+      }
+
+      if (op == 0)
+        heh::world::FillBox(world, edit_box, id, &jobs);
+      else if (op == 1)
+        heh::world::ReplaceInBox(world, edit_box, heh::kAirBlock, id, &jobs);
+      else
+        heh::world::PasteBox(world, copied, origin, true, &jobs);
+
+      for (int32_t x = -16; x < extent; ++x)
+        for (int32_t z = -16; z < extent; ++z)
+          for (int32_t y = 0; y < static_cast<int32_t>(heh::kChunkHeight); ++y)
+            mismatches += world.GetBlock(x, y, z) != at(x, y, z);
+    }
+    std::printf("  random boxes: %zu mismatches\n", mismatches);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  /**
+   * FNV-1a of the blocks of every loaded chunk, in key order.
+   */
+  uint64_t HashWorld(const heh::world::World& world)
+  {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    std::vector<heh::Chunk*> chunks;
+    world.ForEachChunk([&chunks](heh::Chunk* chunk) { chunks.push_back(chunk); });
+    std::sort(chunks.begin(), chunks.end(), [](const heh::Chunk* a, const heh::Chunk* b) {
+      return heh::world::PackChunkKey(a->x, a->z) < heh::world::PackChunkKey(b->x, b->z);
+    });
+    for (const heh::Chunk* chunk : chunks)
+    {
+      for (heh::BlockId id : chunk->blocks_data)
+      {
+        hash ^= static_cast<uint16_t>(id);
+        hash *= 0x100000001b3ull;
+      }
+    }
+    return hash;
+  }
+
+  /**
+   * Streams the chunks around the origin, strips the grass of a 32x32 patch down to dirt,
+   * then runs block ticks and lets the grass grow back. Reports the tick cost next to the
+   * number of active sections, which is what it should follow, and a hash of the blocks
+   * that must not change between runs.
+   */
+  void RunTicks(const heh::config::WorldConfig& settings, int ticks)
+  {
+    heh::world::World world;
+    heh::world::TerrainGenerator generator(static_cast<uint32_t>(settings.seed));
+    heh::JobSystem jobs;
+    heh::world::ChunkStreamer streamer(world, generator, jobs, settings);
+    heh::world::TickScheduler scheduler(world, streamer, jobs, static_cast<uint32_t>(settings.seed),
+                                        settings.random_tick_speed);
+
+    const glm::vec3 pos(0.0f, static_cast<float>(heh::kChunkHeight), 0.0f);
+    const glm::vec3 front(0.0f, 0.0f, -1.0f);
+    double time = 0.0;
+    auto stream = [&]() {
+      for (int idle = 0; idle < 3; time += 1.0 / 60.0)
+      {
+        streamer.Update(pos, front, time);
+        streamer.PopUnloaded();
+        streamer.PopReadyMeshes(SIZE_MAX);
+        idle = streamer.GetJobsInFlight() == 0 ? idle + 1 : 0;
+        if (idle == 0)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    };
+    stream();
+
+    const heh::BlockId grass = static_cast<heh::BlockId>(heh::block_map::FindBlockId("grass", heh::kAirBlock));
+    const heh::BlockId dirt = static_cast<heh::BlockId>(heh::block_map::FindBlockId("dirt", heh::kAirBlock));
+    size_t stripped = 0;
+    if (dirt != heh::kAirBlock)
+    {
+      for (int32_t x = -16; x < 16; ++x)
+      {
+        for (int32_t z = -16; z < 16; ++z)
+        {
+          const glm::ivec3 block(x, generator.GetHeight(x, z), z);
+          if (world.GetBlock(block) == grass && scheduler.SetBlock(block, dirt))
+            ++stripped;
+        }
+      }
+    }
+    stream();
+
+    size_t edits = 0;
+    size_t active_sections = 0;
+    for (int tick = 0; tick < ticks; ++tick)
+    {
+      scheduler.Tick();
+      edits += scheduler.GetStats().edits;
+      active_sections += scheduler.GetStats().active_sections;
+      // Remeshing runs between ticks, as it would between frames.
+      streamer.Update(pos, front, time);
+      streamer.PopReadyMeshes(SIZE_MAX);
+      time += 1.0 / 20.0;
+    }
+    stream();
+
+    const uint64_t hash = HashWorld(world);
+    const heh::world::TickStats& stats = scheduler.GetStats();
+    std::printf("render distance %d  random tick speed %d  %zu chunks ticked  %u threads\n",
+      settings.render_distance, settings.random_tick_speed, stats.chunks, jobs.GetThreadCount());
+    std::printf("  %d ticks  avg %7.3f ms  max %7.3f ms  %7.1f active sections/tick  %zu edits  (%zu grass stripped)\n",
+      ticks, stats.timing.AverageSeconds() * 1000.0, stats.timing.max_seconds * 1000.0,
+      static_cast<double>(active_sections) / ticks, edits, stripped);
+    std::printf("  scheduled ticks pending %zu  hash %016llx\n", stats.pending_ticks, static_cast<unsigned long long>(hash));
+  }
+
+  int BenchTicks(int argc, char** argv)
+  {
+    const int ticks = std::max(ArgInt(argc, argv, 2, 200), 1);
+    heh::config::WorldConfig settings = heh::config::file.world;
+    settings.render_distance = ArgInt(argc, argv, 3, settings.render_distance);
+    settings.prefetch_lookahead = 0.0f;
+
+    // Without random ticks nothing is active, so the cost should stay flat in the world size.
+    heh::config::WorldConfig inert = settings;
+    inert.random_tick_speed = 0;
+    RunTicks(inert, ticks);
+    RunTicks(settings, ticks);
+    return EXIT_SUCCESS;
+  }
+
+  /**
+   * Runs a server on loopback with simulated clients spread apart along +x. Reports the
+   * time from connecting to holding every chunk in view, then the bytes per second while
+   * the clients walk, and finally checks that every client's blocks match the server's.
+   */
+  int BenchNetwork(int argc, char** argv)
+  {
+    const int client_count = std::max(ArgInt(argc, argv, 2, 4), 1);
+    const int radius = std::clamp(ArgInt(argc, argv, 3, 8), 1, 32);
+    const double walk_seconds = std::max(ArgInt(argc, argv, 4, 10), 0);
+    const float walk_speed = 8.0f;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "hehcraft_bench_network";
+    std::filesystem::remove_all(directory);
+
+    heh::config::Config config = heh::config::file;
+    config.world.render_distance = radius;
+    config.world.prefetch_lookahead = 0.0f;
+    config.server.world_directory = directory.string();
+    config.server.save_interval = 0.0f;
+    heh::server::Server server(config);
+    server.Listen("127.0.0.1:0");
+    const double period = 1.0 / server.GetTickRate();
+
+    int64_t in_view = 0;
+    for (int32_t dz = -radius; dz <= radius; ++dz)
+    {
+      for (int32_t dx = -radius; dx <= radius; ++dx)
+        in_view += dx * dx + dz * dz <= radius * radius ? 1 : 0;
+    }
+
+    struct SimulatedClient {
+      std::unique_ptr<heh::net::Client> client;
+      glm::vec3 pos;
+      double joined = -1.0;
+    };
+    std::vector<SimulatedClient> clients;
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < client_count; ++i)
+    {
+      SimulatedClient simulated;
+      simulated.client = std::make_unique<heh::net::Client>(server.GetListenAddress(), radius);
+      simulated.pos = server.GetAnchor() + glm::vec3(static_cast<float>(i * radius * 2 * heh::kChunkWidth), 0.0f, 0.0f);
+      simulated.client->SendPosition(simulated.pos);
+      clients.push_back(std::move(simulated));
+    }
+
+    auto has_full_view = [radius](SimulatedClient& simulated) {
+      const int32_t cx = heh::world::BlockToChunk(static_cast<int32_t>(std::floor(simulated.pos.x)));
+      const int32_t cz = heh::world::BlockToChunk(static_cast<int32_t>(std::floor(simulated.pos.z)));
+      for (int32_t dz = -radius; dz <= radius; ++dz)
+      {
+        for (int32_t dx = -radius; dx <= radius; ++dx)
+        {
+          if (dx * dx + dz * dz <= radius * radius && !simulated.client->GetWorld().GetChunk(cx + dx, cz + dz))
+            return false;
+        }
+      }
+      return true;
+    };
+
+    // Ticks at the tick rate and keeps the clients reading in between.
+    Clock::time_point due = Clock::now();
+    auto step = [&](bool walk) {
+      server.Tick();
+      for (SimulatedClient& simulated : clients)
+      {
+        if (walk)
+        {
+          simulated.pos.x += walk_speed * static_cast<float>(period);
+          simulated.client->SendPosition(simulated.pos);
+        }
+        simulated.client->PopChangedChunks();
+      }
+      due += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(period));
+      do
+      {
+        for (SimulatedClient& simulated : clients)
+        {
+          if (!simulated.client->Poll())
+            throw std::runtime_error("Client lost the connection");
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+      } while (Clock::now() < due);
+    };
+
+    size_t joined = 0;
+    while (joined < clients.size())
+    {
+      if (SecondsSince(start) > 120.0)
+        throw std::runtime_error("Clients did not get their view within 120 seconds");
+      step(false);
+      for (SimulatedClient& simulated : clients)
+      {
+        if (simulated.joined < 0.0 && has_full_view(simulated))
+        {
+          simulated.joined = SecondsSince(start);
+          ++joined;
+        }
+      }
+    }
+
+    std::printf("%d clients  view radius %d (%lld chunks)  %d ticks/s  %.0f KiB/s per client cap\n", client_count,
+      radius, static_cast<long long>(in_view), server.GetTickRate(), config.server.client_bandwidth * 1.0);
+    double join_total = 0.0;
+    double join_max = 0.0;
+    for (const SimulatedClient& simulated : clients)
+    {
+      join_total += simulated.joined;
+      join_max = std::max(join_max, simulated.joined);
+    }
+    const heh::server::ServerStats joined_stats = server.GetStats();
+    std::printf("  join to full view: avg %6.2f s  max %6.2f s  %llu chunks  %.2f MiB (%.0f bytes/chunk)\n",
+      join_total / clients.size(), join_max, static_cast<unsigned long long>(joined_stats.chunks_sent),
+      static_cast<double>(joined_stats.bytes_sent) / (1024.0 * 1024.0),
+      static_cast<double>(joined_stats.bytes_sent) / std::max<double>(static_cast<double>(joined_stats.chunks_sent), 1.0));
+
+    const Clock::time_point walk_start = Clock::now();
+    while (SecondsSince(walk_start) < walk_seconds)
+      step(true);
+    const double walked = std::max(SecondsSince(walk_start), 1e-9);
+    const heh::server::ServerStats walk_stats = server.GetStats();
+    const double walk_bytes = static_cast<double>(walk_stats.bytes_sent - joined_stats.bytes_sent);
+    std::printf("  walking %.1f blocks/s: %.1f KiB/s total  %.1f KiB/s per client  %.1f chunks/s  %llu delta sections\n",
+      walk_speed, walk_bytes / walked / 1024.0, walk_bytes / walked / 1024.0 / client_count,
+      static_cast<double>(walk_stats.chunks_sent - joined_stats.chunks_sent) / walked,
+      static_cast<unsigned long long>(walk_stats.delta_sections_sent));
+
+    // Stop the block behaviours and let the clients catch up before comparing.
+    server.GetTicks().SetRandomTicksPerSection(0);
+    int quiet = 0;
+    for (int tick = 0; quiet < 5 && tick < 60 * server.GetTickRate(); ++tick)
+    {
+      step(false);
+      const bool caught_up = std::all_of(clients.begin(), clients.end(), has_full_view);
+      quiet = caught_up && server.GetTicks().GetStats().edits == 0 ? quiet + 1 : 0;
+    }
+
+    size_t compared = 0;
+    size_t mismatches = 0;
+    for (SimulatedClient& simulated : clients)
+    {
+      simulated.client->GetWorld().ForEachChunk([&](heh::Chunk* chunk) {
+        const heh::Chunk* original = server.GetWorld().GetChunk(chunk->x, chunk->z);
+        if (!original)
+          return;
+        ++compared;
+        mismatches += chunk->blocks_data == original->blocks_data ? 0 : 1;
+      });
+    }
+    std::printf("  %zu client chunks compared: %zu mismatches\n", compared, mismatches);
+
+    clients.clear();
+    server.Save();
+    std::filesystem::remove_all(directory);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  /**
+   * Strips every grass block in view down to dirt and ticks the world while the grass
+   * grows back, with many random ticks per section so most ticks edit blocks, some across
+   * region borders. Runs with 1, 2, 4, ... up to max_threads threads and checks that
+   * every run ends with the same blocks.
+   */
+  int BenchTickScaling(int argc, char** argv)
+  {
+    const int ticks = std::max(ArgInt(argc, argv, 2, 100), 1);
+    heh::config::WorldConfig settings = heh::config::file.world;
+    settings.render_distance = ArgInt(argc, argv, 3, 12);
+    settings.prefetch_lookahead = 0.0f;
+    const unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+    const unsigned max_threads = static_cast<unsigned>(std::max(ArgInt(argc, argv, 4, static_cast<int>(cores)), 1));
+    const int region_size = ArgInt(argc, argv, 5, heh::world::TickScheduler::kMinRegionSize);
+    constexpr int kRandomTicksPerSection = 512;
+
+    const heh::BlockId grass = static_cast<heh::BlockId>(heh::block_map::FindBlockId("grass", heh::kAirBlock));
+    const heh::BlockId dirt = static_cast<heh::BlockId>(heh::block_map::FindBlockId("dirt", heh::kAirBlock));
+    if (grass == heh::kAirBlock || dirt == heh::kAirBlock)
+    {
+      std::cerr << "tick_scaling needs grass and dirt blocks" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    double single_thread_seconds = 0.0;
+    uint64_t first_hash = 0;
+    bool deterministic = true;
+    for (unsigned threads = 1; ; threads = std::min(threads * 2, max_threads))
+    {
+      heh::world::World world;
+      heh::world::TerrainGenerator generator(static_cast<uint32_t>(settings.seed));
+      heh::JobSystem jobs(static_cast<int>(threads) - 1);
+      heh::world::ChunkStreamer streamer(world, generator, jobs, settings);
+      // Without meshes no job holds a chunk between ticks, so every tick edits the same chunks.
+      streamer.SetMeshing(false);
+      heh::world::TickScheduler scheduler(world, streamer, jobs, static_cast<uint32_t>(settings.seed), kRandomTicksPerSection);
+      scheduler.SetRegionSize(region_size);
+
+      const glm::vec3 pos(0.0f, static_cast<float>(heh::kChunkHeight), 0.0f);
+      const glm::vec3 front(0.0f, 0.0f, -1.0f);
+      double time = 0.0;
+      for (int idle = 0; idle < 3; time += 1.0 / 60.0)
+      {
+        streamer.Update(pos, front, time);
+        streamer.PopUnloaded();
+        idle = streamer.GetJobsInFlight() == 0 ? idle + 1 : 0;
+        if (idle == 0)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+
+      std::vector<glm::ivec3> stripped;
+      for (heh::world::ChunkKey key : streamer.GetEditableChunks())
+      {
+        const heh::Chunk* chunk = world.GetChunk(heh::world::ChunkKeyX(key), heh::world::ChunkKeyZ(key));
+        const int32_t base_x = chunk->x * static_cast<int32_t>(heh::kChunkWidth);
+        const int32_t base_z = chunk->z * static_cast<int32_t>(heh::kChunkDepth);
+        for (int32_t x = base_x; x < base_x + static_cast<int32_t>(heh::kChunkWidth); ++x)
+        {
+          for (int32_t z = base_z; z < base_z + static_cast<int32_t>(heh::kChunkDepth); ++z)
+          {
+            const glm::ivec3 block(x, generator.GetHeight(x, z), z);
+            if (world.GetBlock(block) == grass)
+              stripped.push_back(block);
+          }
+        }
+      }
+      // Every other column keeps its grass to spread from.
+      size_t stripped_count = 0;
+      for (size_t i = 0; i < stripped.size(); ++i)
+        stripped_count += i % 2 != 0 && scheduler.SetBlock(stripped[i], dirt) ? 1 : 0;
+
+      size_t edits = 0;
+      size_t deferred = 0;
+      const Clock::time_point start = Clock::now();
+      for (int tick = 0; tick < ticks; ++tick)
+      {
+        scheduler.Tick();
+        edits += scheduler.GetStats().edits;
+        deferred += scheduler.GetStats().deferred_edits;
+      }
+      const double seconds = SecondsSince(start);
+      if (threads == 1)
+        single_thread_seconds = seconds;
+
+      const uint64_t hash = HashWorld(world);
+      if (threads == 1)
+        first_hash = hash;
+      deterministic = deterministic && hash == first_hash;
+
+      const heh::world::TickStats& stats = scheduler.GetStats();
+      std::printf("threads %3u  %5zu chunks in %4zu regions of %d  %7.2f ms/tick  %7.1f ticks/s  speedup %5.2fx  "
+                  "%8.0f edits/tick (%.1f%% deferred)  %zu stripped  hash %016llx\n",
+        threads, stats.chunks, stats.regions, scheduler.GetRegionSize(), seconds * 1000.0 / ticks, ticks / seconds,
+        single_thread_seconds / seconds, static_cast<double>(edits) / ticks,
+        edits ? 100.0 * static_cast<double>(deferred) / static_cast<double>(edits) : 0.0, stripped_count,
+        static_cast<unsigned long long>(hash));
+
+      if (threads == max_threads)
+        break;
+    }
+
+    std::printf("  %s\n", deterministic ? "same blocks with every thread count" : "blocks differ between thread counts");
+    return deterministic ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  struct Benchmark {
+    const char* usage;
+    std::function<int(int, char**)> run;
+  };
+
+  const std::map<std::string, Benchmark>& Benchmarks()
+  {
+    static const std::map<std::string, Benchmark> benchmarks = {
+      { "edit", { "edit [size]", BenchEdit } },
+      { "flythrough", { "flythrough [seconds] [render_distance]", BenchFlythrough } },
+      { "frustum", { "frustum [render_distance] [iterations]", BenchFrustum } },
+      { "generate", { "generate [chunks] [max_threads]", BenchGenerate } },
+      { "lod", { "lod [render_distance] [lod_distance]", BenchLod } },
+      { "network", { "network [clients] [view_radius] [seconds]", BenchNetwork } },
+      { "physics", { "physics [bodies] [ticks]", BenchPhysics } },
+      { "raycast", { "raycast [rays] [reach]", BenchRaycast } },
+      { "residency", { "residency [render_distance] [budget_mib] [frames]", BenchResidency } },
+      { "scaling", { "scaling [side] [max_threads]", BenchScaling } },
+      { "visibility", { "visibility [render_distance] [rays]", BenchVisibility } },
+      { "tick_scaling", { "tick_scaling [ticks] [render_distance] [max_threads] [region_size]", BenchTickScaling } },
+      { "ticks", { "ticks [ticks] [render_distance]", BenchTicks } },
+    };
+    return benchmarks;
+  }
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  try {
+    heh::config::InitConfigFile("config.toml", "blocks.toml", "textures.toml");
+    heh::block_map::LoadBlocks();
+
+    if (argc < 2 || Benchmarks().find(argv[1]) == Benchmarks().end()) {
+      std::cerr << "usage: hehcraft_bench <benchmark> [args...]" << std::endl;
+      for (const auto& [name, benchmark] : Benchmarks())
+        std::cerr << "  " << benchmark.usage << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    return Benchmarks().at(argv[1]).run(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,95 @@
+#include "world/block.hpp"
+#include "world/chunk_storage.hpp"
+#include "world/map_renderer.hpp"
+#include "utils/job_system.hpp"
+#include "utils/toml_extended.hpp"
+
+// std
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+/*
+  Renders a top-down map of a saved world into PNG tiles, one per region file, without a
+  window or GL context. Tiles of regions that did not change since the last run are kept.
+
+  usage: hehcraft_map [--world directory] [--out directory] [--textures directory]
+                      [--force] [--threads count]
+
+  The world defaults to config.toml [server] world_directory.
+*/
+
+namespace {
+
+  struct Options {
+    std::string world;
+    std::string out = "map";
+    std::string textures = "textures";
+    bool force = false;
+    int threads = 0;  ///< 0: one per core.
+  };
+
+  bool ParseOptions(int argc, char** argv, Options& options)
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      const bool has_value = i + 1 < argc;
+      if (std::strcmp(argv[i], "--world") == 0 && has_value)
+        options.world = argv[++i];
+      else if (std::strcmp(argv[i], "--out") == 0 && has_value)
+        options.out = argv[++i];
+      else if (std::strcmp(argv[i], "--textures") == 0 && has_value)
+        options.textures = argv[++i];
+      else if (std::strcmp(argv[i], "--force") == 0)
+        options.force = true;
+      else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+        options.threads = std::atoi(argv[++i]);
+      else
+        return false;
+    }
+    return true;
+  }
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  try {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+      std::cerr << "usage: hehcraft_map [--world directory] [--out directory] [--textures directory] "
+                   "[--force] [--threads count]"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    heh::config::InitConfigFile("config.toml", "blocks.toml", "textures.toml");
+    heh::block_map::LoadBlocks();
+    if (options.world.empty())
+      options.world = heh::config::file.server.world_directory;
+    if (!std::filesystem::is_directory(options.world)) {
+      std::cerr << "Error: no world in " << options.world << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    heh::world::ChunkStorage storage(options.world);
+    heh::JobSystem jobs(options.threads > 0 ? options.threads - 1 : -1);
+    heh::world::MapRenderer renderer(storage, jobs);
+    renderer.LoadColours(options.textures);
+
+    const heh::world::MapStats stats = renderer.Render(options.out, options.force);
+    const double blocks = static_cast<double>(stats.chunks) * heh::kChunkWidth * heh::kChunkDepth;
+    std::printf("map of %s into %s: %zu regions, %zu tiles rendered, %zu up to date, %u threads\n",
+      options.world.c_str(), options.out.c_str(), stats.regions, stats.rendered, stats.regions - stats.rendered,
+      jobs.GetThreadCount());
+    std::printf("  %zu chunks  %.2f s  %.1f M columns/s\n", stats.chunks, stats.seconds,
+      stats.seconds > 0.0 ? blocks / stats.seconds / 1e6 : 0.0);
+    return EXIT_SUCCESS;
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,257 @@
+#include "world/block.hpp"
+#include "world/chunk_storage.hpp"
+#include "world/terrain_generator.hpp"
+#include "utils/job_system.hpp"
+#include "utils/toml_extended.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+  Generates the chunks within a radius ahead of time and saves them to chunk storage,
+  without a window or GL context. Chunks already in the storage are skipped, so an
+  interrupted run continues where it stopped.
+
+  usage: hehcraft_pregen <radius> [--center x z] [--out directory] [--memory megabytes] [--threads count]
+*/
+
+namespace {
+
+  using Clock = std::chrono::steady_clock;
+
+  double SecondsSince(Clock::time_point start)
+  {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  struct Options {
+    int radius = 0;
+    int center_x = 0;
+    int center_z = 0;
+    std::string out = "world";
+    int memory_mb = 1024;
+    int threads = 0;  ///< 0: one per core.
+  };
+
+  bool ParseOptions(int argc, char** argv, Options& options)
+  {
+    if (argc < 2)
+      return false;
+    options.radius = std::atoi(argv[1]);
+    for (int i = 2; i < argc; ++i)
+    {
+      const bool has_value = i + 1 < argc;
+      if (std::strcmp(argv[i], "--center") == 0 && i + 2 < argc)
+      {
+        options.center_x = std::atoi(argv[++i]);
+        options.center_z = std::atoi(argv[++i]);
+      }
+      else if (std::strcmp(argv[i], "--out") == 0 && has_value)
+        options.out = argv[++i];
+      else if (std::strcmp(argv[i], "--memory") == 0 && has_value)
+        options.memory_mb = std::atoi(argv[++i]);
+      else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+        options.threads = std::atoi(argv[++i]);
+      else
+        return false;
+    }
+    return options.radius >= 0 && options.memory_mb > 0;
+  }
+
+  /**
+   * @brief Side, in chunks, of the square tiles generated at once. A tile holds its
+   * chunks and a one-chunk border of terrain for their features, and its blocks must fit
+   * in the memory cap.
+   */
+  int TileSide(int memory_mb)
+  {
+    const double chunk_bytes = static_cast<double>(heh::kChunkVolume * sizeof(heh::BlockId));
+    const double resident = static_cast<double>(memory_mb) * 1024.0 * 1024.0 / chunk_bytes;
+    return std::clamp(static_cast<int>(std::sqrt(resident)) - 2, 1, 32);
+  }
+
+  struct Tile {
+    int32_t x;  ///< Chunk coordinates of the min corner.
+    int32_t z;
+    int64_t distance;  ///< Squared, from the center to the tile center, in chunks.
+  };
+
+  int Run(const Options& options)
+  {
+    using heh::world::PackChunkKey;
+
+    const heh::world::TerrainGenerator generator(static_cast<uint32_t>(heh::config::file.world.seed));
+    heh::world::ChunkStorage storage(options.out);
+    heh::JobSystem jobs(options.threads > 0 ? options.threads - 1 : -1);
+
+    const int32_t radius = options.radius;
+    const int32_t tile_side = TileSide(options.memory_mb);
+    auto in_radius = [&](int32_t x, int32_t z) {
+      const int64_t dx = x - options.center_x;
+      const int64_t dz = z - options.center_z;
+      return dx * dx + dz * dz <= static_cast<int64_t>(radius) * radius;
+    };
+
+    // Tiles nearest the center first, so the area around spawn is usable early.
+    std::vector<Tile> tiles;
+    size_t total = 0;
+    for (int32_t tz = -radius; tz <= radius; tz += tile_side)
+    {
+      for (int32_t tx = -radius; tx <= radius; tx += tile_side)
+      {
+        const int64_t cx = tx + tile_side / 2;
+        const int64_t cz = tz + tile_side / 2;
+        tiles.push_back({ options.center_x + tx, options.center_z + tz, cx * cx + cz * cz });
+      }
+    }
+    std::sort(tiles.begin(), tiles.end(), [](const Tile& a, const Tile& b) { return a.distance < b.distance; });
+    for (int32_t z = -radius; z <= radius; ++z)
+      for (int32_t x = -radius; x <= radius; ++x)
+        total += in_radius(options.center_x + x, options.center_z + z) ? 1 : 0;
+
+    std::printf("pregen radius %d around (%d, %d) into %s: %zu chunks, %d x %d tiles, %u threads, seed %d\n",
+      radius, options.center_x, options.center_z, options.out.c_str(), total, tile_side, tile_side,
+      jobs.GetThreadCount(), heh::config::file.world.seed);
+
+    const Clock::time_point start = Clock::now();
+    Clock::time_point last_report = start;
+    size_t done = 0;
+    size_t skipped = 0;
+    size_t generated = 0;
+    double terrain_seconds = 0.0;
+    double features_seconds = 0.0;
+
+    std::vector<std::unique_ptr<heh::Chunk>> chunks;
+    std::unordered_map<heh::world::ChunkKey, heh::Chunk*> by_key;
+    for (const Tile& tile : tiles)
+    {
+      // Chunks of the tile still missing from the storage, and the terrain they read.
+      std::vector<heh::Chunk*> targets;
+      chunks.clear();
+      by_key.clear();
+      auto add = [&](int32_t x, int32_t z) {
+        heh::Chunk*& chunk = by_key[PackChunkKey(x, z)];
+        if (!chunk)
+        {
+          chunks.push_back(std::make_unique<heh::Chunk>());
+          chunk = chunks.back().get();
+          chunk->x = x;
+          chunk->z = z;
+        }
+        return chunk;
+      };
+      for (int32_t z = tile.z; z < tile.z + tile_side; ++z)
+      {
+        for (int32_t x = tile.x; x < tile.x + tile_side; ++x)
+        {
+          if (!in_radius(x, z))
+            continue;
+          ++done;
+          if (storage.Contains(x, z))
+          {
+            ++skipped;
+            continue;
+          }
+          targets.push_back(add(x, z));
+          for (int dz = -1; dz <= 1; ++dz)
+            for (int dx = -1; dx <= 1; ++dx)
+              add(x + dx, z + dz);
+        }
+      }
+      if (targets.empty())
+        continue;
+
+      Clock::time_point stage_start = Clock::now();
+      jobs.ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+          generator.Generate(*chunks[i]);
+          chunks[i]->status = heh::ChunkStatus::kTerrain;
+        }
+      });
+      terrain_seconds += SecondsSince(stage_start);
+
+      // Features are exclusive within one chunk (see kStageSpecs): four passes over
+      // (x mod 2, z mod 2) keep chunks that run together two apart.
+      stage_start = Clock::now();
+      for (int colour = 0; colour < 4; ++colour)
+      {
+        std::vector<heh::Chunk*> pass;
+        for (heh::Chunk* chunk : targets)
+        {
+          if ((chunk->x & 1) + 2 * (chunk->z & 1) == colour)
+            pass.push_back(chunk);
+        }
+        jobs.ParallelFor(pass.size(), 1, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i)
+          {
+            heh::Chunk& chunk = *pass[i];
+            heh::ChunkNeighbourhood area;
+            for (int dz = -1; dz <= 1; ++dz)
+              for (int dx = -1; dx <= 1; ++dx)
+                area.chunks[static_cast<size_t>((dz + 1) * 3 + (dx + 1))] = by_key.at(PackChunkKey(chunk.x + dx, chunk.z + dz));
+            generator.PlaceFeatures(chunk, area);
+          }
+        });
+      }
+      jobs.ParallelFor(targets.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+          targets[i]->status = heh::ChunkStatus::kFeatures;
+          storage.Save(*targets[i]);
+        }
+      });
+      features_seconds += SecondsSince(stage_start);
+      generated += targets.size();
+
+      if (SecondsSince(last_report) >= 1.0)
+      {
+        last_report = Clock::now();
+        const double seconds = SecondsSince(start);
+        const double rate = static_cast<double>(generated) / seconds;
+        const size_t left = total - done;
+        std::printf("  %zu / %zu chunks (%5.1f%%)  %8.1f chunks/s  eta %6.0f s\n",
+          done, total, 100.0 * static_cast<double>(done) / static_cast<double>(std::max<size_t>(total, 1)), rate,
+          rate > 0.0 ? static_cast<double>(left) / rate : 0.0);
+        std::fflush(stdout);
+      }
+    }
+
+    const double seconds = SecondsSince(start);
+    std::printf("done: %zu generated, %zu already stored, %.2f s, %.1f chunks/s\n",
+      generated, skipped, seconds, seconds > 0.0 ? static_cast<double>(generated) / seconds : 0.0);
+    std::printf("  terrain %.2f s (border chunks included)  features + save %.2f s  %.1f MiB written\n",
+      terrain_seconds, features_seconds, static_cast<double>(storage.GetBytesWritten()) / (1024.0 * 1024.0));
+    return EXIT_SUCCESS;
+  }
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  try {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+      std::cerr << "usage: hehcraft_pregen <radius> [--center x z] [--out directory] [--memory megabytes] [--threads count]"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    heh::config::InitConfigFile("config.toml", "blocks.toml", "textures.toml");
+    heh::block_map::LoadBlocks();
+    return Run(options);
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
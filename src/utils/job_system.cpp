@@ -0,0 +1,305 @@
+#include "utils/job_system.hpp"
+
+// std
+#include <algorithm>
+
+namespace heh {
+
+  namespace {
+
+    // Deque of the worker thread running this code, if it is a worker.
+    thread_local const JobSystem* tls_system = nullptr;
+    thread_local int tls_index = -1;
+
+    constexpr int64_t kInitialRingCapacity = 1024;
+    constexpr int kSpinsBeforeSleep = 64;
+
+  }  // namespace
+
+  namespace job_detail {
+
+    WorkStealingDeque::WorkStealingDeque()
+    {
+      rings_.push_back(std::make_unique<Ring>(kInitialRingCapacity));
+      ring_.store(rings_.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque::~WorkStealingDeque() = default;
+
+    void WorkStealingDeque::Push(Job* job)
+    {
+      const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+      const int64_t top = top_.load(std::memory_order_acquire);
+      Ring* ring = ring_.load(std::memory_order_relaxed);
+
+      if (bottom - top > ring->mask)
+      {
+        auto bigger = std::make_unique<Ring>((ring->mask + 1) * 2);
+        for (int64_t i = top; i < bottom; ++i)
+          bigger->Put(i, ring->Get(i));
+        ring = bigger.get();
+        rings_.push_back(std::move(bigger));
+        ring_.store(ring, std::memory_order_release);
+      }
+
+      ring->Put(bottom, job);
+      bottom_.store(bottom + 1, std::memory_order_release);
+    }
+
+    Job* WorkStealingDeque::Pop()
+    {
+      const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+      Ring* ring = ring_.load(std::memory_order_relaxed);
+      // Claim the slot before looking at top; the seq_cst pair orders it against Steal.
+      bottom_.store(bottom, std::memory_order_seq_cst);
+      int64_t top = top_.load(std::memory_order_seq_cst);
+
+      if (top > bottom)
+      {
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+      }
+
+      Job* job = ring->Get(bottom);
+      if (top == bottom)
+      {
+        // Last job: race the thieves for it.
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+          job = nullptr;
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+      }
+      return job;
+    }
+
+    Job* WorkStealingDeque::Steal()
+    {
+      int64_t top = top_.load(std::memory_order_seq_cst);
+      const int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+      if (top >= bottom)
+        return nullptr;
+
+      Job* job = ring_.load(std::memory_order_acquire)->Get(top);
+      if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+      return job;
+    }
+
+    size_t WorkStealingDeque::SizeApprox() const
+    {
+      const int64_t size = bottom_.load(std::memory_order_relaxed) - top_.load(std::memory_order_relaxed);
+      return size > 0 ? static_cast<size_t>(size) : 0;
+    }
+
+  }  // namespace job_detail
+
+  using job_detail::Job;
+
+  JobSystem::JobSystem(int worker_count)
+    : owner_thread_(std::this_thread::get_id())
+  {
+    if (worker_count < 0)
+    {
+      const unsigned cores = std::thread::hardware_concurrency();
+      worker_count = cores > 1 ? static_cast<int>(cores) - 1 : 1;
+    }
+
+    // All deques exist before any worker starts stealing from them.
+    for (int i = 0; i <= worker_count; ++i)
+      deques_.push_back(std::make_unique<job_detail::WorkStealingDeque>());
+    for (int i = 0; i < worker_count; ++i)
+      workers_.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+  }
+
+  JobSystem::~JobSystem()
+  {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stopping_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (std::thread& worker : workers_)
+      worker.join();
+
+    for (auto& deque : deques_)
+    {
+      while (Job* job = deque->Steal())
+        delete job;
+    }
+    for (Job* job : injected_)
+      delete job;
+  }
+
+  int JobSystem::ThreadIndex() const
+  {
+    if (tls_system == this)
+      return tls_index;
+    return std::this_thread::get_id() == owner_thread_ ? 0 : -1;
+  }
+
+  void JobSystem::Submit(std::function<void()> function, JobCounter* signal, JobCounter* wait_for)
+  {
+    if (signal)
+      signal->value_.fetch_add(1, std::memory_order_relaxed);
+
+    Job* job = new Job{ std::move(function), signal };
+
+    if (wait_for)
+    {
+      // Finish() takes the same lock after the counter reaches zero, so the job is either
+      // seen there or enqueued here, never lost.
+      std::lock_guard<std::mutex> lock(wait_for->mutex_);
+      if (wait_for->value_.load(std::memory_order_acquire) > 0)
+      {
+        wait_for->continuations_.push_back(job);
+        return;
+      }
+    }
+    Enqueue(job);
+  }
+
+  void JobSystem::Enqueue(Job* job)
+  {
+    const int index = ThreadIndex();
+    if (index >= 0)
+      deques_[static_cast<size_t>(index)]->Push(job);
+    else
+    {
+      std::lock_guard<std::mutex> lock(injected_mutex_);
+      injected_.push_back(job);
+    }
+
+    // Either this sees the sleeper, or the sleeper's predicate sees the job (both seq_cst).
+    pending_.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_seq_cst) > 0)
+    {
+      {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+      }
+      sleep_cv_.notify_one();
+    }
+  }
+
+  void JobSystem::Run(Job* job)
+  {
+    job->function();
+    JobCounter* signal = job->signal;
+    delete job;
+    if (signal)
+      Finish(signal);
+  }
+
+  void JobSystem::Finish(JobCounter* counter)
+  {
+    // The decrement happens under the lock that Submit checks wait_for under, and Wait
+    // takes the lock before returning, so the counter is not destroyed while held here.
+    std::vector<Job*> ready;
+    {
+      std::lock_guard<std::mutex> lock(counter->mutex_);
+      if (counter->value_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        ready.swap(counter->continuations_);
+    }
+    for (Job* job : ready)
+      Enqueue(job);
+  }
+
+  Job* JobSystem::FindJob(int index)
+  {
+    Job* job = nullptr;
+    if (index >= 0)
+      job = deques_[static_cast<size_t>(index)]->Pop();
+
+    if (!job)
+    {
+      // Steal, starting after our own deque so thieves spread over the victims.
+      const size_t count = deques_.size();
+      const size_t start = index >= 0 ? static_cast<size_t>(index) + 1 : 0;
+      for (size_t i = 0; i < count && !job; ++i)
+      {
+        const size_t victim = (start + i) % count;
+        if (static_cast<int>(victim) == index)
+          continue;
+        job = deques_[victim]->Steal();
+        if (job)
+          steals_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    if (!job)
+    {
+      std::lock_guard<std::mutex> lock(injected_mutex_);
+      if (!injected_.empty())
+      {
+        job = injected_.front();
+        injected_.pop_front();
+      }
+    }
+
+    if (job)
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+  }
+
+  bool JobSystem::TryRunOne()
+  {
+    Job* job = FindJob(ThreadIndex());
+    if (!job)
+      return false;
+    Run(job);
+    return true;
+  }
+
+  void JobSystem::Wait(const JobCounter& counter)
+  {
+    while (!counter.IsDone())
+    {
+      if (!TryRunOne())
+        std::this_thread::yield();
+    }
+    // The last Finish may still hold the lock; let it release before the caller frees the counter.
+    std::lock_guard<std::mutex> lock(counter.mutex_);
+  }
+
+  void JobSystem::ParallelFor(size_t count, size_t batch_size, const std::function<void(size_t begin, size_t end)>& body)
+  {
+    batch_size = std::max<size_t>(batch_size, 1);
+    JobCounter counter;
+    for (size_t begin = 0; begin < count; begin += batch_size)
+    {
+      const size_t end = std::min(begin + batch_size, count);
+      Submit([&body, begin, end]() { body(begin, end); }, &counter);
+    }
+    Wait(counter);
+  }
+
+  void JobSystem::WorkerLoop(int index)
+  {
+    tls_system = this;
+    tls_index = index;
+
+    int idle_spins = 0;
+    for (;;)
+    {
+      if (Job* job = FindJob(index))
+      {
+        Run(job);
+        idle_spins = 0;
+        continue;
+      }
+
+      if (++idle_spins < kSpinsBeforeSleep)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      idle_spins = 0;
+
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      sleepers_.fetch_add(1, std::memory_order_seq_cst);
+      sleep_cv_.wait(lock, [this]() { return stopping_ || pending_.load(std::memory_order_seq_cst) > 0; });
+      sleepers_.fetch_sub(1, std::memory_order_relaxed);
+      if (stopping_)
+        return;
+    }
+  }
+
+}  // namespace heh
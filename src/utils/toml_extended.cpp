@@ -52,6 +52,31 @@ namespace heh {
         file.window.height = toml::find<int>(window, "height");
         file.window.window_name = toml::find<std::string>(window, "window_name");
         file.window.fullscreen = toml::find<bool>(window, "fullscreen");
+        file.window.upload_budget = toml::find_or<int>(window, "upload_budget", file.window.upload_budget);
+        file.window.mesh_memory = toml::find_or<int>(window, "mesh_memory", file.window.mesh_memory);
+        file.window.keep_evicted_meshes = toml::find_or<bool>(window, "keep_evicted_meshes", file.window.keep_evicted_meshes);
+
+        // Load world config (optional, older config files have no [world] table)
+        if (main_data.contains("world")) {
+          const auto world = toml::find(main_data, "world");
+          file.world.seed = toml::find_or<int>(world, "seed", file.world.seed);
+          file.world.render_distance = toml::find_or<int>(world, "render_distance", file.world.render_distance);
+          file.world.unload_margin = toml::find_or<int>(world, "unload_margin", file.world.unload_margin);
+          file.world.lod_distance = toml::find_or<int>(world, "lod_distance", file.world.lod_distance);
+          file.world.prefetch_lookahead = toml::find_or<float>(world, "prefetch_lookahead", file.world.prefetch_lookahead);
+          file.world.prefetch_queue = toml::find_or<int>(world, "prefetch_queue", file.world.prefetch_queue);
+          file.world.random_tick_speed = toml::find_or<int>(world, "random_tick_speed", file.world.random_tick_speed);
+        }
+
+        // Load server config (optional)
+        if (main_data.contains("server")) {
+          const auto server = toml::find(main_data, "server");
+          file.server.tick_rate = toml::find_or<int>(server, "tick_rate", file.server.tick_rate);
+          file.server.save_interval = toml::find_or<float>(server, "save_interval", file.server.save_interval);
+          file.server.world_directory = toml::find_or<std::string>(server, "world_directory", file.server.world_directory);
+          file.server.address = toml::find_or<std::string>(server, "address", file.server.address);
+          file.server.client_bandwidth = toml::find_or<int>(server, "client_bandwidth", file.server.client_bandwidth);
+        }
       }
       catch (const std::exception& e) {
         throw std::runtime_error(std::string("Error parsing main TOML file: ") + e.what());
@@ -75,6 +100,9 @@ namespace heh {
           block_config.side = toml::find<std::string>(block, "side");
           block_config.top = toml::find<std::string>(block, "top");
           block_config.bottom = toml::find<std::string>(block, "bottom");
+          block_config.opaque = toml::find_or<bool>(block, "opaque", block_config.opaque);
+          block_config.solid = toml::find_or<bool>(block, "solid", block_config.solid);
+          block_config.emission = toml::find_or<uint32_t>(block, "emission", block_config.emission);
 
           file.blocks[toml::find<std::string>(block, "name")] = block_config;
         }
@@ -131,6 +159,27 @@ namespace heh {
       out << "height = " << file.window.height << "\n";
       out << "window_name = \"" << file.window.window_name << "\"\n";
       out << "fullscreen = " << (file.window.fullscreen ? "true" : "false") << "\n";
+      out << "upload_budget = " << file.window.upload_budget << "\n";
+      out << "mesh_memory = " << file.window.mesh_memory << "\n";
+      out << "keep_evicted_meshes = " << (file.window.keep_evicted_meshes ? "true" : "false") << "\n";
+      out << "\n";
+      out << "# World configuration\n";
+      out << "[world]\n";
+      out << "seed = " << file.world.seed << "\n";
+      out << "render_distance = " << file.world.render_distance << "\n";
+      out << "unload_margin = " << file.world.unload_margin << "\n";
+      out << "lod_distance = " << file.world.lod_distance << "\n";
+      out << std::fixed << std::setprecision(6) << "prefetch_lookahead = " << file.world.prefetch_lookahead << "\n";
+      out << "prefetch_queue = " << file.world.prefetch_queue << "\n";
+      out << "random_tick_speed = " << file.world.random_tick_speed << "\n";
+      out << "\n";
+      out << "# Server configuration\n";
+      out << "[server]\n";
+      out << "tick_rate = " << file.server.tick_rate << "\n";
+      out << std::fixed << std::setprecision(6) << "save_interval = " << file.server.save_interval << "\n";
+      out << "world_directory = \"" << file.server.world_directory << "\"\n";
+      out << "address = \"" << file.server.address << "\"\n";
+      out << "client_bandwidth = " << file.server.client_bandwidth << "\n";
     }
 
     void CreateDefaultMainConfig() {
@@ -150,6 +199,27 @@ width = 800
 height = 600
 window_name = "Hehcraft"
 fullscreen = false
+upload_budget = 4096
+mesh_memory = 1024
+keep_evicted_meshes = true
+
+# World configuration
+[world]
+seed = 1337
+render_distance = 8
+unload_margin = 2
+lod_distance = 8
+prefetch_lookahead = 2.0
+prefetch_queue = 64
+random_tick_speed = 3
+
+# Server configuration
+[server]
+tick_rate = 20
+save_interval = 30.0
+world_directory = "world"
+address = ":25565"
+client_bandwidth = 4096
 )";
     }
 
@@ -166,6 +236,81 @@ name = "grass"
 side = "grass"
 top = "grass_top"
 bottom = "grass_bottom"
+
+[[blocks]]
+id = 2
+name = "stone"
+side = "stone"
+top = "stone"
+bottom = "stone"
+
+[[blocks]]
+id = 3
+name = "cobblestone"
+side = "cobblestone"
+top = "cobblestone"
+bottom = "cobblestone"
+
+[[blocks]]
+id = 4
+name = "stone_bricks"
+side = "stone_bricks"
+top = "stone_bricks"
+bottom = "stone_bricks"
+
+[[blocks]]
+id = 5
+name = "wood_log"
+side = "wood_log"
+top = "wood_log_top"
+bottom = "wood_log_top"
+
+[[blocks]]
+id = 6
+name = "wood_planks"
+side = "wood_planks"
+top = "wood_planks"
+bottom = "wood_planks"
+
+[[blocks]]
+id = 7
+name = "leaves"
+side = "leaves"
+top = "leaves"
+bottom = "leaves"
+
+[[blocks]]
+id = 8
+name = "glass"
+side = "glass"
+top = "glass"
+bottom = "glass"
+opaque = false
+
+[[blocks]]
+id = 9
+name = "flower_red"
+side = "flower_red"
+top = "flower_red"
+bottom = "flower_red"
+opaque = false
+solid = false
+
+[[blocks]]
+id = 10
+name = "flower_yellow"
+side = "flower_yellow"
+top = "flower_yellow"
+bottom = "flower_yellow"
+opaque = false
+solid = false
+
+[[blocks]]
+id = 11
+name = "dirt"
+side = "grass_bottom"
+top = "grass_bottom"
+bottom = "grass_bottom"
 )";
     }
 
@@ -195,6 +340,9 @@ uvs = [[0.0, 0.0], [1.0, 0.0], [1.0, 1.0], [0.0, 1.0]]
         out << "side = \"" << block.side << "\"\n";
         out << "top = \"" << block.top << "\"\n";
         out << "bottom = \"" << block.bottom << "\"\n";
+        out << "opaque = " << (block.opaque ? "true" : "false") << "\n";
+        out << "solid = " << (block.solid ? "true" : "false") << "\n";
+        out << "emission = " << block.emission << "\n";
         out << "\n";
       }
     }
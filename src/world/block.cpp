@@ -4,40 +4,86 @@
 #include <unordered_map>
 #include <string>
 #include <vector>
+#include <algorithm>
 
 namespace heh {
   namespace block_map {
     std::unordered_map<int, std::string> id_to_name;
     std::vector<BlockFormat> block_formats;
     std::unordered_map<std::string, TextureFormat> texture_formats;
+    std::vector<BlockFaceUvs> face_uvs;
+    std::vector<BlockProperties> properties;
+
+    static void CopyUvs(const std::string& texture_name, glm::vec2 (&out)[4])
+    {
+      const auto it = texture_formats.find(texture_name);
+      for (size_t i = 0; i < 4; ++i)
+        out[i] = it != texture_formats.end() ? it->second.uvs[i] : glm::vec2(0.0f);
+    }
 
     void LoadBlocks()
     {
+      id_to_name.clear();
+      block_formats.clear();
+      texture_formats.clear();
+      face_uvs.clear();
+      properties.clear();
+
+      int max_id = 0;
+      for (const auto& block_config : config::file.blocks)
+        max_id = std::max(max_id, static_cast<int>(block_config.second.id));
+
+      // block_formats is indexed by id - 1, so it must follow ids rather than map order.
+      block_formats.resize(max_id);
+      // Unused ids behave like any unknown block; id 0 is air.
+      properties.assign(max_id + 1, BlockProperties{ true, true, 0 });
+      properties[0] = BlockProperties{};
       for (const auto& block_config : config::file.blocks)
       {
         // block_config.first = name of the block
         BlockFormat block;
-        int id = config::file.blocks[block_config.first].id;
-        block.side = config::file.blocks[block_config.first].side;
-        block.top = config::file.blocks[block_config.first].top;
-        block.bottom = config::file.blocks[block_config.first].bottom;
+        int id = block_config.second.id;
+        block.side = block_config.second.side;
+        block.top = block_config.second.top;
+        block.bottom = block_config.second.bottom;
 
         id_to_name[id] = block_config.first;
-        block_formats.push_back(block);
+        if (id > 0)
+        {
+          block_formats[id - 1] = block;
+          properties[id].opaque = block_config.second.opaque;
+          properties[id].solid = block_config.second.solid;
+          properties[id].emission = static_cast<uint8_t>(std::min<uint32_t>(block_config.second.emission, 15));
+        }
       }
 
       for (const auto& texture_config : config::file.textures)
       {
         // texture_config.first = name of the texture
         TextureFormat texture;
-        texture.name = config::file.textures[texture_config.first].name;
+        texture.name = texture_config.second.name;
         for (size_t i = 0; i < 4; ++i)
         {
-          texture.uvs[i] = config::file.textures[texture_config.first].uvs[i];
+          texture.uvs[i] = texture_config.second.uvs[i];
         }
         texture_formats[texture.name] = texture;
       }
+
+      face_uvs.resize(max_id + 1);
+      for (int id = 1; id <= max_id; ++id)
+      {
+        const BlockFormat& block = block_formats[id - 1];
+        CopyUvs(block.top, face_uvs[id].top);
+        CopyUvs(block.side, face_uvs[id].side);
+        CopyUvs(block.bottom, face_uvs[id].bottom);
+      }
+    }
+
+    int FindBlockId(const std::string& name, int fallback)
+    {
+      const auto it = config::file.blocks.find(name);
+      return it != config::file.blocks.end() ? static_cast<int>(it->second.id) : fallback;
     }
   } // namespace block_map
 
-} // namespace heh
\ No newline at end of file
+} // namespace heh
@@ -0,0 +1,205 @@
+#include "world/block_edit.hpp"
+
+#include "utils/job_system.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+
+namespace heh {
+
+  namespace world {
+
+    namespace {
+
+      struct ChunkCounts {
+        size_t blocks = 0;
+        size_t changed = 0;
+        size_t full_sections = 0;
+        size_t partial_sections = 0;
+      };
+
+      BlockBox ClipToWorld(BlockBox box)
+      {
+        box.min.y = std::max(box.min.y, 0);
+        box.max.y = std::min(box.max.y, static_cast<int32_t>(kChunkHeight) - 1);
+        return box;
+      }
+
+      /**
+       * @brief Calls op(run, count, start) over the runs of blocks_data inside box, where
+       * start is the world position of run[0]. Without merge every run is (part of) a
+       * single column; with it, columns that are contiguous in the section are merged,
+       * up to the whole section.
+       */
+      template <typename Op>
+      void ForEachRun(Chunk& chunk, const BlockBox& box, bool merge, ChunkCounts& counts, Op& op)
+      {
+        const int32_t origin_x = chunk.x * static_cast<int32_t>(kChunkWidth);
+        const int32_t origin_z = chunk.z * static_cast<int32_t>(kChunkDepth);
+        const uint32_t x0 = static_cast<uint32_t>(std::max(box.min.x - origin_x, 0));
+        const uint32_t x1 = static_cast<uint32_t>(std::min(box.max.x - origin_x, static_cast<int32_t>(kChunkWidth) - 1));
+        const uint32_t z0 = static_cast<uint32_t>(std::max(box.min.z - origin_z, 0));
+        const uint32_t z1 = static_cast<uint32_t>(std::min(box.max.z - origin_z, static_cast<int32_t>(kChunkDepth) - 1));
+        const bool full_x = x0 == 0 && x1 == kChunkWidth - 1;
+        const bool full_z = z0 == 0 && z1 == kChunkDepth - 1;
+
+        BlockId* blocks = chunk.blocks_data.data();
+        const uint32_t first_section = static_cast<uint32_t>(box.min.y) / kSectionHeight;
+        const uint32_t last_section = static_cast<uint32_t>(box.max.y) / kSectionHeight;
+        for (uint32_t section = first_section; section <= last_section; ++section)
+        {
+          const int32_t base_y = static_cast<int32_t>(section * kSectionHeight);
+          const uint32_t y0 = static_cast<uint32_t>(std::max(box.min.y - base_y, 0));
+          const uint32_t y1 = static_cast<uint32_t>(std::min(box.max.y - base_y, static_cast<int32_t>(kSectionHeight) - 1));
+          const bool full_y = y0 == 0 && y1 == kSectionHeight - 1;
+          BlockId* run = blocks + section * kSectionVolume;
+
+          counts.blocks += static_cast<size_t>(x1 - x0 + 1) * (z1 - z0 + 1) * (y1 - y0 + 1);
+          if (full_x && full_y && full_z)
+          {
+            ++counts.full_sections;
+            if (merge)
+            {
+              counts.changed += op(run, kSectionVolume, glm::ivec3(origin_x, base_y, origin_z));
+              continue;
+            }
+          }
+          else
+            ++counts.partial_sections;
+
+          for (uint32_t x = x0; x <= x1; ++x)
+          {
+            const int32_t world_x = origin_x + static_cast<int32_t>(x);
+            if (merge && full_y)
+            {
+              counts.changed += op(run + Chunk::Index(x, 0, z0), (z1 - z0 + 1) * kSectionHeight,
+                                   glm::ivec3(world_x, base_y, origin_z + static_cast<int32_t>(z0)));
+              continue;
+            }
+            for (uint32_t z = z0; z <= z1; ++z)
+            {
+              counts.changed += op(run + Chunk::Index(x, y0, z), y1 - y0 + 1,
+                                   glm::ivec3(world_x, base_y + static_cast<int32_t>(y0), origin_z + static_cast<int32_t>(z)));
+            }
+          }
+        }
+      }
+
+      /**
+       * @brief Runs ForEachRun over every loaded chunk the box overlaps, a job per chunk.
+       */
+      template <typename Op>
+      EditStats EditChunks(const World& world, const BlockBox& unclipped, bool merge, JobSystem* jobs, Op op)
+      {
+        EditStats stats;
+        const BlockBox box = ClipToWorld(unclipped);
+        if (box.IsEmpty())
+          return stats;
+
+        std::vector<Chunk*> chunks;
+        for (int32_t x = BlockToChunk(box.min.x); x <= BlockToChunk(box.max.x); ++x)
+        {
+          for (int32_t z = BlockToChunk(box.min.z); z <= BlockToChunk(box.max.z); ++z)
+          {
+            if (Chunk* chunk = world.GetChunk(x, z))
+            {
+              chunks.push_back(chunk);
+              stats.chunks.push_back(PackChunkKey(x, z));
+            }
+          }
+        }
+
+        std::vector<ChunkCounts> counts(chunks.size());
+        auto edit_range = [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i)
+            ForEachRun(*chunks[i], box, merge, counts[i], op);
+        };
+        if (!jobs || chunks.size() <= 1)
+          edit_range(0, chunks.size());
+        else
+          jobs->ParallelFor(chunks.size(), 1, edit_range);
+
+        for (const ChunkCounts& chunk : counts)
+        {
+          stats.blocks += chunk.blocks;
+          stats.changed += chunk.changed;
+          stats.full_sections += chunk.full_sections;
+          stats.partial_sections += chunk.partial_sections;
+        }
+        std::sort(stats.chunks.begin(), stats.chunks.end());
+        return stats;
+      }
+
+    }  // namespace
+
+    EditStats FillBox(World& world, const BlockBox& box, BlockId id, JobSystem* jobs)
+    {
+      return EditChunks(world, box, true, jobs, [id](BlockId* run, uint32_t count, const glm::ivec3&) {
+        size_t changed = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+          changed += run[i] != id;
+          run[i] = id;
+        }
+        return changed;
+      });
+    }
+
+    EditStats ReplaceInBox(World& world, const BlockBox& box, BlockId from, BlockId to, JobSystem* jobs)
+    {
+      if (from == to)
+        return EditChunks(world, box, true, jobs, [](BlockId*, uint32_t, const glm::ivec3&) { return size_t{ 0 }; });
+      return EditChunks(world, box, true, jobs, [from, to](BlockId* run, uint32_t count, const glm::ivec3&) {
+        size_t changed = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+          const bool hit = run[i] == from;
+          changed += hit;
+          run[i] = hit ? to : run[i];
+        }
+        return changed;
+      });
+    }
+
+    BlockClipboard CopyBox(const World& world, const BlockBox& box, JobSystem* jobs)
+    {
+      BlockClipboard clipboard;
+      if (box.IsEmpty())
+        return clipboard;
+      clipboard.size = box.GetSize();
+      clipboard.blocks.assign(static_cast<size_t>(clipboard.size.x) * clipboard.size.y * clipboard.size.z, kAirBlock);
+
+      EditChunks(world, box, false, jobs, [&clipboard, &box](BlockId* run, uint32_t count, const glm::ivec3& start) {
+        const glm::ivec3 offset = start - box.min;
+        std::memcpy(clipboard.blocks.data() + clipboard.Index(offset.x, offset.y, offset.z), run, count * sizeof(BlockId));
+        return size_t{ 0 };
+      });
+      return clipboard;
+    }
+
+    EditStats PasteBox(World& world, const BlockClipboard& clipboard, const glm::ivec3& origin, bool skip_air,
+                       JobSystem* jobs)
+    {
+      const BlockBox box{ origin, origin + clipboard.size - 1 };
+      if (clipboard.blocks.empty())
+        return {};
+
+      return EditChunks(world, box, false, jobs, [&clipboard, &origin, skip_air](BlockId* run, uint32_t count,
+                                                                                 const glm::ivec3& start) {
+        const glm::ivec3 offset = start - origin;
+        const BlockId* source = clipboard.blocks.data() + clipboard.Index(offset.x, offset.y, offset.z);
+        size_t changed = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+          const BlockId id = skip_air && source[i] == kAirBlock ? run[i] : source[i];
+          changed += id != run[i];
+          run[i] = id;
+        }
+        return changed;
+      });
+    }
+
+  }  // namespace world
+
+}  // namespace heh
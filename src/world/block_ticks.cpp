@@ -0,0 +1,508 @@
+#include "world/block_ticks.hpp"
+
+#include "world/block.hpp"
+#include "world/chunk_streamer.hpp"
+#include "world/light.hpp"
+#include "world/noise.hpp"
+#include "utils/job_system.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+
+namespace heh {
+
+  namespace world {
+
+    namespace {
+
+      // Grass needs this much light above it to spread, and the dirt it spreads to needs
+      // kGrassGrowLight above it.
+      constexpr uint8_t kGrassSpreadLight = 9;
+      constexpr uint8_t kGrassGrowLight = 4;
+
+      const glm::ivec3 kNeighbours[6] = {
+        { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+      };
+
+      uint8_t MaxLight(uint8_t packed) { return std::max<uint8_t>(packed >> 4, packed & 0x0F); }
+
+      /**
+       * @brief Region coordinate of a chunk coordinate, rounding down.
+       */
+      int32_t RegionCoord(int32_t v, int32_t size) { return v >= 0 ? v / size : (v - size + 1) / size; }
+
+      glm::ivec3 IndexToPos(const Chunk& chunk, uint32_t index)
+      {
+        // Inverse of Chunk::Index.
+        return { chunk.x * static_cast<int32_t>(kChunkWidth) + static_cast<int32_t>((index >> 8) & 15u),
+                 static_cast<int32_t>(((index >> 12) << 4) | (index & 15u)),
+                 chunk.z * static_cast<int32_t>(kChunkDepth) + static_cast<int32_t>((index >> 4) & 15u) };
+      }
+
+      uint32_t PosToIndex(const glm::ivec3& pos)
+      {
+        return Chunk::Index(BlockToLocal(pos.x), static_cast<uint32_t>(pos.y), BlockToLocal(pos.z));
+      }
+
+      /**
+       * @brief Covered grass dies back to dirt; lit grass spreads to dirt near it.
+       */
+      void GrassRandomTick(TickContext& context, const glm::ivec3& pos, BlockId)
+      {
+        const BlockId grass_block = context.GetScheduler().GetGrassBlock();
+        const BlockId dirt_block = context.GetScheduler().GetDirtBlock();
+        const glm::ivec3 above = pos + glm::ivec3(0, 1, 0);
+        if (block_map::IsOpaque(context.GetBlock(above)))
+        {
+          if (dirt_block != kAirBlock)
+            context.SetBlock(pos, dirt_block);
+          return;
+        }
+        if (dirt_block == kAirBlock || MaxLight(context.GetLight(above)) < kGrassSpreadLight)
+          return;
+
+        // One try per tick, 1 block sideways, 3 down to 1 up.
+        const uint32_t r = context.Random();
+        const glm::ivec3 target = pos + glm::ivec3(static_cast<int32_t>(r % 3) - 1,
+                                                   static_cast<int32_t>((r / 3) % 5) - 3,
+                                                   static_cast<int32_t>((r / 15) % 3) - 1);
+        if (context.GetBlock(target) != dirt_block)
+          return;
+        const glm::ivec3 target_above = target + glm::ivec3(0, 1, 0);
+        if (!block_map::IsOpaque(context.GetBlock(target_above)) &&
+            MaxLight(context.GetLight(target_above)) >= kGrassGrowLight)
+          context.SetBlock(target, grass_block);
+      }
+
+      /**
+       * @brief Flowers break when the block under them stops holding them.
+       */
+      void FlowerScheduledTick(TickContext& context, const glm::ivec3& pos, BlockId)
+      {
+        if (!block_map::IsSolid(context.GetBlock(pos - glm::ivec3(0, 1, 0))))
+          context.SetBlock(pos, kAirBlock);
+      }
+
+    }  // namespace
+
+    TickContext::TickContext(TickScheduler& scheduler, World& world, const RegionChunk& ticked, const RegionChunk* region,
+                             size_t region_size, uint64_t seed, Output& output)
+      : scheduler_(scheduler),
+        world_(world),
+        blocks_(world),
+        chunk_(*ticked.chunk),
+        tickable_(ticked.tickable),
+        region_(region),
+        region_size_(region_size),
+        tick_(scheduler.tick_),
+        random_state_(seed | 1u),
+        output_(output)
+    {
+    }
+
+    BlockId TickContext::GetBlock(const glm::ivec3& pos)
+    {
+      return blocks_.GetBlock(pos);
+    }
+
+    uint8_t TickContext::GetLight(const glm::ivec3& pos)
+    {
+      if (static_cast<uint32_t>(pos.y) >= kChunkHeight)
+        return kSkyLight;
+      const Chunk* chunk = blocks_.GetChunk(BlockToChunk(pos.x), BlockToChunk(pos.z));
+      return chunk ? chunk->GetLight(BlockToLocal(pos.x), static_cast<uint32_t>(pos.y), BlockToLocal(pos.z)) : kSkyLight;
+    }
+
+    void TickContext::SetBlock(const glm::ivec3& pos, BlockId id)
+    {
+      if (static_cast<uint32_t>(pos.y) >= kChunkHeight)
+        return;
+      Chunk* chunk = &chunk_;
+      uint16_t* tickable = tickable_;
+      const int32_t x = BlockToChunk(pos.x);
+      const int32_t z = BlockToChunk(pos.z);
+      if (x != chunk_.x || z != chunk_.z)
+      {
+        // The region's chunks belong to this job; others wait for the end of the phase.
+        const RegionChunk* end = region_ + region_size_;
+        const RegionChunk* target = std::find_if(region_, end, [x, z](const RegionChunk& other) {
+          return other.chunk->x == x && other.chunk->z == z;
+        });
+        if (target == end)
+        {
+          output_.edits.emplace_back(pos, id);
+          return;
+        }
+        chunk = target->chunk;
+        tickable = target->tickable;
+      }
+
+      const uint32_t index = PosToIndex(pos);
+      const BlockId old_id = chunk->blocks_data[index];
+      if (old_id == id)
+        return;
+      chunk->blocks_data[index] = id;
+      ++output_.edits_applied;
+      if (scheduler_.record_changes_)
+        output_.changes.push_back({ pos, id });
+
+      scheduler_.CountChange(tickable, pos.y, old_id, id);
+      UpdateLight(world_, pos, old_id, output_.remesh);
+      AppendMeshingChunks(pos.x, pos.z, output_.remesh);
+      scheduler_.ScheduleNeighbours(blocks_, pos, output_.schedules);
+    }
+
+    void TickContext::Schedule(const glm::ivec3& pos, uint32_t delay)
+    {
+      output_.schedules.emplace_back(pos, delay);
+    }
+
+    uint32_t TickContext::Random()
+    {
+      // xorshift64*
+      random_state_ ^= random_state_ >> 12;
+      random_state_ ^= random_state_ << 25;
+      random_state_ ^= random_state_ >> 27;
+      return static_cast<uint32_t>((random_state_ * 0x2545F4914F6CDD1Dull) >> 32);
+    }
+
+    TickScheduler::TickScheduler(World& world, ChunkStreamer& streamer, JobSystem& jobs, uint32_t seed,
+                                 int random_ticks_per_section)
+      : world_(world),
+        streamer_(streamer),
+        jobs_(jobs),
+        seed_(seed),
+        random_ticks_per_section_(std::max(random_ticks_per_section, 0))
+    {
+      RegisterDefaultBehaviours();
+    }
+
+    void TickScheduler::RegisterDefaultBehaviours()
+    {
+      // Blocks missing from blocks.toml keep no behaviour.
+      grass_block_ = static_cast<BlockId>(block_map::FindBlockId("grass", kAirBlock));
+      dirt_block_ = static_cast<BlockId>(block_map::FindBlockId("dirt", kAirBlock));
+
+      if (grass_block_ != kAirBlock)
+        Register(grass_block_, { GrassRandomTick, nullptr });
+      for (const char* name : { "flower_red", "flower_yellow" })
+      {
+        const BlockId flower = static_cast<BlockId>(block_map::FindBlockId(name, kAirBlock));
+        if (flower != kAirBlock)
+          Register(flower, { nullptr, FlowerScheduledTick });
+      }
+    }
+
+    void TickScheduler::Register(BlockId id, const BlockBehaviour& behaviour)
+    {
+      if (id < 0)
+        return;
+      if (static_cast<size_t>(id) >= behaviours_.size())
+        behaviours_.resize(static_cast<size_t>(id) + 1);
+      behaviours_[id] = behaviour;
+
+      // The random tick counts depend on the behaviours.
+      for (auto& [key, ticks] : chunks_)
+        ticks.counted = false;
+    }
+
+    void TickScheduler::Schedule(const glm::ivec3& pos, uint32_t delay)
+    {
+      if (static_cast<uint32_t>(pos.y) >= kChunkHeight)
+        return;
+      Chunk* chunk = world_.GetChunk(BlockToChunk(pos.x), BlockToChunk(pos.z));
+      if (!chunk)
+        return;
+      GetTicks(chunk)->queue.push({ tick_ + std::max<uint32_t>(delay, 1), order_++, PosToIndex(pos) });
+      ++stats_.pending_ticks;
+    }
+
+    bool TickScheduler::SetBlock(const glm::ivec3& pos, BlockId id)
+    {
+      const BlockId old_id = world_.GetBlock(pos);
+      if (!streamer_.SetBlock(pos, id))
+        return false;
+      if (old_id == id)
+        return true;
+      if (record_changes_)
+        changes_.push_back({ pos, id });
+
+      ChunkTicks* ticks = GetTicks(world_.GetChunk(BlockToChunk(pos.x), BlockToChunk(pos.z)));
+      if (ticks->counted)
+        CountChange(ticks->tickable.data(), pos.y, old_id, id);
+
+      std::vector<std::pair<glm::ivec3, uint32_t>> schedules;
+      BlockAccessor blocks(world_);
+      ScheduleNeighbours(blocks, pos, schedules);
+      for (const auto& [target, delay] : schedules)
+        Schedule(target, delay);
+      return true;
+    }
+
+    bool TickScheduler::EditBlocks(const BlockBox& box, const std::function<void()>& edit)
+    {
+      if (!streamer_.EditBlocks(box, edit))
+        return false;
+      if (box.IsEmpty())
+        return true;
+      for (int32_t x = BlockToChunk(box.min.x); x <= BlockToChunk(box.max.x); ++x)
+      {
+        for (int32_t z = BlockToChunk(box.min.z); z <= BlockToChunk(box.max.z); ++z)
+        {
+          InvalidateChunk(x, z);
+          if (record_changes_)
+            rewritten_.push_back(PackChunkKey(x, z));
+        }
+      }
+      return true;
+    }
+
+    void TickScheduler::SetRecordChanges(bool record)
+    {
+      record_changes_ = record;
+      if (!record)
+      {
+        changes_.clear();
+        rewritten_.clear();
+      }
+    }
+
+    void TickScheduler::PopChanges(std::vector<BlockChange>& changes, std::vector<ChunkKey>& rewritten)
+    {
+      changes.clear();
+      rewritten.clear();
+      changes.swap(changes_);
+      rewritten.swap(rewritten_);
+    }
+
+    void TickScheduler::InvalidateChunk(int32_t x, int32_t z)
+    {
+      auto it = chunks_.find(PackChunkKey(x, z));
+      if (it != chunks_.end())
+        it->second.counted = false;
+    }
+
+    TickScheduler::ChunkTicks* TickScheduler::GetTicks(Chunk* chunk)
+    {
+      ChunkTicks& ticks = chunks_[PackChunkKey(chunk->x, chunk->z)];
+      if (ticks.chunk != chunk)
+      {
+        stats_.pending_ticks -= ticks.queue.size();
+        ticks = ChunkTicks{};
+        ticks.chunk = chunk;
+      }
+      return &ticks;
+    }
+
+    void TickScheduler::CountTickable(ChunkTicks& ticks, const Chunk& chunk) const
+    {
+      // One table lookup per block; a section is a contiguous run of kSectionVolume ids.
+      std::vector<uint8_t> has_random_tick(behaviours_.size());
+      for (size_t id = 0; id < behaviours_.size(); ++id)
+        has_random_tick[id] = behaviours_[id].random_tick != nullptr;
+
+      const BlockId* blocks = chunk.blocks_data.data();
+      for (uint32_t section = 0; section < kSectionsPerChunk; ++section)
+      {
+        uint32_t count = 0;
+        const BlockId* run = blocks + section * kSectionVolume;
+        for (uint32_t i = 0; i < kSectionVolume; ++i)
+        {
+          const size_t id = static_cast<uint16_t>(run[i]);
+          count += id < has_random_tick.size() ? has_random_tick[id] : 0u;
+        }
+        ticks.tickable[section] = static_cast<uint16_t>(count);
+      }
+      ticks.counted = true;
+    }
+
+    void TickScheduler::CountChange(uint16_t* tickable, int32_t y, BlockId old_id, BlockId new_id) const
+    {
+      const uint32_t section = static_cast<uint32_t>(y) / kSectionHeight;
+      if (GetBehaviour(old_id).random_tick && tickable[section] > 0)
+        --tickable[section];
+      if (GetBehaviour(new_id).random_tick)
+        ++tickable[section];
+    }
+
+    void TickScheduler::ScheduleNeighbours(BlockAccessor& blocks, const glm::ivec3& pos,
+                                           std::vector<std::pair<glm::ivec3, uint32_t>>& out) const
+    {
+      for (const glm::ivec3& offset : kNeighbours)
+      {
+        const glm::ivec3 neighbour = pos + offset;
+        if (GetBehaviour(blocks.GetBlock(neighbour)).scheduled_tick)
+          out.emplace_back(neighbour, 1u);
+      }
+    }
+
+    void TickScheduler::TickRegion(const TickedChunk* ticked, const TickContext::RegionChunk* chunks, size_t count,
+                                   TickContext::Output& output)
+    {
+      // Counted up front: ticks of one chunk may change blocks of the others.
+      for (size_t i = 0; i < count; ++i)
+      {
+        if (!ticked[i].ticks->counted)
+          CountTickable(*ticked[i].ticks, *chunks[i].chunk);
+      }
+      for (size_t i = 0; i < count; ++i)
+        TickChunk(chunks[i], *ticked[i].ticks, chunks, count, output);
+    }
+
+    void TickScheduler::TickChunk(const TickContext::RegionChunk& ticked, ChunkTicks& ticks,
+                                  const TickContext::RegionChunk* region, size_t region_size, TickContext::Output& output)
+    {
+      Chunk& chunk = *ticked.chunk;
+      const uint64_t seed = (static_cast<uint64_t>(noise_detail::Hash(chunk.x, chunk.z, static_cast<int32_t>(tick_),
+                                                                      static_cast<uint32_t>(seed_))) << 32) |
+                            noise_detail::Hash(chunk.z, chunk.x, static_cast<int32_t>(tick_ >> 32),
+                                               static_cast<uint32_t>(seed_) ^ 0x5bd1e995u);
+      TickContext context(*this, world_, ticked, region, region_size, seed, output);
+
+      // Scheduled ticks that are due, each block at most once per tick.
+      thread_local std::vector<uint32_t> ran;
+      ran.clear();
+      while (!ticks.queue.empty() && ticks.queue.top().due <= tick_)
+      {
+        const uint32_t index = ticks.queue.top().index;
+        ticks.queue.pop();
+        ++output.popped_ticks;
+        if (std::find(ran.begin(), ran.end(), index) != ran.end())
+          continue;
+        ran.push_back(index);
+
+        const BlockId id = chunk.blocks_data[index];
+        if (TickFunction tick = GetBehaviour(id).scheduled_tick)
+        {
+          ++output.scheduled_ticks;
+          tick(context, IndexToPos(chunk, index), id);
+        }
+      }
+
+      // Random ticks, only in sections with blocks that have one.
+      if (random_ticks_per_section_ == 0)
+        return;
+      for (uint32_t section = 0; section < kSectionsPerChunk; ++section)
+      {
+        if (ticks.tickable[section] == 0)
+          continue;
+        ++output.active_sections;
+        for (int i = 0; i < random_ticks_per_section_; ++i)
+        {
+          const uint32_t index = (section << 12) | (context.Random() & (kSectionVolume - 1));
+          const BlockId id = chunk.blocks_data[index];
+          if (TickFunction tick = GetBehaviour(id).random_tick)
+          {
+            ++output.random_ticks;
+            tick(context, IndexToPos(chunk, index), id);
+          }
+        }
+      }
+    }
+
+    void TickScheduler::DropUnloaded()
+    {
+      // A chunk that was unloaded loses its scheduled ticks.
+      for (auto it = chunks_.begin(); it != chunks_.end();)
+      {
+        if (world_.GetChunk(ChunkKeyX(it->first), ChunkKeyZ(it->first)) != it->second.chunk)
+        {
+          stats_.pending_ticks -= it->second.queue.size();
+          it = chunks_.erase(it);
+        }
+        else
+          ++it;
+      }
+    }
+
+    void TickScheduler::MergeOutput(TickContext::Output& output, std::vector<ChunkKey>& remesh)
+    {
+      stats_.active_sections += output.active_sections;
+      stats_.random_ticks += output.random_ticks;
+      stats_.scheduled_ticks += output.scheduled_ticks;
+      stats_.pending_ticks -= output.popped_ticks;
+      stats_.edits += output.edits_applied;
+      remesh.insert(remesh.end(), output.remesh.begin(), output.remesh.end());
+      changes_.insert(changes_.end(), output.changes.begin(), output.changes.end());
+      for (const auto& [pos, delay] : output.schedules)
+        Schedule(pos, delay);
+
+      // Edits that crossed into other regions, through the streamer's checks.
+      stats_.deferred_edits += output.edits.size();
+      for (const auto& [pos, id] : output.edits)
+        stats_.edits += SetBlock(pos, id) ? 1 : 0;
+    }
+
+    void TickScheduler::Tick()
+    {
+      const auto start = std::chrono::steady_clock::now();
+      ++tick_;
+      DropUnloaded();
+
+      // Chunks sorted by colour, region, then key, so the merges below run in the same
+      // order whatever the thread count.
+      std::vector<TickedChunk> ticked;
+      for (ChunkKey key : streamer_.GetEditableChunks())
+      {
+        Chunk* chunk = world_.GetChunk(ChunkKeyX(key), ChunkKeyZ(key));
+        if (!chunk)
+          continue;
+        const int32_t region_x = RegionCoord(chunk->x, region_size_);
+        const int32_t region_z = RegionCoord(chunk->z, region_size_);
+        const uint32_t colour = static_cast<uint32_t>(region_x & 1) | (static_cast<uint32_t>(region_z & 1) << 1);
+        ticked.push_back({ colour, PackChunkKey(region_x, region_z), key, GetTicks(chunk) });
+      }
+      std::sort(ticked.begin(), ticked.end(), [](const TickedChunk& a, const TickedChunk& b) {
+        if (a.colour != b.colour)
+          return a.colour < b.colour;
+        return a.region != b.region ? a.region < b.region : a.key < b.key;
+      });
+
+      std::vector<TickContext::RegionChunk> chunks(ticked.size());
+      std::vector<size_t> regions;  // First chunk of every region, then the end.
+      for (size_t i = 0; i < ticked.size(); ++i)
+      {
+        chunks[i] = { world_.GetChunk(ChunkKeyX(ticked[i].key), ChunkKeyZ(ticked[i].key)), ticked[i].ticks->tickable.data() };
+        if (i == 0 || ticked[i].region != ticked[i - 1].region || ticked[i].colour != ticked[i - 1].colour)
+          regions.push_back(i);
+      }
+      regions.push_back(ticked.size());
+      const size_t region_count = regions.size() - 1;
+
+      stats_.chunks = ticked.size();
+      stats_.regions = region_count;
+      stats_.active_sections = 0;
+      stats_.random_ticks = 0;
+      stats_.scheduled_ticks = 0;
+      stats_.edits = 0;
+      stats_.deferred_edits = 0;
+
+      // One phase per colour; the buffered edits land before the next phase reads them.
+      std::vector<TickContext::Output> outputs(region_count);
+      std::vector<ChunkKey> remesh;
+      for (size_t begin = 0; begin < region_count;)
+      {
+        size_t end = begin;
+        while (end < region_count && ticked[regions[end]].colour == ticked[regions[begin]].colour)
+          ++end;
+        jobs_.ParallelFor(end - begin, 1, [&](size_t first, size_t last) {
+          for (size_t r = begin + first; r < begin + last; ++r)
+            TickRegion(&ticked[regions[r]], &chunks[regions[r]], regions[r + 1] - regions[r], outputs[r]);
+        });
+        for (size_t r = begin; r < end; ++r)
+          MergeOutput(outputs[r], remesh);
+        begin = end;
+      }
+
+      std::sort(remesh.begin(), remesh.end());
+      remesh.erase(std::unique(remesh.begin(), remesh.end()), remesh.end());
+      streamer_.RebuildMeshes(remesh);
+
+      ++stats_.ticks;
+      stats_.timing.Add(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+  }  // namespace world
+
+}  // namespace heh
@@ -1,184 +1,415 @@
 #include "world/chunk.hpp"
 
 // std
+#include <algorithm>
 #include <vector>
 #include <limits>
 #include <array>
 #include <type_traits>
 #include <cstdint>
-#include <random>
 
 namespace heh {
 
-  
+  namespace {
 
-  void Chunk::Generate()
-  {
-    data = std::make_unique<ChunkRenderData>();
-    data->vertices.resize(kChunkWidth * kChunkHeight * kChunkDepth * 24);
-    data->elements.resize(kChunkWidth * kChunkHeight * kChunkDepth * 36);
-    blocks_data.resize(kChunkWidth * kChunkHeight * kChunkDepth);
+    // Every face of every block, four vertices each, still fits the int32_t elements.
+    static_assert(static_cast<uint64_t>(kChunkVolume) * 6 * 4 <= static_cast<uint64_t>(std::numeric_limits<int32_t>::max()),
+                  "Chunk meshes could overflow their elements");
 
-    
+    enum FaceUvSet { kUvTop, kUvSide, kUvBottom };
 
-    for (int i = 0; i < kChunkWidth * kChunkHeight * kChunkDepth; ++i)
+    struct FaceDesc
     {
-      blocks_data[i] = 1;
-    }
-
-    for (int x = 0; x < kChunkWidth; ++x) 
+      int dx, dy, dz;          // direction of the neighbour that hides this face
+      int corners[4];          // indices into kCorners
+      int uv_order[4];         // which uv of the face texture each corner uses
+      FaceUvSet uv_set;
+      int u_axis, v_axis;      // the two axes along the face, for sampling light around its corners
+    };
+
+    // Cube corners relative to the block centre (blocks span [p - 0.5, p + 0.5]).
+    //   0..3: top face, 4..7: the same corners one unit lower.
+    constexpr float kCorners[8][3] = {
+      { -0.5f,  0.5f,  0.5f }, {  0.5f,  0.5f,  0.5f }, {  0.5f,  0.5f, -0.5f }, { -0.5f,  0.5f, -0.5f },
+      { -0.5f, -0.5f,  0.5f }, {  0.5f, -0.5f,  0.5f }, {  0.5f, -0.5f, -0.5f }, { -0.5f, -0.5f, -0.5f },
+    };
+
+    // Corner order keeps the counter-clockwise winding expected by glFrontFace(GL_CCW).
+    constexpr FaceDesc kFaces[6] = {
+      {  0,  1,  0, { 0, 1, 2, 3 }, { 0, 1, 2, 3 }, kUvTop,    0, 2 },  // Top face
+      {  0,  0,  1, { 0, 4, 5, 1 }, { 0, 1, 2, 3 }, kUvSide,   0, 1 },  // +Z face
+      {  1,  0,  0, { 1, 5, 6, 2 }, { 3, 2, 1, 0 }, kUvSide,   2, 1 },  // +X face
+      {  0,  0, -1, { 2, 6, 7, 3 }, { 0, 1, 2, 3 }, kUvSide,   0, 1 },  // -Z face
+      { -1,  0,  0, { 3, 7, 4, 0 }, { 3, 2, 1, 0 }, kUvSide,   2, 1 },  // -X face
+      {  0, -1,  0, { 7, 6, 5, 4 }, { 1, 0, 3, 2 }, kUvBottom, 0, 2 },  // Bottom face
+    };
+
+    /**
+     * Blocks in the layer in front of a face, indexed [v + 1][u + 1] along its axes;
+     * [1][1] is the block the face looks into.
+     */
+    struct FaceLight
+    {
+      uint8_t light[3][3];
+      bool opaque[3][3];
+
+      /**
+       * @brief Averages sky and block light over the transparent blocks touching the corner
+       * in direction (su, sv). The diagonal block does not count when both blocks beside it
+       * are opaque, so light does not leak through the edge between them.
+       */
+      glm::vec2 Corner(int su, int sv) const
+      {
+        const int u = su + 1;
+        const int v = sv + 1;
+        int sky = light[1][1] >> 4;
+        int block = light[1][1] & 15;
+        int count = 1;
+        if (!opaque[1][u]) { sky += light[1][u] >> 4; block += light[1][u] & 15; ++count; }
+        if (!opaque[v][1]) { sky += light[v][1] >> 4; block += light[v][1] & 15; ++count; }
+        if (!opaque[v][u] && !(opaque[1][u] && opaque[v][1])) { sky += light[v][u] >> 4; block += light[v][u] & 15; ++count; }
+        const float scale = 1.0f / static_cast<float>(count * kMaxLight);
+        return glm::vec2(static_cast<float>(sky) * scale, static_cast<float>(block) * scale);
+      }
+    };
+
+    // Solid cells under open air (or anything else that is not opaque) whose border faces
+    // are kept as skirts.
+    constexpr int kSkirtCells = 2;
+
+    /**
+     * @brief The block a cell of size^3 blocks of chunk stands for, starting at local
+     * block (x, y, z): air unless at least half of it is solid, else the id most of its
+     * columns have as their top block inside the cell.
+     */
+    BlockId DownsampleCell(const Chunk& chunk, uint32_t x, uint32_t y, uint32_t z, uint32_t size)
     {
-      for (int z = 0; z < kChunkDepth; ++z)
+      std::array<std::pair<BlockId, uint32_t>, 64> votes;
+      size_t vote_count = 0;
+      uint32_t solid = 0;
+      for (uint32_t cx = x; cx < x + size; ++cx)
       {
-        for (int y = 0; y < kChunkHeight; ++y)
+        for (uint32_t cz = z; cz < z + size; ++cz)
         {
-          const int array_expansion = (x * (kChunkDepth * kChunkHeight) + (y + kChunkHeight * z));
-
-
-          // data->elements
-          const uint32_t element_index = array_expansion * 36;
-          const uint32_t element_offset = array_expansion * 24;
-          if (element_offset >= std::numeric_limits<uint32_t>::max() - 24)
-            printf("Chunk Overflow\n");
-
-          // 0 1 2
-          // 0 2 3
-          for (int i = 0; i < 6; ++i)
+          BlockId top = kAirBlock;
+          for (uint32_t cy = y + size; cy-- > y;)
           {
-            data->elements[element_index + (i * 6) + 0] = element_offset + 0 + (i * 4);
-            data->elements[element_index + (i * 6) + 1] = element_offset + 1 + (i * 4);
-            data->elements[element_index + (i * 6) + 2] = element_offset + 2 + (i * 4);
-
-            data->elements[element_index + (i * 6) + 3] = element_offset + 0 + (i * 4);
-            data->elements[element_index + (i * 6) + 4] = element_offset + 2 + (i * 4);
-            data->elements[element_index + (i * 6) + 5] = element_offset + 3 + (i * 4);
+            const BlockId id = chunk.GetBlock(cx, cy, cz);
+            if (id == kAirBlock)
+              continue;
+            ++solid;
+            if (top == kAirBlock)
+              top = id;
           }
+          if (top == kAirBlock)
+            continue;
+          size_t i = 0;
+          while (i < vote_count && votes[i].first != top)
+            ++i;
+          if (i == vote_count)
+            votes[vote_count++] = { top, 0 };
+          ++votes[i].second;
+        }
+      }
+      if (solid * 2 < size * size * size)
+        return kAirBlock;
+
+      size_t best = 0;
+      for (size_t i = 1; i < vote_count; ++i)
+      {
+        if (votes[i].second > votes[best].second)
+          best = i;
+      }
+      return votes[best].first;
+    }
 
+  }  // namespace
 
-          // tex_coords
-
-
-          const int vertex_offset = array_expansion * 24;
-          const int tex_coords_index = array_expansion * 24;
-
-
-          const std::string& name = block_map::id_to_name[blocks_data[array_expansion]];
-          const BlockFormat& block = block_map::block_formats[blocks_data[array_expansion] - 1];
-
-          const TextureFormat& tex_top = block_map::texture_formats[block.top];
-          const TextureFormat& tex_side = block_map::texture_formats[block.side];
-          const TextureFormat& tex_bottom = block_map::texture_formats[block.bottom];
-
-          // verts begin
-
-          // position
-          std::array<Vertex, 8> verts;
-          verts[0].position = glm::vec3(
-            (float)x - 0.5f,
-            (float)y + 0.5f,
-            (float)z + 0.5f
-          );
-          verts[1].position = verts[0].position + glm::vec3(1.f, 0.f, 0.f);
-          verts[2].position = verts[1].position - glm::vec3(0.f, 0.f, 1.f);
-          verts[3].position = verts[0].position - glm::vec3(0.f, 0.f, 1.f);
-
-          verts[4].position = verts[0].position - glm::vec3(0.f, 1.f, 0.f);
-          verts[5].position = verts[1].position - glm::vec3(0.f, 1.f, 0.f);
-          verts[6].position = verts[2].position - glm::vec3(0.f, 1.f, 0.f);
-          verts[7].position = verts[3].position - glm::vec3(0.f, 1.f, 0.f);
-
-
-          // verts end
-          
-          // Top face
-          data->vertices[vertex_offset + 0] = { verts[0].position, tex_top.uvs[0], glm::vec3(0.f, 1.f, 0.f) };
-          data->vertices[vertex_offset + 1] = { verts[1].position, tex_top.uvs[1], glm::vec3(0.f, 1.f, 0.f) };
-          data->vertices[vertex_offset + 2] = { verts[2].position, tex_top.uvs[2], glm::vec3(0.f, 1.f, 0.f) };
-          data->vertices[vertex_offset + 3] = { verts[3].position, tex_top.uvs[3], glm::vec3(0.f, 1.f, 0.f) };
-
-          // Right face
-          data->vertices[vertex_offset + 4] = { verts[0].position, tex_side.uvs[0], glm::vec3(1.f, 0.f, 0.f) };
-          data->vertices[vertex_offset + 5] = { verts[4].position, tex_side.uvs[1], glm::vec3(1.f, 0.f, 0.f) };
-          data->vertices[vertex_offset + 6] = { verts[5].position, tex_side.uvs[2], glm::vec3(1.f, 0.f, 0.f) };
-          data->vertices[vertex_offset + 7] = { verts[1].position, tex_side.uvs[3], glm::vec3(1.f, 0.f, 0.f) };
-
-          // Forward face
-          data->vertices[vertex_offset + 8] = { verts[1].position, tex_side.uvs[3], glm::vec3(0.f, 0.f, 1.f) };
-          data->vertices[vertex_offset + 9] = { verts[5].position, tex_side.uvs[2], glm::vec3(0.f, 0.f, 1.f) };
-          data->vertices[vertex_offset + 10] = { verts[6].position, tex_side.uvs[1], glm::vec3(0.f, 0.f, 1.f) };
-          data->vertices[vertex_offset + 11] = { verts[2].position, tex_side.uvs[0], glm::vec3(0.f, 0.f, 1.f) };
-
-          // Left face
-          data->vertices[vertex_offset + 12] = { verts[2].position, tex_side.uvs[0], glm::vec3(-1.f, 0.f, 0.f) };
-          data->vertices[vertex_offset + 13] = { verts[6].position, tex_side.uvs[1], glm::vec3(-1.f, 0.f, 0.f) };
-          data->vertices[vertex_offset + 14] = { verts[7].position, tex_side.uvs[2], glm::vec3(-1.f, 0.f, 0.f) };
-          data->vertices[vertex_offset + 15] = { verts[3].position, tex_side.uvs[3], glm::vec3(-1.f, 0.f, 0.f) };
-
-          // Back face
-          data->vertices[vertex_offset + 16] = { verts[3].position, tex_side.uvs[3], glm::vec3(0.f, 0.f, -1.f) };
-          data->vertices[vertex_offset + 17] = { verts[7].position, tex_side.uvs[2], glm::vec3(0.f, 0.f, -1.f) };
-          data->vertices[vertex_offset + 18] = { verts[4].position, tex_side.uvs[1], glm::vec3(0.f, 0.f, -1.f) };
-          data->vertices[vertex_offset + 19] = { verts[0].position, tex_side.uvs[0], glm::vec3(0.f, 0.f, -1.f) };
-
-          // Bottom face
-          data->vertices[vertex_offset + 20] = { verts[7].position, tex_bottom.uvs[1], glm::vec3(0.f, -1.f, 0.f) };
-          data->vertices[vertex_offset + 21] = { verts[6].position, tex_bottom.uvs[0], glm::vec3(0.f, -1.f, 0.f) };
-          data->vertices[vertex_offset + 22] = { verts[5].position, tex_bottom.uvs[3], glm::vec3(0.f, -1.f, 0.f) };
-          data->vertices[vertex_offset + 23] = { verts[4].position, tex_bottom.uvs[2], glm::vec3(0.f, -1.f, 0.f) };
+  std::unique_ptr<ChunkRenderData> Chunk::BuildMesh(const ChunkNeighbourhood& area) const
+  {
+    auto data = std::make_unique<ChunkRenderData>();
 
+    // Section by section, in the order of blocks_data, so each section's faces are a
+    // contiguous run of elements the renderer can draw on its own.
+    for (uint32_t section = 0; section < kSectionsPerChunk; ++section)
+    {
+      data->section_elements[section] = static_cast<uint32_t>(data->elements.size());
+      data->section_connectivity[section] = ComputeConnectivity(section);
+      for (uint32_t x = 0; x < kChunkWidth; ++x)
+      {
+        for (uint32_t z = 0; z < kChunkDepth; ++z)
+        {
+          for (uint32_t y = section * kSectionHeight; y < (section + 1) * kSectionHeight; ++y)
+          {
+            const BlockId block_id = GetBlock(x, y, z);
+            if (block_id == kAirBlock || static_cast<size_t>(block_id) >= block_map::face_uvs.size())
+              continue;
+
+            const BlockFaceUvs& uvs = block_map::face_uvs[block_id];
+            const glm::vec3 centre(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+
+            for (const FaceDesc& face : kFaces)
+            {
+              const int front[3] = { static_cast<int>(x) + face.dx, static_cast<int>(y) + face.dy, static_cast<int>(z) + face.dz };
+              // Never draw the underside of the world. Faces show through blocks that are not
+              // opaque, except between two blocks of the same kind (glass, leaves).
+              if (front[1] < 0)
+                continue;
+              const BlockId front_id = area.GetBlock(front[0], front[1], front[2]);
+              if (block_map::IsOpaque(front_id) || front_id == block_id)
+                continue;
+
+              FaceLight face_light;
+              for (int v = -1; v <= 1; ++v)
+              {
+                for (int u = -1; u <= 1; ++u)
+                {
+                  int pos[3] = { front[0], front[1], front[2] };
+                  pos[face.u_axis] += u;
+                  pos[face.v_axis] += v;
+                  face_light.light[v + 1][u + 1] = area.GetLight(pos[0], pos[1], pos[2]);
+                  face_light.opaque[v + 1][u + 1] = block_map::IsOpaque(area.GetBlock(pos[0], pos[1], pos[2]));
+                }
+              }
+
+              const glm::vec2* face_uvs = face.uv_set == kUvTop ? uvs.top
+                : face.uv_set == kUvSide ? uvs.side : uvs.bottom;
+              const glm::vec3 normal(static_cast<float>(face.dx), static_cast<float>(face.dy), static_cast<float>(face.dz));
+
+              const uint32_t element_offset = static_cast<uint32_t>(data->vertices.size());
+
+              for (int i = 0; i < 4; ++i)
+              {
+                const float* corner = kCorners[face.corners[i]];
+                data->vertices.push_back({
+                  centre + glm::vec3(corner[0], corner[1], corner[2]),
+                  face_uvs[face.uv_order[i]],
+                  normal,
+                  face_light.Corner(corner[face.u_axis] > 0.0f ? 1 : -1, corner[face.v_axis] > 0.0f ? 1 : -1) });
+              }
+
+              // 0 1 2
+              // 0 2 3
+              data->elements.push_back(element_offset + 0);
+              data->elements.push_back(element_offset + 1);
+              data->elements.push_back(element_offset + 2);
+              data->elements.push_back(element_offset + 0);
+              data->elements.push_back(element_offset + 2);
+              data->elements.push_back(element_offset + 3);
+            }
+          } // for y
         } // for z
-      } // for y
-    } // for x
-
+      } // for x
+    } // for section
+    data->section_elements[kSectionsPerChunk] = static_cast<uint32_t>(data->elements.size());
 
     // Grab calculated data into a struct
     data->vertex_size_bytes = data->vertices.size() * sizeof(Vertex);
     data->element_size_bytes = data->elements.size() * sizeof(int32_t);
     data->num_elements = static_cast<uint32_t>(data->elements.size());
+    return data;
   }
 
-
-
-
-  void Chunk::UploadToGpu()
+  std::unique_ptr<ChunkRenderData> Chunk::BuildLodMesh(const ChunkNeighbourhood& area, uint32_t lod) const
   {
-    vao_.Bind();  // VAO begin
+    if (lod == 0)
+      return BuildMesh(area);
+    if (lod > kMaxLod)
+      lod = kMaxLod;
+
+    const int size = 1 << lod;
+    const int side = static_cast<int>(kChunkWidth) >> lod;
+    const int height = static_cast<int>(kChunkHeight) >> lod;
+    const int padded = side + 2;
+
+    // Cells of this chunk with a ring of the neighbours' cells around it, indexed
+    // [(x + 1) * padded + z + 1][y]. Missing neighbours and their corners stay air.
+    std::vector<BlockId> cells(static_cast<size_t>(padded * padded * height), kAirBlock);
+    const auto cell = [&](int x, int y, int z) -> BlockId& {
+      return cells[static_cast<size_t>(((x + 1) * padded + z + 1) * height + y)];
+    };
+    for (int x = -1; x <= side; ++x)
     {
-      // VBO
-      vbo_.BindAndSetData(data->vertex_size_bytes, data->vertices.data(), GL_STATIC_DRAW);
-
-      // EBO
-      ebo_.BindAndSetData(data->element_size_bytes, data->elements.data(), GL_STATIC_DRAW);
-
-      // position
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(heh::Vertex), (void*)0);
-      glEnableVertexAttribArray(0);
-
-      // texture coords
-      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(heh::Vertex), (void*)(offsetof(heh::Vertex, tex_coords)));
-      glEnableVertexAttribArray(1);
-
-      // normals
-      glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(heh::Vertex), (void*)(offsetof(heh::Vertex, normal)));
-      glEnableVertexAttribArray(2);
-
-      vbo_.Unbind();
+      for (int z = -1; z <= side; ++z)
+      {
+        const bool outside_x = x < 0 || x >= side;
+        const bool outside_z = z < 0 || z >= side;
+        if (outside_x && outside_z)
+          continue;
+        const Chunk* chunk = area.Get(outside_x ? (x < 0 ? -1 : 1) : 0, outside_z ? (z < 0 ? -1 : 1) : 0);
+        if (!chunk)
+          continue;
+        const uint32_t block_x = static_cast<uint32_t>((x + side) % side * size);
+        const uint32_t block_z = static_cast<uint32_t>((z + side) % side * size);
+        for (int y = 0; y < height; ++y)
+          cell(x, y, z) = DownsampleCell(*chunk, block_x, static_cast<uint32_t>(y * size), block_z, static_cast<uint32_t>(size));
+      }
     }
-    vao_.Unbind(); // VAO end
-  }
 
-  void Chunk::ClearCpuData()
-  {
-    data->vertices.clear();
-    data->vertices.shrink_to_fit();
-    data->elements.clear();
-    data->elements.shrink_to_fit();
+    auto data = std::make_unique<ChunkRenderData>();
+    data->lod = lod;
+    const int section_cells = static_cast<int>(kSectionHeight) >> lod;
+    const float scale = static_cast<float>(size);
+    for (uint32_t section = 0; section < kSectionsPerChunk; ++section)
+    {
+      data->section_elements[section] = static_cast<uint32_t>(data->elements.size());
+      data->section_connectivity[section] = ComputeConnectivity(section);
+      for (int x = 0; x < side; ++x)
+      {
+        for (int z = 0; z < side; ++z)
+        {
+          for (int y = static_cast<int>(section) * section_cells; y < static_cast<int>(section + 1) * section_cells; ++y)
+          {
+            const BlockId block_id = cell(x, y, z);
+            if (block_id == kAirBlock || static_cast<size_t>(block_id) >= block_map::face_uvs.size())
+              continue;
+
+            bool under_air = false;
+            for (int above = y + 1; above <= y + kSkirtCells && !under_air; ++above)
+              under_air = above >= height || !block_map::IsOpaque(cell(x, above, z));
+
+            const BlockFaceUvs& uvs = block_map::face_uvs[block_id];
+            const glm::ivec3 first(x * size, y * size, z * size);
+            const glm::vec3 centre = glm::vec3(first) + glm::vec3(0.5f * (scale - 1.0f));
+
+            for (const FaceDesc& face : kFaces)
+            {
+              const int front_y = y + face.dy;
+              if (front_y < 0)
+                continue;
+              const int front_x = x + face.dx;
+              const int front_z = z + face.dz;
+              const bool border = front_x < 0 || front_x >= side || front_z < 0 || front_z >= side;
+              // As in BuildMesh: hidden only by opaque cells or cells of the same kind.
+              if (front_y < height && !(border && under_air))
+              {
+                const BlockId front_id = cell(front_x, front_y, front_z);
+                if (block_map::IsOpaque(front_id) || front_id == block_id)
+                  continue;
+              }
+
+              // The layer of blocks just in front of the face.
+              const int normal[3] = { face.dx, face.dy, face.dz };
+              int sky = 0;
+              int block = 0;
+              for (int v = 0; v < size; ++v)
+              {
+                for (int u = 0; u < size; ++u)
+                {
+                  int pos[3] = { first.x, first.y, first.z };
+                  for (int axis = 0; axis < 3; ++axis)
+                  {
+                    if (normal[axis] != 0)
+                      pos[axis] += normal[axis] > 0 ? size : -1;
+                  }
+                  pos[face.u_axis] += u;
+                  pos[face.v_axis] += v;
+                  const uint8_t light = area.GetLight(pos[0], pos[1], pos[2]);
+                  sky = std::max(sky, light >> 4);
+                  block = std::max(block, light & 15);
+                }
+              }
+              const glm::vec2 face_light(static_cast<float>(sky) / kMaxLight, static_cast<float>(block) / kMaxLight);
+
+              const glm::vec2* face_uvs = face.uv_set == kUvTop ? uvs.top
+                : face.uv_set == kUvSide ? uvs.side : uvs.bottom;
+              const glm::vec3 face_normal(static_cast<float>(face.dx), static_cast<float>(face.dy), static_cast<float>(face.dz));
+
+              const uint32_t element_offset = static_cast<uint32_t>(data->vertices.size());
+              for (int i = 0; i < 4; ++i)
+              {
+                const float* corner = kCorners[face.corners[i]];
+                data->vertices.push_back({
+                  centre + glm::vec3(corner[0], corner[1], corner[2]) * scale,
+                  face_uvs[face.uv_order[i]],
+                  face_normal,
+                  face_light });
+              }
+
+              data->elements.push_back(element_offset + 0);
+              data->elements.push_back(element_offset + 1);
+              data->elements.push_back(element_offset + 2);
+              data->elements.push_back(element_offset + 0);
+              data->elements.push_back(element_offset + 2);
+              data->elements.push_back(element_offset + 3);
+            }
+          } // for y
+        } // for z
+      } // for x
+    } // for section
+    data->section_elements[kSectionsPerChunk] = static_cast<uint32_t>(data->elements.size());
+
+    data->vertex_size_bytes = data->vertices.size() * sizeof(Vertex);
+    data->element_size_bytes = data->elements.size() * sizeof(int32_t);
+    data->num_elements = static_cast<uint32_t>(data->elements.size());
+    return data;
   }
 
-  void Chunk::Render()
+  uint16_t Chunk::ComputeConnectivity(uint32_t section) const
   {
-    vao_.Bind();
-    glDrawElements(GL_TRIANGLES, data->num_elements, GL_UNSIGNED_INT, nullptr);
+    // Local index (x << 8) | (z << 4) | y, as in blocks_data.
+    const BlockId* blocks = blocks_data.data() + section * kSectionVolume;
+    std::array<bool, kSectionVolume> open;
+    size_t open_count = 0;
+    for (uint32_t i = 0; i < kSectionVolume; ++i)
+    {
+      open[i] = !block_map::IsOpaque(blocks[i]);
+      open_count += open[i] ? 1 : 0;
+    }
+    if (open_count == kSectionVolume)
+      return kAllFacesConnected;
+    if (open_count == 0)
+      return 0;
+
+    // Each open region joins every pair of the faces it touches.
+    uint16_t mask = 0;
+    std::array<bool, kSectionVolume> visited{};
+    std::vector<uint16_t> stack;
+    stack.reserve(kSectionVolume);
+    for (uint32_t seed = 0; seed < kSectionVolume; ++seed)
+    {
+      if (!open[seed] || visited[seed])
+        continue;
+      uint8_t faces = 0;
+      visited[seed] = true;
+      stack.push_back(static_cast<uint16_t>(seed));
+      while (!stack.empty())
+      {
+        const uint32_t i = stack.back();
+        stack.pop_back();
+        const uint32_t x = i >> 8;
+        const uint32_t z = (i >> 4) & 15;
+        const uint32_t y = i & 15;
+        faces |= static_cast<uint8_t>((y == 0) << kFaceDown | (y == 15) << kFaceUp | (z == 0) << kFaceNorth |
+                                      (z == 15) << kFaceSouth | (x == 0) << kFaceWest | (x == 15) << kFaceEast);
+
+        const auto visit = [&](uint32_t next) {
+          if (open[next] && !visited[next])
+          {
+            visited[next] = true;
+            stack.push_back(static_cast<uint16_t>(next));
+          }
+        };
+        if (y > 0) visit(i - 1);
+        if (y < 15) visit(i + 1);
+        if (z > 0) visit(i - 16);
+        if (z < 15) visit(i + 16);
+        if (x > 0) visit(i - 256);
+        if (x < 15) visit(i + 256);
+      }
+
+      for (int a = 0; a < kSectionFaceCount; ++a)
+      {
+        for (int b = a + 1; b < kSectionFaceCount; ++b)
+        {
+          if ((faces >> a & 1) && (faces >> b & 1))
+            mask |= SectionFacePairBit(a, b);
+        }
+      }
+      if (mask == kAllFacesConnected)
+        break;
+    }
+    return mask;
   }
 
-}  // namespace heh
\ No newline at end of file
+}  // namespace heh
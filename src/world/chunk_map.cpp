@@ -0,0 +1,128 @@
+#include "world/chunk_map.hpp"
+
+// std
+#include <cassert>
+
+namespace heh {
+
+  namespace world {
+
+    static size_t NextPowerOfTwo(size_t v)
+    {
+      size_t p = 16;
+      while (p < v)
+        p <<= 1;
+      return p;
+    }
+
+    ChunkMap::ChunkMap(size_t initial_capacity)
+      : table_(new Table(NextPowerOfTwo(initial_capacity)))
+    {
+    }
+
+    ChunkMap::~ChunkMap()
+    {
+      delete table_.load(std::memory_order_relaxed);
+    }
+
+    bool ChunkMap::Insert(ChunkKey key, Chunk* chunk)
+    {
+      assert(key != kEmptyChunkKey && key != kTombstoneChunkKey);
+      std::lock_guard<std::mutex> lock(write_mutex_);
+
+      Table* table = table_.load(std::memory_order_relaxed);
+      // Keep the load factor (tombstones included) at or below 1/2 so probe runs stay short.
+      if ((used_slots_ + 1) * 2 > table->mask + 1)
+      {
+        const size_t live = size_.load(std::memory_order_relaxed);
+        Grow((live + 1) * 4 > table->mask + 1 ? (table->mask + 1) * 2 : table->mask + 1);
+        table = table_.load(std::memory_order_relaxed);
+      }
+
+      size_t i = Hash(key) & table->mask;
+      size_t first_tombstone = SIZE_MAX;
+      for (;;)
+      {
+        const ChunkKey k = table->slots[i].key.load(std::memory_order_relaxed);
+        if (k == key)
+          return false;
+        if (k == kTombstoneChunkKey && first_tombstone == SIZE_MAX)
+          first_tombstone = i;
+        if (k == kEmptyChunkKey)
+          break;
+        i = (i + 1) & table->mask;
+      }
+
+      if (first_tombstone != SIZE_MAX)
+        i = first_tombstone;
+      else
+        ++used_slots_;
+
+      // Publish the value before the key so a reader that sees the key also sees the chunk.
+      // Release on the value too: a reader that loads it from a reused tombstone is then
+      // sure to see the erase's tombstone when it checks the key again (see Find).
+      table->slots[i].value.store(chunk, std::memory_order_release);
+      table->slots[i].key.store(key, std::memory_order_release);
+      size_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    Chunk* ChunkMap::Erase(ChunkKey key)
+    {
+      std::lock_guard<std::mutex> lock(write_mutex_);
+
+      Table* table = table_.load(std::memory_order_relaxed);
+      size_t i = Hash(key) & table->mask;
+      for (;;)
+      {
+        Slot& slot = table->slots[i];
+        const ChunkKey k = slot.key.load(std::memory_order_relaxed);
+        if (k == kEmptyChunkKey)
+          return nullptr;
+        if (k == key)
+        {
+          Chunk* chunk = slot.value.load(std::memory_order_relaxed);
+          // Readers that already matched the key observe nullptr, i.e. "not loaded".
+          slot.value.store(nullptr, std::memory_order_release);
+          slot.key.store(kTombstoneChunkKey, std::memory_order_release);
+          size_.fetch_sub(1, std::memory_order_relaxed);
+          return chunk;
+        }
+        i = (i + 1) & table->mask;
+      }
+    }
+
+    void ChunkMap::Grow(size_t new_capacity)
+    {
+      Table* old_table = table_.load(std::memory_order_relaxed);
+      auto new_table = std::make_unique<Table>(new_capacity);
+
+      used_slots_ = 0;
+      for (size_t i = 0; i <= old_table->mask; ++i)
+      {
+        const ChunkKey k = old_table->slots[i].key.load(std::memory_order_relaxed);
+        if (k == kEmptyChunkKey || k == kTombstoneChunkKey)
+          continue;
+
+        size_t j = Hash(k) & new_table->mask;
+        while (new_table->slots[j].key.load(std::memory_order_relaxed) != kEmptyChunkKey)
+          j = (j + 1) & new_table->mask;
+
+        new_table->slots[j].value.store(old_table->slots[i].value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        new_table->slots[j].key.store(k, std::memory_order_relaxed);
+        ++used_slots_;
+      }
+
+      table_.store(new_table.release(), std::memory_order_release);
+      retired_tables_.emplace_back(old_table);
+    }
+
+    void ChunkMap::ReclaimRetired()
+    {
+      std::lock_guard<std::mutex> lock(write_mutex_);
+      retired_tables_.clear();
+    }
+
+  }  // namespace world
+
+}  // namespace heh
@@ -0,0 +1,424 @@
+#include "world/chunk_storage.hpp"
+
+// std
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace heh {
+
+  namespace world {
+
+    namespace {
+
+      constexpr char kMagic[4] = { 'H', 'C', 'R', '2' };
+      // Same header size, but all the offsets and then all the sizes; converted on save.
+      constexpr char kLegacyMagic[4] = { 'H', 'C', 'R', '1' };
+      constexpr uint32_t kColumns = ChunkStorage::kRegionWidth * ChunkStorage::kRegionWidth;
+      // Magic, then the offset and the size of every column side by side, so a column's
+      // entry is replaced with a single write.
+      constexpr uint32_t kEntrySize = 2 * sizeof(uint32_t);
+      constexpr uint32_t kHeaderSize = sizeof(kMagic) + kColumns * kEntrySize;
+      // Checksum, status and run count.
+      constexpr uint32_t kRecordHeaderSize = 4 + 1 + 4;
+      constexpr uint32_t kMaxRun = 0xFFFF;
+
+      // Files are little-endian whatever the machine.
+      void PutU16(std::vector<uint8_t>& out, uint16_t v)
+      {
+        out.push_back(static_cast<uint8_t>(v));
+        out.push_back(static_cast<uint8_t>(v >> 8));
+      }
+
+      void PutU32(uint8_t* out, uint32_t v)
+      {
+        for (int i = 0; i < 4; ++i)
+          out[i] = static_cast<uint8_t>(v >> (8 * i));
+      }
+
+      uint16_t GetU16(const uint8_t* in) { return static_cast<uint16_t>(in[0] | (in[1] << 8)); }
+
+      uint32_t GetU32(const uint8_t* in)
+      {
+        return static_cast<uint32_t>(in[0]) | (static_cast<uint32_t>(in[1]) << 8) | (static_cast<uint32_t>(in[2]) << 16) |
+               (static_cast<uint32_t>(in[3]) << 24);
+      }
+
+      uint32_t Checksum(const uint8_t* data, size_t size)
+      {
+        uint32_t hash = 2166136261u;  // FNV-1a
+        for (size_t i = 0; i < size; ++i)
+          hash = (hash ^ data[i]) * 16777619u;
+        return hash;
+      }
+
+      int32_t FloorDiv(int32_t v, int32_t d) { return v >= 0 ? v / d : -((-v + d - 1) / d); }
+
+      uint32_t ColumnIndex(int32_t x, int32_t z)
+      {
+        const int32_t w = ChunkStorage::kRegionWidth;
+        return static_cast<uint32_t>((z - FloorDiv(z, w) * w) * w + (x - FloorDiv(x, w) * w));
+      }
+
+      std::vector<uint8_t> Encode(const Chunk& chunk)
+      {
+        std::vector<uint8_t> record(kRecordHeaderSize);
+        record[4] = static_cast<uint8_t>(chunk.status);
+        uint32_t runs = 0;
+        const BlockId* blocks = chunk.blocks_data.data();
+        for (size_t i = 0; i < chunk.blocks_data.size();)
+        {
+          size_t end = i + 1;
+          while (end < chunk.blocks_data.size() && end - i < kMaxRun && blocks[end] == blocks[i])
+            ++end;
+          PutU16(record, static_cast<uint16_t>(end - i));
+          PutU16(record, static_cast<uint16_t>(blocks[i]));
+          ++runs;
+          i = end;
+        }
+        PutU32(record.data() + 5, runs);
+        PutU32(record.data(), Checksum(record.data() + 4, record.size() - 4));
+        return record;
+      }
+
+      /**
+       * @brief Checks the checksum and the sizes of a record.
+       * @return The number of runs, or -1 if the record is damaged.
+       */
+      int64_t CheckRecord(const uint8_t* record, size_t size)
+      {
+        if (size < kRecordHeaderSize || Checksum(record + 4, size - 4) != GetU32(record))
+          return -1;
+        const uint32_t runs = GetU32(record + 5);
+        if (record[4] >= kChunkStatusCount || size != kRecordHeaderSize + static_cast<size_t>(runs) * 4)
+          return -1;
+        return runs;
+      }
+
+      bool Decode(const std::vector<uint8_t>& record, Chunk& chunk)
+      {
+        const int64_t runs = CheckRecord(record.data(), record.size());
+        if (runs < 0)
+          return false;
+
+        std::vector<BlockId> blocks(kChunkVolume);
+        size_t filled = 0;
+        const uint8_t* in = record.data() + kRecordHeaderSize;
+        for (int64_t run = 0; run < runs; ++run, in += 4)
+        {
+          const size_t length = GetU16(in);
+          if (length > kChunkVolume - filled)
+            return false;
+          std::fill_n(blocks.begin() + static_cast<std::ptrdiff_t>(filled), length, static_cast<BlockId>(GetU16(in + 2)));
+          filled += length;
+        }
+        if (filled != kChunkVolume)
+          return false;
+
+        chunk.blocks_data = std::move(blocks);
+        chunk.status = static_cast<ChunkStatus>(record[4]);
+        return true;
+      }
+
+      bool DecodeSurface(const uint8_t* record, size_t size, ChunkSurface& surface)
+      {
+        const int64_t runs = CheckRecord(record, size);
+        if (runs < 0)
+          return false;
+
+        // Runs follow Chunk::Index: section by section, and column by column inside a
+        // section, so of the stretches of a column that are not air the last is highest.
+        surface.top.fill(kAirBlock);
+        surface.height.fill(0);
+        size_t filled = 0;
+        const uint8_t* in = record + kRecordHeaderSize;
+        for (int64_t run = 0; run < runs; ++run, in += 4)
+        {
+          const size_t length = GetU16(in);
+          const BlockId id = static_cast<BlockId>(GetU16(in + 2));
+          if (length > kChunkVolume - filled)
+            return false;
+          const size_t end = filled + length;
+          for (size_t i = filled; id != kAirBlock && i < end; i = (i | 15) + 1)
+          {
+            const size_t last = std::min(end, (i | 15) + 1) - 1;
+            const size_t column = (last >> 4) & 0xFF;
+            surface.top[column] = id;
+            surface.height[column] = static_cast<uint8_t>(((last >> 12) << 4) | (last & 15));
+          }
+          filled = end;
+        }
+        return filled == kChunkVolume;
+      }
+
+    }  // namespace
+
+    ChunkStorage::ChunkStorage(const std::string& directory)
+      : directory_(directory)
+    {
+      std::error_code error;
+      std::filesystem::create_directories(directory_, error);
+      if (error)
+        throw std::runtime_error("Failed to create chunk storage directory " + directory_ + ": " + error.message());
+    }
+
+    std::string ChunkStorage::RegionPath(int32_t region_x, int32_t region_z) const
+    {
+      return directory_ + "/r." + std::to_string(region_x) + "." + std::to_string(region_z) + ".hcr";
+    }
+
+    ChunkStorage::Region& ChunkStorage::GetRegion(int32_t region_x, int32_t region_z)
+    {
+      std::unique_ptr<Region>& region = regions_[PackChunkKey(region_x, region_z)];
+      if (region)
+        return *region;
+
+      region = std::make_unique<Region>();
+      region->end = kHeaderSize;
+      std::ifstream in(RegionPath(region_x, region_z), std::ios::binary);
+      if (!in)
+        return *region;
+
+      // A file with a bad header is treated as empty and overwritten.
+      std::vector<uint8_t> header(kHeaderSize);
+      in.read(reinterpret_cast<char*>(header.data()), kHeaderSize);
+      if (!in)
+        return *region;
+      region->legacy = std::equal(std::begin(kLegacyMagic), std::end(kLegacyMagic), header.begin());
+      if (!region->legacy && !std::equal(std::begin(kMagic), std::end(kMagic), header.begin()))
+        return *region;
+      in.seekg(0, std::ios::end);
+      const uint32_t file_size = static_cast<uint32_t>(in.tellg());
+      for (uint32_t i = 0; i < kColumns; ++i)
+      {
+        const uint8_t* entry = header.data() + sizeof(kMagic) + i * kEntrySize;
+        region->offsets[i] = GetU32(region->legacy ? header.data() + sizeof(kMagic) + i * 4 : entry);
+        region->sizes[i] = GetU32(region->legacy ? header.data() + sizeof(kMagic) + (kColumns + i) * 4 : entry + 4);
+        if (region->offsets[i] < kHeaderSize || region->offsets[i] + region->sizes[i] > file_size)
+          region->offsets[i] = region->sizes[i] = 0;
+      }
+      region->end = file_size;
+      uint32_t live = kHeaderSize;
+      for (uint32_t i = 0; i < kColumns; ++i)
+        live += region->sizes[i];
+      region->dead = file_size > live ? file_size - live : 0;
+      return *region;
+    }
+
+    bool ChunkStorage::Contains(int32_t x, int32_t z)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const Region& region = GetRegion(FloorDiv(x, kRegionWidth), FloorDiv(z, kRegionWidth));
+      return region.offsets[ColumnIndex(x, z)] != 0;
+    }
+
+    bool ChunkStorage::Load(Chunk& chunk)
+    {
+      const int32_t region_x = FloorDiv(chunk.x, kRegionWidth);
+      const int32_t region_z = FloorDiv(chunk.z, kRegionWidth);
+      std::vector<uint8_t> record;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Region& region = GetRegion(region_x, region_z);
+        const uint32_t column = ColumnIndex(chunk.x, chunk.z);
+        if (region.offsets[column] == 0)
+          return false;
+
+        std::ifstream in(RegionPath(region_x, region_z), std::ios::binary);
+        record.resize(region.sizes[column]);
+        in.seekg(region.offsets[column]);
+        in.read(reinterpret_cast<char*>(record.data()), static_cast<std::streamsize>(record.size()));
+        if (!in)
+          return false;
+      }
+      return Decode(record, chunk);
+    }
+
+    std::vector<ChunkKey> ChunkStorage::ListRegions() const
+    {
+      std::vector<ChunkKey> regions;
+      std::error_code error;
+      for (const auto& entry : std::filesystem::directory_iterator(directory_, error))
+      {
+        const std::string name = entry.path().filename().string();
+        int region_x = 0;
+        int region_z = 0;
+        // The round trip rejects other files that happen to start the same way.
+        if (std::sscanf(name.c_str(), "r.%d.%d", &region_x, &region_z) == 2 &&
+            directory_ + "/" + name == RegionPath(region_x, region_z))
+          regions.push_back(PackChunkKey(region_x, region_z));
+      }
+      std::sort(regions.begin(), regions.end());
+      return regions;
+    }
+
+    uint64_t ChunkStorage::GetRegionVersion(int32_t region_x, int32_t region_z)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const Region& region = GetRegion(region_x, region_z);
+      if (region.end == kHeaderSize)
+        return 0;
+      uint64_t hash = 0xcbf29ce484222325ull;  // FNV-1a
+      for (uint32_t i = 0; i < kColumns; ++i)
+      {
+        hash = (hash ^ region.offsets[i]) * 0x100000001b3ull;
+        hash = (hash ^ region.sizes[i]) * 0x100000001b3ull;
+      }
+      return hash == 0 ? 1 : hash;
+    }
+
+    std::vector<ChunkSurface> ChunkStorage::LoadRegionSurfaces(int32_t region_x, int32_t region_z)
+    {
+      std::array<uint32_t, kColumns> offsets;
+      std::array<uint32_t, kColumns> sizes;
+      std::vector<uint8_t> file;
+      for (;;)
+      {
+        uint32_t end;
+        uint64_t generation;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          const Region& region = GetRegion(region_x, region_z);
+          offsets = region.offsets;
+          sizes = region.sizes;
+          end = region.end;
+          generation = region.generation;
+        }
+        if (end == kHeaderSize)
+          return {};
+
+        // Records are never written over, so the bytes before end stay as they are while
+        // other threads append; the file is read without holding the lock. Compaction
+        // replaces the file instead, and the read is then done again.
+        file.resize(end);
+        std::ifstream in(RegionPath(region_x, region_z), std::ios::binary);
+        in.read(reinterpret_cast<char*>(file.data()), static_cast<std::streamsize>(file.size()));
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (GetRegion(region_x, region_z).generation != generation)
+          continue;
+        if (!in)
+          return {};
+        break;
+      }
+
+      std::vector<ChunkSurface> surfaces;
+      for (uint32_t column = 0; column < kColumns; ++column)
+      {
+        if (offsets[column] == 0)
+          continue;
+        ChunkSurface surface;
+        surface.x = region_x * kRegionWidth + static_cast<int32_t>(column % kRegionWidth);
+        surface.z = region_z * kRegionWidth + static_cast<int32_t>(column / kRegionWidth);
+        if (DecodeSurface(file.data() + offsets[column], sizes[column], surface))
+          surfaces.push_back(surface);
+      }
+      return surfaces;
+    }
+
+    void ChunkStorage::Save(const Chunk& chunk)
+    {
+      const std::vector<uint8_t> record = Encode(chunk);
+      const int32_t region_x = FloorDiv(chunk.x, kRegionWidth);
+      const int32_t region_z = FloorDiv(chunk.z, kRegionWidth);
+      const std::string path = RegionPath(region_x, region_z);
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      Region& region = GetRegion(region_x, region_z);
+      if (region.legacy && region.end != kHeaderSize && !Compact(region_x, region_z, region))
+        throw std::runtime_error("Failed to convert region file: " + path);
+
+      if (region.end == kHeaderSize)
+      {
+        // New (or unreadable) file: start it with an empty header.
+        std::vector<uint8_t> header(kHeaderSize, 0);
+        std::copy(std::begin(kMagic), std::end(kMagic), header.begin());
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(header.data()), kHeaderSize);
+        if (!out)
+          throw std::runtime_error("Failed to write region file: " + path);
+      }
+
+      std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+      const uint32_t column = ColumnIndex(chunk.x, chunk.z);
+      uint8_t entry[kEntrySize];
+      out.seekp(region.end);
+      out.write(reinterpret_cast<const char*>(record.data()), static_cast<std::streamsize>(record.size()));
+      out.flush();
+      PutU32(entry, region.end);
+      PutU32(entry + 4, static_cast<uint32_t>(record.size()));
+      out.seekp(sizeof(kMagic) + column * kEntrySize);
+      out.write(reinterpret_cast<const char*>(entry), kEntrySize);
+      out.flush();
+      if (!out)
+        throw std::runtime_error("Failed to write region file: " + path);
+
+      region.dead += region.sizes[column];
+      region.offsets[column] = region.end;
+      region.sizes[column] = static_cast<uint32_t>(record.size());
+      region.end += static_cast<uint32_t>(record.size());
+      bytes_written_ += record.size();
+
+      if (region.dead > kMinCompactBytes && region.dead > region.end - region.dead)
+        Compact(region_x, region_z, region);
+    }
+
+    bool ChunkStorage::Compact(int32_t region_x, int32_t region_z, Region& region)
+    {
+      const std::string path = RegionPath(region_x, region_z);
+      std::vector<uint8_t> file(region.end);
+      {
+        std::ifstream in(path, std::ios::binary);
+        in.read(reinterpret_cast<char*>(file.data()), static_cast<std::streamsize>(file.size()));
+        if (!in)
+          return false;
+      }
+
+      std::vector<uint8_t> compacted(kHeaderSize, 0);
+      std::copy(std::begin(kMagic), std::end(kMagic), compacted.begin());
+      std::array<uint32_t, kColumns> offsets{};
+      for (uint32_t column = 0; column < kColumns; ++column)
+      {
+        if (region.offsets[column] == 0)
+          continue;
+        offsets[column] = static_cast<uint32_t>(compacted.size());
+        PutU32(compacted.data() + sizeof(kMagic) + column * kEntrySize, offsets[column]);
+        PutU32(compacted.data() + sizeof(kMagic) + column * kEntrySize + 4, region.sizes[column]);
+        const auto record = file.begin() + region.offsets[column];
+        compacted.insert(compacted.end(), record, record + region.sizes[column]);
+      }
+
+      // Written aside and moved over the old file, so one of the two is whole at any
+      // time. On failure the old file stays, and compaction is tried again on a later save.
+      const std::string temporary = path + ".tmp";
+      {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(compacted.data()), static_cast<std::streamsize>(compacted.size()));
+        if (!out)
+        {
+          out.close();
+          std::remove(temporary.c_str());
+          return false;
+        }
+      }
+      std::error_code error;
+      std::filesystem::rename(temporary, path, error);
+      if (error)
+      {
+        std::remove(temporary.c_str());
+        return false;
+      }
+
+      region.offsets = offsets;
+      region.end = static_cast<uint32_t>(compacted.size());
+      region.dead = 0;
+      region.legacy = false;
+      ++region.generation;
+      return true;
+    }
+
+  }  // namespace world
+
+}  // namespace heh
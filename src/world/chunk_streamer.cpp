@@ -0,0 +1,982 @@
+#include "world/chunk_streamer.hpp"
+
+#include "world/light.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace heh {
+
+  namespace world {
+
+    static bool InRadius(int32_t x, int32_t z, int32_t center_x, int32_t center_z, float radius)
+    {
+      const float dx = static_cast<float>(x - center_x);
+      const float dz = static_cast<float>(z - center_z);
+      return dx * dx + dz * dz <= radius * radius;
+    }
+
+    // Chunks a mesh may stray past the edge of its level of detail ring before it is
+    // rebuilt, so moving back and forth over the edge does not rebuild it every time.
+    static constexpr float kLodHysteresis = 1.0f;
+
+    uint32_t LodForDistance(float distance, int lod_distance)
+    {
+      if (lod_distance <= 0)
+        return 0;
+      uint32_t lod = 0;
+      for (float edge = static_cast<float>(lod_distance); distance >= edge && lod < kMaxLod; edge *= 2.0f)
+        ++lod;
+      return lod;
+    }
+
+    static double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    template <typename Function>
+    void ChunkStreamer::Submit(Function&& job)
+    {
+      jobs_.Submit([this, job = std::forward<Function>(job)]() mutable {
+        if (!stopping_.load(std::memory_order_relaxed))
+          job();
+      }, &jobs_counter_);
+    }
+
+    void VelocityEstimator::AddSample(double time, const glm::vec3& pos)
+    {
+      samples_.push_back({ time, pos });
+      while (samples_.size() > 2 && time - samples_.front().time > window_)
+        samples_.pop_front();
+    }
+
+    glm::vec3 VelocityEstimator::GetVelocity() const
+    {
+      if (samples_.size() < 2)
+        return glm::vec3(0.0f);
+      const double dt = samples_.back().time - samples_.front().time;
+      if (dt < 1e-3)
+        return glm::vec3(0.0f);
+      return (samples_.back().pos - samples_.front().pos) / static_cast<float>(dt);
+    }
+
+    ChunkStreamer::ChunkStreamer(World& world, const TerrainGenerator& generator, JobSystem& jobs,
+                                 const config::WorldConfig& settings)
+      : world_(world),
+        generator_(generator),
+        render_distance_(std::max(settings.render_distance, 1)),
+        unload_margin_(std::max(settings.unload_margin, 0)),
+        lod_distance_(std::max(settings.lod_distance, 0)),
+        prefetch_lookahead_(std::max(settings.prefetch_lookahead, 0.0f)),
+        prefetch_queue_(static_cast<size_t>(std::max(settings.prefetch_queue, 0))),
+        jobs_(jobs)
+    {
+      const unsigned worker_count = std::max(jobs.GetWorkerCount(), 1u);
+      // Keep the queue short so priorities follow the camera instead of a stale backlog.
+      // Prefetching gets its own share so it is not starved while the radius is refilling.
+      max_jobs_in_flight_ = worker_count * 2;
+      max_prefetch_in_flight_ = std::max(worker_count / 2, 1u);
+    }
+
+    ChunkStreamer::~ChunkStreamer()
+    {
+      // Jobs reference this streamer and the chunks it pinned; let them all return first.
+      stopping_.store(true, std::memory_order_relaxed);
+      jobs_.Wait(jobs_counter_);
+      jobs_.Wait(saves_counter_);
+    }
+
+    void ChunkStreamer::SetAnchors(const std::vector<glm::vec3>& positions)
+    {
+      std::vector<glm::vec2> anchors;
+      anchors.reserve(positions.size());
+      for (const glm::vec3& pos : positions)
+        anchors.emplace_back(pos.x / kChunkWidth, pos.z / kChunkDepth);
+
+      // Only a change of chunk calls for a new scan.
+      auto chunk_of = [](const glm::vec2& pos) { return glm::ivec2(glm::floor(pos)); };
+      bool moved = anchors.size() != anchors_.size();
+      for (size_t i = 0; i < anchors.size() && !moved; ++i)
+        moved = chunk_of(anchors[i]) != chunk_of(anchors_[i]);
+      anchors_ = std::move(anchors);
+      if (moved)
+      {
+        scan_needed_ = true;
+        advance_needed_ = true;
+      }
+    }
+
+    bool ChunkStreamer::InAnyRadius(int32_t x, int32_t z, float radius) const
+    {
+      if (InRadius(x, z, center_x_, center_z_, radius))
+        return true;
+      for (const glm::vec2& anchor : anchors_)
+      {
+        const glm::ivec2 center(glm::floor(anchor));
+        if (InRadius(x, z, center.x, center.y, radius))
+          return true;
+      }
+      return false;
+    }
+
+    void ChunkStreamer::SetMeshing(bool enabled)
+    {
+      meshing_ = enabled;
+      advance_needed_ = true;
+    }
+
+    bool ChunkStreamer::SaveChunk(Entry& entry)
+    {
+      // Chunks without their features would be loaded back without them.
+      if (!storage_ || !entry.changed || entry.Status() < ChunkStatus::kFeatures)
+        return false;
+      entry.changed = false;
+
+      // Light and meshes are rebuilt after loading; only the blocks are kept.
+      auto copy = std::make_shared<Chunk>();
+      copy->x = entry.chunk->x;
+      copy->z = entry.chunk->z;
+      copy->status = ChunkStatus::kFeatures;
+      copy->blocks_data = entry.chunk->blocks_data;
+
+      ++stats_.saved;
+      saves_in_flight_.fetch_add(1, std::memory_order_relaxed);
+      const ChunkKey key = PackChunkKey(copy->x, copy->z);
+      {
+        // A key has one save job at a time, which writes its copies in order; a copy it
+        // has not reached yet is just replaced by the newer one.
+        std::lock_guard<std::mutex> lock(pending_saves_mutex_);
+        auto [it, added] = pending_saves_.try_emplace(key);
+        if (it->second.latest)
+          saves_in_flight_.fetch_sub(1, std::memory_order_relaxed);
+        it->second.latest = std::move(copy);
+        if (!added)
+          return true;
+      }
+      jobs_.Submit([this, key]() { WritePendingSaves(key); }, &saves_counter_);
+      return true;
+    }
+
+    void ChunkStreamer::WritePendingSaves(ChunkKey key)
+    {
+      for (;;)
+      {
+        std::shared_ptr<const Chunk> copy;
+        {
+          std::lock_guard<std::mutex> lock(pending_saves_mutex_);
+          PendingSave& pending = pending_saves_.at(key);
+          if (!pending.latest)
+          {
+            // Written: loads can go to storage again.
+            pending_saves_.erase(key);
+            return;
+          }
+          pending.writing = std::move(pending.latest);
+          copy = pending.writing;
+        }
+        try {
+          storage_->Save(*copy);
+        } catch (const std::exception& e) {
+          std::lock_guard<std::mutex> lock(results_mutex_);
+          if (save_error_.empty())
+            save_error_ = e.what();
+        }
+        saves_in_flight_.fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+
+    bool ChunkStreamer::LoadPendingSave(Chunk& chunk)
+    {
+      std::lock_guard<std::mutex> lock(pending_saves_mutex_);
+      auto it = pending_saves_.find(PackChunkKey(chunk.x, chunk.z));
+      if (it == pending_saves_.end())
+        return false;
+      const Chunk& copy = it->second.latest ? *it->second.latest : *it->second.writing;
+      chunk.blocks_data = copy.blocks_data;
+      chunk.status = copy.status;
+      return true;
+    }
+
+    void ChunkStreamer::ThrowSaveError()
+    {
+      std::string error;
+      {
+        std::lock_guard<std::mutex> lock(results_mutex_);
+        error.swap(save_error_);
+      }
+      if (!error.empty())
+        throw std::runtime_error("Failed to save chunk: " + error);
+    }
+
+    size_t ChunkStreamer::SaveChanged()
+    {
+      size_t count = 0;
+      for (auto& [key, entry] : entries_)
+      {
+        if (entry.running == ChunkStatus::kEmpty)
+          count += SaveChunk(entry) ? 1 : 0;
+      }
+      return count;
+    }
+
+    void ChunkStreamer::WaitForSaves()
+    {
+      jobs_.Wait(saves_counter_);
+      ThrowSaveError();
+    }
+
+    bool ChunkStreamer::SetBlock(const glm::ivec3& pos, BlockId id)
+    {
+      if (static_cast<uint32_t>(pos.y) >= kChunkHeight)
+        return false;
+
+      const int32_t x = BlockToChunk(pos.x);
+      const int32_t z = BlockToChunk(pos.z);
+      auto it = entries_.find(PackChunkKey(x, z));
+      // Pins mean a job of this chunk or a neighbour is reading the blocks.
+      if (it == entries_.end() || it->second.Status() < ChunkStatus::kFeatures ||
+          it->second.running != ChunkStatus::kEmpty || it->second.pins > 0)
+        return false;
+
+      // The light update writes up to one chunk away. When some of those chunks have no
+      // light yet, the lit ones are sent back through the light stage instead.
+      bool relight_in_place = true;
+      for (int dz = -1; dz <= 1; ++dz)
+      {
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+          auto neighbour = entries_.find(PackChunkKey(x + dx, z + dz));
+          if (neighbour == entries_.end() || neighbour->second.Status() < ChunkStatus::kLight)
+          {
+            relight_in_place = false;
+            continue;
+          }
+          if (neighbour->second.running != ChunkStatus::kEmpty || neighbour->second.pins > 0)
+            return false;
+        }
+      }
+
+      const BlockId old_id = world_.GetBlock(pos);
+      world_.SetBlock(pos, id);
+
+      std::vector<ChunkKey> remesh;
+      AppendMeshingChunks(pos.x, pos.z, remesh);
+      if (relight_in_place)
+        UpdateLight(world_, pos, old_id, remesh);
+      else
+      {
+        for (int dz = -1; dz <= 1; ++dz)
+        {
+          for (int dx = -1; dx <= 1; ++dx)
+          {
+            auto neighbour = entries_.find(PackChunkKey(x + dx, z + dz));
+            if (neighbour != entries_.end() && neighbour->second.Status() >= ChunkStatus::kLight)
+              neighbour->second.chunk->status = ChunkStatus::kFeatures;
+          }
+        }
+      }
+
+      RebuildMeshes(remesh);
+      advance_needed_ = true;
+      return true;
+    }
+
+    bool ChunkStreamer::EditBlocks(const BlockBox& box, const std::function<void()>& edit)
+    {
+      if (box.IsEmpty())
+        return true;
+
+      const int32_t min_x = BlockToChunk(box.min.x);
+      const int32_t max_x = BlockToChunk(box.max.x);
+      const int32_t min_z = BlockToChunk(box.min.z);
+      const int32_t max_z = BlockToChunk(box.max.z);
+
+      // Relit chunks read their neighbours; remeshed ones read theirs too.
+      for (int32_t z = min_z - 2; z <= max_z + 2; ++z)
+      {
+        for (int32_t x = min_x - 2; x <= max_x + 2; ++x)
+        {
+          auto it = entries_.find(PackChunkKey(x, z));
+          if (it != entries_.end() && (it->second.running != ChunkStatus::kEmpty || it->second.pins > 0))
+            return false;
+        }
+      }
+
+      edit();
+
+      for (int32_t z = min_z; z <= max_z; ++z)
+      {
+        for (int32_t x = min_x; x <= max_x; ++x)
+        {
+          auto it = entries_.find(PackChunkKey(x, z));
+          if (it != entries_.end())
+            it->second.changed = true;
+        }
+      }
+
+      for (int32_t z = min_z - 2; z <= max_z + 2; ++z)
+      {
+        for (int32_t x = min_x - 2; x <= max_x + 2; ++x)
+        {
+          auto it = entries_.find(PackChunkKey(x, z));
+          if (it == entries_.end())
+            continue;
+          const bool relight = x >= min_x - 1 && x <= max_x + 1 && z >= min_z - 1 && z <= max_z + 1;
+          if (relight && it->second.Status() >= ChunkStatus::kLight)
+            it->second.chunk->status = ChunkStatus::kFeatures;
+          else if (it->second.Status() >= ChunkStatus::kMeshed)
+            it->second.chunk->status = ChunkStatus::kLight;
+        }
+      }
+      advance_needed_ = true;
+      return true;
+    }
+
+    std::vector<ChunkKey> ChunkStreamer::GetEditableChunks() const
+    {
+      auto editable = [this](int32_t x, int32_t z) {
+        auto it = entries_.find(PackChunkKey(x, z));
+        return it != entries_.end() && it->second.Status() >= ChunkStatus::kLight &&
+               it->second.running == ChunkStatus::kEmpty && it->second.pins == 0;
+      };
+
+      std::vector<ChunkKey> keys;
+      for (const auto& [key, entry] : entries_)
+      {
+        if (entry.Status() < ChunkStatus::kLight)
+          continue;
+        const int32_t x = entry.chunk->x;
+        const int32_t z = entry.chunk->z;
+        bool idle = true;
+        for (int dz = -1; dz <= 1 && idle; ++dz)
+        {
+          for (int dx = -1; dx <= 1 && idle; ++dx)
+            idle = editable(x + dx, z + dz);
+        }
+        if (idle)
+          keys.push_back(key);
+      }
+      return keys;
+    }
+
+    void ChunkStreamer::RebuildMeshes(const std::vector<ChunkKey>& keys)
+    {
+      for (ChunkKey key : keys)
+      {
+        auto it = entries_.find(key);
+        if (it != entries_.end())
+          it->second.changed = true;
+      }
+      RemeshChunks(keys);
+    }
+
+    void ChunkStreamer::RemeshChunks(const std::vector<ChunkKey>& keys)
+    {
+      for (ChunkKey key : keys)
+      {
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.Status() >= ChunkStatus::kMeshed)
+        {
+          it->second.chunk->status = ChunkStatus::kLight;
+          advance_needed_ = true;
+        }
+      }
+    }
+
+    void ChunkStreamer::SetRenderDistance(int render_distance)
+    {
+      render_distance_ = std::max(render_distance, 1);
+      scan_needed_ = true;
+      advance_needed_ = true;
+    }
+
+    void ChunkStreamer::Update(const glm::vec3& camera_pos, const glm::vec3& camera_front, double time)
+    {
+      ThrowSaveError();
+      velocity_.AddSample(time, camera_pos);
+
+      camera_chunk_pos_ = glm::vec2(camera_pos.x / kChunkWidth, camera_pos.z / kChunkDepth);
+      const glm::vec2 front(camera_front.x, camera_front.z);
+      if (glm::dot(front, front) > 1e-6f)
+        camera_dir_ = glm::normalize(front);
+
+      const int32_t center_x = static_cast<int32_t>(std::floor(camera_chunk_pos_.x));
+      const int32_t center_z = static_cast<int32_t>(std::floor(camera_chunk_pos_.y));
+      bool center_changed = false;
+      if (center_x != center_x_ || center_z != center_z_ || first_update_)
+      {
+        const int32_t old_x = center_x_;
+        const int32_t old_z = center_z_;
+        center_x_ = center_x;
+        center_z_ = center_z;
+        scan_needed_ = true;
+        advance_needed_ = true;
+        center_changed = true;
+        if (!first_update_)
+          CountEnteringChunks(old_x, old_z);
+        first_update_ = false;
+      }
+
+      // Without workers the stages run here, a frame behind.
+      if (jobs_.GetWorkerCount() == 0)
+      {
+        while (jobs_.TryRunOne())
+        {
+        }
+      }
+
+      DrainCompletedJobs();
+
+      // Re-plan the predicted path when the camera changes chunk and a few times a second
+      // in between, so turning cancels prefetches quickly.
+      if (center_changed || time - last_prefetch_time_ >= 0.25)
+      {
+        last_prefetch_time_ = time;
+        UpdatePrefetchTargets();
+      }
+
+      UnloadFarChunks();
+      if (center_changed)
+        UpdateLods();
+      AdvanceStages();
+      QueueGeneration();
+      QueuePrefetch();
+
+      // Workers only touch chunks they were handed (and pinned), never the map itself,
+      // so unloaded chunks can be freed right away.
+      world_.ReclaimRetired();
+    }
+
+    std::vector<ChunkStreamer::MeshUpload> ChunkStreamer::PopReadyMeshes(size_t max_count)
+    {
+      // Drop meshes of chunks that were unloaded while waiting.
+      ready_meshes_.erase(std::remove_if(ready_meshes_.begin(), ready_meshes_.end(),
+        [this](const MeshUpload& mesh) {
+          auto it = entries_.find(PackChunkKey(mesh.x, mesh.z));
+          return it == entries_.end() || it->second.Status() != ChunkStatus::kMeshed;
+        }),
+        ready_meshes_.end());
+
+      std::sort(ready_meshes_.begin(), ready_meshes_.end(), [this](const MeshUpload& a, const MeshUpload& b) {
+        return Priority(a.x, a.z) > Priority(b.x, b.z);
+      });
+
+      // Nearest meshes are at the back; take them from there.
+      std::vector<MeshUpload> out;
+      while (!ready_meshes_.empty() && out.size() < max_count)
+      {
+        entries_[PackChunkKey(ready_meshes_.back().x, ready_meshes_.back().z)].chunk->status = ChunkStatus::kUploaded;
+        out.push_back(std::move(ready_meshes_.back()));
+        ready_meshes_.pop_back();
+      }
+      return out;
+    }
+
+    std::array<size_t, kChunkStatusCount> ChunkStreamer::CountByStatus() const
+    {
+      std::array<size_t, kChunkStatusCount> counts{};
+      for (const auto& [key, entry] : entries_)
+        ++counts[static_cast<size_t>(entry.Status())];
+      return counts;
+    }
+
+    std::vector<ChunkKey> ChunkStreamer::PopUnloaded()
+    {
+      std::vector<ChunkKey> out;
+      out.swap(unloaded_);
+      return out;
+    }
+
+    float ChunkStreamer::Priority(int32_t x, int32_t z) const
+    {
+      // Lower is more urgent: squared distance, halved straight ahead and raised by half behind.
+      // Anchors have no direction; only their distance counts.
+      float anchor_dist2 = std::numeric_limits<float>::max();
+      for (const glm::vec2& anchor : anchors_)
+      {
+        const glm::vec2 to_chunk = glm::vec2(x + 0.5f, z + 0.5f) - anchor;
+        anchor_dist2 = std::min(anchor_dist2, glm::dot(to_chunk, to_chunk));
+      }
+
+      const glm::vec2 to_chunk = glm::vec2(x + 0.5f, z + 0.5f) - camera_chunk_pos_;
+      const float dist2 = glm::dot(to_chunk, to_chunk);
+      if (dist2 < 2.0f)
+        return std::min(dist2, anchor_dist2);
+      const float facing = glm::dot(to_chunk, camera_dir_) / std::sqrt(dist2);
+      return std::min(dist2 * (1.0f - 0.5f * facing), anchor_dist2);
+    }
+
+    float ChunkStreamer::NearestDistance(int32_t x, int32_t z) const
+    {
+      auto distance2 = [x, z](int32_t center_x, int32_t center_z) {
+        const float dx = static_cast<float>(x - center_x);
+        const float dz = static_cast<float>(z - center_z);
+        return dx * dx + dz * dz;
+      };
+      float nearest2 = distance2(center_x_, center_z_);
+      for (const glm::vec2& anchor : anchors_)
+      {
+        const glm::ivec2 center(glm::floor(anchor));
+        nearest2 = std::min(nearest2, distance2(center.x, center.y));
+      }
+      return std::sqrt(nearest2);
+    }
+
+    ChunkStatus ChunkStreamer::TargetStatus(int32_t x, int32_t z) const
+    {
+      const float distance = NearestDistance(x, z);
+      const ChunkStatus last = meshing_ ? ChunkStatus::kMeshed : ChunkStatus::kLight;
+      for (ChunkStatus status = last; status != ChunkStatus::kEmpty;
+           status = static_cast<ChunkStatus>(static_cast<uint8_t>(status) - 1))
+      {
+        if (distance <= static_cast<float>(render_distance_) + StageMargin(status))
+          return status;
+      }
+      return ChunkStatus::kEmpty;
+    }
+
+    bool ChunkStreamer::NeighboursReady(int32_t x, int32_t z, const StageSpec& spec) const
+    {
+      for (int dz = -spec.neighbour_radius; dz <= spec.neighbour_radius; ++dz)
+      {
+        for (int dx = -spec.neighbour_radius; dx <= spec.neighbour_radius; ++dx)
+        {
+          auto it = entries_.find(PackChunkKey(x + dx, z + dz));
+          if (it == entries_.end() || it->second.Status() < spec.neighbour_status)
+            return false;
+        }
+      }
+      return true;
+    }
+
+    bool ChunkStreamer::NeighbourRunning(int32_t x, int32_t z, const StageSpec& spec) const
+    {
+      for (int dz = -spec.neighbour_radius; dz <= spec.neighbour_radius; ++dz)
+      {
+        for (int dx = -spec.neighbour_radius; dx <= spec.neighbour_radius; ++dx)
+        {
+          auto it = entries_.find(PackChunkKey(x + dx, z + dz));
+          if (it != entries_.end() && it->second.running == spec.stage)
+            return true;
+        }
+      }
+      return false;
+    }
+
+    void ChunkStreamer::PinArea(int32_t x, int32_t z, int radius, int delta)
+    {
+      for (int dz = -radius; dz <= radius; ++dz)
+      {
+        for (int dx = -radius; dx <= radius; ++dx)
+        {
+          auto it = entries_.find(PackChunkKey(x + dx, z + dz));
+          if (it != entries_.end())
+            it->second.pins += delta;
+        }
+      }
+    }
+
+    void ChunkStreamer::DrainCompletedJobs()
+    {
+      std::vector<StageResult> results;
+      {
+        std::lock_guard<std::mutex> lock(results_mutex_);
+        results.swap(results_);
+      }
+      if (!results.empty())
+        advance_needed_ = true;
+
+      for (StageResult& result : results)
+      {
+        const ChunkKey key = PackChunkKey(result.x, result.z);
+
+        if (result.stage == ChunkStatus::kTerrain)
+        {
+          --generating_;
+          if (result.prefetch)
+            --prefetching_;
+          if (!result.chunk)
+            continue;
+
+          auto it = entries_.find(key);
+          // Chunks that went out of range while generating were forgotten; drop them.
+          if (it == entries_.end() || it->second.running != ChunkStatus::kTerrain)
+            continue;
+          stage_timings_[static_cast<size_t>(ChunkStatus::kTerrain)].Add(result.seconds);
+          stats_.loaded += result.loaded ? 1 : 0;
+          it->second.chunk = world_.InsertChunk(std::move(result.chunk));
+          it->second.running = ChunkStatus::kEmpty;
+          it->second.changed = !result.loaded;
+          continue;
+        }
+
+        // The chunk and its neighbours were pinned, so they are all still here.
+        --running_;
+        Entry& entry = entries_[key];
+        PinArea(result.x, result.z, GetStageSpec(result.stage).neighbour_radius, -1);
+        entry.running = ChunkStatus::kEmpty;
+        entry.chunk->status = result.stage;
+        stage_timings_[static_cast<size_t>(result.stage)].Add(result.seconds);
+
+        if (result.stage == ChunkStatus::kMeshed)
+          ready_meshes_.push_back({ result.x, result.z, std::move(result.mesh) });
+      }
+    }
+
+    void ChunkStreamer::UnloadFarChunks()
+    {
+      const float keep_radius = TerrainRadius() + static_cast<float>(unload_margin_);
+
+      for (auto it = entries_.begin(); it != entries_.end();)
+      {
+        const int32_t x = ChunkKeyX(it->first);
+        const int32_t z = ChunkKeyZ(it->first);
+        // Prefetched chunks stay as long as they are on the predicted path.
+        if (it->second.prefetch)
+        {
+          ++it;
+          continue;
+        }
+
+        if (InAnyRadius(x, z, keep_radius) || it->second.pins > 0)
+        {
+          ++it;
+          continue;
+        }
+
+        if (it->second.chunk)
+        {
+          SaveChunk(it->second);
+          world_.UnloadChunk(x, z);
+          unloaded_.push_back(it->first);
+        }
+        it = entries_.erase(it);
+      }
+    }
+
+    void ChunkStreamer::UpdateLods()
+    {
+      if (!meshing_)
+        return;
+      for (auto& [key, entry] : entries_)
+      {
+        if (entry.Status() < ChunkStatus::kMeshed || entry.running != ChunkStatus::kEmpty)
+          continue;
+        const float distance = NearestDistance(ChunkKeyX(key), ChunkKeyZ(key));
+        if (entry.lod >= LodForDistance(distance - kLodHysteresis, lod_distance_) &&
+            entry.lod <= LodForDistance(distance + kLodHysteresis, lod_distance_))
+          continue;
+        // The old mesh stays drawn until the new one is uploaded in its place.
+        entry.chunk->status = ChunkStatus::kLight;
+        advance_needed_ = true;
+        ++stats_.lod_changed;
+      }
+    }
+
+    void ChunkStreamer::CountEnteringChunks(int32_t old_x, int32_t old_z)
+    {
+      const int32_t radius = render_distance_;
+      for (int32_t dz = -radius; dz <= radius; ++dz)
+      {
+        for (int32_t dx = -radius; dx <= radius; ++dx)
+        {
+          const int32_t x = center_x_ + dx;
+          const int32_t z = center_z_ + dz;
+          if (!InRadius(x, z, center_x_, center_z_, radius) || InRadius(x, z, old_x, old_z, radius))
+            continue;
+
+          ++stats_.entered_view;
+          auto it = entries_.find(PackChunkKey(x, z));
+          if (it != entries_.end() && it->second.chunk)
+            ++stats_.ready_on_entry;
+        }
+      }
+    }
+
+    void ChunkStreamer::UpdatePrefetchTargets()
+    {
+      prefetch_targets_.clear();
+
+      const glm::vec3 velocity = velocity_.GetVelocity();
+      const glm::vec2 chunk_velocity(velocity.x / kChunkWidth, velocity.z / kChunkDepth);
+      const float speed = glm::length(chunk_velocity);
+
+      // Below a quarter chunk per second the regular radius keeps up on its own.
+      if (prefetch_lookahead_ > 0.0f && prefetch_queue_ > 0 && speed > 0.25f)
+      {
+        const float load_radius = TerrainRadius();
+        const int32_t extent = static_cast<int32_t>(load_radius);
+        // Step the predicted path half a chunk at a time, at most a quarter second apart.
+        const float step = std::min(0.25f, 0.5f / speed);
+
+        std::unordered_map<ChunkKey, float> found;
+        for (float t = step; t <= prefetch_lookahead_ && found.size() < prefetch_queue_; t += step)
+        {
+          const glm::vec2 predicted = camera_chunk_pos_ + chunk_velocity * t;
+          const int32_t px = static_cast<int32_t>(std::floor(predicted.x));
+          const int32_t pz = static_cast<int32_t>(std::floor(predicted.y));
+
+          for (int32_t dz = -extent; dz <= extent; ++dz)
+          {
+            for (int32_t dx = -extent; dx <= extent; ++dx)
+            {
+              const int32_t x = px + dx;
+              const int32_t z = pz + dz;
+              if (!InRadius(x, z, px, pz, load_radius) || InRadius(x, z, center_x_, center_z_, load_radius))
+                continue;
+              found.emplace(PackChunkKey(x, z), t);
+            }
+          }
+        }
+
+        for (const auto& [key, t] : found)
+        {
+          // Among chunks reached at the same step, the ones closest to the path come first.
+          const glm::vec2 to_chunk = glm::vec2(ChunkKeyX(key) + 0.5f, ChunkKeyZ(key) + 0.5f) - camera_chunk_pos_;
+          prefetch_targets_.emplace_back(t + 1e-3f * glm::length(to_chunk - chunk_velocity * t), key);
+        }
+        std::sort(prefetch_targets_.begin(), prefetch_targets_.end());
+        if (prefetch_targets_.size() > prefetch_queue_)
+          prefetch_targets_.resize(prefetch_queue_);
+      }
+
+      // Cancel prefetches that are no longer on the predicted path.
+      std::unordered_map<ChunkKey, float> wanted(prefetch_targets_.size());
+      for (const auto& [t, key] : prefetch_targets_)
+        wanted.emplace(key, t);
+
+      const float load_radius = TerrainRadius();
+      for (auto it = entries_.begin(); it != entries_.end();)
+      {
+        if (!it->second.prefetch)
+        {
+          ++it;
+          continue;
+        }
+
+        // A prefetched chunk becomes a regular one once it enters the load radius.
+        if (InRadius(ChunkKeyX(it->first), ChunkKeyZ(it->first), center_x_, center_z_, load_radius))
+        {
+          it->second.prefetch = false;
+          it->second.cancel.reset();
+          ++stats_.prefetch_used;
+          ++it;
+          continue;
+        }
+
+        if (wanted.count(it->first) || it->second.pins > 0)
+        {
+          ++it;
+          continue;
+        }
+
+        if (!it->second.chunk)
+          it->second.cancel->store(true, std::memory_order_relaxed);
+        else
+        {
+          SaveChunk(it->second);
+          world_.UnloadChunk(ChunkKeyX(it->first), ChunkKeyZ(it->first));
+          unloaded_.push_back(it->first);
+        }
+        ++stats_.prefetch_cancelled;
+        it = entries_.erase(it);
+      }
+    }
+
+    void ChunkStreamer::QueuePrefetch()
+    {
+      for (const auto& [t, key] : prefetch_targets_)
+      {
+        if (prefetching_ >= max_prefetch_in_flight_)
+          break;
+        if (entries_.find(key) != entries_.end())
+          continue;
+
+        Entry& entry = entries_[key];
+        entry.running = ChunkStatus::kTerrain;
+        entry.prefetch = true;
+        entry.cancel = std::make_shared<std::atomic<bool>>(false);
+        ++prefetching_;
+        ++stats_.prefetch_requested;
+        SubmitGeneration(key, entry.cancel);
+      }
+    }
+
+    void ChunkStreamer::AdvanceStages()
+    {
+      if (!advance_needed_)
+        return;
+      advance_needed_ = false;
+
+      std::vector<std::pair<float, ChunkKey>> candidates;
+      for (const auto& [key, entry] : entries_)
+      {
+        if (!entry.chunk || entry.running != ChunkStatus::kEmpty || entry.Status() >= ChunkStatus::kMeshed)
+          continue;
+        const int32_t x = ChunkKeyX(key);
+        const int32_t z = ChunkKeyZ(key);
+        const ChunkStatus next = NextStatus(entry.Status());
+        if (TargetStatus(x, z) < next || !NeighboursReady(x, z, GetStageSpec(next)))
+          continue;
+        candidates.emplace_back(Priority(x, z), key);
+      }
+
+      std::sort(candidates.begin(), candidates.end());
+      for (const auto& [priority, key] : candidates)
+      {
+        const int32_t x = ChunkKeyX(key);
+        const int32_t z = ChunkKeyZ(key);
+        Entry& entry = entries_[key];
+        const StageSpec& spec = GetStageSpec(NextStatus(entry.Status()));
+
+        // May have started on a neighbour earlier in this pass; retry next Update.
+        if (spec.exclusive && NeighbourRunning(x, z, spec))
+        {
+          advance_needed_ = true;
+          continue;
+        }
+
+        if (GetJobsInFlight() >= max_jobs_in_flight_)
+        {
+          advance_needed_ = true;
+          break;
+        }
+        SubmitStage(key, spec.stage);
+      }
+    }
+
+    void ChunkStreamer::QueueGeneration()
+    {
+      if (!scan_needed_ || GetJobsInFlight() >= max_jobs_in_flight_)
+        return;
+
+      const float load_radius = TerrainRadius();
+      const int32_t extent = static_cast<int32_t>(load_radius);
+
+      std::vector<glm::ivec2> centers{ glm::ivec2(center_x_, center_z_) };
+      for (const glm::vec2& anchor : anchors_)
+        centers.emplace_back(glm::floor(anchor));
+
+      std::vector<std::pair<float, ChunkKey>> candidates;
+      for (const glm::ivec2& center : centers)
+      {
+        for (int32_t dz = -extent; dz <= extent; ++dz)
+        {
+          for (int32_t dx = -extent; dx <= extent; ++dx)
+          {
+            if (!InRadius(center.x + dx, center.y + dz, center.x, center.y, load_radius))
+              continue;
+            const ChunkKey key = PackChunkKey(center.x + dx, center.y + dz);
+            if (entries_.find(key) == entries_.end())
+              candidates.emplace_back(Priority(center.x + dx, center.y + dz), key);
+          }
+        }
+      }
+
+      if (candidates.empty())
+      {
+        scan_needed_ = false;
+        return;
+      }
+
+      // Anchors close to each other find the same chunks.
+      std::sort(candidates.begin(), candidates.end());
+      candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+      for (const auto& [priority, key] : candidates)
+      {
+        if (GetJobsInFlight() >= max_jobs_in_flight_)
+          break;
+
+        entries_[key].running = ChunkStatus::kTerrain;
+        SubmitGeneration(key, nullptr);
+      }
+    }
+
+    void ChunkStreamer::SubmitGeneration(ChunkKey key, std::shared_ptr<std::atomic<bool>> cancel)
+    {
+      ++generating_;
+
+      const int32_t x = ChunkKeyX(key);
+      const int32_t z = ChunkKeyZ(key);
+      Submit([this, x, z, cancel]() {
+        const auto start = std::chrono::steady_clock::now();
+        StageResult result{ x, z, ChunkStatus::kTerrain, nullptr, nullptr };
+        result.prefetch = cancel != nullptr;
+        if (!cancel || !cancel->load(std::memory_order_relaxed))
+        {
+          result.chunk = std::make_unique<Chunk>();
+          result.chunk->x = x;
+          result.chunk->z = z;
+          // Stored chunks already have their features; light is not stored. A save still
+          // on its way to storage is newer than what storage holds.
+          result.loaded = storage_ && (LoadPendingSave(*result.chunk) || storage_->Load(*result.chunk));
+          if (result.loaded)
+            result.chunk->status = std::clamp(result.chunk->status, ChunkStatus::kTerrain, ChunkStatus::kFeatures);
+          else
+          {
+            generator_.Generate(*result.chunk);
+            result.chunk->status = ChunkStatus::kTerrain;
+          }
+        }
+        result.seconds = SecondsSince(start);
+        std::lock_guard<std::mutex> lock(results_mutex_);
+        results_.push_back(std::move(result));
+      });
+    }
+
+    void ChunkStreamer::SubmitStage(ChunkKey key, ChunkStatus stage)
+    {
+      ++running_;
+
+      const int32_t x = ChunkKeyX(key);
+      const int32_t z = ChunkKeyZ(key);
+      const int radius = GetStageSpec(stage).neighbour_radius;
+
+      Entry& entry = entries_[key];
+      entry.running = stage;
+      PinArea(x, z, radius, 1);
+
+      if (stage == ChunkStatus::kMeshed)
+        entry.lod = static_cast<uint8_t>(LodForDistance(NearestDistance(x, z), lod_distance_));
+      const uint32_t lod = entry.lod;
+
+      Chunk* chunk = entry.chunk;
+      ChunkNeighbourhood area;
+      for (int dz = -1; dz <= 1; ++dz)
+      {
+        for (int dx = -1; dx <= 1; ++dx)
+          area.chunks[(dz + 1) * 3 + (dx + 1)] = (dx == 0 && dz == 0) || radius > 0 ? world_.GetChunk(x + dx, z + dz) : nullptr;
+      }
+
+      Submit([this, x, z, stage, chunk, area, lod]() {
+        const auto start = std::chrono::steady_clock::now();
+        StageResult result{ x, z, stage, nullptr, nullptr };
+        switch (stage)
+        {
+        case ChunkStatus::kFeatures:
+          generator_.PlaceFeatures(*chunk, area);
+          break;
+        case ChunkStatus::kLight:
+          ComputeLight(*chunk, area);
+          break;
+        case ChunkStatus::kMeshed:
+          result.mesh = chunk->BuildLodMesh(area, lod);
+          break;
+        default:
+          break;
+        }
+        result.seconds = SecondsSince(start);
+        std::lock_guard<std::mutex> lock(results_mutex_);
+        results_.push_back(std::move(result));
+      });
+    }
+
+  }  // namespace world
+
+}  // namespace heh
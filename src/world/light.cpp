@@ -0,0 +1,416 @@
+#include "world/light.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace heh {
+
+  namespace world {
+
+    namespace {
+
+      // ComputeLight floods a region of 3x3 chunks; the center chunk starts at kRegionOffset.
+      constexpr int kRegionWidth = 3 * static_cast<int>(kChunkWidth);
+      constexpr int kRegionOffset = static_cast<int>(kChunkWidth);
+      constexpr int kRegionLayer = kRegionWidth * kRegionWidth;
+
+      struct RegionScratch {
+        std::vector<uint8_t> opaque;
+        std::vector<uint8_t> sky;
+        std::vector<uint8_t> block;
+        std::vector<uint32_t> queue;
+      };
+
+      // One per thread: light jobs run on every worker at once.
+      thread_local RegionScratch region_scratch;
+
+      /**
+       * @brief Breadth-first flood of light over the region, from the cells in queue.
+       * Sky light keeps level 15 going down.
+       */
+      void FloodRegion(std::vector<uint8_t>& light, const std::vector<uint8_t>& opaque,
+                       std::vector<uint32_t>& queue, int top, bool sky)
+      {
+        auto spread = [&](uint32_t cell, uint8_t level) {
+          if (!opaque[cell] && light[cell] < level)
+          {
+            light[cell] = level;
+            queue.push_back(cell);
+          }
+        };
+
+        for (size_t head = 0; head < queue.size(); ++head)
+        {
+          const uint32_t cell = queue[head];
+          const uint8_t level = light[cell];
+          if (level <= 1)
+            continue;
+
+          const int x = static_cast<int>(cell % kRegionWidth);
+          const int z = static_cast<int>(cell / kRegionWidth % kRegionWidth);
+          const int y = static_cast<int>(cell / kRegionLayer);
+          const uint8_t next = level - 1;
+
+          if (x > 0) spread(cell - 1, next);
+          if (x < kRegionWidth - 1) spread(cell + 1, next);
+          if (z > 0) spread(cell - kRegionWidth, next);
+          if (z < kRegionWidth - 1) spread(cell + kRegionWidth, next);
+          if (y > 0) spread(cell - kRegionLayer, sky && level == kMaxLight ? level : next);
+          if (y < top - 1) spread(cell + kRegionLayer, next);
+        }
+        queue.clear();
+      }
+
+      /**
+       * @brief The chunks within one chunk of an edit, addressed with positions local to the
+       * center chunk (x and z in [-16, 32)). Cells are packed as y << 12 | (z + 16) << 6 | (x + 16).
+       */
+      class EditArea {
+      public:
+        EditArea(World& world, int32_t chunk_x, int32_t chunk_z)
+          : chunk_x_(chunk_x), chunk_z_(chunk_z)
+        {
+          for (int dz = -1; dz <= 1; ++dz)
+          {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+              Chunk* chunk = world.GetChunk(chunk_x + dx, chunk_z + dz);
+              chunks_[(dz + 1) * 3 + (dx + 1)] = chunk && !chunk->light_data.empty() ? chunk : nullptr;
+            }
+          }
+        }
+
+        static uint32_t Pack(int x, int y, int z)
+        {
+          return static_cast<uint32_t>(y) << 12 | static_cast<uint32_t>(z + kRegionOffset) << 6 | static_cast<uint32_t>(x + kRegionOffset);
+        }
+
+        static int UnpackX(uint32_t cell) { return static_cast<int>(cell & 63) - kRegionOffset; }
+        static int UnpackY(uint32_t cell) { return static_cast<int>(cell >> 12); }
+        static int UnpackZ(uint32_t cell) { return static_cast<int>((cell >> 6) & 63) - kRegionOffset; }
+
+        /**
+         * @brief The chunk holding a local position, nullptr outside the area or the world.
+         */
+        Chunk* Get(int x, int y, int z) const
+        {
+          if (x < -kRegionOffset || x >= kRegionWidth - kRegionOffset || z < -kRegionOffset ||
+              z >= kRegionWidth - kRegionOffset || y < 0 || y >= static_cast<int>(kChunkHeight))
+            return nullptr;
+          return chunks_[((z >> 4) + 1) * 3 + ((x >> 4) + 1)];
+        }
+
+        static uint32_t Index(int x, int y, int z)
+        {
+          return Chunk::Index(static_cast<uint32_t>(x) & 15u, static_cast<uint32_t>(y), static_cast<uint32_t>(z) & 15u);
+        }
+
+        /**
+         * @brief Notes that the light at a local position changed.
+         */
+        void MarkDirty(int x, int z)
+        {
+          const int cx = x >> 4;
+          const int cz = z >> 4;
+          const int lx = x & 15;
+          const int lz = z & 15;
+          for (int dz = lz == 0 ? -1 : 0; dz <= (lz == 15 ? 1 : 0); ++dz)
+          {
+            for (int dx = lx == 0 ? -1 : 0; dx <= (lx == 15 ? 1 : 0); ++dx)
+              dirty_[static_cast<size_t>((cz + dz + 2) * 5 + (cx + dx + 2))] = true;
+          }
+        }
+
+        void AppendDirty(std::vector<ChunkKey>& out) const
+        {
+          for (int dz = -2; dz <= 2; ++dz)
+          {
+            for (int dx = -2; dx <= 2; ++dx)
+            {
+              if (dirty_[static_cast<size_t>((dz + 2) * 5 + (dx + 2))])
+                out.push_back(PackChunkKey(chunk_x_ + dx, chunk_z_ + dz));
+            }
+          }
+        }
+
+      private:
+        std::array<Chunk*, 9> chunks_;
+        int32_t chunk_x_;
+        int32_t chunk_z_;
+        std::array<bool, 25> dirty_{};  ///< Chunks within two of the center whose meshes show changed light.
+      };
+
+      struct RemovedLight {
+        uint32_t cell;
+        uint8_t level;
+      };
+
+      constexpr int kDirections[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, 1, 0 }, { 0, -1, 0 } };
+      constexpr int kDown = 5;
+
+      /**
+       * @brief Incremental update of one light channel (shift 4: sky, 0: block) around cell.
+       */
+      void RelightChannel(EditArea& area, int px, int py, int pz, int shift, bool was_opaque)
+      {
+        const bool sky = shift == 4;
+        auto get = [shift](const Chunk* chunk, uint32_t index) -> uint8_t {
+          return static_cast<uint8_t>((chunk->light_data[index] >> shift) & 15);
+        };
+        auto set = [shift](Chunk* chunk, uint32_t index, uint8_t level) {
+          uint8_t& packed = chunk->light_data[index];
+          packed = static_cast<uint8_t>((packed & ~(15 << shift)) | (level << shift));
+        };
+
+        static thread_local std::vector<RemovedLight> removed;
+        static thread_local std::vector<uint32_t> added;
+        removed.clear();
+        added.clear();
+
+        Chunk* center = area.Get(px, py, pz);
+        const uint32_t center_index = EditArea::Index(px, py, pz);
+        const BlockId id = center->blocks_data[center_index];
+        const bool opaque = block_map::IsOpaque(id);
+
+        // Whatever reached the old block is taken back; the refill below restores what still can.
+        const uint8_t old_level = get(center, center_index);
+        if (old_level > 0)
+        {
+          set(center, center_index, 0);
+          area.MarkDirty(px, pz);
+          removed.push_back({ EditArea::Pack(px, py, pz), old_level });
+        }
+
+        for (size_t head = 0; head < removed.size(); ++head)
+        {
+          const RemovedLight node = removed[head];
+          const int x = EditArea::UnpackX(node.cell);
+          const int y = EditArea::UnpackY(node.cell);
+          const int z = EditArea::UnpackZ(node.cell);
+          for (int dir = 0; dir < 6; ++dir)
+          {
+            const int nx = x + kDirections[dir][0];
+            const int ny = y + kDirections[dir][1];
+            const int nz = z + kDirections[dir][2];
+            Chunk* chunk = area.Get(nx, ny, nz);
+            if (!chunk)
+              continue;
+            const uint32_t index = EditArea::Index(nx, ny, nz);
+            const uint8_t level = get(chunk, index);
+            if (level == 0)
+              continue;
+
+            // Dimmer neighbours, and sky columns below a removed 15, were lit through this cell.
+            if (level < node.level || (sky && dir == kDown && node.level == kMaxLight && level == kMaxLight))
+            {
+              set(chunk, index, 0);
+              area.MarkDirty(nx, nz);
+              removed.push_back({ EditArea::Pack(nx, ny, nz), level });
+
+              const uint8_t emission = sky ? 0 : block_map::GetEmission(chunk->blocks_data[index]);
+              if (emission > 0)
+              {
+                set(chunk, index, emission);
+                added.push_back(EditArea::Pack(nx, ny, nz));
+              }
+            }
+            else
+              added.push_back(EditArea::Pack(nx, ny, nz));
+          }
+        }
+
+        // Seed the refill from the new block and, if light can now pass, from around it.
+        const uint8_t emission = sky ? 0 : block_map::GetEmission(id);
+        if (emission > get(center, center_index))
+        {
+          set(center, center_index, emission);
+          area.MarkDirty(px, pz);
+          added.push_back(EditArea::Pack(px, py, pz));
+        }
+        if (!opaque && was_opaque)
+        {
+          if (sky && py == static_cast<int>(kChunkHeight) - 1)
+          {
+            set(center, center_index, kMaxLight);
+            area.MarkDirty(px, pz);
+            added.push_back(EditArea::Pack(px, py, pz));
+          }
+          for (const auto& d : kDirections)
+          {
+            if (area.Get(px + d[0], py + d[1], pz + d[2]))
+              added.push_back(EditArea::Pack(px + d[0], py + d[1], pz + d[2]));
+          }
+        }
+
+        for (size_t head = 0; head < added.size(); ++head)
+        {
+          const uint32_t cell = added[head];
+          const int x = EditArea::UnpackX(cell);
+          const int y = EditArea::UnpackY(cell);
+          const int z = EditArea::UnpackZ(cell);
+          const uint8_t level = get(area.Get(x, y, z), EditArea::Index(x, y, z));
+          if (level <= 1)
+            continue;
+
+          for (int dir = 0; dir < 6; ++dir)
+          {
+            const int nx = x + kDirections[dir][0];
+            const int ny = y + kDirections[dir][1];
+            const int nz = z + kDirections[dir][2];
+            Chunk* chunk = area.Get(nx, ny, nz);
+            if (!chunk)
+              continue;
+            const uint32_t index = EditArea::Index(nx, ny, nz);
+            if (block_map::IsOpaque(chunk->blocks_data[index]))
+              continue;
+
+            const uint8_t next = sky && dir == kDown && level == kMaxLight ? level : static_cast<uint8_t>(level - 1);
+            if (get(chunk, index) < next)
+            {
+              set(chunk, index, next);
+              area.MarkDirty(nx, nz);
+              added.push_back(EditArea::Pack(nx, ny, nz));
+            }
+          }
+        }
+      }
+
+    }  // namespace
+
+    void ComputeLight(Chunk& chunk, const ChunkNeighbourhood& area)
+    {
+      RegionScratch& scratch = region_scratch;
+
+      // Highest opaque block of every column (-1 if none) and the highest block of any kind.
+      std::array<int16_t, kRegionLayer> heights;
+      int highest_block = -1;
+      for (int z = 0; z < kRegionWidth; ++z)
+      {
+        for (int x = 0; x < kRegionWidth; ++x)
+        {
+          int16_t height = -1;
+          const Chunk* column_chunk = area.Get((x >> 4) - 1, (z >> 4) - 1);
+          if (column_chunk)
+          {
+            const uint32_t lx = static_cast<uint32_t>(x) & 15u;
+            const uint32_t lz = static_cast<uint32_t>(z) & 15u;
+            for (int y = static_cast<int>(kChunkHeight) - 1; y >= 0; --y)
+            {
+              const BlockId id = column_chunk->GetBlock(lx, static_cast<uint32_t>(y), lz);
+              if (id == kAirBlock)
+                continue;
+              highest_block = std::max(highest_block, y);
+              if (block_map::IsOpaque(id))
+              {
+                height = static_cast<int16_t>(y);
+                break;
+              }
+            }
+          }
+          heights[static_cast<size_t>(z * kRegionWidth + x)] = height;
+        }
+      }
+
+      // Above this, nothing blocks the sky and no emitter reaches.
+      const int top = std::min(highest_block + 1 + static_cast<int>(kMaxLight), static_cast<int>(kChunkHeight));
+      const size_t cell_count = static_cast<size_t>(top) * kRegionLayer;
+      scratch.opaque.assign(cell_count, 0);
+      scratch.sky.assign(cell_count, 0);
+      scratch.block.assign(cell_count, 0);
+
+      for (int z = 0; z < kRegionWidth; ++z)
+      {
+        for (int x = 0; x < kRegionWidth; ++x)
+        {
+          const size_t column = static_cast<size_t>(z * kRegionWidth + x);
+          const Chunk* column_chunk = area.Get((x >> 4) - 1, (z >> 4) - 1);
+          const int height = heights[column];
+          for (int y = height + 1; y < top; ++y)
+            scratch.sky[static_cast<size_t>(y) * kRegionLayer + column] = kMaxLight;
+          if (!column_chunk)
+            continue;
+
+          const uint32_t lx = static_cast<uint32_t>(x) & 15u;
+          const uint32_t lz = static_cast<uint32_t>(z) & 15u;
+          for (int y = 0; y < std::min(top, highest_block + 1); ++y)
+          {
+            const BlockId id = column_chunk->GetBlock(lx, static_cast<uint32_t>(y), lz);
+            if (id == kAirBlock)
+              continue;
+            const size_t cell = static_cast<size_t>(y) * kRegionLayer + column;
+            scratch.opaque[cell] = block_map::IsOpaque(id);
+            const uint8_t emission = block_map::GetEmission(id);
+            if (emission > 0)
+            {
+              scratch.block[cell] = emission;
+              scratch.queue.push_back(static_cast<uint32_t>(cell));
+            }
+          }
+        }
+      }
+      FloodRegion(scratch.block, scratch.opaque, scratch.queue, top, false);
+
+      // Sky light only needs to spread from the open cells that have darker cells beside them.
+      for (int z = 0; z < kRegionWidth; ++z)
+      {
+        for (int x = 0; x < kRegionWidth; ++x)
+        {
+          const size_t column = static_cast<size_t>(z * kRegionWidth + x);
+          int neighbour_height = -1;
+          if (x > 0) neighbour_height = std::max<int>(neighbour_height, heights[column - 1]);
+          if (x < kRegionWidth - 1) neighbour_height = std::max<int>(neighbour_height, heights[column + 1]);
+          if (z > 0) neighbour_height = std::max<int>(neighbour_height, heights[column - kRegionWidth]);
+          if (z < kRegionWidth - 1) neighbour_height = std::max<int>(neighbour_height, heights[column + kRegionWidth]);
+          for (int y = heights[column] + 1; y <= std::min(neighbour_height, top - 1); ++y)
+            scratch.queue.push_back(static_cast<uint32_t>(static_cast<size_t>(y) * kRegionLayer + column));
+        }
+      }
+      FloodRegion(scratch.sky, scratch.opaque, scratch.queue, top, true);
+
+      chunk.light_data.resize(kChunkVolume);
+      for (uint32_t x = 0; x < kChunkWidth; ++x)
+      {
+        for (uint32_t z = 0; z < kChunkDepth; ++z)
+        {
+          const size_t column = static_cast<size_t>((z + kRegionOffset) * kRegionWidth + (x + kRegionOffset));
+          for (uint32_t y = 0; y < kChunkHeight; ++y)
+          {
+            uint8_t light = kSkyLight;
+            if (static_cast<int>(y) < top)
+            {
+              const size_t cell = static_cast<size_t>(y) * kRegionLayer + column;
+              light = static_cast<uint8_t>(scratch.sky[cell] << 4 | scratch.block[cell]);
+            }
+            chunk.light_data[Chunk::Index(x, y, z)] = light;
+          }
+        }
+      }
+    }
+
+    void UpdateLight(World& world, const glm::ivec3& pos, BlockId old_id, std::vector<ChunkKey>& dirty)
+    {
+      if (static_cast<uint32_t>(pos.y) >= kChunkHeight)
+        return;
+
+      EditArea area(world, BlockToChunk(pos.x), BlockToChunk(pos.z));
+      const int px = static_cast<int>(BlockToLocal(pos.x));
+      const int pz = static_cast<int>(BlockToLocal(pos.z));
+      Chunk* chunk = area.Get(px, pos.y, pz);
+      if (!chunk)
+        return;
+
+      const BlockId id = chunk->GetBlock(static_cast<uint32_t>(px), static_cast<uint32_t>(pos.y), static_cast<uint32_t>(pz));
+      const bool was_opaque = block_map::IsOpaque(old_id);
+      const bool opaque = block_map::IsOpaque(id);
+      if (was_opaque != opaque)
+        RelightChannel(area, px, pos.y, pz, 4, was_opaque);
+      if (was_opaque != opaque || block_map::GetEmission(old_id) != block_map::GetEmission(id))
+        RelightChannel(area, px, pos.y, pz, 0, was_opaque);
+      area.AppendDirty(dirty);
+    }
+
+  }  // namespace world
+
+}  // namespace heh
@@ -0,0 +1,216 @@
+#include "world/map_renderer.hpp"
+
+#include "utils/job_system.hpp"
+#include "utils/toml_extended.hpp"
+
+// libs
+// Private copies: the client defines the public stb functions in its own main.cpp.
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+namespace heh {
+
+  namespace world {
+
+    namespace {
+
+      constexpr uint8_t kGrey = 128;
+
+      // Relief against the column to the north, then a tint by altitude.
+      constexpr float kShadeHigher = 1.12f;
+      constexpr float kShadeLevel = 1.0f;
+      constexpr float kShadeLower = 0.82f;
+      constexpr float kAltitudeTint = 0.35f;
+
+      uint8_t Shade(uint8_t value, float factor)
+      {
+        return static_cast<uint8_t>(std::min(static_cast<float>(value) * factor, 255.0f));
+      }
+
+    }  // namespace
+
+    MapRenderer::MapRenderer(ChunkStorage& storage, JobSystem& jobs)
+      : storage_(storage),
+        jobs_(jobs)
+    {
+    }
+
+    void MapRenderer::LoadColours(const std::string& texture_directory)
+    {
+      colours_.clear();
+      for (const auto& [name, block] : config::file.blocks)
+      {
+        if (block.id >= colours_.size())
+          colours_.resize(block.id + 1, Colour{ kGrey, kGrey, kGrey });
+
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        const std::string path = texture_directory + "/" + block.top + ".png";
+        unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (!pixels)
+          continue;
+
+        // Weighted by alpha, so the holes of flowers and leaves do not darken them.
+        uint64_t sum[3] = { 0, 0, 0 };
+        uint64_t weight = 0;
+        for (int i = 0; i < width * height; ++i)
+        {
+          const unsigned char* pixel = pixels + i * 4;
+          for (int c = 0; c < 3; ++c)
+            sum[c] += static_cast<uint64_t>(pixel[c]) * pixel[3];
+          weight += pixel[3];
+        }
+        stbi_image_free(pixels);
+        if (weight > 0)
+        {
+          colours_[block.id] = { static_cast<uint8_t>(sum[0] / weight), static_cast<uint8_t>(sum[1] / weight),
+                                 static_cast<uint8_t>(sum[2] / weight) };
+        }
+      }
+    }
+
+    long MapRenderer::RenderTile(int32_t region_x, int32_t region_z, const std::string& path) const
+    {
+      const std::vector<ChunkSurface> surfaces = storage_.LoadRegionSurfaces(region_x, region_z);
+
+      // Tile-wide so the relief can look one column north across chunk borders.
+      constexpr int32_t kSize = kTileSize;
+      std::vector<BlockId> tops(static_cast<size_t>(kSize * kSize), kAirBlock);
+      std::vector<int16_t> heights(static_cast<size_t>(kSize * kSize), -1);
+      for (const ChunkSurface& surface : surfaces)
+      {
+        const int32_t base_x = (surface.x - region_x * ChunkStorage::kRegionWidth) * static_cast<int32_t>(kChunkWidth);
+        const int32_t base_z = (surface.z - region_z * ChunkStorage::kRegionWidth) * static_cast<int32_t>(kChunkDepth);
+        for (int32_t x = 0; x < static_cast<int32_t>(kChunkWidth); ++x)
+        {
+          for (int32_t z = 0; z < static_cast<int32_t>(kChunkDepth); ++z)
+          {
+            const size_t column = static_cast<size_t>(x * static_cast<int32_t>(kChunkDepth) + z);
+            if (surface.top[column] == kAirBlock)
+              continue;
+            const size_t pixel = static_cast<size_t>((base_z + z) * kSize + base_x + x);
+            tops[pixel] = surface.top[column];
+            heights[pixel] = surface.height[column];
+          }
+        }
+      }
+
+      // Rows run north to south (z), columns west to east (x).
+      std::vector<uint8_t> image(static_cast<size_t>(kSize * kSize) * 4, 0);
+      for (int32_t z = 0; z < kSize; ++z)
+      {
+        for (int32_t x = 0; x < kSize; ++x)
+        {
+          const size_t pixel = static_cast<size_t>(z * kSize + x);
+          const int16_t height = heights[pixel];
+          if (height < 0)
+            continue;
+          const size_t id = static_cast<uint16_t>(tops[pixel]);
+          const Colour colour = id < colours_.size() ? colours_[id] : Colour{ kGrey, kGrey, kGrey };
+
+          // The first row has nothing north of it in the tile and stays level.
+          const int16_t north = z > 0 && heights[pixel - kSize] >= 0 ? heights[pixel - kSize] : height;
+          float factor = height > north ? kShadeHigher : (height < north ? kShadeLower : kShadeLevel);
+          factor *= 1.0f - kAltitudeTint * 0.5f + kAltitudeTint * static_cast<float>(height) / kChunkHeight;
+
+          uint8_t* out = image.data() + pixel * 4;
+          out[0] = Shade(colour.r, factor);
+          out[1] = Shade(colour.g, factor);
+          out[2] = Shade(colour.b, factor);
+          out[3] = 255;
+        }
+      }
+
+      if (!stbi_write_png(path.c_str(), kSize, kSize, 4, image.data(), kSize * 4))
+        return -1;
+      return static_cast<long>(surfaces.size());
+    }
+
+    MapStats MapRenderer::Render(const std::string& output_directory, bool force)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      std::error_code error;
+      std::filesystem::create_directories(output_directory, error);
+      if (error)
+        throw std::runtime_error("Failed to create map directory " + output_directory + ": " + error.message());
+
+      // Region versions the existing tiles were drawn from.
+      const std::string index_path = output_directory + "/tiles.txt";
+      std::map<ChunkKey, uint64_t> drawn;
+      {
+        std::ifstream in(index_path);
+        int32_t x = 0;
+        int32_t z = 0;
+        uint64_t version = 0;
+        while (in >> x >> z >> version)
+          drawn[PackChunkKey(x, z)] = version;
+      }
+
+      struct Tile {
+        ChunkKey key;
+        uint64_t version;
+        std::string path;
+      };
+      std::vector<Tile> tiles;
+      MapStats stats;
+      const std::vector<ChunkKey> regions = storage_.ListRegions();
+      stats.regions = regions.size();
+      for (ChunkKey key : regions)
+      {
+        const uint64_t version = storage_.GetRegionVersion(ChunkKeyX(key), ChunkKeyZ(key));
+        const std::string path = output_directory + "/r." + std::to_string(ChunkKeyX(key)) + "." +
+                                 std::to_string(ChunkKeyZ(key)) + ".png";
+        auto it = drawn.find(key);
+        if (force || it == drawn.end() || it->second != version || !std::filesystem::exists(path))
+          tiles.push_back({ key, version, path });
+      }
+
+      std::vector<long> results(tiles.size(), -1);
+      jobs_.ParallelFor(tiles.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+          results[i] = RenderTile(ChunkKeyX(tiles[i].key), ChunkKeyZ(tiles[i].key), tiles[i].path);
+      });
+
+      // Only tiles that were written count as drawn, so a failed one is retried next run.
+      std::string failed;
+      for (size_t i = 0; i < tiles.size(); ++i)
+      {
+        if (results[i] < 0)
+        {
+          failed = tiles[i].path;
+          drawn.erase(tiles[i].key);
+          continue;
+        }
+        drawn[tiles[i].key] = tiles[i].version;
+        ++stats.rendered;
+        stats.chunks += static_cast<size_t>(results[i]);
+      }
+
+      std::ofstream out(index_path, std::ios::trunc);
+      for (const auto& [key, version] : drawn)
+        out << ChunkKeyX(key) << ' ' << ChunkKeyZ(key) << ' ' << version << '\n';
+      if (!out)
+        throw std::runtime_error("Failed to write map index " + index_path);
+      if (!failed.empty())
+        throw std::runtime_error("Failed to write map tile " + failed);
+
+      stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      return stats;
+    }
+
+  }  // namespace world
+
+}  // namespace heh
@@ -0,0 +1,98 @@
+#include "world/noise.hpp"
+
+namespace heh {
+
+  namespace world {
+
+    void Fractal2(const float* x, const float* y, uint32_t seed, const FractalSettings& settings, float* out)
+    {
+      float sum[kNoiseLanes] = {};
+      float frequency = settings.frequency;
+      float amplitude = 1.0f;
+      float total_amplitude = 0.0f;
+
+      for (int octave = 0; octave < settings.octaves; ++octave)
+      {
+        const uint32_t octave_seed = seed + static_cast<uint32_t>(octave) * 0x9E3779B9u;
+
+        // Straight-line, branch-free body: vectorized across the lanes.
+        for (int lane = 0; lane < kNoiseLanes; ++lane)
+          sum[lane] += amplitude * Simplex2(x[lane] * frequency, y[lane] * frequency, octave_seed);
+
+        total_amplitude += amplitude;
+        frequency *= settings.lacunarity;
+        amplitude *= settings.gain;
+      }
+
+      const float scale = total_amplitude > 0.0f ? 1.0f / total_amplitude : 0.0f;
+      for (int lane = 0; lane < kNoiseLanes; ++lane)
+        out[lane] = sum[lane] * scale;
+    }
+
+    float Fractal2(float x, float y, uint32_t seed, const FractalSettings& settings)
+    {
+      float sum = 0.0f;
+      float frequency = settings.frequency;
+      float amplitude = 1.0f;
+      float total_amplitude = 0.0f;
+
+      for (int octave = 0; octave < settings.octaves; ++octave)
+      {
+        const uint32_t octave_seed = seed + static_cast<uint32_t>(octave) * 0x9E3779B9u;
+        sum += amplitude * Simplex2(x * frequency, y * frequency, octave_seed);
+        total_amplitude += amplitude;
+        frequency *= settings.lacunarity;
+        amplitude *= settings.gain;
+      }
+
+      const float scale = total_amplitude > 0.0f ? 1.0f / total_amplitude : 0.0f;
+      return sum * scale;
+    }
+
+    void Fractal3(const float* x, const float* y, const float* z, uint32_t seed, const FractalSettings& settings, float* out)
+    {
+      float sum[kNoiseLanes] = {};
+      float frequency = settings.frequency;
+      float amplitude = 1.0f;
+      float total_amplitude = 0.0f;
+
+      for (int octave = 0; octave < settings.octaves; ++octave)
+      {
+        const uint32_t octave_seed = seed + static_cast<uint32_t>(octave) * 0x9E3779B9u;
+
+        for (int lane = 0; lane < kNoiseLanes; ++lane)
+          sum[lane] += amplitude * Simplex3(x[lane] * frequency, y[lane] * frequency, z[lane] * frequency, octave_seed);
+
+        total_amplitude += amplitude;
+        frequency *= settings.lacunarity;
+        amplitude *= settings.gain;
+      }
+
+      const float scale = total_amplitude > 0.0f ? 1.0f / total_amplitude : 0.0f;
+      for (int lane = 0; lane < kNoiseLanes; ++lane)
+        out[lane] = sum[lane] * scale;
+    }
+
+    float Fractal3(float x, float y, float z, uint32_t seed, const FractalSettings& settings)
+    {
+      float sum = 0.0f;
+      float frequency = settings.frequency;
+      float amplitude = 1.0f;
+      float total_amplitude = 0.0f;
+
+      for (int octave = 0; octave < settings.octaves; ++octave)
+      {
+        const uint32_t octave_seed = seed + static_cast<uint32_t>(octave) * 0x9E3779B9u;
+        sum += amplitude * Simplex3(x * frequency, y * frequency, z * frequency, octave_seed);
+        total_amplitude += amplitude;
+        frequency *= settings.lacunarity;
+        amplitude *= settings.gain;
+      }
+
+      const float scale = total_amplitude > 0.0f ? 1.0f / total_amplitude : 0.0f;
+      return sum * scale;
+    }
+
+  }  // namespace world
+
+}  // namespace heh
@@ -0,0 +1,139 @@
+#include "world/physics.hpp"
+
+#include "utils/job_system.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace heh {
+
+  namespace world {
+
+    namespace {
+
+      constexpr size_t kBodiesPerJob = 64;
+
+      // Tolerance for boxes that end a step touching a block, up to float rounding.
+      constexpr float kEpsilon = 1e-4f;
+
+      // Solid block boxes of the current sweep, reused between calls.
+      thread_local std::vector<Aabb> solid_boxes;
+
+      int32_t BlockAt(float v) { return static_cast<int32_t>(std::floor(v + 0.5f)); }
+
+      bool IsSolidAt(BlockAccessor& blocks, int32_t x, int32_t y, int32_t z)
+      {
+        if (y < 0)
+          return true;
+        if (y >= static_cast<int32_t>(kChunkHeight))
+          return false;
+        const Chunk* chunk = blocks.GetChunk(BlockToChunk(x), BlockToChunk(z));
+        if (!chunk || chunk->status < ChunkStatus::kFeatures)
+          return true;
+        return block_map::IsSolid(chunk->GetBlock(BlockToLocal(x), static_cast<uint32_t>(y), BlockToLocal(z)));
+      }
+
+      bool Overlaps(const Aabb& a, const Aabb& b, int axis)
+      {
+        return a.min[axis] < b.max[axis] - kEpsilon && a.max[axis] > b.min[axis] + kEpsilon;
+      }
+
+      /**
+       * @brief Shortens motion along axis so box stops at the first block in the way.
+       */
+      float ClipAxis(const Aabb& box, float motion, int axis)
+      {
+        const int u = (axis + 1) % 3;
+        const int v = (axis + 2) % 3;
+        for (const Aabb& block : solid_boxes)
+        {
+          if (!Overlaps(box, block, u) || !Overlaps(box, block, v))
+            continue;
+          if (motion > 0.0f && box.max[axis] <= block.min[axis] + kEpsilon)
+            motion = std::min(motion, block.min[axis] - box.max[axis]);
+          else if (motion < 0.0f && box.min[axis] >= block.max[axis] - kEpsilon)
+            motion = std::max(motion, block.max[axis] - box.min[axis]);
+        }
+        return motion;
+      }
+
+    }  // namespace
+
+    glm::vec3 SweepAabb(BlockAccessor& blocks, const Aabb& box, const glm::vec3& motion)
+    {
+      // Broadphase: the solid blocks overlapping the box at its start and end positions.
+      const glm::vec3 low = glm::min(box.min, box.min + motion) - kEpsilon;
+      const glm::vec3 high = glm::max(box.max, box.max + motion) + kEpsilon;
+      const glm::ivec3 first(BlockAt(low.x), BlockAt(low.y), BlockAt(low.z));
+      const glm::ivec3 last(BlockAt(high.x), BlockAt(high.y), BlockAt(high.z));
+
+      solid_boxes.clear();
+      for (int32_t x = first.x; x <= last.x; ++x)
+      {
+        for (int32_t z = first.z; z <= last.z; ++z)
+        {
+          for (int32_t y = first.y; y <= last.y; ++y)
+          {
+            if (!IsSolidAt(blocks, x, y, z))
+              continue;
+            const glm::vec3 centre(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+            solid_boxes.push_back({ centre - 0.5f, centre + 0.5f });
+          }
+        }
+      }
+
+      Aabb moved = box;
+      glm::vec3 applied(0.0f);
+      for (int axis : { 1, 0, 2 })
+      {
+        if (motion[axis] == 0.0f)
+          continue;
+        applied[axis] = ClipAxis(moved, motion[axis], axis);
+        moved.min[axis] += applied[axis];
+        moved.max[axis] += applied[axis];
+      }
+      return applied;
+    }
+
+    void StepBody(BlockAccessor& blocks, Body& body, float dt)
+    {
+      const Chunk* chunk = blocks.GetChunk(BlockToChunk(BlockAt(body.position.x)), BlockToChunk(BlockAt(body.position.z)));
+      if (!chunk || chunk->status < ChunkStatus::kFeatures)
+        return;
+
+      if (body.gravity)
+        body.velocity.y = std::max(body.velocity.y - kGravity * dt, -kTerminalVelocity);
+
+      const glm::vec3 motion = body.velocity * dt;
+      const glm::vec3 applied = SweepAabb(blocks, body.GetBounds(), motion);
+      body.position += applied;
+
+      body.on_ground = motion.y < 0.0f && applied.y > motion.y;
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        if (applied[axis] != motion[axis])
+          body.velocity[axis] = 0.0f;
+      }
+    }
+
+    void StepBodies(const World& world, Body* bodies, size_t count, float dt, JobSystem* jobs)
+    {
+      auto step_range = [&](size_t begin, size_t end) {
+        BlockAccessor accessor(world);
+        for (size_t i = begin; i < end; ++i)
+          StepBody(accessor, bodies[i], dt);
+      };
+
+      if (!jobs || count <= kBodiesPerJob)
+      {
+        step_range(0, count);
+        return;
+      }
+      jobs->ParallelFor(count, kBodiesPerJob, step_range);
+    }
+
+  }  // namespace world
+
+}  // namespace heh
@@ -0,0 +1,117 @@
+#include "world/raycast.hpp"
+
+#include "utils/job_system.hpp"
+
+// std
+#include <cmath>
+#include <limits>
+
+namespace heh {
+
+  namespace world {
+
+    namespace {
+
+      constexpr size_t kRaysPerJob = 64;
+
+      bool Cast(BlockAccessor& accessor, const Ray& ray, float max_distance, RaycastHit& hit)
+      {
+        hit = RaycastHit{};
+
+        // Shift by half a block so block p spans [p, p + 1) and the cell is a floor.
+        const glm::vec3 origin = ray.origin + 0.5f;
+        const glm::vec3& dir = ray.direction;
+        constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+        glm::ivec3 cell(static_cast<int32_t>(std::floor(origin.x)),
+                        static_cast<int32_t>(std::floor(origin.y)),
+                        static_cast<int32_t>(std::floor(origin.z)));
+        glm::ivec3 step(0);
+        glm::vec3 t_max(kInfinity);    // Ray distance to the next boundary on each axis.
+        glm::vec3 t_delta(kInfinity);  // Ray distance between boundaries on each axis.
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          if (dir[axis] > 0.0f)
+          {
+            step[axis] = 1;
+            t_delta[axis] = 1.0f / dir[axis];
+            t_max[axis] = (static_cast<float>(cell[axis]) + 1.0f - origin[axis]) * t_delta[axis];
+          }
+          else if (dir[axis] < 0.0f)
+          {
+            step[axis] = -1;
+            t_delta[axis] = -1.0f / dir[axis];
+            t_max[axis] = (origin[axis] - static_cast<float>(cell[axis])) * t_delta[axis];
+          }
+        }
+
+        const int32_t height = static_cast<int32_t>(kChunkHeight);
+        glm::ivec3 normal(0);
+        float distance = 0.0f;
+
+        for (;;)
+        {
+          // Nothing to hit once the ray has left the world vertically for good.
+          if ((cell.y >= height && step.y >= 0) || (cell.y < 0 && step.y <= 0))
+            return false;
+
+          if (static_cast<uint32_t>(cell.y) < kChunkHeight)
+          {
+            const Chunk* chunk = accessor.GetChunk(BlockToChunk(cell.x), BlockToChunk(cell.z));
+            if (chunk && chunk->status >= ChunkStatus::kFeatures)
+            {
+              const BlockId id = chunk->GetBlock(BlockToLocal(cell.x), static_cast<uint32_t>(cell.y), BlockToLocal(cell.z));
+              if (id != kAirBlock)
+              {
+                hit.hit = true;
+                hit.id = id;
+                hit.block = cell;
+                hit.normal = normal;
+                hit.distance = distance;
+                return true;
+              }
+            }
+          }
+
+          const int axis = t_max.x < t_max.y ? (t_max.x < t_max.z ? 0 : 2) : (t_max.y < t_max.z ? 1 : 2);
+          distance = t_max[axis];
+          if (distance > max_distance)
+            return false;
+
+          cell[axis] += step[axis];
+          t_max[axis] += t_delta[axis];
+          normal = glm::ivec3(0);
+          normal[axis] = -step[axis];
+        }
+      }
+
+    }  // namespace
+
+    bool Raycast(const World& world, const Ray& ray, float max_distance, RaycastHit& hit)
+    {
+      BlockAccessor accessor(world);
+      return Cast(accessor, ray, max_distance, hit);
+    }
+
+    void RaycastBatch(const World& world, const Ray* rays, size_t count, float max_distance, RaycastHit* hits,
+                      JobSystem* jobs)
+    {
+      // One accessor per batch: rays from the same origin keep hitting the same chunks.
+      auto cast_range = [&](size_t begin, size_t end) {
+        BlockAccessor accessor(world);
+        for (size_t i = begin; i < end; ++i)
+          Cast(accessor, rays[i], max_distance, hits[i]);
+      };
+
+      if (!jobs || count <= kRaysPerJob)
+      {
+        cast_range(0, count);
+        return;
+      }
+      jobs->ParallelFor(count, kRaysPerJob, cast_range);
+    }
+
+  }  // namespace world
+
+}  // namespace heh
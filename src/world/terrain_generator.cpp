@@ -0,0 +1,364 @@
+#include "world/terrain_generator.hpp"
+
+// std
+#include <algorithm>
+#include <vector>
+
+namespace heh {
+
+  namespace world {
+
+    static_assert(kChunkWidth == kNoiseLanes, "One noise batch must cover one row of a chunk");
+    static_assert(kSectionHeight % TerrainGenerator::kCaveCellHeight == 0, "Cave cells must not straddle sections");
+
+    namespace {
+
+      constexpr int32_t kTreeReach = 2;          ///< Leaves reach this far from the trunk.
+      constexpr uint32_t kTreesPerMille = 6;     ///< Chance of a tree per grass column.
+      constexpr uint32_t kFlowersPerMille = 25;  ///< Chance of a flower per grass column.
+      constexpr uint32_t kTreeSalt = 0x7f4a7c15u;
+      constexpr uint32_t kFlowerSalt = 0x94d049bbu;
+
+      constexpr uint32_t kCaveCellsX = kChunkWidth / TerrainGenerator::kCaveCellWidth;
+      constexpr uint32_t kCaveCellsY = kChunkHeight / TerrainGenerator::kCaveCellHeight;
+      constexpr uint32_t kCaveCellsZ = kChunkDepth / TerrainGenerator::kCaveCellWidth;
+      // Lattice levels along Y, rounded up to whole noise batches.
+      constexpr uint32_t kCaveLevels = (kCaveCellsY + 1 + kNoiseLanes - 1) / kNoiseLanes * kNoiseLanes;
+
+      enum class CaveCell : uint8_t {
+        kSolid,   ///< All corners <= 0: nothing carved.
+        kCarved,  ///< All corners > 0: everything carved.
+        kMixed,   ///< Interpolate per block.
+      };
+
+    }  // namespace
+
+    namespace {
+
+      TerrainGenerator::Settings SeededSettings(uint32_t seed)
+      {
+        TerrainGenerator::Settings settings;
+        settings.seed = seed;
+        return settings;
+      }
+
+    }  // namespace
+
+    TerrainGenerator::TerrainGenerator(uint32_t seed)
+      : TerrainGenerator(SeededSettings(seed))
+    {
+    }
+
+    TerrainGenerator::TerrainGenerator(const Settings& settings)
+      : settings_(settings)
+    {
+      // Ids are resolved once; blocks.toml files from before these blocks existed fall back to grass.
+      grass_ = static_cast<BlockId>(block_map::FindBlockId("grass", 1));
+      stone_ = static_cast<BlockId>(block_map::FindBlockId("stone", grass_));
+      cobblestone_ = static_cast<BlockId>(block_map::FindBlockId("cobblestone", stone_));
+      // Missing decoration blocks disable the feature instead.
+      log_ = static_cast<BlockId>(block_map::FindBlockId("wood_log", kAirBlock));
+      leaves_ = static_cast<BlockId>(block_map::FindBlockId("leaves", kAirBlock));
+      flowers_[0] = static_cast<BlockId>(block_map::FindBlockId("flower_red", kAirBlock));
+      flowers_[1] = static_cast<BlockId>(block_map::FindBlockId("flower_yellow", flowers_[0]));
+    }
+
+    int32_t TerrainGenerator::NoiseToHeight(float n) const
+    {
+      const int32_t height = settings_.base_height + static_cast<int32_t>(n * static_cast<float>(settings_.height_range));
+      return std::clamp<int32_t>(height, 4, static_cast<int32_t>(kChunkHeight) - 2);
+    }
+
+    void TerrainGenerator::GenerateHeightmap(int32_t chunk_x, int32_t chunk_z, int32_t* heights) const
+    {
+      float xs[kNoiseLanes];
+      float zs[kNoiseLanes];
+      float n[kNoiseLanes];
+
+      const int32_t origin_x = chunk_x * static_cast<int32_t>(kChunkWidth);
+      const int32_t origin_z = chunk_z * static_cast<int32_t>(kChunkDepth);
+      for (int lane = 0; lane < kNoiseLanes; ++lane)
+        xs[lane] = static_cast<float>(origin_x + lane);
+
+      // One batch per row: the 16 columns of a row go through the noise together.
+      for (uint32_t z = 0; z < kChunkDepth; ++z)
+      {
+        for (int lane = 0; lane < kNoiseLanes; ++lane)
+          zs[lane] = static_cast<float>(origin_z + static_cast<int32_t>(z));
+
+        Fractal2(xs, zs, settings_.seed, settings_.height_noise, n);
+
+        for (int lane = 0; lane < kNoiseLanes; ++lane)
+          heights[z * kChunkWidth + lane] = NoiseToHeight(n[lane]);
+      }
+    }
+
+    int32_t TerrainGenerator::GetHeight(int32_t x, int32_t z) const
+    {
+      return NoiseToHeight(Fractal2(static_cast<float>(x), static_cast<float>(z), settings_.seed, settings_.height_noise));
+    }
+
+    void TerrainGenerator::Generate(Chunk& chunk) const
+    {
+      int32_t heights[kChunkWidth * kChunkDepth];
+      GenerateHeightmap(chunk.x, chunk.z, heights);
+      FillColumns(chunk, heights);
+      CarveCaves(chunk, heights);
+    }
+
+    void TerrainGenerator::FillColumns(Chunk& chunk, const int32_t* heights) const
+    {
+      chunk.blocks_data.resize(kChunkVolume);
+      BlockId* blocks = chunk.blocks_data.data();
+
+      const int32_t origin_x = chunk.x * static_cast<int32_t>(kChunkWidth);
+      const int32_t origin_z = chunk.z * static_cast<int32_t>(kChunkDepth);
+
+      for (uint32_t x = 0; x < kChunkWidth; ++x)
+      {
+        for (uint32_t z = 0; z < kChunkDepth; ++z)
+        {
+          const int32_t height = heights[z * kChunkWidth + x];
+          // 1..3 blocks of cobblestone at the bottom of the world.
+          const int32_t floor_top = 1 + static_cast<int32_t>(
+            noise_detail::Hash(origin_x + static_cast<int32_t>(x), origin_z + static_cast<int32_t>(z), settings_.seed) % 3u);
+
+          // A column is 16 contiguous ids per section (see Chunk::Index).
+          for (uint32_t section = 0; section < kSectionsPerChunk; ++section)
+          {
+            BlockId* run = blocks + Chunk::Index(x, section * kSectionHeight, z);
+            const int32_t base_y = static_cast<int32_t>(section * kSectionHeight);
+
+            if (base_y > height)
+            {
+              std::fill(run, run + kSectionHeight, kAirBlock);
+              continue;
+            }
+
+            for (uint32_t i = 0; i < kSectionHeight; ++i)
+            {
+              const int32_t y = base_y + static_cast<int32_t>(i);
+              run[i] = y < floor_top ? cobblestone_
+                : y < height ? stone_
+                : y == height ? grass_
+                : kAirBlock;
+            }
+          }
+        }
+      }
+    }
+
+    void TerrainGenerator::PlaceFeatures(Chunk& chunk, const ChunkNeighbourhood& area) const
+    {
+      const int32_t origin_x = chunk.x * static_cast<int32_t>(kChunkWidth);
+      const int32_t origin_z = chunk.z * static_cast<int32_t>(kChunkDepth);
+      constexpr int32_t kWidth = static_cast<int32_t>(kChunkWidth);
+      constexpr int32_t kDepth = static_cast<int32_t>(kChunkDepth);
+      constexpr int32_t kHeight = static_cast<int32_t>(kChunkHeight);
+
+      // Features only fill air, so overlapping trees resolve the same way in every chunk.
+      auto place = [&chunk](int32_t x, int32_t y, int32_t z, BlockId id) {
+        if (x < 0 || x >= kWidth || z < 0 || z >= kDepth || y < 0 || y >= kHeight)
+          return;
+        const uint32_t index = Chunk::Index(static_cast<uint32_t>(x), static_cast<uint32_t>(y), static_cast<uint32_t>(z));
+        if (chunk.blocks_data[index] == kAirBlock)
+          chunk.blocks_data[index] = id;
+      };
+
+      struct Tree {
+        int32_t x;       ///< Local to chunk, may be outside it by up to kTreeReach.
+        int32_t base_y;  ///< Lowest log.
+        int32_t z;
+        int32_t height;
+        uint32_t hash;
+      };
+      std::vector<Tree> trees;
+
+      if (log_ != kAirBlock && leaves_ != kAirBlock)
+      {
+        for (int32_t z = -kTreeReach; z < kDepth + kTreeReach; ++z)
+        {
+          for (int32_t x = -kTreeReach; x < kWidth + kTreeReach; ++x)
+          {
+            const uint32_t hash = noise_detail::Hash(origin_x + x, origin_z + z, settings_.seed ^ kTreeSalt);
+            if (hash % 1000u >= kTreesPerMille)
+              continue;
+            const int32_t ground = GetHeight(origin_x + x, origin_z + z);
+            // The surface may have been carved away by a cave.
+            if (area.GetBlock(x, ground, z) != grass_ || ground + 8 >= kHeight)
+              continue;
+            trees.push_back({ x, ground + 1, z, 4 + static_cast<int32_t>((hash >> 10) % 3u), hash });
+          }
+        }
+      }
+
+      // Trunks first so leaves of a neighbouring tree never cut one.
+      for (const Tree& tree : trees)
+      {
+        for (int32_t i = 0; i < tree.height; ++i)
+          place(tree.x, tree.base_y + i, tree.z, log_);
+      }
+
+      for (const Tree& tree : trees)
+      {
+        const int32_t top = tree.base_y + tree.height - 1;
+        for (int32_t dy = -2; dy <= 1; ++dy)
+        {
+          const int32_t radius = dy < 0 ? 2 : 1;
+          for (int32_t dz = -radius; dz <= radius; ++dz)
+          {
+            for (int32_t dx = -radius; dx <= radius; ++dx)
+            {
+              // Trim the corners: always on the top layer, by chance below it.
+              const bool corner = (dx == -radius || dx == radius) && (dz == -radius || dz == radius);
+              const uint32_t corner_bit = static_cast<uint32_t>((dy + 2) * 4 + (dx > 0 ? 2 : 0) + (dz > 0 ? 1 : 0));
+              if (corner && (dy == 1 || ((tree.hash >> (16 + corner_bit % 16)) & 1u)))
+                continue;
+              place(tree.x + dx, top + dy, tree.z + dz, leaves_);
+            }
+          }
+        }
+      }
+
+      if (flowers_[0] == kAirBlock)
+        return;
+
+      for (int32_t z = 0; z < kDepth; ++z)
+      {
+        for (int32_t x = 0; x < kWidth; ++x)
+        {
+          const uint32_t hash = noise_detail::Hash(origin_x + x, origin_z + z, settings_.seed ^ kFlowerSalt);
+          if (hash % 1000u >= kFlowersPerMille)
+            continue;
+          const int32_t ground = GetHeight(origin_x + x, origin_z + z);
+          if (ground + 1 >= kHeight || chunk.GetBlock(static_cast<uint32_t>(x), static_cast<uint32_t>(ground), static_cast<uint32_t>(z)) != grass_)
+            continue;
+          place(x, ground + 1, z, flowers_[(hash >> 12) & 1u]);
+        }
+      }
+    }
+
+    void TerrainGenerator::CarveCaves(Chunk& chunk, const int32_t* heights) const
+    {
+      if (settings_.cave_threshold >= 1.0f)
+        return;
+
+      int32_t max_height = 0;
+      for (uint32_t i = 0; i < kChunkWidth * kChunkDepth; ++i)
+        max_height = std::max(max_height, heights[i]);
+      // Cells entirely above the terrain are air already.
+      const uint32_t cells_y = std::min<uint32_t>(static_cast<uint32_t>(max_height) / kCaveCellHeight + 1, kCaveCellsY);
+
+      // density[lx][lz][ly] = cave noise - threshold at the lattice points.
+      float density[kCaveCellsX + 1][kCaveCellsZ + 1][kCaveLevels];
+
+      const int32_t origin_x = chunk.x * static_cast<int32_t>(kChunkWidth);
+      const int32_t origin_z = chunk.z * static_cast<int32_t>(kChunkDepth);
+      const uint32_t cave_seed = settings_.seed ^ 0x5bd1e995u;
+
+      float xs[kNoiseLanes];
+      float ys[kNoiseLanes];
+      float zs[kNoiseLanes];
+      for (uint32_t lx = 0; lx <= kCaveCellsX; ++lx)
+      {
+        for (uint32_t lz = 0; lz <= kCaveCellsZ; ++lz)
+        {
+          for (int lane = 0; lane < kNoiseLanes; ++lane)
+          {
+            xs[lane] = static_cast<float>(origin_x + static_cast<int32_t>(lx * kCaveCellWidth));
+            zs[lane] = static_cast<float>(origin_z + static_cast<int32_t>(lz * kCaveCellWidth));
+          }
+
+          // One batch covers kNoiseLanes levels of the lattice column.
+          for (uint32_t level = 0; level <= cells_y; level += kNoiseLanes)
+          {
+            for (int lane = 0; lane < kNoiseLanes; ++lane)
+              ys[lane] = static_cast<float>((level + static_cast<uint32_t>(lane)) * kCaveCellHeight);
+
+            float* out = &density[lx][lz][level];
+            Fractal3(xs, ys, zs, cave_seed, settings_.cave_noise, out);
+            for (int lane = 0; lane < kNoiseLanes; ++lane)
+              out[lane] -= settings_.cave_threshold;
+          }
+        }
+      }
+
+      // Trilinear interpolation stays within the corner range, so agreeing corners decide the whole cell.
+      CaveCell cells[kCaveCellsX][kCaveCellsZ][kCaveCellsY];
+      for (uint32_t cx = 0; cx < kCaveCellsX; ++cx)
+      {
+        for (uint32_t cz = 0; cz < kCaveCellsZ; ++cz)
+        {
+          for (uint32_t cy = 0; cy < cells_y; ++cy)
+          {
+            int positive = 0;
+            for (uint32_t corner = 0; corner < 8; ++corner)
+              positive += density[cx + (corner & 1)][cz + ((corner >> 1) & 1)][cy + (corner >> 2)] > 0.0f ? 1 : 0;
+            cells[cx][cz][cy] = positive == 0 ? CaveCell::kSolid : positive == 8 ? CaveCell::kCarved : CaveCell::kMixed;
+          }
+        }
+      }
+
+      BlockId* blocks = chunk.blocks_data.data();
+      constexpr float kInvCellWidth = 1.0f / static_cast<float>(kCaveCellWidth);
+      constexpr float kInvCellHeight = 1.0f / static_cast<float>(kCaveCellHeight);
+
+      for (uint32_t x = 0; x < kChunkWidth; ++x)
+      {
+        const uint32_t cx = x / kCaveCellWidth;
+        const float fx = static_cast<float>(x % kCaveCellWidth) * kInvCellWidth;
+
+        for (uint32_t z = 0; z < kChunkDepth; ++z)
+        {
+          const uint32_t cz = z / kCaveCellWidth;
+          const float fz = static_cast<float>(z % kCaveCellWidth) * kInvCellWidth;
+          const int32_t height = heights[z * kChunkWidth + x];
+
+          const float* d00 = density[cx][cz];
+          const float* d10 = density[cx + 1][cz];
+          const float* d01 = density[cx][cz + 1];
+          const float* d11 = density[cx + 1][cz + 1];
+
+          for (uint32_t cy = 0; cy < cells_y; ++cy)
+          {
+            const int32_t base_y = static_cast<int32_t>(cy * kCaveCellHeight);
+            const CaveCell cell = cells[cx][cz][cy];
+            if (cell == CaveCell::kSolid || base_y > height)
+              continue;
+
+            // Cells are 8-aligned, so their blocks are a contiguous run of the column.
+            BlockId* run = blocks + Chunk::Index(x, static_cast<uint32_t>(base_y), z);
+
+            if (cell == CaveCell::kCarved)
+            {
+              for (uint32_t i = 0; i < kCaveCellHeight; ++i)
+              {
+                const int32_t y = base_y + static_cast<int32_t>(i);
+                run[i] = y >= kCaveMinY ? kAirBlock : run[i];
+              }
+              continue;
+            }
+
+            // Bilinear in XZ at the cell's bottom and top levels, then linear along Y.
+            auto bilinear = [&](uint32_t level) {
+              const float a = d00[level] + (d10[level] - d00[level]) * fx;
+              const float b = d01[level] + (d11[level] - d01[level]) * fx;
+              return a + (b - a) * fz;
+            };
+            const float bottom = bilinear(cy);
+            const float step = (bilinear(cy + 1) - bottom) * kInvCellHeight;
+
+            for (uint32_t i = 0; i < kCaveCellHeight; ++i)
+            {
+              const int32_t y = base_y + static_cast<int32_t>(i);
+              const float d = bottom + step * static_cast<float>(i);
+              run[i] = (d > 0.0f && y >= kCaveMinY) ? kAirBlock : run[i];
+            }
+          }
+        }
+      }
+    }
+
+  }  // namespace world
+
+}  // namespace heh
@@ -0,0 +1,76 @@
+#include "world/world.hpp"
+
+// std
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace heh {
+
+  namespace world {
+
+    World::World() = default;
+
+    World::~World()
+    {
+      chunks_.ForEach([](ChunkKey, Chunk* chunk) { delete chunk; });
+    }
+
+    Chunk* World::CreateChunk(int32_t x, int32_t z)
+    {
+      auto chunk = std::make_unique<Chunk>();
+      chunk->x = x;
+      chunk->z = z;
+      chunk->blocks_data.assign(kChunkVolume, kAirBlock);
+      return InsertChunk(std::move(chunk));
+    }
+
+    Chunk* World::InsertChunk(std::unique_ptr<Chunk> chunk)
+    {
+      const ChunkKey key = PackChunkKey(chunk->x, chunk->z);
+      if (!chunks_.Insert(key, chunk.get()))
+        return chunks_.Find(key);
+      return chunk.release();
+    }
+
+    bool World::UnloadChunk(int32_t x, int32_t z)
+    {
+      Chunk* chunk = chunks_.Erase(PackChunkKey(x, z));
+      if (!chunk)
+        return false;
+
+      std::lock_guard<std::mutex> lock(retired_mutex_);
+      retired_chunks_.emplace_back(chunk);
+      return true;
+    }
+
+    void World::ReclaimRetired()
+    {
+      {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        retired_chunks_.clear();
+      }
+      chunks_.ReclaimRetired();
+    }
+
+    bool World::SetBlock(int32_t x, int32_t y, int32_t z, BlockId id)
+    {
+      if (static_cast<uint32_t>(y) >= kChunkHeight)
+        return false;
+      Chunk* chunk = GetChunk(BlockToChunk(x), BlockToChunk(z));
+      if (!chunk)
+        return false;
+      chunk->SetBlock(BlockToLocal(x), static_cast<uint32_t>(y), BlockToLocal(z), id);
+      return true;
+    }
+
+    void World::GetBlocks(const glm::ivec3* positions, size_t count, BlockId* out) const
+    {
+      BlockAccessor accessor(*this);
+      for (size_t i = 0; i < count; ++i)
+        out[i] = accessor.GetBlock(positions[i]);
+    }
+
+  }  // namespace world
+
+}  // namespace heh